@@ -13,12 +13,51 @@
 #include <string.h>
 #include <stdbool.h>
 #include <math.h>
+
+/**
+ * HAL header can be overridden with compiler flag, e.g. -DNRF24L01_HAL_HEADER=\"stm32f4xx_hal.h\" for other
+ * STM32 families or a host model of the radio for load testing(see README, Host simulation).
+ */
+#ifdef NRF24L01_HAL_HEADER
+#include NRF24L01_HAL_HEADER
+#else
 #include "stm32f1xx_hal.h"
+#endif
+
+/**
+ * Size of the per-instance SPI scratch buffer: command byte + max payload size (32 bytes).
+ */
+#define NRF24L01_SPI_BUFFER_SIZE 33
+
+/**
+ * Number of received packets each RX pipe queue can hold in RAM(34 bytes per packet, 6 queues per device).
+ * MUST be a power of two. When queue is full, new packets for this pipe are dropped.
+ */
+#define NRF24L01_RX_QUEUE_DEPTH 4
+
+/**
+ * Pipe number that makes NRF24L01_ReceivePacket and NRF24L01_ReceivePacketWithSize take a packet of any pipe
+ */
+#define NRF24L01_ANY_PIPE 0xFF
 
 /**
- * Defines the cache size for NRF24L01 devices. MUST be set according to number of connected devices.
+ * Number of RF channels covered by spectrum scan(2400 - 2525 MHz)
  */
-#define NRF24L01_DEVICES 1
+#define NRF24L01_CHANNELS 126
+
+/**
+ * First byte of multi-packet message. Small messages(up to 255 packets) use 3 byte header:
+ * | 0x00 | number of packets | packet size |, larger ones use 6 byte header with 32-bit message size:
+ * | 0x01 | packet size | message size (4 bytes, MSB first) |.
+ * Compressed messages(see NRF24L01_Compression.h) use the same 6 byte header with uncompressed message size:
+ * | 0x02 | packet size | message size (4 bytes, MSB first) |
+ */
+#define NRF24L01_MESSAGE_HEADER 0x00
+#define NRF24L01_MESSAGE_HEADER_SIZE 3
+#define NRF24L01_LARGE_MESSAGE_HEADER 0x01
+#define NRF24L01_LARGE_MESSAGE_HEADER_SIZE 6
+#define NRF24L01_COMPRESSED_MESSAGE_HEADER 0x02
+#define NRF24L01_COMPRESSED_MESSAGE_HEADER_SIZE 6
 
 #define NRF24L01_CMD_DUMMY_LOAD 0xFF
 #define NRF24L01_RX_PIPE_NUMBER_EMPTY 0x07
@@ -68,7 +107,18 @@
 #define NRF24L01_REG_CONFIG_PRIM_RX_BIT_MASK 0x01
 #define NRF24L01_REG_CONFIG_PWR_UP_BIT_MASK 0x02
 #define NRF24L01_REG_STATUS_RESET_FLAGS 0x70
+#define NRF24L01_REG_STATUS_RX_DR_BIT_MASK 0x40
+#define NRF24L01_REG_STATUS_TX_DS_BIT_MASK 0x20
+#define NRF24L01_REG_STATUS_MAX_RT_BIT_MASK 0x10
+#define NRF24L01_REG_FIFO_STATUS_RX_EMPTY_BIT_MASK 0x01
+#define NRF24L01_REG_FIFO_STATUS_RX_FULL_BIT_MASK 0x02
+#define NRF24L01_REG_FIFO_STATUS_TX_EMPTY_BIT_MASK 0x10
+#define NRF24L01_REG_FIFO_STATUS_TX_FULL_BIT_MASK 0x20
+#define NRF24L01_REG_RF_SETUP_DATA_RATE_BIT_MASK 0x28
+#define NRF24L01_REG_RF_SETUP_RF_POWER_BIT_MASK 0x06
 #define NRF24L01_REG_FEATURE_ENABLE_DYNAMIC_PAYLOAD 0x04
+#define NRF24L01_REG_FEATURE_ENABLE_ACK_PAYLOAD 0x02
+#define NRF24L01_REG_FEATURE_ENABLE_DYNAMIC_ACK 0x01
 
 /**
  * @brief Address width options
@@ -201,6 +251,11 @@ typedef struct {
  * - address: 				   Address for this RX pipe
  * - size: 					   Fixed payload size (ignored if dynamic enabled)
  * - enableDynamicPayloadSize: Enable dynamic payload length
+ * - enableAckPayloadFeature:  Enable payloads attached to ACK packets(see NRF24L01_WriteAckPayload).
+ *                             Must be enabled on both sides together with dynamic payload size
+ *                             on TX pipe 0 and receiving pipe.
+ * - enableNoAckFeature:       Enable packets that are not acknowledged(see NRF24L01_TransmitPacketNoAck).
+ *                             Required on transmitter only.
  *
  * @example TX configuration:
  * NRF24L01_Config config = {
@@ -240,8 +295,258 @@ typedef struct {
 	NRF24L01_RxPipe rxPipes[6];
 	uint64_t txPipeAddress;
 	bool enableDynamicPayloadSizeFeature;
+	bool enableAckPayloadFeature;
+	bool enableNoAckFeature;
 } NRF24L01_Config;
 
+typedef struct NRF24L01_Device NRF24L01_Device;
+typedef struct NRF24L01_Compression NRF24L01_Compression;
+
+/**
+ * @brief Received packet
+ *
+ * Fields:
+ * - pipe: RX pipe number (0–5) the packet was received on
+ * - size: Payload size
+ * - data: Payload
+ */
+typedef struct {
+	uint8_t pipe;
+	uint8_t size;
+	uint8_t data[32];
+} NRF24L01_Packet;
+
+/**
+ * @brief Fixed size ring buffer of packets received on one RX pipe
+ *
+ * Single producer(driver) and single consumer(application), so it can be filled from interrupt without locking.
+ *
+ * Fields:
+ * - packets:  Packets storage
+ * - head:     Free running read counter
+ * - tail:     Free running write counter
+ */
+typedef struct {
+	NRF24L01_Packet packets[NRF24L01_RX_QUEUE_DEPTH];
+	volatile uint8_t head;
+	volatile uint8_t tail;
+} NRF24L01_RxQueue;
+
+/**
+ * @brief Traffic statistics
+ *
+ * Collected always, updating costs a few increments per packet and no extra SPI transactions,
+ * except retransmitHistogram which needs OBSERVE_TX read and is collected only if enableStatistics is true.
+ *
+ * Fields:
+ * - txPackets:           Number of transmitted packets (acknowledged ones if auto ACK is used)
+ * - txBytes:             Number of bytes in transmitted packets
+ * - txFailed:            Number of transmissions failed due to max retransmits or timeout
+ * - rxPackets:           Number of packets received on every pipe
+ * - rxBytes:             Number of bytes received on every pipe
+ * - rxDropped:           Number of packets dropped on every pipe due to RX queue overflow
+ * - latencyMin:          Min time in us from start of transmission to ACK (TX_DS)
+ * - latencyMax:          Max time in us from start of transmission to ACK
+ * - latencyAverage:      Average time in us from start of transmission to ACK
+ * - latencyTotal:        Sum of all measured latencies in us
+ * - latencyCount:        Number of measured latencies (single packet transmissions only)
+ * - retransmitHistogram: Number of transmissions by number of retransmissions they needed (0-15)
+ * - rxFifoHighWater:     Max number of payloads found in RX FIFO at once (1-3, 3 means FIFO could overflow)
+ * - rxQueueHighWater:    Max number of packets in RX queue of every pipe
+ * - spiTransactions:     Number of SPI transactions
+ */
+typedef struct {
+	uint32_t txPackets;
+	uint32_t txBytes;
+	uint32_t txFailed;
+	uint32_t rxPackets[6];
+	uint32_t rxBytes[6];
+	uint32_t rxDropped[6];
+	uint32_t latencyMin;
+	uint32_t latencyMax;
+	uint32_t latencyAverage;
+	uint64_t latencyTotal;
+	uint32_t latencyCount;
+	uint32_t retransmitHistogram[16];
+	uint8_t rxFifoHighWater;
+	uint8_t rxQueueHighWater[6];
+	uint32_t spiTransactions;
+} NRF24L01_Stats;
+
+/**
+ * @brief Event callbacks for interrupt driven operation
+ *
+ * Callbacks are invoked from NRF24L01_IRQHandler, i.e. in interrupt context. Any of them can be NULL.
+ *
+ * Fields:
+ * - onPacketReceived:  Called for every payload read from RX FIFO in RX mode. Data is valid only during the call.
+ *                      If not registered, payloads are put into RX queue and can be taken with NRF24L01_Read.
+ *                      ACK payloads are not passed here(see NRF24L01_ReadAckPayload).
+ * - onPacketSent:      Called when transmitted packet is acknowledged (TX_DS)
+ * - onMaxRetransmits:  Called when packet is dropped after max retransmits (MAX_RT). TX FIFO is flushed.
+ */
+typedef struct {
+	void (*onPacketReceived)(NRF24L01_Device *device, uint8_t pipe, const uint8_t *data, uint8_t size);
+	void (*onPacketSent)(NRF24L01_Device *device);
+	void (*onMaxRetransmits)(NRF24L01_Device *device);
+} NRF24L01_Callbacks;
+
+/**
+ * @brief Provides next part of the message being transmitted with NRF24L01_TransmitStream
+ *
+ * @param context User context passed to NRF24L01_TransmitStream
+ * @param offset Offset of the requested part in the message
+ * @param data Pointer to buffer to fill
+ * @param size Number of bytes to fill (max 32)
+ * @return true if data provided, false to abort transmission
+ */
+typedef bool (*NRF24L01_DataSource)(void *context, uint32_t offset, uint8_t *data, uint8_t size);
+
+/**
+ * @brief Consumes next part of the message being received with NRF24L01_ReceiveStream
+ *
+ * @param context User context passed to NRF24L01_ReceiveStream
+ * @param offset Offset of the part in the message
+ * @param data Pointer to received data, valid only during the call
+ * @param size Number of received bytes (max 32)
+ * @return true to continue, false to abort receiving
+ */
+typedef bool (*NRF24L01_DataSink)(void *context, uint32_t offset, const uint8_t *data, uint8_t size);
+
+/**
+ * @brief State of asynchronous(DMA) transfer
+ */
+typedef enum {
+	ASYNC_IDLE = 0x00,
+	ASYNC_TX_PAYLOAD = 0x01, //TX payload is being written by DMA
+	ASYNC_TX_WAIT = 0x02,    //Waiting for TX_DS/MAX_RT interrupt
+	ASYNC_RX_WAIT = 0x03,    //Waiting for RX_DR interrupt
+	ASYNC_RX_PAYLOAD = 0x04  //RX payload is being read by DMA
+} NRF24L01_AsyncState;
+
+/**
+ * @brief State of non-blocking operation driven by NRF24L01_Process
+ */
+typedef enum {
+	PROCESS_READY = 0x00,           //Idle, ready for next operation
+	PROCESS_POWER_ON_RESET = 0x01,  //Waiting for radio to leave power on reset state
+	PROCESS_POWER_UP = 0x02,        //Waiting for crystal to start up
+	PROCESS_TX = 0x03,              //Waiting for TX_DS/MAX_RT
+	PROCESS_RX = 0x04               //Listening, payloads are moved into RX queues
+} NRF24L01_ProcessState;
+
+/**
+ * @brief Event reported by NRF24L01_Process
+ */
+typedef enum {
+	PROCESS_EVENT_NONE = 0x00,
+	PROCESS_EVENT_READY = 0x01,           //Non-blocking initialization finished
+	PROCESS_EVENT_PACKET_SENT = 0x02,     //Packet was transmitted(and acknowledged if auto ACK is used)
+	PROCESS_EVENT_TRANSMIT_FAILED = 0x03, //Max retransmits reached or timeout occurred
+	PROCESS_EVENT_PACKET_RECEIVED = 0x04  //At least one packet was put into RX queues
+} NRF24L01_ProcessEvent;
+
+/**
+ * @brief Radio power state
+ */
+typedef enum {
+	POWER_STATE_POWER_DOWN = 0x00,
+	POWER_STATE_STANDBY = 0x01, //Standby-I, powered up with CE low
+	POWER_STATE_ACTIVE = 0x02   //TX/RX mode with CE high
+} NRF24L01_PowerState;
+
+/**
+ * @brief Power state statistics
+ *
+ * Fields:
+ * - timeInState: Time in us spent in every NRF24L01_PowerState since initialization
+ * - powerUps:    Number of transitions from power down mode, each costs powerUpDelay
+ */
+typedef struct {
+	uint64_t timeInState[3];
+	uint32_t powerUps;
+} NRF24L01_PowerStats;
+
+/**
+ * @brief NRF24L01 runtime instance
+ *
+ * Links a device with its configuration and current radio mode.
+ * Embedded into every device handle, so any number of radios can be used and
+ * the instance is reached directly from the handle.
+ *
+ * Fields:
+ * - device: Pointer to NRF24L01_Device
+ * - config: Pointer to NRF24L01_Config
+ * - mode:      Current radio mode:
+ *              0x00 = TX mode,
+ *              0x01 = RX mode,
+ *              0xFF = uninitialized
+ * - spiBuffer: Scratch buffer for register access and DMA transfers, payloads are written from and read into
+ *              caller buffers directly
+ * - callbacks: Registered event callbacks for interrupt driven operation
+ * - interruptDriven: True while interrupt driven RX or TX is active, IRQ events are ignored otherwise
+ * - asyncState: State of asynchronous(DMA) transfer
+ * - asyncBuffer: Caller buffer for asynchronous receive
+ * - asyncPipe: Pipe of payload being read by DMA
+ * - asyncSize: Size of payload being transferred by DMA
+ * - irqPending: IRQ arrived while DMA transfer or blocking SPI transaction was in progress and must be handled
+ *               after it
+ * - spiBusy: Blocking SPI transaction is in progress
+ * - rxQueues: Received packets that were not consumed yet, one queue per RX pipe
+ * - ackQueue: ACK payloads received by transmitter that were not consumed yet
+ * - lastReadPipe: Pipe served by the last NRF24L01_Read call
+ * - registers: Shadow copy of writable single byte registers indexed by address, so they are never read
+ *              before being modified. STATUS is not shadowed.
+ * - addressRegisters: Shadow copy of RX_ADDR_P0, RX_ADDR_P1 and TX_ADDR (5 bytes each)
+ * - powerState: Current radio power state
+ * - powerStateTick: HAL tick of the last power state change
+ * - powerStateCycles: DWT cycle counter value of the last power state change
+ * - lastActivityTick: HAL tick of the last finished transaction, used for power down idle timeout
+ * - powerStats: Time spent in every power state
+ * - stats: Traffic statistics
+ * - txStartCycles: DWT cycle counter value when current single packet transmission started
+ * - txSize: Size of current single packet transmission
+ * - processState: State of non-blocking operation
+ * - processNextState: State to enter once crystal has started up
+ * - processListening: Return to listening after non-blocking transmission
+ * - processTick: Tick passed to the first NRF24L01_Process call of current non-blocking operation
+ * - processTickPending: Current non-blocking operation was started and processTick is not stamped yet
+ * - powerUpCycles: DWT cycle counter value when radio was asked to power up
+ */
+typedef struct {
+	NRF24L01_Device *device;
+	NRF24L01_Config *config;
+	uint8_t mode;
+	uint8_t spiBuffer[NRF24L01_SPI_BUFFER_SIZE];
+	NRF24L01_Callbacks callbacks;
+	volatile bool interruptDriven;
+	volatile NRF24L01_AsyncState asyncState;
+	uint8_t *asyncBuffer;
+	uint8_t asyncPipe;
+	uint8_t asyncSize;
+	volatile bool irqPending;
+	volatile bool spiBusy;
+	NRF24L01_RxQueue rxQueues[6];
+	NRF24L01_RxQueue ackQueue;
+	uint8_t lastReadPipe;
+	uint8_t registers[NRF24L01_REG_FEATURE + 1];
+	uint8_t addressRegisters[3][5];
+	NRF24L01_PowerState powerState;
+	uint32_t powerStateTick;
+	uint32_t powerStateCycles;
+	volatile uint32_t lastActivityTick;
+	NRF24L01_PowerStats powerStats;
+	NRF24L01_Stats stats;
+	uint32_t txStartCycles;
+	uint8_t txSize;
+	NRF24L01_ProcessState processState;
+	NRF24L01_ProcessState processNextState;
+	bool processListening;
+	uint32_t processTick;
+	bool processTickPending;
+	uint32_t powerUpCycles;
+} NRF24L01_Instance;
+
 /**
  * @brief Main device handle
  *
@@ -253,55 +558,255 @@ typedef struct {
  * - CE_Pin:        			   Chip Enable GPIO pin
  * - CSN_Port:      			   Chip Select Not GPIO port
  * - CSN_Pin:       			   Chip Select Not GPIO pin
+ * - IRQ_Port:      			   Interrupt GPIO port (optional, NULL if IRQ pin is not connected).
+ *                  			   When set, blocking calls poll the pin instead of STATUS register over SPI.
+ * - IRQ_Pin:       			   Interrupt GPIO pin (optional)
  * - hspi:          			   Pointer to SPI handle
  * - enableStatistics: 			   If true, transmission statistics will be collected (lost & retransmitted packets)
  * - packetsLost:   			   Number of lost packets (available if enableStatistics is true).
  *                  			   This counter is cumulative since initialization or last manual reset.
  * - packetsRetransmitted: 		   Number of retransmitted packets (available if enableStatistics is true).
  *                         		   This counter is cumulative since initialization or last manual reset.
+ *                         		   See NRF24L01_GetStats for detailed statistics.
  * - powerDownBetweenTransactions: Enables power saving mode between transactions at the cost of throughput.
  *                                 Significantly reduces power usage (TX: ~2x | RX: ~4x less)
  *                                 Max transaction rate: ~150k/sec with power saving ON, ~650k/sec with it OFF.
+ * - powerUpDelay:                 Time in us the radio needs to leave power down mode (crystal start-up time).
+ *                                 Depends on crystal inductance: 1500 (Ls = 30mH), 3000 (60mH), 4500 (90mH)
+ *                                 or 150 with external clock. 0 = 4500 (worst case).
+ * - powerDownIdleTimeout:         With powerDownBetweenTransactions, radio stays in Standby-I after transaction
+ *                                 and is powered down by NRF24L01_UpdatePowerState only after this many ms without
+ *                                 activity, so bursts of transactions do not pay power up delay every time.
+ *                                 0 = power down right after every transaction.
+ * - compression:                  Workspace for compressed multi-packet messages (optional, see
+ *                                 NRF24L01_Compression.h). When set, NRF24L01_Receive and NRF24L01_ReceiveStream
+ *                                 accept compressed messages, without it they are dropped.
+ * - compressMessages:             NRF24L01_Transmit and NRF24L01_TransmitStream compress messages, requires
+ *                                 compression workspace. Peers must agree: enable it only if every receiver has
+ *                                 compression workspace. Message is compressed only if it takes more than one packet
+ *                                 and compression saves packets, otherwise it is sent as it is. Compressed messages
+ *                                 need packet size of at least 7.
+ * - instance:                     Runtime state of the radio (internal, filled by NRF24L01_Init)
+ *
+ * Every radio needs its own handle. Radios on different SPI peripherals share no state
+ * and can be driven concurrently(e.g. from different RTOS tasks or interrupts).
  */
-typedef struct {
+struct NRF24L01_Device {
 	GPIO_TypeDef *CE_Port;
 	uint16_t CE_Pin;
 	GPIO_TypeDef *CSN_Port;
 	uint16_t CSN_Pin;
+	GPIO_TypeDef *IRQ_Port;
+	uint16_t IRQ_Pin;
 	SPI_HandleTypeDef *hspi;
 	bool enableStatistics;
 	uint64_t packetsLost;
 	uint64_t packetsRetransmitted;
 	bool powerDownBetweenTransactions;
-} NRF24L01_Device;
+	uint16_t powerUpDelay;
+	uint32_t powerDownIdleTimeout;
+	NRF24L01_Compression *compression;
+	bool compressMessages;
+	NRF24L01_Instance instance;
+};
 
 /**
- * @brief NRF24L01 runtime instance
- *
- * Links a device with its configuration and current radio mode.
- * Used as a context and for internal caching.
+ * @brief Initialize the nRF24L01 module with given config
  *
- * Fields:
- * - device: Pointer to NRF24L01_Device
- * - config: Pointer to NRF24L01_Config
- * - mode:   Current radio mode:
- *           0x00 = TX mode,
- *           0x01 = RX mode,
- *           0xFF = uninitialized
+ * @param device Pointer to NRF24L01_Device with GPIO and SPI settings
+ * @param config Pointer to NRF24L01_Config with radio settings
  */
-typedef struct {
-	NRF24L01_Device *device;
-	NRF24L01_Config *config;
-	uint8_t mode;
-} NRF24L01_Instance;
+void NRF24L01_Init(NRF24L01_Device *device, NRF24L01_Config *config);
 
 /**
- * @brief Initialize the nRF24L01 module with given config
+ * @brief Start non-blocking initialization of the nRF24L01 module with given config
+ *
+ * Returns immediately, NRF24L01_Process configures the radio once power on reset time has passed
+ * and reports PROCESS_EVENT_READY.
  *
  * @param device Pointer to NRF24L01_Device with GPIO and SPI settings
  * @param config Pointer to NRF24L01_Config with radio settings
+ * @return true if started, false if config is invalid
  */
-void NRF24L01_Init(NRF24L01_Device *device, NRF24L01_Config *config);
+bool NRF24L01_InitNonBlocking(NRF24L01_Device *device, NRF24L01_Config *config);
+
+/**
+ * @brief Advance non-blocking operation of the device
+ *
+ * Never waits: every call does at most a few short SPI transactions(one STATUS read while waiting
+ * for the radio, none if IRQ pin is connected and not asserted), so it can be called from superloop
+ * together with other tasks. Also powers radio down after powerDownIdleTimeout like NRF24L01_UpdatePowerState.
+ * Blocking API must not be used while NRF24L01_GetProcessState is not PROCESS_READY.
+ *
+ * @example
+ * while (1) {
+ *     switch (NRF24L01_Process(&device, HAL_GetTick())) {
+ *     case PROCESS_EVENT_PACKET_RECEIVED:
+ *         while (NRF24L01_Read(&device, &packet)) { ... }
+ *         break;
+ *     ...
+ *     }
+ *     UpdateDisplay();
+ * }
+ *
+ * @param device Device handle
+ * @param tick Current time in ms, e.g. HAL_GetTick. Any millisecond clock can be used if it is the same on every call,
+ *             timeouts of an operation are counted from the first call after it was started.
+ * @return Event that happened during the call, callbacks registered with NRF24L01_RegisterCallbacks
+ *         (onPacketSent, onMaxRetransmits) are called as well
+ */
+NRF24L01_ProcessEvent NRF24L01_Process(NRF24L01_Device *device, uint32_t tick);
+
+/**
+ * @brief Get state of non-blocking operation
+ *
+ * @param device Device handle
+ * @return Current state
+ */
+NRF24L01_ProcessState NRF24L01_GetProcessState(NRF24L01_Device *device);
+
+/**
+ * @brief Start non-blocking transmission of one packet
+ *
+ * Payload is written right away, so data buffer can be reused after the call.
+ * Can be called while listening with NRF24L01_StartListeningNonBlocking, listening is resumed after transmission.
+ * Result is reported by NRF24L01_Process.
+ *
+ * @param device Device handle
+ * @param data Pointer to data to send
+ * @param size Number of bytes to send (max 32)
+ * @return true if started, false if arguments are invalid or device is busy
+ */
+bool NRF24L01_TransmitPacketNonBlocking(NRF24L01_Device *device, const uint8_t *data, uint8_t size);
+
+/**
+ * @brief Start non-blocking receiving
+ *
+ * NRF24L01_Process moves received payloads into RX queues, take them with NRF24L01_Read or NRF24L01_ReadPipe.
+ *
+ * @param device Device handle
+ * @return true if started, false if device is busy
+ */
+bool NRF24L01_StartListeningNonBlocking(NRF24L01_Device *device);
+
+/**
+ * @brief Stop non-blocking receiving
+ *
+ * If a packet is being transmitted, it is finished but listening is not resumed.
+ *
+ * @param device Device handle
+ */
+void NRF24L01_StopListeningNonBlocking(NRF24L01_Device *device);
+
+/**
+ * @brief Verify that radio registers match their shadow copy and restore the ones that do not
+ *
+ * All configuration and mode changes are written from shadow copy without reading registers back,
+ * so radio reset(e.g. brown-out) would go unnoticed. Call this periodically or after suspicious failures.
+ *
+ * @param device Device handle
+ * @return true if all registers matched, false if any register was restored
+ */
+bool NRF24L01_VerifyRegisters(NRF24L01_Device *device);
+
+/**
+ * @brief Change RF channel
+ *
+ * Should be called between transactions. If radio is listening(CE high), it is briefly
+ * put into standby, so the new frequency takes effect.
+ *
+ * @param device Device handle
+ * @param channel RF channel (0-127), frequency is 2400 + channel MHz
+ * @return true if channel changed, false if channel is invalid
+ */
+bool NRF24L01_SetChannel(NRF24L01_Device *device, uint8_t channel);
+
+/**
+ * @brief Get current RF channel
+ *
+ * @param device Device handle
+ * @return RF channel (0-127)
+ */
+uint8_t NRF24L01_GetChannel(NRF24L01_Device *device);
+
+/**
+ * @brief Change data rate
+ *
+ * Both modules must use the same data rate, so it must be changed on both ends.
+ *
+ * @param device Device handle
+ * @param dataRate New data rate
+ */
+void NRF24L01_SetDataRate(NRF24L01_Device *device, DATA_RATE dataRate);
+
+/**
+ * @brief Change transmit power
+ *
+ * @param device Device handle
+ * @param rfPower New RF power level
+ */
+void NRF24L01_SetRFPower(NRF24L01_Device *device, RF_POWER rfPower);
+
+/**
+ * @brief Change automatic retransmission settings
+ *
+ * @param device Device handle
+ * @param retransmitDelay Delay between retransmissions
+ * @param retransmitCount Max number of retransmissions
+ */
+void NRF24L01_SetRetransmission(NRF24L01_Device *device, RETRANSMIT_DELAY retransmitDelay,
+		RETRANSMIT_COUNT retransmitCount);
+
+/**
+ * @brief Change TX address
+ *
+ * RX pipe 0 is set to the same address to receive automatic acknowledgments, so pipe 0 can not be used
+ * for listening on its own address afterwards. Must be called while not listening.
+ *
+ * @param device Device handle
+ * @param address New TX address (configured address width)
+ * @return true if address changed, false if radio is listening
+ */
+bool NRF24L01_SetTxAddress(NRF24L01_Device *device, uint64_t address);
+
+/**
+ * @brief Change address of RX pipe
+ *
+ * Pipe keeps its enable, auto ACK and payload size settings. Must be called while not listening.
+ *
+ * @param device Device handle
+ * @param pipe RX pipe number (0-5)
+ * @param address New address, only the least significant byte is used for pipes 2-5
+ * @return true if address changed, false if pipe is invalid or radio is listening
+ */
+bool NRF24L01_SetRxAddress(NRF24L01_Device *device, uint8_t pipe, uint64_t address);
+
+/**
+ * @brief Survey occupancy of all RF channels using Received Power Detector(RPD)
+ *
+ * All channels are swept 'samples' times, each sample listens ~170 us and checks if a signal
+ * stronger than -64 dBm was present. Scan takes ~22 ms per sample, e.g. ~2.2 s for 100 samples.
+ * Current channel is restored afterwards. Packets received during scan stay in RX FIFO.
+ *
+ * @param device Device handle
+ * @param histogram Array of NRF24L01_CHANNELS elements to store number of samples each channel was busy
+ * @param samples Number of samples per channel (1-255)
+ * @return true if scanned, false if interrupt driven or asynchronous operation is in progress
+ */
+bool NRF24L01_ScanChannels(NRF24L01_Device *device, uint8_t *histogram, uint8_t samples);
+
+/**
+ * @brief Find the least congested channel in spectrum scan results
+ *
+ * Channel is rated by its own occupancy and occupancy of adjacent channels,
+ * as 1-2 Mbps transmission takes 1-2 MHz bandwidth.
+ *
+ * @param histogram Results of NRF24L01_ScanChannels
+ * @param firstChannel First allowed channel (0-125)
+ * @param lastChannel Last allowed channel (firstChannel-125)
+ * @return Least congested channel
+ */
+uint8_t NRF24L01_FindQuietChannel(const uint8_t *histogram, uint8_t firstChannel, uint8_t lastChannel);
 
 /**
  * @brief Enable or disable power-down mode usage between transmissions
@@ -311,6 +816,24 @@ void NRF24L01_Init(NRF24L01_Device *device, NRF24L01_Config *config);
  */
 void NRF24L01_UsePowerDownMode(NRF24L01_Device *device, bool enable);
 
+/**
+ * @brief Power down radio if it was idle for powerDownIdleTimeout
+ *
+ * Must be called periodically(e.g. from main loop) when powerDownIdleTimeout is used.
+ * Does nothing while interrupt driven or asynchronous operation is in progress.
+ *
+ * @param device Device handle
+ */
+void NRF24L01_UpdatePowerState(NRF24L01_Device *device);
+
+/**
+ * @brief Get time spent in every power state
+ *
+ * @param device Device handle
+ * @param stats Pointer to store statistics, time of current state is included
+ */
+void NRF24L01_GetPowerStats(NRF24L01_Device *device, NRF24L01_PowerStats *stats);
+
 /**
  * @brief Transmit one packet
  *
@@ -324,32 +847,70 @@ bool NRF24L01_TransmitPacket(NRF24L01_Device *device, const uint8_t *data, uint8
 /**
  * @brief Receive one packet from a given RX pipe
  *
+ * All payloads in RX FIFO are read on every wakeup. Packets for other pipes are kept
+ * in RX queue and returned by later calls or NRF24L01_Read.
+ *
  * @param device Device handle
- * @param pipe RX pipe number (0–5)
+ * @param pipe RX pipe number (0–5) or NRF24L01_ANY_PIPE
  * @param buffer Pointer to buffer to store received data
  * @param timeout Timeout in ms
  * @return true if data received, false if timeout occurred
  */
 bool NRF24L01_ReceivePacket(NRF24L01_Device *device, uint8_t pipe, uint8_t *buffer, uint32_t timeout);
 
+/**
+ * @brief Receive one packet from a given RX pipe and get its size
+ *
+ * Same as NRF24L01_ReceivePacket, for pipes with dynamic payload size where packets differ in length.
+ *
+ * @param device Device handle
+ * @param pipe RX pipe number (0–5) or NRF24L01_ANY_PIPE
+ * @param buffer Pointer to buffer of at least 32 bytes to store received data
+ * @param size Pointer to store number of received bytes
+ * @param timeout Timeout in ms
+ * @return true if data received, false if timeout occurred
+ */
+bool NRF24L01_ReceivePacketWithSize(NRF24L01_Device *device, uint8_t pipe, uint8_t *buffer, uint8_t *size,
+		uint32_t timeout);
+
 /**
  * @brief Transmit data of arbitrary size by splitting it into multiple packets
  *
  * Unlike NRF24L01_TransmitPacket that sends only for single packet,
  * this method automatically splits the data into packets and sends them sequentially.
- * There is no limit on the total amount of data to be transmitted.
- * The packet size must be at least 3 bytes to accommodate transaction data.
- * If the (data size + 3 additional info) is not an exact multiple of the packet size,
+ * Packets are streamed through the 3-level TX FIFO with CE held high, so they go on air back-to-back.
+ * Messages that fit into 255 packets are sent with 3 byte header, larger ones(up to 4 GB)
+ * with 6 byte header carrying 32-bit message size.
+ * The packet size must be at least 3 bytes to accommodate transaction data(6 bytes for large messages).
+ * If the (data size + header) is not an exact multiple of the packet size,
  * the remaining bytes will be padded with 0x00. These padding bytes are used only for
  * alignment and are not part of the actual transmitted data.
  *
  * @param device Device handle
  * @param data Pointer to data to send
- * @param size Total number of bytes to send (no fixed limit)
+ * @param size Total number of bytes to send
  * @param packetSize Size of each packet data will be split into(min 3, max 32).
  * @return true if all packets transmitted successfully, false otherwise
  */
-bool NRF24L01_Transmit(NRF24L01_Device *device, const uint8_t *data, uint8_t size, uint8_t packetSize);
+bool NRF24L01_Transmit(NRF24L01_Device *device, const uint8_t *data, uint32_t size, uint8_t packetSize);
+
+/**
+ * @brief Transmit data of arbitrary size provided part by part by callback
+ *
+ * Same as NRF24L01_Transmit, but message is not required to be in RAM: source is asked for
+ * every packet's data right before it is queued into TX FIFO, e.g. to read firmware from flash.
+ * With compressMessages set, source is read twice: once to find out if compression saves packets
+ * and once more while packets are queued, then it is asked for larger parts ahead of the packet being queued.
+ *
+ * @param device Device handle
+ * @param source Callback providing message data
+ * @param context User context passed to source
+ * @param size Total number of bytes to send
+ * @param packetSize Size of each packet data will be split into(min 3, max 32).
+ * @return true if all packets transmitted successfully, false otherwise or if source aborted
+ */
+bool NRF24L01_TransmitStream(NRF24L01_Device *device, NRF24L01_DataSource source, void *context, uint32_t size,
+		uint8_t packetSize);
 
 /**
  * @brief Receive data of arbitrary size by reading multiple packets
@@ -360,6 +921,8 @@ bool NRF24L01_Transmit(NRF24L01_Device *device, const uint8_t *data, uint8_t siz
  * Ensure that the provided buffer is large enough to hold the entire data to be received.
  * Padding bytes (0x00) added during transmission are automatically removed
  * and do not count toward the final data size.
+ * First packet is taken as a header only if it is as long as the packet size it declares, packets of other
+ * length(e.g. a stray packet starting with 0x00) are skipped, and such a packet in the middle fails the message.
  *
  * @param device Device handle
  * @param pipe RX pipe number (0–5)
@@ -369,4 +932,258 @@ bool NRF24L01_Transmit(NRF24L01_Device *device, const uint8_t *data, uint8_t siz
  */
 bool NRF24L01_Receive(NRF24L01_Device *device, uint8_t pipe, uint8_t *buffer, uint32_t timeout);
 
+/**
+ * @brief Receive data of arbitrary size passing it part by part to callback
+ *
+ * Same as NRF24L01_Receive, but message is not required to fit into RAM: every packet's data
+ * is passed to sink as soon as it is received, e.g. to write firmware into flash.
+ * For messages with 3 byte header padding bytes of the last packet are passed to sink as well.
+ *
+ * @param device Device handle
+ * @param pipe RX pipe number (0–5)
+ * @param sink Callback consuming message data
+ * @param context User context passed to sink
+ * @param size Pointer to store received message size, can be NULL
+ * @param timeout Timeout in ms for the first packet to arrive
+ * @return true if full data received successfully, false if timeout occurred or sink aborted
+ */
+bool NRF24L01_ReceiveStream(NRF24L01_Device *device, uint8_t pipe, NRF24L01_DataSink sink, void *context,
+		uint32_t *size, uint32_t timeout);
+
+/**
+ * @brief Register callbacks for interrupt driven operation
+ *
+ * @param device Device handle
+ * @param callbacks Callbacks to copy into device instance
+ */
+void NRF24L01_RegisterCallbacks(NRF24L01_Device *device, const NRF24L01_Callbacks *callbacks);
+
+/**
+ * @brief Start interrupt driven receiving
+ *
+ * Switches radio to RX mode and keeps CE high. Every received payload is delivered
+ * to onPacketReceived callback from NRF24L01_IRQHandler. Requires IRQ pin to be connected.
+ *
+ * @param device Device handle
+ */
+void NRF24L01_StartListening(NRF24L01_Device *device);
+
+/**
+ * @brief Stop interrupt driven receiving
+ *
+ * @param device Device handle
+ */
+void NRF24L01_StopListening(NRF24L01_Device *device);
+
+/**
+ * @brief Start interrupt driven transmission of one packet
+ *
+ * Writes payload and pulses CE without waiting for the result.
+ * Completion is reported with onPacketSent or onMaxRetransmits callback.
+ * Stops listening if it was started.
+ *
+ * @param device Device handle
+ * @param data Pointer to data to send
+ * @param size Number of bytes to send (max 32)
+ * @return true if transmission is started, false if size is invalid
+ */
+bool NRF24L01_TransmitPacketIT(NRF24L01_Device *device, const uint8_t *data, uint8_t size);
+
+/**
+ * @brief IRQ pin interrupt handler
+ *
+ * Must be called from HAL_GPIO_EXTI_Callback when the IRQ pin of this device falls.
+ * Reads STATUS once, clears interrupt flags and dispatches events to registered callbacks.
+ * If it interrupts a blocking SPI transaction of this device(up to ~70 us at 4 Mbps SPI), the event is handled
+ * right after the transaction ends, so main context calls can be made while listening. Interrupts stay enabled.
+ *
+ * @example
+ * void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
+ *     if (GPIO_Pin == device.IRQ_Pin) {
+ *         NRF24L01_IRQHandler(&device);
+ *     }
+ * }
+ *
+ * @param device Device handle
+ */
+void NRF24L01_IRQHandler(NRF24L01_Device *device);
+
+/**
+ * @brief Start non-blocking transmission of one packet using SPI DMA
+ *
+ * Returns immediately, payload is written by DMA and the result is reported with
+ * onPacketSent or onMaxRetransmits callback. Requires IRQ pin to be connected and
+ * NRF24L01_SPICompleteHandler to be called from HAL_SPI_TxRxCpltCallback.
+ * Data is copied into the instance, so caller buffer can be reused right after the call.
+ *
+ * @param device Device handle
+ * @param data Pointer to data to send
+ * @param size Number of bytes to send (max 32)
+ * @return true if transmission is started, false if device is busy, size is invalid or DMA failed to start
+ */
+bool NRF24L01_TransmitPacketAsync(NRF24L01_Device *device, const uint8_t *data, uint8_t size);
+
+/**
+ * @brief Start non-blocking receiving of one packet using SPI DMA
+ *
+ * Switches radio to RX mode and returns immediately. Once a packet from any pipe arrives,
+ * it is read by DMA into the buffer and reported with onPacketReceived callback.
+ * Requires IRQ pin to be connected and NRF24L01_SPICompleteHandler to be called from HAL_SPI_TxRxCpltCallback.
+ *
+ * @param device Device handle
+ * @param buffer Pointer to buffer to store received data(min 32 bytes), must stay valid until callback
+ * @return true if receiving is started, false if device is busy
+ */
+bool NRF24L01_ReceivePacketAsync(NRF24L01_Device *device, uint8_t *buffer);
+
+/**
+ * @brief Check if asynchronous transfer is in progress
+ *
+ * Blocking API must not be used while device is busy.
+ *
+ * @param device Device handle
+ * @return true if asynchronous transfer is in progress
+ */
+bool NRF24L01_IsBusy(NRF24L01_Device *device);
+
+/**
+ * @brief SPI DMA transfer complete handler
+ *
+ * Must be called from HAL_SPI_TxRxCpltCallback for SPI used by this device.
+ *
+ * @example
+ * void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi) {
+ *     if (hspi == device.hspi) {
+ *         NRF24L01_SPICompleteHandler(&device);
+ *     }
+ * }
+ *
+ * @param device Device handle
+ */
+void NRF24L01_SPICompleteHandler(NRF24L01_Device *device);
+
+/**
+ * @brief Move all received payloads from RX FIFO into RX queue
+ *
+ * Should be called periodically after NRF24L01_StartListening without IRQ handler being used.
+ * Every payload is tagged with its pipe number and size, so bursty senders on any pipe are not lost.
+ *
+ * @param device Device handle
+ * @return Number of packets in all RX queues
+ */
+uint8_t NRF24L01_Poll(NRF24L01_Device *device);
+
+/**
+ * @brief Take the oldest packet from any RX pipe queue
+ *
+ * Pipes are served round-robin, so one busy pipe can't starve others.
+ *
+ * @param device Device handle
+ * @param packet Pointer to store packet
+ * @return true if packet was taken, false if all queues are empty
+ */
+bool NRF24L01_Read(NRF24L01_Device *device, NRF24L01_Packet *packet);
+
+/**
+ * @brief Take the oldest packet from RX queue of given pipe
+ *
+ * @param device Device handle
+ * @param pipe RX pipe number (0–5)
+ * @param packet Pointer to store packet
+ * @return true if packet was taken, false if queue is empty
+ */
+bool NRF24L01_ReadPipe(NRF24L01_Device *device, uint8_t pipe, NRF24L01_Packet *packet);
+
+/**
+ * @brief Get number of packets waiting in RX queue of given pipe
+ *
+ * @param device Device handle
+ * @param pipe RX pipe number (0–5)
+ * @return Number of queued packets
+ */
+uint8_t NRF24L01_Available(NRF24L01_Device *device, uint8_t pipe);
+
+/**
+ * @brief Get counters of given RX pipe queue
+ *
+ * @param device Device handle
+ * @param pipe RX pipe number (0–5)
+ * @param received Pointer to store number of packets received on this pipe
+ * @param dropped Pointer to store number of packets dropped due to queue overflow
+ */
+void NRF24L01_GetPipeCounters(NRF24L01_Device *device, uint8_t pipe, uint32_t *received, uint32_t *dropped);
+
+/**
+ * @brief Take snapshot of traffic statistics
+ *
+ * Snapshot is taken with interrupts disabled, so it is consistent with counters updated from NRF24L01_IRQHandler.
+ *
+ * @param device Device handle
+ * @param stats Pointer to store statistics
+ * @param reset Reset statistics right after snapshot, e.g. to get per-interval throughput
+ */
+void NRF24L01_GetStats(NRF24L01_Device *device, NRF24L01_Stats *stats, bool reset);
+
+/**
+ * @brief Preload payload to be sent back with the next ACK on given pipe
+ *
+ * Receiver side of request/response exchange without TX/RX mode switching.
+ * Up to 3 ACK payloads can be pending. Requires enableAckPayloadFeature.
+ *
+ * @param device Device handle
+ * @param pipe RX pipe number (0–5) the ACK payload is sent on
+ * @param data Pointer to data to send
+ * @param size Number of bytes to send (1-32)
+ * @return true if payload is written, false if TX FIFO is full or arguments are invalid
+ */
+bool NRF24L01_WriteAckPayload(NRF24L01_Device *device, uint8_t pipe, const uint8_t *data, uint8_t size);
+
+/**
+ * @brief Drop ACK payloads that are still pending on every pipe
+ *
+ * Lets receiver replace pending ACK payload with a newer one. An ACK that is being sent at the moment
+ * goes without payload. Must not be called while transmitting.
+ *
+ * @param device Device handle
+ */
+void NRF24L01_FlushAckPayloads(NRF24L01_Device *device);
+
+/**
+ * @brief Take the oldest ACK payload received by transmitter
+ *
+ * ACK payloads are read together with TX_DS by every transmit function and stored in their own queue
+ * (NRF24L01_RX_QUEUE_DEPTH packets), separate from packets received on pipe 0 in RX mode.
+ * They are never passed to onPacketReceived callback, take them in onPacketSent instead.
+ *
+ * @param device Device handle
+ * @param packet Pointer to store ACK payload
+ * @return true if ACK payload was taken, false if none was received
+ */
+bool NRF24L01_ReadAckPayload(NRF24L01_Device *device, NRF24L01_Packet *packet);
+
+/**
+ * @brief Transmit one packet without waiting for acknowledgment
+ *
+ * Fire-and-forget transmission for streams where freshness beats reliability.
+ * Payload is written with W_TX_PAYLOAD_NOACK into TX FIFO and CE is kept high, so the call
+ * returns as soon as there is a free FIFO slot. Packets are never retransmitted.
+ * Call NRF24L01_FlushNoAck before using other functions, otherwise unsent packets may be flushed.
+ * Requires enableNoAckFeature.
+ *
+ * @param device Device handle
+ * @param data Pointer to data to send
+ * @param size Number of bytes to send (max 32)
+ * @return true if packet is queued, false if arguments are invalid or TX FIFO stayed full
+ */
+bool NRF24L01_TransmitPacketNoAck(NRF24L01_Device *device, const uint8_t *data, uint8_t size);
+
+/**
+ * @brief Wait for all packets queued by NRF24L01_TransmitPacketNoAck to go on air and leave TX mode
+ *
+ * @param device Device handle
+ * @param timeout Timeout in ms
+ * @return true if all packets are sent, false if timeout occurred
+ */
+bool NRF24L01_FlushNoAck(NRF24L01_Device *device, uint32_t timeout);
+
 #endif // NRF24L01_H
@@ -0,0 +1,117 @@
+/**
+ * @brief Small-message aggregation for nRF24L01+ library
+ *
+ * Packs several short application records into one payload, so preamble, address, CRC and ACK turnaround
+ * are paid once per packet instead of once per record. Pending packet is sent when the next record does not
+ * fit into it or when the oldest record in it has waited for flushDelay(Nagle-style). Receiver unpacks
+ * records one by one.
+ *
+ * Packet format:
+ * | 0xA9 | number of records | size | record | size | record | ... |
+ *
+ * E.g. 6 records of 4 bytes go in one 32 byte packet instead of 6 packets.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#ifndef NRF24L01_AGGREGATOR_H
+#define NRF24L01_AGGREGATOR_H
+
+#include "NRF24L01.h"
+
+#define NRF24L01_AGGREGATOR_MARKER 0xA9
+#define NRF24L01_AGGREGATOR_HEADER_SIZE 2
+#define NRF24L01_AGGREGATOR_MAX_RECORD (32 - NRF24L01_AGGREGATOR_HEADER_SIZE - 1)
+
+/**
+ * @brief Aggregator handle
+ *
+ * Fields:
+ * - device:      Device handle
+ * - pipe:        RX pipe number (0–5) used for receiving
+ * - flushDelay:  Max time in ms a record waits in pending packet, 0 sends every record at once
+ * - records:     Records sent or received
+ * - packets:     Packets sent or received, records / packets is the aggregation ratio
+ * - txPacket:    Pending packet (internal)
+ * - txSize:      Number of used bytes in pending packet, 0 if there is nothing to send (internal)
+ * - txTick:      HAL tick when the first record was put into pending packet (internal)
+ * - rxPacket:    Packet being unpacked (internal)
+ * - rxLength:    Number of received bytes of packet being unpacked (internal)
+ * - rxOffset:    Offset of the next record in packet being unpacked (internal)
+ * - rxRemaining: Number of records left in packet being unpacked (internal)
+ */
+typedef struct {
+	NRF24L01_Device *device;
+	uint8_t pipe;
+	uint32_t flushDelay;
+	uint32_t records;
+	uint32_t packets;
+	uint8_t txPacket[32];
+	uint8_t txSize;
+	uint32_t txTick;
+	uint8_t rxPacket[32];
+	uint8_t rxLength;
+	uint8_t rxOffset;
+	uint8_t rxRemaining;
+} NRF24L01_Aggregator;
+
+/**
+ * @brief Initialize aggregator handle
+ *
+ * Device must be configured with dynamic payload size, packets are sent only as long as their records.
+ *
+ * @param aggregator Aggregator handle
+ * @param device Initialized device handle
+ * @param pipe RX pipe number (0–5) used for receiving
+ * @param flushDelay Max time in ms a record waits in pending packet
+ */
+void NRF24L01_AggregatorInit(NRF24L01_Aggregator *aggregator, NRF24L01_Device *device, uint8_t pipe,
+		uint32_t flushDelay);
+
+/**
+ * @brief Put record into pending packet
+ *
+ * Pending packet is sent first if the record does not fit into it, and together with the record
+ * if it becomes full or flushDelay is 0.
+ *
+ * @param aggregator Aggregator handle
+ * @param data Pointer to record
+ * @param size Size of record (1-NRF24L01_AGGREGATOR_MAX_RECORD)
+ * @return true if record is accepted, false if size is invalid or pending packet failed to send
+ *         (it is kept and sent again with the next call)
+ */
+bool NRF24L01_AggregatorWrite(NRF24L01_Aggregator *aggregator, const uint8_t *data, uint8_t size);
+
+/**
+ * @brief Send pending packet if its oldest record has waited for flushDelay
+ *
+ * Must be called periodically, e.g. from the main loop.
+ *
+ * @param aggregator Aggregator handle
+ * @return false if pending packet failed to send, true otherwise
+ */
+bool NRF24L01_AggregatorUpdate(NRF24L01_Aggregator *aggregator);
+
+/**
+ * @brief Send pending packet right away
+ *
+ * @param aggregator Aggregator handle
+ * @return true if packet was sent or there was nothing to send, false if max retries reached
+ */
+bool NRF24L01_AggregatorFlush(NRF24L01_Aggregator *aggregator);
+
+/**
+ * @brief Receive one record
+ *
+ * Records of the last received packet are returned first, a new packet is received only when all of them were read.
+ *
+ * @param aggregator Aggregator handle
+ * @param buffer Pointer to buffer of at least NRF24L01_AGGREGATOR_MAX_RECORD bytes
+ * @param size Pointer to store record size
+ * @param timeout Timeout in ms
+ * @return true if record received, false if timeout occurred
+ */
+bool NRF24L01_AggregatorReceive(NRF24L01_Aggregator *aggregator, uint8_t *buffer, uint8_t *size, uint32_t timeout);
+
+#endif // NRF24L01_AGGREGATOR_H
@@ -0,0 +1,157 @@
+/**
+ * @brief Compression of multi-packet messages for nRF24L01+ library
+ *
+ * Streaming LZ77 codec with 256 byte window, so repeated frames and runs of equal bytes(e.g. zero padding)
+ * are sent as 2 byte back references. Compressed stream is a sequence of tokens:
+ *
+ * | Token       | Meaning                                                                      |
+ * |-------------|------------------------------------------------------------------------------|
+ * | 0x00 - 0x7F | (token + 1) literal bytes follow                                             |
+ * | 0x80 - 0xFF | copy (token - 0x80 + 3) bytes starting (next byte + 1) bytes back in output |
+ *
+ * Copy may overlap the bytes it produces, so a run is encoded as a single literal and one copy.
+ * Both ends need no heap and only a workspace of fixed size, set it as compression field of the device handle.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#ifndef NRF24L01_COMPRESSION_H
+#define NRF24L01_COMPRESSION_H
+
+#include "NRF24L01.h"
+
+#define NRF24L01_COMPRESSION_WINDOW 256
+#define NRF24L01_COMPRESSION_MIN_MATCH 3
+#define NRF24L01_COMPRESSION_MAX_MATCH 66 //Format allows 130, shorter lookahead saves RAM
+#define NRF24L01_COMPRESSION_MAX_LITERALS 64 //Format allows 128, shorter run saves RAM
+#define NRF24L01_COMPRESSION_OUTPUT_SIZE (32 + 1 + NRF24L01_COMPRESSION_MAX_LITERALS + 2)
+
+/**
+ * @brief Compressor state
+ *
+ * Fields:
+ * - source:        Callback providing uncompressed data
+ * - context:       User context passed to source
+ * - size:          Size of uncompressed data
+ * - readOffset:    Number of bytes read from source
+ * - input:         Window of already compressed bytes followed by lookahead
+ * - inputLength:   Number of valid bytes in input
+ * - position:      Position of the first byte to compress in input
+ * - output:        Compressed bytes ready to be sent followed by open literal run
+ * - outputLength:  Number of compressed bytes ready to be sent
+ * - literals:      Length of open literal run
+ * - failed:        Source aborted
+ */
+typedef struct {
+	NRF24L01_DataSource source;
+	void *context;
+	uint32_t size;
+	uint32_t readOffset;
+	uint8_t input[NRF24L01_COMPRESSION_WINDOW + 2 * NRF24L01_COMPRESSION_MAX_MATCH];
+	uint16_t inputLength;
+	uint16_t position;
+	uint8_t output[NRF24L01_COMPRESSION_OUTPUT_SIZE];
+	uint8_t outputLength;
+	uint8_t literals;
+	bool failed;
+} NRF24L01_Compressor;
+
+/**
+ * @brief Decompressor state
+ *
+ * Fields:
+ * - sink:          Callback consuming uncompressed data
+ * - context:       User context passed to sink
+ * - size:          Size of uncompressed data
+ * - written:       Number of bytes produced so far
+ * - flushed:       Number of bytes passed to sink so far
+ * - window:        Ring buffer with the last produced bytes
+ * - literals:      Number of literal bytes left in current token
+ * - matchLength:   Length of copy waiting for its distance byte, 0 if none
+ */
+typedef struct {
+	NRF24L01_DataSink sink;
+	void *context;
+	uint32_t size;
+	uint32_t written;
+	uint32_t flushed;
+	uint8_t window[NRF24L01_COMPRESSION_WINDOW];
+	uint8_t literals;
+	uint8_t matchLength;
+} NRF24L01_Decompressor;
+
+/**
+ * @brief Compression workspace
+ *
+ * Device transmits or receives one message at a time, so both directions share the same RAM(~500 bytes).
+ */
+struct NRF24L01_Compression {
+	union {
+		NRF24L01_Compressor compressor;
+		NRF24L01_Decompressor decompressor;
+	};
+};
+
+/**
+ * @brief Start compressing data
+ *
+ * @param compressor Compressor state
+ * @param source Callback providing uncompressed data
+ * @param context User context passed to source
+ * @param size Size of uncompressed data
+ */
+void NRF24L01_CompressorInit(NRF24L01_Compressor *compressor, NRF24L01_DataSource source, void *context,
+		uint32_t size);
+
+/**
+ * @brief Take next part of compressed data
+ *
+ * @param compressor Compressor state
+ * @param data Pointer to store compressed bytes
+ * @param size Max number of bytes to take
+ * @param taken Pointer to store number of bytes taken, less than size only at the end of data
+ * @return true if successful, false if source aborted
+ */
+bool NRF24L01_CompressorRead(NRF24L01_Compressor *compressor, uint8_t *data, uint8_t size, uint8_t *taken);
+
+/**
+ * @brief Check if all compressed data was taken
+ *
+ * @param compressor Compressor state
+ * @return true if nothing is left to take
+ */
+bool NRF24L01_CompressorFinished(NRF24L01_Compressor *compressor);
+
+/**
+ * @brief Start decompressing data
+ *
+ * @param decompressor Decompressor state
+ * @param sink Callback consuming uncompressed data
+ * @param context User context passed to sink
+ * @param size Size of uncompressed data
+ */
+void NRF24L01_DecompressorInit(NRF24L01_Decompressor *decompressor, NRF24L01_DataSink sink, void *context,
+		uint32_t size);
+
+/**
+ * @brief Decompress next part of compressed data
+ *
+ * Bytes after the end of data(padding of the last packet) are ignored.
+ *
+ * @param decompressor Decompressor state
+ * @param data Pointer to compressed bytes
+ * @param size Number of compressed bytes
+ * @return true if successful, false if data is corrupted or sink aborted
+ */
+bool NRF24L01_DecompressorWrite(NRF24L01_Decompressor *decompressor, const uint8_t *data, uint8_t size);
+
+/**
+ * @brief Check if all data was decompressed and passed to sink
+ *
+ * @param decompressor Decompressor state
+ * @return true if finished
+ */
+bool NRF24L01_DecompressorFinished(NRF24L01_Decompressor *decompressor);
+
+#endif // NRF24L01_COMPRESSION_H
@@ -0,0 +1,148 @@
+/**
+ * @brief Forward error correction for multi-fragment messages for nRF24L01+ library
+ *
+ * Splits messages into numbered fragments and sends one XOR parity fragment after every group of groupSize data
+ * fragments. Fragment that failed (max retransmits reached) is not sent again: receiver rebuilds one lost fragment
+ * per group from parity and the rest of the group, so a message survives up to one lost fragment in every group
+ * without retransmission. Overhead is 1 / groupSize, e.g. 25% for groups of 4.
+ *
+ * Groups that lost more fragments can be repaired(maxRetransmissions > 0): after the message transmitter asks for
+ * receiver's status, which comes in ACK payload, and sends the missing data fragments again until the message is
+ * complete. Both sides then need enableAckPayloadFeature and receiver replaces its pending ACK payloads,
+ * so pipe used for receiving should not carry other ones.
+ *
+ * Fragment format:
+ * | 0xE5 | message id | packet size | group size | index (2 bytes) | message size (2 bytes) | data |
+ * Highest bit of index is set if transmitter repairs groups. Header-only fragment(packet size 8) with this bit
+ * asks for status, without it opens a message and its ACK takes stale status of the receiver.
+ *
+ * ACK payload format(status of the message being received, see NRF24L01_Reassembly.h):
+ * | 0xE6 | message id | first missing data fragment (2 bytes) | bitmap of the next 64 data fragments (8 bytes) |
+ *
+ * Fragments are numbered across data and parity, group g consists of fragments g * (groupSize + 1) and up,
+ * its parity is the last one(the last group may be shorter). Data of the last fragment is padded with 0x00.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#ifndef NRF24L01_FEC_H
+#define NRF24L01_FEC_H
+
+#include "NRF24L01_Reassembly.h"
+
+/**
+ * Max number of data fragments per message.
+ * Max message size is NRF24L01_FEC_MAX_FRAGMENTS * (packetSize - 8) bytes.
+ */
+#define NRF24L01_FEC_MAX_FRAGMENTS NRF24L01_REASSEMBLY_MAX_FRAGMENTS
+
+#define NRF24L01_FEC_FRAME_MARKER 0xE5
+#define NRF24L01_FEC_STATUS_MARKER 0xE6
+#define NRF24L01_FEC_HEADER_SIZE 8
+#define NRF24L01_FEC_REPAIR_FLAG 0x80 //In the high byte of index
+
+/**
+ * @brief FEC statistics
+ *
+ * Fields:
+ * - fragments:   Fragments sent or received, including parity
+ * - failed:      Fragments that failed to send
+ * - recovered:   Fragments rebuilt from parity by receiver
+ * - resent:      Data fragments sent again to repair groups that could not be rebuilt
+ * - lost:        Messages that lost more than one fragment in a group and were not repaired
+ */
+typedef struct {
+	uint32_t fragments;
+	uint32_t failed;
+	uint32_t recovered;
+	uint32_t resent;
+	uint32_t lost;
+} NRF24L01_FecStats;
+
+/**
+ * @brief FEC handle
+ *
+ * Fields:
+ * - device:             Device handle
+ * - pipe:               RX pipe number (0–5) used for receiving
+ * - packetSize:         Size of each fragment including header (9-32). Transmitter side only.
+ * - groupSize:          Number of data fragments per parity fragment (1-255). Transmitter side only.
+ * - noAck:              Send fragments with NRF24L01_TransmitPacketNoAck(requires enableNoAckFeature),
+ *                       parity replaces hardware retransmissions. Transmitter side only.
+ * - flushTimeout:       Timeout in ms for fragments queued with noAck to go on air (default 100).
+ *                       Transmitter side only.
+ * - maxRetransmissions: Max number of data fragments sent again and status requests left without status
+ *                       per message before giving up (default 0: groups are not repaired). Transmitter side only.
+ * - messageId:          Id of the last sent message (internal)
+ * - rx:                 Reassembly of the message being received, rebuilt fragments count as received (internal)
+ * - stats:              Statistics
+ */
+typedef struct {
+	NRF24L01_Device *device;
+	uint8_t pipe;
+	uint8_t packetSize;
+	uint8_t groupSize;
+	bool noAck;
+	uint32_t flushTimeout;
+	uint16_t maxRetransmissions;
+	uint8_t messageId;
+	NRF24L01_Reassembly rx;
+	NRF24L01_FecStats stats;
+} NRF24L01_Fec;
+
+/**
+ * @brief Initialize FEC handle
+ *
+ * @param fec FEC handle
+ * @param device Initialized device handle
+ * @param pipe RX pipe number (0–5) used for receiving
+ * @param packetSize Size of each fragment including header (9-32)
+ * @param groupSize Number of data fragments per parity fragment (1-255), smaller groups survive more losses
+ */
+void NRF24L01_FecInit(NRF24L01_Fec *fec, NRF24L01_Device *device, uint8_t pipe, uint8_t packetSize,
+		uint8_t groupSize);
+
+/**
+ * @brief Send message with parity fragments
+ *
+ * Every fragment is sent once. Without repair sending stops as soon as a group has lost two fragments, as receiver
+ * can not rebuild it. With noAck a fragment is lost only if it could not be queued, and the message fails
+ * if queued fragments did not go on air.
+ * With repair(maxRetransmissions > 0) data fragments missing from receiver's status are sent again, so the call
+ * returns true only when receiver has the whole message. Receiver has to keep calling NRF24L01_FecReceive.
+ *
+ * @param fec FEC handle
+ * @param data Pointer to data to send
+ * @param size Number of bytes to send
+ * @return true if receiver can rebuild(with repair: has) the message, false if message is too large, a group lost more
+ *         than one fragment, queued noAck fragments failed to go on air or repair exceeded maxRetransmissions
+ */
+bool NRF24L01_FecSend(NRF24L01_Fec *fec, const uint8_t *data, uint16_t size);
+
+/**
+ * @brief Receive message, rebuilding lost fragments from parity
+ *
+ * Progress is kept in the FEC handle, so if timeout occurs in the middle of a message,
+ * the next call with the same buffer continues receiving it instead of starting over.
+ *
+ * @param fec FEC handle
+ * @param buffer Pointer to buffer to store received message
+ * @param bufferSize Size of the buffer, larger messages are ignored
+ * @param size Pointer to store received message size
+ * @param timeout Timeout in ms since the last received fragment
+ * @return true if whole message received, false if timeout occurred or a group lost more than one fragment
+ */
+bool NRF24L01_FecReceive(NRF24L01_Fec *fec, uint8_t *buffer, uint16_t bufferSize, uint16_t *size,
+		uint32_t timeout);
+
+/**
+ * @brief Get FEC statistics
+ *
+ * @param fec FEC handle
+ * @param stats Pointer to store statistics
+ * @param reset Reset statistics after reading
+ */
+void NRF24L01_FecGetStats(NRF24L01_Fec *fec, NRF24L01_FecStats *stats, bool reset);
+
+#endif // NRF24L01_FEC_H
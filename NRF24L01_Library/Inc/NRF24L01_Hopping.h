@@ -0,0 +1,132 @@
+/**
+ * @brief Frequency hopping for nRF24L01+ library
+ *
+ * Both ends build the same pseudo-random hop sequence from a shared seed and channel range.
+ * Every channel of the range is visited once per cycle, each for one time slot.
+ * Leader hops by its own clock. Follower parks on one channel until it hears the leader there,
+ * derives leader's slot timing from the position of that channel in the sequence and then hops along.
+ * Every received packet was sent during leader's slot of its channel, so it bounds the start of leader's slots
+ * from both sides. Follower keeps its slot timing in the middle of these bounds, which are widened with time
+ * since the previous packet to follow clock drift in either direction. If nothing is received for lossTimeout
+ * follower parks again, moving to the next channel of the sequence after every full cycle,
+ * so a jammed channel can not prevent resynchronization.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#ifndef NRF24L01_HOPPING_H
+#define NRF24L01_HOPPING_H
+
+#include "NRF24L01.h"
+
+/**
+ * Max number of channels in hop sequence
+ */
+#define NRF24L01_HOPPING_MAX_CHANNELS 126
+
+/**
+ * @brief Frequency hopping handle
+ *
+ * Fields:
+ * - device:            Device handle
+ * - sequence:          Hop sequence
+ * - numberOfChannels:  Number of channels in hop sequence
+ * - slotTime:          Time in ms spent on every channel
+ * - lossTimeout:       Time in ms without received packets after which follower is resynchronized
+ *                      (default 2 cycles)
+ * - leader:            Leader hops by its own clock, follower synchronizes to received packets
+ * - synchronized:      Follower knows leader's slot timing, always true for leader
+ * - epoch:             HAL tick when slot 0 started (internal)
+ * - epochMin:          Earliest HAL tick when leader's slot 0 could start (internal)
+ * - epochMax:          Latest HAL tick when leader's slot 0 could start (internal)
+ * - slot:              Current slot of the sequence (internal)
+ * - lastReceivedTick:  HAL tick of the last received packet (internal)
+ * - parkedTick:        HAL tick when unsynchronized follower parked on its channel (internal)
+ */
+typedef struct {
+	NRF24L01_Device *device;
+	uint8_t sequence[NRF24L01_HOPPING_MAX_CHANNELS];
+	uint8_t numberOfChannels;
+	uint32_t slotTime;
+	uint32_t lossTimeout;
+	bool leader;
+	bool synchronized;
+	uint32_t epoch;
+	uint32_t epochMin;
+	uint32_t epochMax;
+	uint8_t slot;
+	uint32_t lastReceivedTick;
+	uint32_t parkedTick;
+} NRF24L01_Hopping;
+
+/**
+ * @brief Initialize frequency hopping handle and build hop sequence
+ *
+ * Channel stays unchanged until NRF24L01_HoppingStart is called.
+ *
+ * @param hopping Frequency hopping handle
+ * @param device Initialized device handle
+ * @param seed Seed of hop sequence, must be the same on both ends
+ * @param firstChannel First channel of hopping range (0-125)
+ * @param lastChannel Last channel of hopping range (firstChannel-125)
+ * @param slotTime Time in ms spent on every channel, must be the same on both ends
+ * @return true if initialized, false if channel range or slot time is invalid
+ */
+bool NRF24L01_HoppingInit(NRF24L01_Hopping *hopping, NRF24L01_Device *device, uint16_t seed, uint8_t firstChannel,
+		uint8_t lastChannel, uint32_t slotTime);
+
+/**
+ * @brief Start hopping
+ *
+ * @param hopping Frequency hopping handle
+ * @param leader true for the side that defines slot timing(usually transmitter), false for follower
+ */
+void NRF24L01_HoppingStart(NRF24L01_Hopping *hopping, bool leader);
+
+/**
+ * @brief Switch channel if slot has changed
+ *
+ * Must be called often(at least several times per slot), e.g. from main loop.
+ * NRF24L01_HoppingTransmitPacket and NRF24L01_HoppingReceivePacket call it by themselves.
+ *
+ * @param hopping Frequency hopping handle
+ */
+void NRF24L01_HoppingUpdate(NRF24L01_Hopping *hopping);
+
+/**
+ * @brief Realign follower's slot timing to received packet
+ *
+ * Must be called right after a packet from the leader was received,
+ * if packets are not received with NRF24L01_HoppingReceivePacket.
+ *
+ * @param hopping Frequency hopping handle
+ */
+void NRF24L01_HoppingPacketReceived(NRF24L01_Hopping *hopping);
+
+/**
+ * @brief Transmit one packet on the channel of the current slot
+ *
+ * @param hopping Frequency hopping handle
+ * @param data Pointer to data to send
+ * @param size Number of bytes to send (max 32)
+ * @return true if transmitted successfully, false if max retries reached
+ */
+bool NRF24L01_HoppingTransmitPacket(NRF24L01_Hopping *hopping, const uint8_t *data, uint8_t size);
+
+/**
+ * @brief Receive one packet following the hop sequence
+ *
+ * Radio stays in RX mode for the whole call and only its channel is switched at slot boundaries.
+ * Uses non-blocking receiving, so device must not be listening with NRF24L01_StartListeningNonBlocking
+ * or interrupt driven RX.
+ *
+ * @param hopping Frequency hopping handle
+ * @param pipe RX pipe number (0–5) or NRF24L01_ANY_PIPE
+ * @param buffer Pointer to buffer to store received data
+ * @param timeout Timeout in ms
+ * @return true if data received, false if timeout occurred
+ */
+bool NRF24L01_HoppingReceivePacket(NRF24L01_Hopping *hopping, uint8_t pipe, uint8_t *buffer, uint32_t timeout);
+
+#endif // NRF24L01_HOPPING_H
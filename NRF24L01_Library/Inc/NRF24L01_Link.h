@@ -0,0 +1,147 @@
+/**
+ * @brief Adaptive link controller for nRF24L01+ library
+ *
+ * Transmitting side(leader) evaluates every window of transmitted packets and moves along the ladder of link levels:
+ *
+ * | Level | Data rate | Retransmit delay | Retransmit count |
+ * |-------|-----------|------------------|------------------|
+ * | 0     | 250 kbps  | 1500 us          | 15               |
+ * | 1     | 1 Mbps    | 750 us           | 10               |
+ * | 2     | 2 Mbps    | 500 us           | 5                |
+ *
+ * Retransmit delays are long enough for 32 byte ACK payloads at every data rate. Higher levels give a packet up
+ * after fewer retries, so a fading level shows up as lost packets before retries stall the link.
+ * Lossy window first raises RF power, at max power it steps data rate down. Several clean windows in a row
+ * step data rate up or, at the highest level, lower RF power. Loss and retransmit thresholds leave a band where
+ * nothing changes(hysteresis), a level that failed right after stepping up is retried after twice longer time.
+ * The window right after a change is not evaluated as receiver needs time to follow. Window that has lost more
+ * than maxLossRate of the whole window is evaluated right away, without waiting for the rest of failed packets.
+ *
+ * Every packet starts with a link header byte: | keepalive flag (0x80) | leader's level (bits 0-1) |, so up to
+ * 31 bytes of data are carried. Leader announces a new level at the old data rate and switches only when the
+ * announcement was acknowledged(confirmation handshake). A step down that is not confirmed is announced again
+ * until the follower has not heard the leader for followerTimeout and searches by itself, a step up that is not
+ * confirmed is dropped. Leader sends keepalive when it has not transmitted for keepaliveInterval, so an idle link
+ * still carries a packet in every interval. Receiving side(follower) switches to the level of every received packet,
+ * after the ACK of it went out at the old data rate. Only when nothing is received for followerTimeout, which is
+ * longer than keepaliveInterval plus the time the leader spends on all retries at the slowest level, the
+ * announcement was lost and follower tries the next lower level(wrapping from the lowest to the highest).
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#ifndef NRF24L01_LINK_H
+#define NRF24L01_LINK_H
+
+#include "NRF24L01.h"
+
+#define NRF24L01_LINK_LEVELS 3
+#define NRF24L01_LINK_HEADER_SIZE 1
+#define NRF24L01_LINK_KEEPALIVE 0x80
+
+/**
+ * @brief Adaptive link handle
+ *
+ * Fields:
+ * - device:           Device handle
+ * - leader:           Leader adapts link settings, follower follows leader's data rate
+ * - window:           Number of transmitted packets per evaluation window (default 50)
+ * - maxLossRate:      Lost packets per mille in window above which link is degraded (default 100)
+ * - maxRetransmitRate: Retransmissions per mille of packets in window below which clean window can
+ *                      step link up (default 100)
+ * - stepUpWindows:    Number of clean windows in a row required to step link up (default 4)
+ * - keepaliveInterval: Time in ms without transmitted packets after which leader sends keepalive (default 100)
+ * - followerTimeout:  Time in ms without received packets after which follower tries next level (default 200),
+ *                     must be longer than keepaliveInterval plus all retries of a packet at level 0
+ * - level:            Current link level (0 - most robust)
+ * - rfPower:          Current RF power
+ * - lossRate:         Lost packets per mille in the last window
+ * - retransmitRate:   Retransmissions per mille of packets in the last window
+ * - windowPackets:    Packets transmitted in current window (internal)
+ * - windowLost:       Packets lost in current window (internal)
+ * - windowRetransmitted: Value of packetsRetransmitted at the start of window (internal)
+ * - cleanWindows:     Clean windows in a row (internal)
+ * - stepUpBackoff:    Multiplier of stepUpWindows, doubled when level fails right after stepping up (internal)
+ * - settling:         Current window follows a change and is not evaluated (internal)
+ * - steppedUp:        Last change stepped data rate up (internal)
+ * - lastTransmitTick: HAL tick of the last transmitted packet (internal)
+ * - lastReceivedTick: HAL tick of the last received packet (internal)
+ * - lastAckedTick:    HAL tick of the last packet acknowledged by follower (internal)
+ */
+typedef struct {
+	NRF24L01_Device *device;
+	bool leader;
+	uint16_t window;
+	uint16_t maxLossRate;
+	uint16_t maxRetransmitRate;
+	uint8_t stepUpWindows;
+	uint32_t keepaliveInterval;
+	uint32_t followerTimeout;
+	uint8_t level;
+	RF_POWER rfPower;
+	uint16_t lossRate;
+	uint16_t retransmitRate;
+	uint16_t windowPackets;
+	uint16_t windowLost;
+	uint64_t windowRetransmitted;
+	uint8_t cleanWindows;
+	uint8_t stepUpBackoff;
+	bool settling;
+	bool steppedUp;
+	uint32_t lastTransmitTick;
+	uint32_t lastReceivedTick;
+	uint32_t lastAckedTick;
+} NRF24L01_Link;
+
+/**
+ * @brief Initialize adaptive link handle
+ *
+ * Starting level and RF power are taken from the config the device was initialized with,
+ * so both ends initialized with the same config start in agreement. Leader evaluates statistics of the device,
+ * so enableStatistics must be set on its device handle. Device must be configured with dynamic payload size,
+ * keepalives are only as long as the link header.
+ *
+ * @param link Adaptive link handle
+ * @param device Initialized device handle
+ * @param leader true for transmitting side, false for receiving side
+ * @return true if initialized, false if leader's device does not collect statistics
+ */
+bool NRF24L01_LinkInit(NRF24L01_Link *link, NRF24L01_Device *device, bool leader);
+
+/**
+ * @brief Transmit one packet and adapt link settings
+ *
+ * Waits up to followerTimeout when a step down to a lower level is not confirmed by follower.
+ *
+ * @param link Adaptive link handle
+ * @param data Pointer to data to send
+ * @param size Number of bytes to send (max 31)
+ * @return true if transmitted successfully, false if max retries reached
+ */
+bool NRF24L01_LinkTransmitPacket(NRF24L01_Link *link, const uint8_t *data, uint8_t size);
+
+/**
+ * @brief Send keepalive if leader has not transmitted for keepaliveInterval
+ *
+ * Must be called periodically by leader, e.g. from the main loop, so follower does not lose it while it is idle.
+ *
+ * @param link Adaptive link handle
+ * @return false if keepalive failed to send, true otherwise
+ */
+bool NRF24L01_LinkUpdate(NRF24L01_Link *link);
+
+/**
+ * @brief Receive one packet following leader's data rate
+ *
+ * Keepalives are consumed without returning.
+ *
+ * @param link Adaptive link handle
+ * @param pipe RX pipe number (0–5)
+ * @param buffer Pointer to buffer of at least 31 bytes to store received data(without link header)
+ * @param timeout Timeout in ms
+ * @return true if data received, false if timeout occurred
+ */
+bool NRF24L01_LinkReceivePacket(NRF24L01_Link *link, uint8_t pipe, uint8_t *buffer, uint32_t timeout);
+
+#endif // NRF24L01_LINK_H
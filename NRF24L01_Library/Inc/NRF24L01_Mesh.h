@@ -0,0 +1,225 @@
+/**
+ * @brief Multi-hop mesh routing layer for nRF24L01+ library
+ *
+ * Nodes form a tree rooted at the gateway, node address is the path from the gateway written in octal digits 1-5
+ * (least significant digit first), e.g. 0 is the gateway, 03 is its child, 043 is a child of 03 and 0543 is a child
+ * of 043. Up to 5 children per node and 4 levels give 780 nodes. A frame goes down if destination is in the subtree
+ * of the node, otherwise up to the parent, so no routing tables are needed and any node can reach any other one.
+ *
+ * Every hop is a regular packet with automatic acknowledgment and retransmissions. Frames that still failed are
+ * retried by the mesh layer after a random backoff and are recognized by receivers as duplicates with
+ * (source, message id) cache. Every node adds a random part to the retransmit delay of the device, so nodes whose
+ * packets collided do not collide again on every automatic retransmission.
+ * Each hop adds the time the frame spent in it to the age field, so the destination gets end-to-end latency
+ * without synchronized clocks.
+ *
+ * Frame format:
+ * | 0xA7 | source (2 bytes) | destination (2 bytes) | message id | hops | age in ms (2 bytes) | size | data |
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#ifndef NRF24L01_MESH_H
+#define NRF24L01_MESH_H
+
+#include "NRF24L01.h"
+
+#define NRF24L01_MESH_GATEWAY 0
+#define NRF24L01_MESH_MAX_LEVELS 4
+#define NRF24L01_MESH_MAX_HOPS (2 * NRF24L01_MESH_MAX_LEVELS)
+
+#define NRF24L01_MESH_QUEUE_DEPTH 8 //Frames waiting to be forwarded or sent
+#define NRF24L01_MESH_INBOX_DEPTH 4 //Frames delivered to this node and not yet read
+#define NRF24L01_MESH_SEEN_DEPTH 16 //Recently seen (source, message id) pairs
+#define NRF24L01_MESH_BACKOFF 4 //ms, max backoff after the first failed attempt, doubled after every next one
+
+/**
+ * Node with address N listens at NRF24L01_MESH_BASE_ADDRESS ^ (N << 8) ^ (k << 32), k is 0 for frames from its parent
+ * (pipe 1) and digit of the child for frames from a child(pipes 2-5 for children 1-4, pipe 0 for child 5 while not
+ * transmitting). Every neighbour sends to an address of its own, so a node waiting for ACK never takes the ACK
+ * of a frame its sibling sent at the same time.
+ * All nodes must use the same channel, data rate and 5 byte address width.
+ */
+#define NRF24L01_MESH_BASE_ADDRESS 0xC2C2C2C2C2
+
+#define NRF24L01_MESH_FRAME_MARKER 0xA7
+#define NRF24L01_MESH_HEADER_SIZE 10
+#define NRF24L01_MESH_MAX_PAYLOAD (32 - NRF24L01_MESH_HEADER_SIZE)
+
+/**
+ * @brief Frame waiting in the queue of a node
+ *
+ * Fields:
+ * - data:      Frame with header
+ * - size:      Size of frame with header
+ * - attempts:  Number of failed transmissions to the next hop
+ * - tick:      Time in ms the frame was queued or the last time its age was updated
+ * - backoff:   Time in ms after the last failed attempt before the frame is sent again
+ */
+typedef struct {
+	uint8_t data[32];
+	uint8_t size;
+	uint8_t attempts;
+	uint32_t tick;
+	uint16_t backoff;
+} NRF24L01_MeshFrame;
+
+/**
+ * @brief Mesh statistics
+ *
+ * Latency and hops are measured for frames delivered to this node.
+ *
+ * Fields:
+ * - sent:           Frames queued by NRF24L01_MeshSend
+ * - received:       Frames delivered to this node
+ * - forwarded:      Frames of other nodes passed to the next hop
+ * - failed:         Frames dropped after max attempts to reach the next hop
+ * - dropped:        Frames dropped as queue or inbox was full or max hops was exceeded
+ * - duplicates:     Frames received again after their ACK was lost
+ * - queueHighWater: Max number of frames in the queue
+ * - latencyMin:     Min time in ms from NRF24L01_MeshSend at the source to reception
+ * - latencyMax:     Max time in ms from NRF24L01_MeshSend at the source to reception
+ * - latencyAverage: Average time in ms from NRF24L01_MeshSend at the source to reception
+ * - latencyTotal:   Sum of all latencies in ms
+ * - hopsMin:        Min number of hops
+ * - hopsMax:        Max number of hops
+ * - hopsTotal:      Sum of all hops, hopsTotal / received is the average
+ */
+typedef struct {
+	uint32_t sent;
+	uint32_t received;
+	uint32_t forwarded;
+	uint32_t failed;
+	uint32_t dropped;
+	uint32_t duplicates;
+	uint8_t queueHighWater;
+	uint32_t latencyMin;
+	uint32_t latencyMax;
+	uint32_t latencyAverage;
+	uint64_t latencyTotal;
+	uint8_t hopsMin;
+	uint8_t hopsMax;
+	uint32_t hopsTotal;
+} NRF24L01_MeshStats;
+
+/**
+ * @brief Mesh handle
+ *
+ * Fields:
+ * - device:       Device handle
+ * - address:      Address of this node in the tree
+ * - maxAttempts:  Max number of transmissions of a frame to the next hop (default 5), each of them
+ *                 includes automatic retransmissions configured for the device
+ * - messageId:    Id of the last sent frame (internal)
+ * - txAddress:    Node TX address currently points to (internal)
+ * - queue:        Ring buffer of frames to send (internal)
+ * - queueHead:    Index of the oldest frame in queue (internal)
+ * - queueCount:   Number of frames in queue (internal)
+ * - inbox:        Ring buffer of frames delivered to this node (internal)
+ * - inboxHead:    Index of the oldest frame in inbox (internal)
+ * - inboxCount:   Number of frames in inbox (internal)
+ * - seen:         Recently seen source and message id pairs, bit 24 marks used entry (internal)
+ * - seenNext:     Index of entry to overwrite next (internal)
+ * - random:       State of pseudo-random generator of retry backoff (internal)
+ * - stats:        Statistics
+ */
+typedef struct {
+	NRF24L01_Device *device;
+	uint16_t address;
+	uint8_t maxAttempts;
+	uint8_t messageId;
+	int32_t txAddress;
+	NRF24L01_MeshFrame queue[NRF24L01_MESH_QUEUE_DEPTH];
+	uint8_t queueHead;
+	uint8_t queueCount;
+	NRF24L01_MeshFrame inbox[NRF24L01_MESH_INBOX_DEPTH];
+	uint8_t inboxHead;
+	uint8_t inboxCount;
+	uint32_t seen[NRF24L01_MESH_SEEN_DEPTH];
+	uint8_t seenNext;
+	uint16_t random;
+	NRF24L01_MeshStats stats;
+} NRF24L01_Mesh;
+
+/**
+ * @brief Check if node address is valid
+ *
+ * @param address Node address
+ * @return true if every digit is 1-5 and there are no gaps and at most NRF24L01_MESH_MAX_LEVELS digits
+ */
+bool NRF24L01_MeshIsValidAddress(uint16_t address);
+
+/**
+ * @brief Get next hop on the way from node to destination
+ *
+ * @param address Address of the current node
+ * @param destination Address of the destination node
+ * @return Address of a child if destination is in its subtree, otherwise address of the parent
+ */
+uint16_t NRF24L01_MeshGetNextHop(uint16_t address, uint16_t destination);
+
+/**
+ * @brief Initialize mesh handle and set pipe 1 address of the node
+ *
+ * Device must be configured with all 6 pipes enabled with auto ACK and dynamic payload size, mesh uses all of them
+ * (see NRF24L01_MESH_BASE_ADDRESS), so they can not be used by the application.
+ * Retransmit delay of the device is set up to 750 us longer than configured, different on every node.
+ *
+ * @param mesh Mesh handle
+ * @param device Initialized device handle
+ * @param address Address of this node, NRF24L01_MESH_GATEWAY for the gateway
+ * @return true if successful, false if address is invalid
+ */
+bool NRF24L01_MeshInit(NRF24L01_Mesh *mesh, NRF24L01_Device *device, uint16_t address);
+
+/**
+ * @brief Queue data for destination node
+ *
+ * Frame is sent by the next NRF24L01_MeshUpdate.
+ *
+ * @param mesh Mesh handle
+ * @param destination Address of destination node
+ * @param data Pointer to data to send
+ * @param size Number of bytes to send (0-NRF24L01_MESH_MAX_PAYLOAD)
+ * @return true if queued, false if destination is invalid, data is too large or queue is full
+ */
+bool NRF24L01_MeshSend(NRF24L01_Mesh *mesh, uint16_t destination, const uint8_t *data, uint8_t size);
+
+/**
+ * @brief Send queued frames and listen for frames from neighbours
+ *
+ * Every queued frame is tried once unless it waits for its backoff, frames that failed go to the end of the queue,
+ * so a lost neighbour does not block the others. Once a frame failed, the other frames for the same neighbour wait
+ * for the next call, as the neighbour is likely transmitting itself and does not hear until it listens again.
+ * Listening ends 1 ms after the last received frame, so received frames are forwarded by the next call without
+ * waiting for the whole timeout.
+ * Must be called periodically on every node, also on leaf nodes to receive frames sent to them.
+ *
+ * @param mesh Mesh handle
+ * @param timeout Max time in ms to listen
+ * @return true if at least one frame was received
+ */
+bool NRF24L01_MeshUpdate(NRF24L01_Mesh *mesh, uint32_t timeout);
+
+/**
+ * @brief Take data delivered to this node
+ *
+ * @param mesh Mesh handle
+ * @param source Pointer to store address of source node
+ * @param buffer Pointer to buffer of at least NRF24L01_MESH_MAX_PAYLOAD bytes
+ * @param size Pointer to store number of received bytes
+ * @return true if data was taken, false if inbox is empty
+ */
+bool NRF24L01_MeshReceive(NRF24L01_Mesh *mesh, uint16_t *source, uint8_t *buffer, uint8_t *size);
+
+/**
+ * @brief Get mesh statistics
+ *
+ * @param mesh Mesh handle
+ * @param stats Pointer to store statistics
+ * @param reset Reset statistics after reading
+ */
+void NRF24L01_MeshGetStats(NRF24L01_Mesh *mesh, NRF24L01_MeshStats *stats, bool reset);
+
+#endif // NRF24L01_MESH_H
@@ -0,0 +1,203 @@
+/**
+ * @brief Reassembly of fragmented messages for nRF24L01+ library (internal)
+ *
+ * Shared by NRF24L01_Transport.h and NRF24L01_Fec.h. Fragments start with a common header:
+ * | marker | message id | packet size | ... | message size (2 bytes) | data |
+ * where message size is always the last 2 bytes of the header. Fragments are placed into the buffer by their
+ * number, so they can arrive out of order, and a bitmap keeps track of received ones. Frames of other messages
+ * and late fragments of the last completed one are ignored.
+ *
+ * Receiver can report the message being received to the transmitter in ACK payload(status):
+ * | marker | message id | first missing fragment (2 bytes) | bitmap of the next 64 fragments (8 bytes) |
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#ifndef NRF24L01_REASSEMBLY_H
+#define NRF24L01_REASSEMBLY_H
+
+#include "NRF24L01.h"
+
+/**
+ * Max number of data fragments per message. Defines size of fragment bitmap (1 bit per fragment).
+ */
+#define NRF24L01_REASSEMBLY_MAX_FRAGMENTS 256
+
+/**
+ * Size of status ACK payload and number of fragments covered by its bitmap.
+ */
+#define NRF24L01_REASSEMBLY_STATUS_SIZE 12
+#define NRF24L01_REASSEMBLY_STATUS_WINDOW 64
+
+/**
+ * @brief What protocol did with a fragment of the message being received
+ */
+typedef enum {
+	FRAGMENT_IGNORED = 0x00,  //Not a valid fragment of the message(e.g. duplicate)
+	FRAGMENT_ACCEPTED = 0x01, //Fragment belongs to the message, timeout is restarted
+	FRAGMENT_LOST = 0x02      //Message can not be completed anymore
+} NRF24L01_FragmentResult;
+
+/**
+ * @brief Handles one fragment of the message being received
+ *
+ * @param context Protocol handle
+ * @param packet Received fragment including header
+ * @param buffer Buffer the message is being received into
+ * @return What was done with the fragment
+ */
+typedef NRF24L01_FragmentResult (*NRF24L01_FragmentHandler)(void *context, const uint8_t *packet, uint8_t *buffer);
+
+/**
+ * @brief Reassembly state
+ *
+ * Fields:
+ * - active:         Message is partially received
+ * - messageId:      Id of the message being received
+ * - size:           Size of the message being received
+ * - chunkSize:      Data bytes per fragment of the message being received
+ * - fragments:      Number of data fragments of the message being received
+ * - received:       Number of already received data fragments
+ * - lastReceivedId: Id of the last completed or lost message, its late fragments are ignored until
+ *                   a receive call times out without any accepted fragment
+ * - bitmap:         Received data fragments of the message being received
+ */
+typedef struct {
+	bool active;
+	uint8_t messageId;
+	uint16_t size;
+	uint8_t chunkSize;
+	uint16_t fragments;
+	uint16_t received;
+	int16_t lastReceivedId;
+	uint8_t bitmap[NRF24L01_REASSEMBLY_MAX_FRAGMENTS / 8];
+} NRF24L01_Reassembly;
+
+/**
+ * @brief Received fragments reported by receiver
+ *
+ * Fields:
+ * - missing: First missing fragment, all before it are received(number of fragments if message is complete)
+ * - bitmap:  Received fragments among NRF24L01_REASSEMBLY_STATUS_WINDOW starting at missing
+ */
+typedef struct {
+	uint16_t missing;
+	uint8_t bitmap[NRF24L01_REASSEMBLY_STATUS_WINDOW / 8];
+} NRF24L01_ReassemblyStatus;
+
+/**
+ * @brief Get number of data fragments of a message
+ *
+ * @param size Size of the message
+ * @param chunkSize Data bytes per fragment
+ * @return Number of data fragments, at least 1
+ */
+uint16_t NRF24L01_FragmentCount(uint16_t size, uint8_t chunkSize);
+
+/**
+ * @brief Get number of message bytes carried by data fragment, the rest of it is padding
+ *
+ * @param size Size of the message
+ * @param chunkSize Data bytes per fragment
+ * @param fragment Number of data fragment
+ * @return Number of message bytes
+ */
+uint8_t NRF24L01_FragmentLength(uint16_t size, uint8_t chunkSize, uint16_t fragment);
+
+/**
+ * @brief Initialize reassembly state
+ *
+ * @param reassembly Reassembly state
+ */
+void NRF24L01_ReassemblyInit(NRF24L01_Reassembly *reassembly);
+
+/**
+ * @brief Check if data fragment of the message being received is already in the buffer
+ *
+ * @param reassembly Reassembly state
+ * @param fragment Number of data fragment
+ * @return true if received
+ */
+bool NRF24L01_ReassemblyHasFragment(NRF24L01_Reassembly *reassembly, uint16_t fragment);
+
+/**
+ * @brief Put data fragment into the buffer
+ *
+ * @param reassembly Reassembly state
+ * @param buffer Buffer the message is being received into
+ * @param fragment Number of data fragment
+ * @param data Data of the fragment(without header)
+ * @return true if placed, false if fragment is out of range or already received
+ */
+bool NRF24L01_ReassemblyPlace(NRF24L01_Reassembly *reassembly, uint8_t *buffer, uint16_t fragment,
+		const uint8_t *data);
+
+/**
+ * @brief Write status of the last message as ACK payload
+ *
+ * Replacing drops pending ACK payloads first and ACK that is being sent at the moment goes without payload,
+ * so it should not be done right after a frame that was sent with ACK. Without replacing status is queued
+ * behind the pending one, which is dropped once the next packet arrives.
+ *
+ * @param reassembly Reassembly state
+ * @param device Device handle
+ * @param pipe RX pipe number (0–5) fragments are received on
+ * @param marker First byte of status
+ * @param replace Drop pending ACK payloads
+ */
+void NRF24L01_ReassemblyWriteStatus(NRF24L01_Reassembly *reassembly, NRF24L01_Device *device, uint8_t pipe,
+		uint8_t marker, bool replace);
+
+/**
+ * @brief Take every ACK payload received by transmitter and find the latest status of the message
+ *
+ * @param device Device handle
+ * @param marker First byte of status
+ * @param messageId Id of the message being sent
+ * @param status Pointer to store status
+ * @return true if status of the message was received
+ */
+bool NRF24L01_ReassemblyReadStatus(NRF24L01_Device *device, uint8_t marker, uint8_t messageId,
+		NRF24L01_ReassemblyStatus *status);
+
+/**
+ * @brief Check if status reports fragment as received
+ *
+ * @param status Status received from receiver
+ * @param fragment Number of fragment
+ * @return true if received, false if missing or beyond the bitmap
+ */
+bool NRF24L01_ReassemblyStatusHas(const NRF24L01_ReassemblyStatus *status, uint16_t fragment);
+
+/**
+ * @brief Receive fragments until the message is complete
+ *
+ * Frames with other marker, packet size larger than received payload or id of the last completed message
+ * are skipped, the first fragment of a new message abandons the previous one(sender has given up on it).
+ * Header-only frames(packet size equal to headerSize) of the last message are passed to handler as requests,
+ * its result is ignored.
+ * Every fragment of the message being received is passed to handler. Radio listens on the polled path
+ * (NRF24L01_StartListeningNonBlocking) until the function returns, so fragments sent back-to-back are not missed
+ * while it settles into RX mode again and onPacketReceived callback does not take them.
+ * Timeout without any accepted fragment forgets id of the last completed message.
+ *
+ * @param reassembly Reassembly state
+ * @param device Device handle
+ * @param pipe RX pipe number (0–5)
+ * @param marker First byte of every fragment
+ * @param headerSize Size of fragment header
+ * @param handler Protocol's fragment handler
+ * @param context Protocol handle passed to handler
+ * @param buffer Pointer to buffer to store received message
+ * @param bufferSize Size of the buffer, larger messages are ignored
+ * @param size Pointer to store received message size
+ * @param timeout Timeout in ms since the last accepted fragment
+ * @return true if whole message received, false if timeout occurred, handler reported the message lost
+ *         or device is busy with non-blocking operation
+ */
+bool NRF24L01_ReassemblyReceive(NRF24L01_Reassembly *reassembly, NRF24L01_Device *device, uint8_t pipe,
+		uint8_t marker, uint8_t headerSize, NRF24L01_FragmentHandler handler, void *context, uint8_t *buffer,
+		uint16_t bufferSize, uint16_t *size, uint32_t timeout);
+
+#endif // NRF24L01_REASSEMBLY_H
@@ -0,0 +1,205 @@
+/**
+ * @brief TDMA slot scheduler for nRF24L01+ library
+ *
+ * Gateway starts every superframe with a beacon and nodes transmit only in the slot the gateway assigned to them,
+ * so packets of different nodes do not collide and every node gets one slot per superframe. Superframe consists of:
+ *
+ * | beacon slot | data slot 1 | ... | data slot N | join slot |
+ *
+ * Node without a slot sends a join request in a random slot between the first slot after the last assigned one
+ * (announced in beacons) and the join slot. Requests of several nodes may still collide, so every node waits
+ * a random number of superframes before the next request(range doubled after every unanswered one).
+ * Gateway assigns the first free data slot and keeps it for the node, beacons announce assignments in rotation,
+ * starting with the ones assigned in the previous superframe. Gateway sends beacons by a fixed schedule, nodes time
+ * their slots from beacon reception with DWT cycle counter and listen to a beacon again every resyncInterval
+ * superframes, so clock drift stays within guard time.
+ *
+ * Beacon:       | 0xB5 | sequence | number of slots | slot time in us (2 bytes) | join from slot | count |
+ *               | (node id, slot) pairs |
+ * Join request: | 0xB6 | node id |
+ * Data:         | 0xB7 | node id | size | data |
+ *
+ * Worst-case latency of a packet is one superframe, (number of slots + 2) * slot time, plus its transmission.
+ * Node that was idle for more than resyncInterval superframes listens for a beacon first, so its worst case is two
+ * superframes.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#ifndef NRF24L01_TDMA_H
+#define NRF24L01_TDMA_H
+
+#include "NRF24L01.h"
+
+#define NRF24L01_TDMA_MAX_SLOTS 128
+#define NRF24L01_TDMA_NO_SLOT 0 //Data slots are numbered from 1
+#define NRF24L01_TDMA_GUARD_TIME 200 //Time in us at the beginning of every slot nobody transmits in
+#define NRF24L01_TDMA_MAX_SUPERFRAME 1000000 //Time in us, keeps beacon prediction within range of DWT cycle counter
+#define NRF24L01_TDMA_MAX_JOIN_BACKOFF 8 //Max number of superframes between join requests
+
+#define NRF24L01_TDMA_BEACON_MARKER 0xB5
+#define NRF24L01_TDMA_JOIN_MARKER 0xB6
+#define NRF24L01_TDMA_DATA_MARKER 0xB7
+#define NRF24L01_TDMA_BEACON_HEADER_SIZE 7
+#define NRF24L01_TDMA_BEACON_ASSIGNMENTS ((32 - NRF24L01_TDMA_BEACON_HEADER_SIZE) / 2)
+#define NRF24L01_TDMA_HEADER_SIZE 3
+#define NRF24L01_TDMA_MAX_PAYLOAD (32 - NRF24L01_TDMA_HEADER_SIZE)
+
+/**
+ * @brief TDMA statistics
+ *
+ * Fields:
+ * - beacons:        Beacons sent by gateway or received by node
+ * - missedBeacons:  Times node listened for a beacon for 2 superframes without hearing one
+ * - joins:          Join requests sent by node or slots assigned by gateway
+ * - packets:        Packets delivered by node or received by gateway
+ * - failed:         Packets node sent in its slot that were not acknowledged
+ * - lateSlots:      Times node missed start of its slot and waited for the next superframe
+ * - latencyMax:     Max time in us from NRF24L01_TdmaTransmitPacket call to ACK
+ */
+typedef struct {
+	uint32_t beacons;
+	uint32_t missedBeacons;
+	uint32_t joins;
+	uint32_t packets;
+	uint32_t failed;
+	uint32_t lateSlots;
+	uint32_t latencyMax;
+} NRF24L01_TdmaStats;
+
+/**
+ * @brief TDMA handle
+ *
+ * Fields:
+ * - device:           Device handle
+ * - gateway:          Handle belongs to gateway
+ * - nodeId:           Id of node (1-255), 0 for gateway
+ * - beaconAddress:    Address beacons are sent to
+ * - uplinkAddress:    Address nodes send join requests and data to
+ * - numberOfSlots:    Number of data slots in superframe, nodes learn it from beacons
+ * - slotTime:         Length of slot in us, nodes learn it from beacons
+ * - resyncInterval:   Number of superframes node transmits by predicted beacon time before it listens
+ *                     to a beacon again (default 8)
+ * - slot:             Assigned data slot of node, NRF24L01_TDMA_NO_SLOT if none
+ * - joinFrom:         First slot join requests may be sent in, all slots after it are free
+ * - sequence:         Sequence number of the last beacon
+ * - synchronized:     Node knows beacon timing (internal)
+ * - beaconCycles:     DWT cycle count when the last beacon was sent or received(predicted by node) (internal)
+ * - beaconTick:       HAL tick when node heard the last beacon (internal)
+ * - predictedBeacons: Number of beacons node predicted since it heard one (internal)
+ * - joinWindow:       Node picks join backoff from [0, joinWindow) superframes (internal)
+ * - joinDelay:        Superframes node waits before its next join request (internal)
+ * - random:           State of pseudo-random generator of join backoff (internal)
+ * - slotOwners:       Node id per data slot, 0 if slot is free (gateway, internal)
+ * - announceSlot:     Data slot the next beacon starts announcing from (gateway, internal)
+ * - assigned:         A slot was assigned since the last beacon (gateway, internal)
+ * - stats:            Statistics
+ */
+typedef struct {
+	NRF24L01_Device *device;
+	bool gateway;
+	uint8_t nodeId;
+	uint64_t beaconAddress;
+	uint64_t uplinkAddress;
+	uint8_t numberOfSlots;
+	uint16_t slotTime;
+	uint8_t resyncInterval;
+	uint8_t slot;
+	uint8_t joinFrom;
+	uint8_t sequence;
+	bool synchronized;
+	uint32_t beaconCycles;
+	uint32_t beaconTick;
+	uint8_t predictedBeacons;
+	uint8_t joinWindow;
+	uint8_t joinDelay;
+	uint16_t random;
+	uint8_t slotOwners[NRF24L01_TDMA_MAX_SLOTS + 1];
+	uint8_t announceSlot;
+	bool assigned;
+	NRF24L01_TdmaStats stats;
+} NRF24L01_Tdma;
+
+/**
+ * @brief Initialize gateway
+ *
+ * Device must be configured with enableNoAckFeature and pipe 1 enabled with auto ACK and dynamic payload size,
+ * its address is set to uplinkAddress. First beacon is sent by the first NRF24L01_TdmaReceive.
+ *
+ * @param tdma TDMA handle
+ * @param device Initialized device handle
+ * @param beaconAddress Address beacons are sent to
+ * @param uplinkAddress Address gateway receives on
+ * @param numberOfSlots Number of data slots in superframe (1-NRF24L01_TDMA_MAX_SLOTS), at least number of nodes
+ * @param slotTime Length of slot in us, must fit guard time and a packet with all retransmissions,
+ *                 e.g. 2000 us at 2 Mbps with 3 retransmissions of 500 us delay
+ * @return true if initialized, false if arguments are invalid or superframe is longer than
+ *         NRF24L01_TDMA_MAX_SUPERFRAME
+ */
+bool NRF24L01_TdmaInitGateway(NRF24L01_Tdma *tdma, NRF24L01_Device *device, uint64_t beaconAddress,
+		uint64_t uplinkAddress, uint8_t numberOfSlots, uint16_t slotTime);
+
+/**
+ * @brief Initialize node
+ *
+ * Device must be configured with pipe 0 enabled with auto ACK and dynamic payload size. Pipe 0 is switched
+ * between beacon address(listening) and uplink address(ACKs), so it can not be used by the application.
+ *
+ * @param tdma TDMA handle
+ * @param device Initialized device handle
+ * @param beaconAddress Address beacons are sent to
+ * @param uplinkAddress Address gateway receives on
+ * @param nodeId Unique id of node (1-255)
+ * @return true if initialized, false if node id is invalid
+ */
+bool NRF24L01_TdmaInitNode(NRF24L01_Tdma *tdma, NRF24L01_Device *device, uint64_t beaconAddress,
+		uint64_t uplinkAddress, uint8_t nodeId);
+
+/**
+ * @brief Transmit one packet in the slot of node
+ *
+ * Synchronizes to beacons and joins first if needed. If slot of the current superframe has already started,
+ * waits for the next one. Only one packet is sent per call and superframe.
+ *
+ * @param tdma TDMA handle of node
+ * @param data Pointer to data to send
+ * @param size Number of bytes to send (max NRF24L01_TDMA_MAX_PAYLOAD)
+ * @param timeout Timeout in ms
+ * @return true if packet was acknowledged, false if it failed or timeout occurred before the slot
+ */
+bool NRF24L01_TdmaTransmitPacket(NRF24L01_Tdma *tdma, const uint8_t *data, uint8_t size, uint32_t timeout);
+
+/**
+ * @brief Send beacons and receive one packet from nodes
+ *
+ * Must be called continuously, beacons are sent only from inside of it, so the application should not spend more
+ * than guard time between calls. Join requests are handled internally.
+ *
+ * @param tdma TDMA handle of gateway
+ * @param nodeId Pointer to store id of node that sent the packet
+ * @param buffer Pointer to buffer of at least NRF24L01_TDMA_MAX_PAYLOAD bytes
+ * @param size Pointer to store number of received bytes
+ * @param timeout Timeout in ms
+ * @return true if packet received, false if timeout occurred
+ */
+bool NRF24L01_TdmaReceive(NRF24L01_Tdma *tdma, uint8_t *nodeId, uint8_t *buffer, uint8_t *size, uint32_t timeout);
+
+/**
+ * @brief Release slot of node, e.g. after it was removed from the network
+ *
+ * @param tdma TDMA handle of gateway
+ * @param nodeId Id of node
+ */
+void NRF24L01_TdmaReleaseNode(NRF24L01_Tdma *tdma, uint8_t nodeId);
+
+/**
+ * @brief Get TDMA statistics
+ *
+ * @param tdma TDMA handle
+ * @param stats Pointer to store statistics
+ * @param reset Reset statistics after reading
+ */
+void NRF24L01_TdmaGetStats(NRF24L01_Tdma *tdma, NRF24L01_TdmaStats *stats, bool reset);
+
+#endif // NRF24L01_TDMA_H
@@ -0,0 +1,112 @@
+/**
+ * @brief Reliable transport layer for nRF24L01+ library
+ *
+ * Splits messages into fragments with sequence numbers and sends them in windows. Every fragment of a window
+ * but the last one is sent without ACK, the last one is acknowledged and its ACK payload carries receiver's
+ * bitmap of received fragments. Only the fragments missing from the bitmap are sent again in the next window,
+ * so a lost fragment neither restarts the whole message nor stalls the link for retransmit delays.
+ * With window 1 every fragment is acknowledged and a failed one is sent again right away(stop-and-wait).
+ * Receiver places fragments by sequence number and ignores duplicates and frames of other messages.
+ *
+ * Fragment format:
+ * | 0xD5 | message id | packet size | sequence (2 bytes) | message size (2 bytes) | data |
+ * Highest bit of sequence marks acknowledged fragment. Header-only fragment(packet size 7) opens a windowed
+ * message, its ACK takes stale ACK payload of the receiver.
+ *
+ * ACK payload format(status of the message being received):
+ * | 0xD6 | message id | first missing fragment (2 bytes) | bitmap of the next 64 fragments (8 bytes) |
+ *
+ * Both sides need enableAckPayloadFeature, transmitter also enableNoAckFeature for windows larger than 1.
+ * Receiver replaces its pending ACK payloads, so pipe used for receiving should not carry other ones.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#ifndef NRF24L01_TRANSPORT_H
+#define NRF24L01_TRANSPORT_H
+
+#include "NRF24L01_Reassembly.h"
+
+/**
+ * Max number of fragments per message.
+ * Max message size is NRF24L01_TRANSPORT_MAX_FRAGMENTS * (packetSize - 7) bytes.
+ */
+#define NRF24L01_TRANSPORT_MAX_FRAGMENTS NRF24L01_REASSEMBLY_MAX_FRAGMENTS
+
+/**
+ * Max number of fragments per window, limited by the bitmap of ACK payload.
+ */
+#define NRF24L01_TRANSPORT_MAX_WINDOW NRF24L01_REASSEMBLY_STATUS_WINDOW
+
+#define NRF24L01_TRANSPORT_FRAME_MARKER 0xD5
+#define NRF24L01_TRANSPORT_STATUS_MARKER 0xD6
+#define NRF24L01_TRANSPORT_HEADER_SIZE 7
+#define NRF24L01_TRANSPORT_ACK_FLAG 0x80 //In the high byte of sequence
+#define NRF24L01_TRANSPORT_FLUSH_TIMEOUT 10 //ms for fragments without ACK to leave TX FIFO
+
+/**
+ * @brief Transport handle
+ *
+ * Fields:
+ * - device:             Device handle
+ * - pipe:               RX pipe number (0–5) used for receiving
+ * - packetSize:         Size of each fragment including header (8-32). Transmitter side only.
+ * - window:             Max number of fragments sent per acknowledged one (1-64). Transmitter side only.
+ * - maxRetransmissions: Max number of fragments per message that were not delivered and had to be sent again
+ *                       before giving up (default 32)
+ * - messageId:          Id of the last sent message (internal)
+ * - txBitmap:           Delivered fragments of the message being sent (internal)
+ * - rx:                 Reassembly of the message being received (internal)
+ */
+typedef struct {
+	NRF24L01_Device *device;
+	uint8_t pipe;
+	uint8_t packetSize;
+	uint8_t window;
+	uint16_t maxRetransmissions;
+	uint8_t messageId;
+	uint8_t txBitmap[NRF24L01_TRANSPORT_MAX_FRAGMENTS / 8];
+	NRF24L01_Reassembly rx;
+} NRF24L01_Transport;
+
+/**
+ * @brief Initialize transport handle
+ *
+ * @param transport Transport handle
+ * @param device Initialized device handle
+ * @param pipe RX pipe number (0–5) used for receiving
+ * @param packetSize Size of each fragment including header (8-32)
+ * @param window Max number of fragments sent per acknowledged one (1-64), 1 is stop-and-wait
+ */
+void NRF24L01_TransportInit(NRF24L01_Transport *transport, NRF24L01_Device *device, uint8_t pipe,
+		uint8_t packetSize, uint8_t window);
+
+/**
+ * @brief Send message reliably
+ *
+ * @param transport Transport handle
+ * @param data Pointer to data to send
+ * @param size Number of bytes to send
+ * @return true if every fragment was delivered, false if message is too large or retransmissions were exhausted
+ */
+bool NRF24L01_TransportSend(NRF24L01_Transport *transport, const uint8_t *data, uint16_t size);
+
+/**
+ * @brief Receive message
+ *
+ * Progress is kept in the transport handle, so if timeout occurs in the middle of a message,
+ * the next call with the same buffer continues receiving it instead of starting over.
+ * Every accepted fragment replaces pending ACK payload with the status of the message.
+ *
+ * @param transport Transport handle
+ * @param buffer Pointer to buffer to store received message
+ * @param bufferSize Size of the buffer, larger messages are ignored
+ * @param size Pointer to store received message size
+ * @param timeout Timeout in ms since the last received fragment
+ * @return true if whole message received, false if timeout occurred
+ */
+bool NRF24L01_TransportReceive(NRF24L01_Transport *transport, uint8_t *buffer, uint16_t bufferSize, uint16_t *size,
+		uint32_t timeout);
+
+#endif // NRF24L01_TRANSPORT_H
@@ -0,0 +1,47 @@
+/**
+ * @brief Implementation of helpers shared by benchmarks of nRF24L01+ host simulator
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Bench.h"
+
+int benchFailures = 0;
+
+NRF24L01_Config NRF24L01_BenchConfig(DATA_RATE dataRate, bool transmitter) {
+	NRF24L01_Config config = { 0 };
+	config.addressWidth = ADDR_WIDTH_5BYTES;
+	config.retransmitCount = RETR_TIMES_15;
+	//Long enough for 32 byte ACK payload at every data rate
+	config.retransmitDelay = dataRate == DATA_RATE_250KBPS ? RETR_DELAY_1500US : RETR_DELAY_750US;
+	config.channel = 76;
+	config.rfPower = RF_PWR_0DBM;
+	config.dataRate = dataRate;
+	config.rxPipes[0] = (NRF24L01_RxPipe ) { 0, transmitter, true, NRF24L01_BENCH_ADDRESS, 32, true };
+	config.rxPipes[1] = (NRF24L01_RxPipe ) { 1, !transmitter, true, NRF24L01_BENCH_ADDRESS, 32, true };
+	for (uint8_t i = 2; i < 6; i++) {
+		config.rxPipes[i].index = i;
+	}
+	config.txPipeAddress = NRF24L01_BENCH_ADDRESS;
+	config.enableDynamicPayloadSizeFeature = true;
+	config.enableAckPayloadFeature = true;
+	config.enableNoAckFeature = true;
+	return config;
+}
+
+const char* NRF24L01_BenchDataRateName(DATA_RATE dataRate) {
+	switch (dataRate) {
+	case DATA_RATE_250KBPS:
+		return "250 kbps";
+	case DATA_RATE_1MBPS:
+		return "1 Mbps";
+	default:
+		return "2 Mbps";
+	}
+}
+
+int NRF24L01_BenchExit(const char *name) {
+	printf("%s: %s\n", name, benchFailures == 0 ? "PASS" : "FAIL");
+	return benchFailures == 0 ? 0 : 1;
+}
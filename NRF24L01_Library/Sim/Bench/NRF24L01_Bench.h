@@ -0,0 +1,58 @@
+/**
+ * @brief Helpers shared by benchmarks of nRF24L01+ host simulator
+ *
+ * Every benchmark prints its measurements and checks them against thresholds, a failed check makes the
+ * benchmark exit with non-zero status, so it can run in CI with "make check".
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#ifndef NRF24L01_BENCH_H
+#define NRF24L01_BENCH_H
+
+#include "NRF24L01_Sim.h"
+#include <stdio.h>
+
+#define NRF24L01_BENCH_ADDRESS 0xA1B2C3D4E5
+
+extern int benchFailures;
+
+#define NRF24L01_BENCH_CHECK(condition, ...) \
+	do { \
+		if (!(condition)) { \
+			printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+			benchFailures++; \
+		} \
+	} while (0)
+
+/**
+ * @brief Build config of a point to point link with dynamic payload size and ACK payloads
+ *
+ * Transmitter receives ACKs on pipe 0, receiver listens on pipe 1, both use the same address.
+ *
+ * @param dataRate Data rate
+ * @param transmitter true for transmitting side
+ * @return Config
+ */
+NRF24L01_Config NRF24L01_BenchConfig(DATA_RATE dataRate, bool transmitter);
+
+/**
+ * @brief Get name of data rate
+ *
+ * @param dataRate Data rate
+ * @return Name, e.g. "1 Mbps"
+ */
+const char* NRF24L01_BenchDataRateName(DATA_RATE dataRate);
+
+/**
+ * @brief Report result of the benchmark
+ *
+ * @param name Benchmark name
+ * @return Exit status, 0 if every check passed
+ */
+int NRF24L01_BenchExit(const char *name);
+
+#endif // NRF24L01_BENCH_H
@@ -0,0 +1,164 @@
+/**
+ * @brief Packets and goodput of compressed multi-packet messages
+ *
+ * Sends the same 4 KB message with and without compressMessages for sample data shaped like typical recordings,
+ * generated from a fixed seed: log of 16 byte sensor frames(timestamp, temperature, humidity, acceleration,
+ * status) with sensor noise, text log lines, zero filled buffer and random data. Packets are counted by the library's
+ * statistics, goodput is message data per simulated time(CPU time of the codec is not simulated).
+ * Compression must save packets on repetitive data and must never cost packets on random data.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Bench.h"
+#include "NRF24L01_Compression.h"
+
+#define BENCH_MESSAGE_SIZE 4096
+
+typedef struct {
+	const char *name;
+	double maxRatio; //Max compressed / plain packets
+	uint8_t message[BENCH_MESSAGE_SIZE];
+} BenchData;
+
+typedef struct {
+	const BenchData *data;
+	bool compress;
+	bool delivered;
+	bool received;
+	uint32_t packets;
+	uint64_t duration;
+} BenchRun;
+
+static BenchData sets[] = {
+	{ "Sensor frames, 16 bytes", 0.7, { 0 } },
+	{ "Text log", 0.5, { 0 } },
+	{ "Zeros", 0.1, { 0 } },
+	{ "Random", 1.0, { 0 } }
+};
+
+static NRF24L01_Device transmitter;
+static NRF24L01_Device receiver;
+static NRF24L01_Config transmitterConfig;
+static NRF24L01_Config receiverConfig;
+static NRF24L01_Compression transmitterCompression;
+static NRF24L01_Compression receiverCompression;
+static uint8_t buffer[BENCH_MESSAGE_SIZE + 32]; //Padding of the last packet is stored too
+
+//Uniformly distributed number in range 0 to range - 1
+static int32_t Noise(uint32_t range) {
+	return (int32_t) ((uint32_t) (NRF24L01_SimRandom() * range) % range);
+}
+
+//Sensor sampled every 100 ms, noise in the lowest bits of every reading
+static void RecordSensorFrames(uint8_t *data) {
+	for (uint32_t i = 0; i < BENCH_MESSAGE_SIZE / 16; i++) {
+		uint8_t *frame = &data[i * 16];
+		uint32_t timestamp = 1000000 + i * 100;
+		int16_t readings[5] = {
+			(int16_t) (2341 + i / 64 + Noise(3)),     //Temperature, 0.01 C
+			(int16_t) (4520 - i / 32 + Noise(2)),     //Humidity, 0.01 %
+			(int16_t) (Noise(5) - 2),                 //Acceleration X, mg
+			(int16_t) (Noise(5) - 2),                 //Acceleration Y, mg
+			(int16_t) (1000 + Noise(5) - 2)           //Acceleration Z, mg
+		};
+		memcpy(frame, &timestamp, sizeof(timestamp));
+		memcpy(&frame[4], readings, sizeof(readings));
+		frame[14] = 0x01; //Status
+		frame[15] = 0x00;
+	}
+}
+
+static void RecordTextLog(uint8_t *data) {
+	char line[80];
+	uint32_t offset = 0;
+	for (uint32_t i = 0; offset < BENCH_MESSAGE_SIZE; i++) {
+		int length = snprintf(line, sizeof(line), "00:%02u:%02u.%u INFO temp=%u.%02uC hum=%u.%u%% bat=3.%02uV\n",
+				i / 600 % 60, i / 10 % 60, i % 10, 23 + i / 500, Noise(100),
+				45 + Noise(2), Noise(10), 71 - i / 100);
+		uint32_t size = offset + length < BENCH_MESSAGE_SIZE ? (uint32_t) length : BENCH_MESSAGE_SIZE - offset;
+		memcpy(&data[offset], line, size);
+		offset += size;
+	}
+}
+
+static void RecordRandom(uint8_t *data) {
+	for (uint32_t i = 0; i < BENCH_MESSAGE_SIZE; i++) {
+		data[i] = (uint8_t) Noise(256);
+	}
+}
+
+static void Transmitter(void *arg) {
+	BenchRun *run = arg;
+	NRF24L01_Stats stats;
+	transmitter.enableStatistics = true;
+	transmitter.compression = &transmitterCompression;
+	transmitter.compressMessages = run->compress;
+	NRF24L01_Init(&transmitter, &transmitterConfig);
+	HAL_Delay(5);
+	NRF24L01_GetStats(&transmitter, &stats, true);
+	uint64_t start = NRF24L01_SimGetTime();
+	run->delivered = NRF24L01_Transmit(&transmitter, run->data->message, BENCH_MESSAGE_SIZE, 32);
+	run->duration = NRF24L01_SimGetTime() - start;
+	NRF24L01_GetStats(&transmitter, &stats, true);
+	run->packets = stats.txPackets;
+	HAL_Delay(5); //Receiver takes the last packets
+	NRF24L01_SimStop();
+}
+
+static void Receiver(void *arg) {
+	BenchRun *run = arg;
+	receiver.compression = &receiverCompression;
+	NRF24L01_Init(&receiver, &receiverConfig);
+	run->received = NRF24L01_Receive(&receiver, 1, buffer, 1000)
+			&& memcmp(buffer, run->data->message, BENCH_MESSAGE_SIZE) == 0;
+}
+
+static BenchRun Run(const BenchData *data, bool compress) {
+	BenchRun run = { data, compress, false, false, 0, 0 };
+	memset(buffer, 0, sizeof(buffer));
+	transmitterConfig = NRF24L01_BenchConfig(DATA_RATE_2MBPS, true);
+	receiverConfig = NRF24L01_BenchConfig(DATA_RATE_2MBPS, false);
+	NRF24L01_SimReset(NULL);
+	NRF24L01_SimNode *node = NRF24L01_SimAddNode(Transmitter, &run);
+	NRF24L01_SimAttach(&transmitter, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	node = NRF24L01_SimAddNode(Receiver, &run);
+	NRF24L01_SimAttach(&receiver, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	NRF24L01_SimRun(60 * NRF24L01_SIM_SECOND);
+	return run;
+}
+
+static double Goodput(const BenchRun *run) {
+	return run->duration > 0 ? BENCH_MESSAGE_SIZE * 8.0 * NRF24L01_SIM_SECOND / run->duration / 1000 : 0;
+}
+
+int main(void) {
+	NRF24L01_SimReset(NULL); //Seeds NRF24L01_SimRandom, sample data is the same in every run
+	RecordSensorFrames(sets[0].message);
+	RecordTextLog(sets[1].message);
+	RecordRandom(sets[3].message);
+
+	printf("%d byte message, 32 byte packets at 2 Mbps, goodput in kbps\n", BENCH_MESSAGE_SIZE);
+	printf("| Data                    | Plain packets | Compressed packets | Ratio | Plain goodput | "
+			"Compressed goodput |\n");
+	printf("|-------------------------|---------------|--------------------|-------|---------------|"
+			"--------------------|\n");
+	for (uint8_t i = 0; i < sizeof(sets) / sizeof(sets[0]); i++) {
+		BenchData *data = &sets[i];
+		BenchRun plain = Run(data, false);
+		BenchRun compressed = Run(data, true);
+		double ratio = plain.packets > 0 ? (double) compressed.packets / plain.packets : 0;
+		printf("| %-23s | %13u | %18u | %5.2f | %13.0f | %18.0f |\n", data->name, plain.packets,
+				compressed.packets, ratio, Goodput(&plain), Goodput(&compressed));
+
+		NRF24L01_BENCH_CHECK(plain.delivered && plain.received, "%s: plain message not received", data->name);
+		NRF24L01_BENCH_CHECK(compressed.delivered && compressed.received, "%s: compressed message not received",
+				data->name);
+		//Compression is dropped when it saves no packets, so it never costs any
+		NRF24L01_BENCH_CHECK(compressed.packets <= plain.packets && ratio <= data->maxRatio,
+				"%s: %u packets compressed, %u plain", data->name, compressed.packets, plain.packets);
+	}
+	printf("\n");
+	return NRF24L01_BenchExit("NRF24L01_BenchCompression");
+}
@@ -0,0 +1,174 @@
+/**
+ * @brief Goodput of multi-fragment messages with XOR parity against acknowledged messages on a lossy link
+ *
+ * Sends 1000 byte messages in 32 byte packets until BENCH_MESSAGES of them arrived intact, at several loss rates
+ * (every delivery, ACKs included, is lost with the same probability). NRF24L01_Transmit is the current behavior:
+ * every packet is acknowledged and retransmitted up to 15 times 250 us apart. FEC sends fragments without ACK,
+ * parity rebuilds one lost fragment per group and groups that lost more are repaired: transmitter asks for
+ * receiver's status and sends their missing fragments again. Receiver reports every message to the transmitter
+ * (as an application level acknowledgment would), a message that was not delivered is sent again from scratch.
+ * Goodput is message data per simulated time, including the time lost messages took.
+ *
+ * FEC must beat NRF24L01_Transmit at the loss it targets: groups of 8 from 5%, groups of 4 from 10%.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Bench.h"
+#include "NRF24L01_Fec.h"
+
+#define BENCH_MESSAGE_SIZE 1000
+#define BENCH_MESSAGES 20
+#define BENCH_MAX_ATTEMPTS 200
+#define BENCH_RECEIVE_TIMEOUT 20 //ms after the last fragment before receiver gives up on a message
+#define BENCH_REPAIRS 32
+
+typedef enum {
+	BENCH_PLAIN = 0,
+	BENCH_FEC_8 = 8,
+	BENCH_FEC_4 = 4
+} BenchMode;
+
+typedef struct {
+	BenchMode mode;
+	uint32_t attempts;  //Messages sent, including the ones sent again
+	uint32_t delivered; //Messages that arrived intact
+	uint32_t recovered; //Fragments rebuilt from parity
+	uint64_t duration;
+} BenchRun;
+
+typedef enum {
+	VERDICT_PENDING = 0,
+	VERDICT_RECEIVED,
+	VERDICT_LOST
+} BenchVerdict;
+
+static NRF24L01_Device transmitter;
+static NRF24L01_Device receiver;
+static NRF24L01_Config transmitterConfig;
+static NRF24L01_Config receiverConfig;
+static NRF24L01_Fec transmitterFec;
+static NRF24L01_Fec receiverFec;
+static uint8_t message[BENCH_MESSAGE_SIZE];
+static uint8_t buffer[BENCH_MESSAGE_SIZE + 32]; //Padding of the last packet is stored too
+static volatile BenchVerdict verdict; //Receiver's report of the last message, shared by the nodes
+
+//Every message differs, so a stale buffer is never taken for the new one
+static void FillMessage(uint32_t number) {
+	for (uint32_t i = 0; i < BENCH_MESSAGE_SIZE; i++) {
+		message[i] = (uint8_t) (number * 31 + i * 7);
+	}
+}
+
+static void Transmitter(void *arg) {
+	BenchRun *run = arg;
+	NRF24L01_Init(&transmitter, &transmitterConfig);
+	NRF24L01_FecInit(&transmitterFec, &transmitter, 1, 32, run->mode);
+	transmitterFec.noAck = true;
+	transmitterFec.maxRetransmissions = BENCH_REPAIRS;
+	HAL_Delay(5);
+
+	uint64_t start = NRF24L01_SimGetTime();
+	while (run->delivered < BENCH_MESSAGES && run->attempts < BENCH_MAX_ATTEMPTS) {
+		FillMessage(run->delivered);
+		verdict = VERDICT_PENDING;
+		run->attempts++;
+		if (run->mode == BENCH_PLAIN) {
+			NRF24L01_Transmit(&transmitter, message, BENCH_MESSAGE_SIZE, 32);
+		} else {
+			NRF24L01_FecSend(&transmitterFec, message, BENCH_MESSAGE_SIZE);
+		}
+		while (verdict == VERDICT_PENDING) {
+			HAL_Delay(1);
+		}
+		run->delivered += verdict == VERDICT_RECEIVED;
+	}
+	run->duration = NRF24L01_SimGetTime() - start;
+	NRF24L01_SimStop();
+}
+
+static void Receiver(void *arg) {
+	BenchRun *run = arg;
+	NRF24L01_FecStats stats;
+	uint16_t size = 0;
+	NRF24L01_Init(&receiver, &receiverConfig);
+	NRF24L01_FecInit(&receiverFec, &receiver, 1, 32, run->mode);
+	while (true) {
+		bool received;
+		if (run->mode == BENCH_PLAIN) {
+			received = NRF24L01_Receive(&receiver, 1, buffer, 1000);
+			size = BENCH_MESSAGE_SIZE;
+		} else {
+			received = NRF24L01_FecReceive(&receiverFec, buffer, sizeof(buffer), &size, BENCH_RECEIVE_TIMEOUT);
+		}
+
+		//Nothing arrived at all, e.g. between messages
+		if (!received && verdict != VERDICT_PENDING) {
+			continue;
+		}
+		received = received && size == BENCH_MESSAGE_SIZE && memcmp(buffer, message, BENCH_MESSAGE_SIZE) == 0;
+		NRF24L01_FecGetStats(&receiverFec, &stats, true);
+		run->recovered += stats.recovered;
+		//Fragments of a lost message still in the air are ignored by its id, the next one is sent with a new id
+		verdict = received ? VERDICT_RECEIVED : VERDICT_LOST;
+	}
+}
+
+static BenchRun Run(BenchMode mode, float loss) {
+	BenchRun run = { mode, 0, 0, 0, 0 };
+	NRF24L01_SimAir air = NRF24L01_SimDefaultAir();
+	air.loss = loss;
+	transmitterConfig = NRF24L01_BenchConfig(DATA_RATE_2MBPS, true);
+	receiverConfig = NRF24L01_BenchConfig(DATA_RATE_2MBPS, false);
+	transmitterConfig.retransmitDelay = RETR_DELAY_250US; //No ACK payloads, shortest delay is enough
+	receiverConfig.retransmitDelay = RETR_DELAY_250US;
+	NRF24L01_SimReset(&air);
+	verdict = VERDICT_RECEIVED; //Receiver times out before the first message
+	NRF24L01_SimNode *node = NRF24L01_SimAddNode(Transmitter, &run);
+	NRF24L01_SimAttach(&transmitter, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	node = NRF24L01_SimAddNode(Receiver, &run);
+	NRF24L01_SimAttach(&receiver, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	NRF24L01_SimRun(120 * NRF24L01_SIM_SECOND);
+	return run;
+}
+
+static double Goodput(const BenchRun *run) {
+	return run->duration > 0 ?
+			(double) run->delivered * BENCH_MESSAGE_SIZE * 8.0 * NRF24L01_SIM_SECOND / run->duration / 1000 : 0;
+}
+
+int main(void) {
+	const float losses[] = { 0.0f, 0.01f, 0.05f, 0.1f, 0.2f };
+	const BenchMode modes[] = { BENCH_PLAIN, BENCH_FEC_8, BENCH_FEC_4 };
+	printf("%d byte messages in 32 byte packets at 2 Mbps, goodput in kbps(messages sent per %d delivered)\n",
+			BENCH_MESSAGE_SIZE, BENCH_MESSAGES);
+	printf("| Loss | NRF24L01_Transmit | FEC groupSize 8 | FEC groupSize 4 |\n");
+	printf("|------|-------------------|-----------------|-----------------|\n");
+	for (uint8_t i = 0; i < sizeof(losses) / sizeof(losses[0]); i++) {
+		BenchRun runs[3];
+		for (uint8_t mode = 0; mode < 3; mode++) {
+			runs[mode] = Run(modes[mode], losses[i]);
+		}
+		printf("| %3.0f%% | %10.0f (%4u) | %8.0f (%4u) | %8.0f (%4u) |\n", losses[i] * 100, Goodput(&runs[0]),
+				runs[0].attempts, Goodput(&runs[1]), runs[1].attempts, Goodput(&runs[2]), runs[2].attempts);
+
+		//Repair delivers what parity could not rebuild, so no message has to be sent again
+		for (uint8_t mode = 0; mode < 3; mode++) {
+			NRF24L01_BENCH_CHECK(runs[mode].delivered == BENCH_MESSAGES && runs[mode].attempts == BENCH_MESSAGES,
+					"loss %.0f%%, groupSize %u: %u of %u messages delivered", losses[i] * 100, modes[mode],
+					runs[mode].delivered, runs[mode].attempts);
+		}
+		//No packet waits for ACK, one parity per group and repair of the rest must pay off at the loss they target
+		for (uint8_t mode = 1; mode < 3; mode++) {
+			float target = modes[mode] == BENCH_FEC_8 ? 0.05f : 0.1f;
+			NRF24L01_BENCH_CHECK(losses[i] < target || Goodput(&runs[mode]) > Goodput(&runs[0]),
+					"loss %.0f%%: goodput %.0f kbps with groupSize %u, %.0f kbps acknowledged", losses[i] * 100,
+					Goodput(&runs[mode]), modes[mode], Goodput(&runs[0]));
+		}
+		NRF24L01_BENCH_CHECK(losses[i] == 0 || runs[2].recovered > 0, "loss %.0f%%: no fragment rebuilt",
+				losses[i] * 100);
+	}
+	printf("\n");
+	return NRF24L01_BenchExit("NRF24L01_BenchFec");
+}
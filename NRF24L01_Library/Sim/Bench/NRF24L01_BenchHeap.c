@@ -0,0 +1,144 @@
+/**
+ * @brief Heap use of SPI register and payload path
+ *
+ * Linked with malloc, calloc, realloc and free wrapped(see Makefile), every call made while counting is on is
+ * counted, whether it comes from the library or from the model. After Init and a few warm up packets that fill
+ * the model's packet pool, single packets, multi-packet messages, register verification and statistics must not
+ * allocate at all.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Bench.h"
+#include <stdlib.h>
+
+#define BENCH_WARM_UP_PACKETS 10
+#define BENCH_PACKETS 500
+#define BENCH_MESSAGES 20
+#define BENCH_MESSAGE_SIZE 1000
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void *pointer, size_t size);
+void __real_free(void *pointer);
+
+typedef struct {
+	const char *name;
+	uint32_t count;
+	uint32_t allocations;
+	uint32_t frees;
+} BenchPhase;
+
+static BenchPhase phases[] = {
+	{ "TransmitPacket/ReceivePacket, 32 bytes", 0, 0, 0 },
+	{ "Transmit/Receive, 1000 bytes", 0, 0, 0 },
+	{ "VerifyRegisters, GetStats", 0, 0, 0 }
+};
+static BenchPhase *phase; //NULL while not counting
+
+void* __wrap_malloc(size_t size) {
+	if (phase != NULL) {
+		phase->allocations++;
+	}
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+	if (phase != NULL) {
+		phase->allocations++;
+	}
+	return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void *pointer, size_t size) {
+	if (phase != NULL) {
+		phase->allocations++;
+	}
+	return __real_realloc(pointer, size);
+}
+
+void __wrap_free(void *pointer) {
+	if (phase != NULL && pointer != NULL) {
+		phase->frees++;
+	}
+	__real_free(pointer);
+}
+
+static NRF24L01_Device transmitter;
+static NRF24L01_Device receiver;
+static NRF24L01_Config transmitterConfig;
+static NRF24L01_Config receiverConfig;
+static uint32_t delivered;
+static uint32_t received;
+static uint32_t messagesDelivered;
+static uint32_t messagesReceived;
+
+static void Transmitter(void *arg) {
+	(void) arg;
+	static uint8_t message[BENCH_MESSAGE_SIZE];
+	uint8_t packet[32];
+	NRF24L01_Stats stats;
+	NRF24L01_Init(&transmitter, &transmitterConfig);
+	HAL_Delay(5);
+	for (uint32_t i = 0; i < BENCH_WARM_UP_PACKETS + BENCH_PACKETS; i++) {
+		phase = i >= BENCH_WARM_UP_PACKETS ? &phases[0] : NULL;
+		memset(packet, (uint8_t) i, sizeof(packet));
+		delivered += NRF24L01_TransmitPacket(&transmitter, packet, sizeof(packet));
+	}
+	phases[0].count = BENCH_PACKETS;
+	phase = &phases[1];
+	for (uint32_t i = 0; i < BENCH_MESSAGES; i++) {
+		memset(message, (uint8_t) i, sizeof(message));
+		messagesDelivered += NRF24L01_Transmit(&transmitter, message, sizeof(message), 32);
+	}
+	phases[1].count = BENCH_MESSAGES;
+	phase = &phases[2];
+	NRF24L01_VerifyRegisters(&transmitter);
+	NRF24L01_GetStats(&transmitter, &stats, true);
+	phases[2].count = 1;
+	phase = NULL;
+	NRF24L01_SimStop();
+}
+
+static void Receiver(void *arg) {
+	(void) arg;
+	static uint8_t message[BENCH_MESSAGE_SIZE + 32]; //Padding of the last packet is stored too
+	uint8_t packet[32];
+	NRF24L01_Init(&receiver, &receiverConfig);
+	while (received < BENCH_WARM_UP_PACKETS + BENCH_PACKETS) {
+		received += NRF24L01_ReceivePacket(&receiver, 1, packet, 100);
+	}
+	while (true) {
+		messagesReceived += NRF24L01_Receive(&receiver, 1, message, 1000);
+	}
+}
+
+int main(void) {
+	transmitterConfig = NRF24L01_BenchConfig(DATA_RATE_2MBPS, true);
+	receiverConfig = NRF24L01_BenchConfig(DATA_RATE_2MBPS, false);
+	transmitter.enableStatistics = true;
+	NRF24L01_SimReset(NULL);
+	NRF24L01_SimNode *node = NRF24L01_SimAddNode(Transmitter, NULL);
+	NRF24L01_SimAttach(&transmitter, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	node = NRF24L01_SimAddNode(Receiver, NULL);
+	NRF24L01_SimAttach(&receiver, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	NRF24L01_SimRun(60 * NRF24L01_SIM_SECOND);
+
+	printf("Heap use after Init and %d warm up packets\n", BENCH_WARM_UP_PACKETS);
+	printf("| Operation                              | Count | Allocations | Frees |\n");
+	printf("|----------------------------------------|-------|-------------|-------|\n");
+	for (uint8_t i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+		printf("| %-38s | %5u | %11u | %5u |\n", phases[i].name, phases[i].count, phases[i].allocations,
+				phases[i].frees);
+		NRF24L01_BENCH_CHECK(phases[i].allocations == 0 && phases[i].frees == 0, "%s: %u allocations, %u frees",
+				phases[i].name, phases[i].allocations, phases[i].frees);
+	}
+	printf("\n");
+
+	NRF24L01_BENCH_CHECK(delivered == BENCH_WARM_UP_PACKETS + BENCH_PACKETS && received == delivered,
+			"%u packets delivered, %u received", delivered, received);
+	NRF24L01_BENCH_CHECK(messagesDelivered == BENCH_MESSAGES && messagesReceived == BENCH_MESSAGES,
+			"%u messages delivered, %u received", messagesDelivered, messagesReceived);
+	return NRF24L01_BenchExit("NRF24L01_BenchHeap");
+}
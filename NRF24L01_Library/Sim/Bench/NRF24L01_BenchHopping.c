@@ -0,0 +1,153 @@
+/**
+ * @brief Frequency hopping against a fixed channel with jammed channels
+ *
+ * Leader sends a numbered packet every ms for BENCH_DURATION ms, either hopping over BENCH_CHANNELS channels or
+ * staying on the first channel of the range. Jammed channels lose every delivery. Reports the share of packets
+ * that reached the follower and checks that hopping keeps the link up when the fixed channel is jammed and
+ * loses no more than the share of jammed slots.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Bench.h"
+#include "NRF24L01_Hopping.h"
+
+#define BENCH_FIRST_CHANNEL 2
+#define BENCH_CHANNELS 20
+#define BENCH_SLOT_TIME 10
+#define BENCH_DURATION 4000
+#define BENCH_MAX_PACKETS 8192
+
+typedef struct {
+	const char *name;
+	uint8_t jammed;     //Number of jammed channels from the first one of the range
+} BenchJamming;
+
+typedef struct {
+	const BenchJamming *jamming;
+	bool hopping;
+	uint32_t sent;      //Packets leader sent
+	uint32_t delivered; //Different packets follower received
+} BenchRun;
+
+static const BenchJamming jammings[] = {
+	{ "No jamming", 0 },
+	{ "Fixed channel jammed", 1 },
+	{ "4 channels jammed", 4 }
+};
+
+static NRF24L01_Device leaderDevice;
+static NRF24L01_Device followerDevice;
+static NRF24L01_Config leaderConfig;
+static NRF24L01_Config followerConfig;
+static NRF24L01_Hopping leader;
+static NRF24L01_Hopping follower;
+static bool followerReady;
+static bool received[BENCH_MAX_PACKETS];
+
+static void Leader(void *arg) {
+	BenchRun *run = arg;
+	uint8_t packet[32] = { 0 };
+	NRF24L01_Init(&leaderDevice, &leaderConfig);
+	NRF24L01_SetChannel(&leaderDevice, BENCH_FIRST_CHANNEL);
+	NRF24L01_HoppingInit(&leader, &leaderDevice, 0x5A17, BENCH_FIRST_CHANNEL,
+			BENCH_FIRST_CHANNEL + BENCH_CHANNELS - 1, BENCH_SLOT_TIME);
+	while (!followerReady) {
+		HAL_Delay(1);
+	}
+	if (run->hopping) {
+		NRF24L01_HoppingStart(&leader, true);
+	}
+
+	uint32_t end = HAL_GetTick() + BENCH_DURATION;
+	while (HAL_GetTick() < end && run->sent < BENCH_MAX_PACKETS) {
+		packet[0] = run->sent >> 8;
+		packet[1] = run->sent & 0xFF;
+		if (run->hopping) {
+			NRF24L01_HoppingTransmitPacket(&leader, packet, sizeof(packet));
+		} else {
+			NRF24L01_TransmitPacket(&leaderDevice, packet, sizeof(packet));
+		}
+		run->sent++;
+		HAL_Delay(1);
+	}
+	HAL_Delay(10); //Follower takes the last packet
+	NRF24L01_SimStop();
+}
+
+static void Follower(void *arg) {
+	BenchRun *run = arg;
+	uint8_t packet[32];
+	bool result;
+	NRF24L01_Init(&followerDevice, &followerConfig);
+	NRF24L01_SetChannel(&followerDevice, BENCH_FIRST_CHANNEL);
+	NRF24L01_HoppingInit(&follower, &followerDevice, 0x5A17, BENCH_FIRST_CHANNEL,
+			BENCH_FIRST_CHANNEL + BENCH_CHANNELS - 1, BENCH_SLOT_TIME);
+	if (run->hopping) {
+		NRF24L01_HoppingStart(&follower, false);
+	}
+	followerReady = true;
+
+	while (true) {
+		if (run->hopping) {
+			result = NRF24L01_HoppingReceivePacket(&follower, 1, packet, 100);
+		} else {
+			result = NRF24L01_ReceivePacket(&followerDevice, 1, packet, 100);
+		}
+		uint16_t number = (packet[0] << 8) | packet[1];
+		if (result && number < BENCH_MAX_PACKETS && !received[number]) {
+			received[number] = true;
+			run->delivered++;
+		}
+	}
+}
+
+static BenchRun Run(const BenchJamming *jamming, bool hopping) {
+	BenchRun run = { jamming, hopping, 0, 0 };
+	NRF24L01_SimAir air = NRF24L01_SimDefaultAir();
+	for (uint8_t i = 0; i < jamming->jammed; i++) {
+		air.channelLoss[BENCH_FIRST_CHANNEL + i] = 1.0f;
+	}
+	memset(received, 0, sizeof(received));
+	followerReady = false;
+	NRF24L01_SimReset(&air);
+	NRF24L01_SimNode *node = NRF24L01_SimAddNode(Leader, &run);
+	NRF24L01_SimAttach(&leaderDevice, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	node = NRF24L01_SimAddNode(Follower, &run);
+	NRF24L01_SimAttach(&followerDevice, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	NRF24L01_SimRun(2 * BENCH_DURATION * NRF24L01_SIM_SECOND / 1000);
+	return run;
+}
+
+static double Delivery(const BenchRun *run) {
+	return run->sent > 0 ? 100.0 * run->delivered / run->sent : 0;
+}
+
+int main(void) {
+	leaderConfig = NRF24L01_BenchConfig(DATA_RATE_2MBPS, true);
+	followerConfig = NRF24L01_BenchConfig(DATA_RATE_2MBPS, false);
+
+	printf("Packets delivered in %d ms, %d channels, %d ms slots at 2 Mbps\n", BENCH_DURATION, BENCH_CHANNELS,
+			BENCH_SLOT_TIME);
+	printf("| Jamming              | Fixed channel | Hopping |\n");
+	printf("|----------------------|---------------|---------|\n");
+	for (uint8_t i = 0; i < sizeof(jammings) / sizeof(jammings[0]); i++) {
+		const BenchJamming *jamming = &jammings[i];
+		BenchRun fixed = Run(jamming, false);
+		BenchRun hopping = Run(jamming, true);
+		printf("| %-20s | %12.1f%% | %6.1f%% |\n", jamming->name, Delivery(&fixed), Delivery(&hopping));
+
+		//Jammed slots are lost, the follower must stay synchronized through them
+		double expected = 100.0 * (BENCH_CHANNELS - jamming->jammed) / BENCH_CHANNELS;
+		NRF24L01_BENCH_CHECK(Delivery(&hopping) >= expected - 5, "%s: hopping delivered %.1f%%, expected %.1f%%",
+				jamming->name, Delivery(&hopping), expected);
+		if (jamming->jammed > 0) {
+			NRF24L01_BENCH_CHECK(Delivery(&hopping) > Delivery(&fixed) + 50,
+					"%s: hopping delivered %.1f%%, fixed channel %.1f%%", jamming->name, Delivery(&hopping),
+					Delivery(&fixed));
+		}
+	}
+	printf("\n");
+	return NRF24L01_BenchExit("NRF24L01_BenchHopping");
+}
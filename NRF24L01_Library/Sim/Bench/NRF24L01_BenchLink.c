@@ -0,0 +1,150 @@
+/**
+ * @brief Adaptive link controller on channel with variable loss
+ *
+ * Loss of every delivery depends on the data rate and changes from phase to phase: high data rate fades out and
+ * comes back, the leader goes idle for a while, then only 250 kbps gets through. Reports time spent at every
+ * level, goodput and how often follower disagreed with leader, and checks the level the leader settles at and
+ * that follower disagrees for at most 1% of every phase.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Bench.h"
+#include "NRF24L01_Link.h"
+
+typedef struct {
+	const char *name;
+	uint32_t duration;  //ms
+	bool idle;          //Leader only calls NRF24L01_LinkUpdate
+	float loss[3];      //Per delivery at 250 kbps, 1 Mbps, 2 Mbps
+	uint8_t level;      //Level leader is expected to settle at
+	uint32_t levelTime[NRF24L01_LINK_LEVELS];
+	uint32_t samples;
+	uint32_t disagreements;
+	uint32_t sent;
+	uint32_t failed;
+	uint32_t received;
+} BenchPhase;
+
+static BenchPhase phases[] = {
+	{ "2 Mbps fades out", 3000, false, { 0.01f, 0.01f, 0.90f }, 1, { 0 }, 0, 0, 0, 0, 0 },
+	{ "2 Mbps comes back", 5000, false, { 0.01f, 0.01f, 0.01f }, 2, { 0 }, 0, 0, 0, 0, 0 },
+	{ "Leader idle", 1000, true, { 0.01f, 0.01f, 0.01f }, 2, { 0 }, 0, 0, 0, 0, 0 },
+	{ "Only 250 kbps gets through", 3000, false, { 0.01f, 0.90f, 0.90f }, 0, { 0 }, 0, 0, 0, 0, 0 }
+};
+static uint8_t phase;
+
+static NRF24L01_Device leaderDevice;
+static NRF24L01_Device followerDevice;
+static NRF24L01_Config leaderConfig;
+static NRF24L01_Config followerConfig;
+static NRF24L01_Link leader;
+static NRF24L01_Link follower;
+static bool followerReady;
+static bool linkInitWithoutStatistics;
+static bool linkInitialized;
+
+static float Loss(void *context, const NRF24L01_SimPath *path) {
+	(void) context;
+	uint8_t rate = path->dataRate == DATA_RATE_250KBPS ? 0 : path->dataRate == DATA_RATE_1MBPS ? 1 : 2;
+	return phases[phase].loss[rate];
+}
+
+//Level of both ends is sampled every ms of the run
+static void Sample(BenchPhase *current, uint32_t *lastSample) {
+	uint32_t now = HAL_GetTick();
+	while (*lastSample < now) {
+		(*lastSample)++;
+		current->levelTime[leader.level]++;
+		current->samples++;
+		current->disagreements += follower.level != leader.level;
+	}
+}
+
+static void Leader(void *arg) {
+	(void) arg;
+	uint8_t data[31] = { 0 };
+	NRF24L01_Init(&leaderDevice, &leaderConfig);
+	linkInitWithoutStatistics = NRF24L01_LinkInit(&leader, &leaderDevice, true);
+	leaderDevice.enableStatistics = true;
+	linkInitialized = NRF24L01_LinkInit(&leader, &leaderDevice, true);
+	while (!followerReady) {
+		HAL_Delay(1);
+	}
+	uint32_t lastSample = HAL_GetTick();
+	for (phase = 0; phase < sizeof(phases) / sizeof(phases[0]); phase++) {
+		BenchPhase *current = &phases[phase];
+		uint32_t end = HAL_GetTick() + current->duration;
+		while (HAL_GetTick() < end) {
+			if (current->idle) {
+				NRF24L01_LinkUpdate(&leader);
+				HAL_Delay(1);
+			} else {
+				current->sent++;
+				current->failed += !NRF24L01_LinkTransmitPacket(&leader, data, sizeof(data));
+			}
+			Sample(current, &lastSample);
+		}
+	}
+	NRF24L01_SimStop();
+}
+
+static void Follower(void *arg) {
+	(void) arg;
+	uint8_t buffer[31];
+	NRF24L01_Init(&followerDevice, &followerConfig);
+	NRF24L01_LinkInit(&follower, &followerDevice, false);
+	followerReady = true;
+	while (true) {
+		if (NRF24L01_LinkReceivePacket(&follower, 1, buffer, 10)) {
+			phases[phase].received++;
+		}
+	}
+}
+
+int main(void) {
+	NRF24L01_SimAir air = NRF24L01_SimDefaultAir();
+	air.lossCallback = Loss;
+	NRF24L01_SimReset(&air);
+	leaderConfig = NRF24L01_BenchConfig(DATA_RATE_2MBPS, true);
+	followerConfig = NRF24L01_BenchConfig(DATA_RATE_2MBPS, false);
+	NRF24L01_SimNode *node = NRF24L01_SimAddNode(Leader, NULL);
+	NRF24L01_SimAttach(&leaderDevice, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	node = NRF24L01_SimAddNode(Follower, NULL);
+	NRF24L01_SimAttach(&followerDevice, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	NRF24L01_SimRun(60 * NRF24L01_SIM_SECOND);
+
+	printf("Adaptive link, 31 byte packets, loss per delivery at 250 kbps / 1 Mbps / 2 Mbps\n");
+	printf("| Phase                      | Loss           | Time at level 0/1/2 | Goodput (kbps) | Failed | "
+			"Disagreement |\n");
+	printf("|----------------------------|----------------|---------------------|----------------|--------|"
+			"--------------|\n");
+	for (uint8_t i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+		BenchPhase *current = &phases[i];
+		double share[NRF24L01_LINK_LEVELS];
+		for (uint8_t level = 0; level < NRF24L01_LINK_LEVELS; level++) {
+			share[level] = current->samples > 0 ? 100.0 * current->levelTime[level] / current->samples : 0;
+		}
+		printf("| %-26s | %3.0f%%/%3.0f%%/%3.0f%% | %5.1f/%5.1f/%5.1f%% | %14.1f | %6u | %11.1f%% |\n",
+				current->name, current->loss[0] * 100, current->loss[1] * 100, current->loss[2] * 100, share[0],
+				share[1], share[2], current->received * 31 * 8.0 / current->duration, current->failed,
+				current->samples > 0 ? 100.0 * current->disagreements / current->samples : 0);
+
+		//Leader has to find the best level working in this phase and spend most of the time there
+		NRF24L01_BENCH_CHECK(share[current->level] >= 50, "%s: %.1f%% of time at level %u", current->name,
+				share[current->level], current->level);
+		NRF24L01_BENCH_CHECK(current->received > 0 || current->idle, "%s: nothing received", current->name);
+		//Leader switches only with follower's confirmation, so they disagree only for the handshake
+		NRF24L01_BENCH_CHECK(current->disagreements * 100 <= current->samples, "%s: follower disagreed %u of %u ms",
+				current->name, current->disagreements, current->samples);
+	}
+	printf("\n");
+	NRF24L01_BENCH_CHECK(!linkInitWithoutStatistics && linkInitialized,
+			"NRF24L01_LinkInit of leader: %s without statistics, %s with them",
+			linkInitWithoutStatistics ? "accepted" : "rejected", linkInitialized ? "accepted" : "rejected");
+	//Keepalives hold follower at the level of idle leader
+	NRF24L01_BENCH_CHECK(phases[2].disagreements == 0, "leader idle: follower disagreed %u ms",
+			phases[2].disagreements);
+	return NRF24L01_BenchExit("NRF24L01_BenchLink");
+}
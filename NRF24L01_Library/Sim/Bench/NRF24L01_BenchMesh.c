@@ -0,0 +1,209 @@
+/**
+ * @brief Delivery and latency of 80 node mesh with 4 levels
+ *
+ * Gateway has 4 children, every node of levels 1 and 2 has 3 children and 27 nodes of level 3 have one child.
+ * Every node sends a reading to the gateway every 2 s for 10 s(first one at a random time) and the gateway answers
+ * each of them, so frames go up and down through all levels. All nodes share one channel, but a node hears only its
+ * parent, its children and its siblings, so frames collide at a node only if both come from its neighbourhood
+ * (nodes two hops apart are hidden from each other). Reports per level frames delivered each way and end-to-end
+ * latency, on lossless link and on link that loses every twentieth delivery.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Bench.h"
+#include "NRF24L01_Mesh.h"
+
+#define BENCH_NODES 80
+#define BENCH_PERIOD 2000     //ms between readings of a node
+#define BENCH_SEND_TIME 10000 //ms during which readings are sent
+#define BENCH_DRAIN_TIME 3000 //ms for the last frames to arrive
+
+typedef struct {
+	uint16_t address;
+	uint8_t level;
+	NRF24L01_Device device;
+	NRF24L01_Config config;
+	NRF24L01_Mesh mesh;
+	uint32_t sent;
+	uint32_t delivered; //Readings of this node received by gateway
+	uint32_t replies;   //Answers of gateway received by this node
+	uint32_t latencyTotal;
+	uint32_t latencyMax;
+} BenchNode;
+
+typedef struct {
+	uint32_t nodes;
+	uint32_t sent;
+	uint32_t delivered;
+	uint32_t replies;
+	uint32_t latencyTotal;
+	uint32_t latencyMax;
+} BenchLevel;
+
+static BenchNode nodes[BENCH_NODES];
+
+//Reading and answer carry the tick the reading was sent at, nodes share simulated time
+typedef struct {
+	uint16_t index;
+	uint32_t tick;
+} BenchReading;
+
+static void Gateway(void *arg) {
+	BenchNode *node = arg;
+	BenchReading reading;
+	uint16_t source;
+	uint8_t size;
+	NRF24L01_Init(&node->device, &node->config);
+	NRF24L01_MeshInit(&node->mesh, &node->device, node->address);
+	while (HAL_GetTick() < BENCH_SEND_TIME + BENCH_DRAIN_TIME) {
+		NRF24L01_MeshUpdate(&node->mesh, 5);
+		while (NRF24L01_MeshReceive(&node->mesh, &source, (uint8_t*) &reading, &size)) {
+			BenchNode *sender = &nodes[reading.index];
+			uint32_t latency = HAL_GetTick() - reading.tick;
+			sender->delivered++;
+			sender->latencyTotal += latency;
+			sender->latencyMax = latency > sender->latencyMax ? latency : sender->latencyMax;
+			NRF24L01_MeshSend(&node->mesh, source, (uint8_t*) &reading, sizeof(reading));
+		}
+	}
+	NRF24L01_SimStop();
+}
+
+static void Sensor(void *arg) {
+	BenchNode *node = arg;
+	BenchReading reading = { (uint16_t) (node - nodes), 0 };
+	uint16_t source;
+	uint8_t size;
+	NRF24L01_Init(&node->device, &node->config);
+	NRF24L01_MeshInit(&node->mesh, &node->device, node->address);
+	uint32_t next = 10 + (uint32_t) (NRF24L01_SimRandom() * BENCH_PERIOD);
+	while (true) {
+		if (HAL_GetTick() >= next && next < BENCH_SEND_TIME) {
+			reading.tick = HAL_GetTick();
+			node->sent += NRF24L01_MeshSend(&node->mesh, NRF24L01_MESH_GATEWAY, (uint8_t*) &reading, sizeof(reading));
+			next += BENCH_PERIOD;
+		}
+		NRF24L01_MeshUpdate(&node->mesh, 5);
+		while (NRF24L01_MeshReceive(&node->mesh, &source, (uint8_t*) &reading, &size)) {
+			node->replies += source == NRF24L01_MESH_GATEWAY;
+		}
+		reading.index = (uint16_t) (node - nodes);
+	}
+}
+
+static uint16_t Parent(const BenchNode *node) {
+	return node->address & ((1 << (3 * (node->level - 1))) - 1);
+}
+
+//Chip index is node index, neighbours are parent and child or children of the same parent
+static bool InRange(void *context, uint16_t transmitter, uint16_t receiver) {
+	(void) context;
+	const BenchNode *a = &nodes[transmitter];
+	const BenchNode *b = &nodes[receiver];
+	return (b->level > 0 && Parent(b) == a->address) || (a->level > 0 && Parent(a) == b->address)
+			|| (a->level > 0 && b->level > 0 && Parent(a) == Parent(b));
+}
+
+//Node 0 is the gateway, children get digits 1, 2, ... in order of their parents
+static void BuildTree(void) {
+	const uint8_t children[NRF24L01_MESH_MAX_LEVELS] = { 4, 3, 3, 1 };
+	uint16_t count = 1;
+	nodes[0].address = NRF24L01_MESH_GATEWAY;
+	nodes[0].level = 0;
+	for (uint16_t parent = 0; parent < count && count < BENCH_NODES; parent++) {
+		uint8_t level = nodes[parent].level;
+		if (level >= NRF24L01_MESH_MAX_LEVELS) {
+			continue;
+		}
+		for (uint8_t digit = 1; digit <= children[level] && count < BENCH_NODES; digit++) {
+			nodes[count].address = nodes[parent].address | (uint16_t) (digit << (3 * level));
+			nodes[count].level = level + 1;
+			count++;
+		}
+	}
+}
+
+static void Run(float loss, BenchLevel *levels, NRF24L01_MeshStats *total, uint32_t *collisions) {
+	NRF24L01_SimAir air = NRF24L01_SimDefaultAir();
+	air.loss = loss;
+	air.rangeCallback = InRange;
+	air.quantum = 50 * NRF24L01_SIM_US; //Far below retransmit delay, keeps 80 nodes fast to simulate
+	NRF24L01_SimReset(&air);
+	for (uint16_t i = 0; i < BENCH_NODES; i++) {
+		BenchNode *node = &nodes[i];
+		uint16_t address = node->address;
+		uint8_t level = node->level;
+		memset(node, 0, sizeof(BenchNode));
+		node->address = address;
+		node->level = level;
+		node->config = NRF24L01_BenchConfig(DATA_RATE_2MBPS, true);
+		for (uint8_t pipe = 1; pipe < 6; pipe++) {
+			node->config.rxPipes[pipe] = node->config.rxPipes[0]; //Mesh sets the addresses
+			node->config.rxPipes[pipe].index = pipe;
+		}
+		NRF24L01_SimNode *simNode = NRF24L01_SimAddNode(i == 0 ? Gateway : Sensor, node);
+		NRF24L01_SimAttach(&node->device, NRF24L01_SimAddChip(simNode), NRF24L01_SIM_IRQ_POLL);
+	}
+	NRF24L01_SimRun(60 * NRF24L01_SIM_SECOND);
+
+	memset(levels, 0, sizeof(BenchLevel) * (NRF24L01_MESH_MAX_LEVELS + 1));
+	memset(total, 0, sizeof(NRF24L01_MeshStats));
+	*collisions = 0;
+	for (uint16_t i = 0; i < BENCH_NODES; i++) {
+		BenchNode *node = &nodes[i];
+		BenchLevel *level = &levels[node->level];
+		NRF24L01_MeshStats stats;
+		NRF24L01_MeshGetStats(&node->mesh, &stats, false);
+		total->forwarded += stats.forwarded;
+		total->failed += stats.failed;
+		total->dropped += stats.dropped;
+		total->duplicates += stats.duplicates;
+		total->hopsMax = stats.hopsMax > total->hopsMax ? stats.hopsMax : total->hopsMax;
+		*collisions += NRF24L01_SimGetChipStats(node->device.hspi->chip).collisions;
+		level->nodes++;
+		level->sent += node->sent;
+		level->delivered += node->delivered;
+		level->replies += node->replies;
+		level->latencyTotal += node->latencyTotal;
+		level->latencyMax = node->latencyMax > level->latencyMax ? node->latencyMax : level->latencyMax;
+	}
+}
+
+int main(void) {
+	const float losses[] = { 0.0f, 0.05f };
+	BuildTree();
+	printf("%d nodes at 2 Mbps, reading to gateway and answer back every %d ms per node\n", BENCH_NODES,
+			BENCH_PERIOD);
+	printf("| Loss | Level | Nodes | Readings | Delivered up | Answered down | Latency up avg/max (ms) |\n");
+	printf("|------|-------|-------|----------|--------------|---------------|-------------------------|\n");
+	for (uint8_t i = 0; i < sizeof(losses) / sizeof(losses[0]); i++) {
+		BenchLevel levels[NRF24L01_MESH_MAX_LEVELS + 1];
+		NRF24L01_MeshStats total;
+		uint32_t collisions;
+		Run(losses[i], levels, &total, &collisions);
+		for (uint8_t level = 1; level <= NRF24L01_MESH_MAX_LEVELS; level++) {
+			BenchLevel *current = &levels[level];
+			double up = current->sent > 0 ? 100.0 * current->delivered / current->sent : 0;
+			double down = current->delivered > 0 ? 100.0 * current->replies / current->delivered : 0;
+			double latency = current->delivered > 0 ? (double) current->latencyTotal / current->delivered : 0;
+			printf("| %3.0f%% | %5u | %5u | %8u | %11.1f%% | %12.1f%% | %14.1f / %6u |\n", losses[i] * 100, level,
+					current->nodes, current->sent, up, down, latency, current->latencyMax);
+
+			//Mesh layer retries every hop, so only frames that failed all attempts are lost, mostly near the gateway
+			//where neighbours are busy transmitting
+			NRF24L01_BENCH_CHECK(current->sent >= current->nodes * (BENCH_SEND_TIME / BENCH_PERIOD - 1),
+					"loss %.0f%%, level %u: %u readings sent", losses[i] * 100, level, current->sent);
+			NRF24L01_BENCH_CHECK(up >= 95 && down >= 95, "loss %.0f%%, level %u: %.1f%% delivered up, %.1f%% down",
+					losses[i] * 100, level, up, down);
+		}
+		printf("| %3.0f%% | Total: %u forwarded, %u failed, %u dropped, %u duplicates, %u collisions, max %u hops |\n",
+				losses[i] * 100, total.forwarded, total.failed, total.dropped, total.duplicates, collisions,
+				total.hopsMax);
+		NRF24L01_BENCH_CHECK(total.hopsMax == NRF24L01_MESH_MAX_LEVELS, "loss %.0f%%: max %u hops", losses[i] * 100,
+				total.hopsMax);
+	}
+	printf("\n");
+	return NRF24L01_BenchExit("NRF24L01_BenchMesh");
+}
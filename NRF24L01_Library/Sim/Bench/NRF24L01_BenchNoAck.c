@@ -0,0 +1,113 @@
+/**
+ * @brief Packet rate of NRF24L01_TransmitPacketNoAck against acknowledged NRF24L01_TransmitPacket
+ *
+ * Sends the same number of 32 byte packets in both modes for every data rate on lossless link and on link that
+ * loses every tenth packet: no-ACK packets are never repeated, so the loss is passed to the receiver, while
+ * acknowledged ones are retransmitted at the cost of rate.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Bench.h"
+
+#define BENCH_PACKETS 2000
+
+typedef struct {
+	bool noAck;
+	uint32_t delivered;
+	uint32_t received;
+	uint64_t duration;
+} BenchRun;
+
+static NRF24L01_Device transmitter;
+static NRF24L01_Device receiver;
+static NRF24L01_Config transmitterConfig;
+static NRF24L01_Config receiverConfig;
+
+static void Transmitter(void *arg) {
+	BenchRun *run = arg;
+	uint8_t packet[32] = { 0 };
+	NRF24L01_Init(&transmitter, &transmitterConfig);
+	HAL_Delay(5);
+	uint64_t start = NRF24L01_SimGetTime();
+	for (uint32_t i = 0; i < BENCH_PACKETS; i++) {
+		memcpy(packet, &i, sizeof(i));
+		if (run->noAck) {
+			run->delivered += NRF24L01_TransmitPacketNoAck(&transmitter, packet, sizeof(packet));
+		} else {
+			run->delivered += NRF24L01_TransmitPacket(&transmitter, packet, sizeof(packet));
+		}
+	}
+	if (run->noAck && !NRF24L01_FlushNoAck(&transmitter, 100)) {
+		run->delivered = 0;
+	}
+	run->duration = NRF24L01_SimGetTime() - start;
+	HAL_Delay(5); //Receiver takes the last packets
+	NRF24L01_SimStop();
+}
+
+//Stays in RX mode: NRF24L01_ReceivePacket leaves it after every packet and misses the start of the next one
+static void Receiver(void *arg) {
+	BenchRun *run = arg;
+	NRF24L01_Packet packet;
+	NRF24L01_Init(&receiver, &receiverConfig);
+	NRF24L01_StartListening(&receiver);
+	while (true) {
+		NRF24L01_Poll(&receiver);
+		while (NRF24L01_Read(&receiver, &packet)) {
+			run->received++;
+		}
+	}
+}
+
+static BenchRun Run(DATA_RATE dataRate, float loss, bool noAck) {
+	BenchRun run = { noAck, 0, 0, 0 };
+	NRF24L01_SimAir air = NRF24L01_SimDefaultAir();
+	air.loss = loss;
+	transmitterConfig = NRF24L01_BenchConfig(dataRate, true);
+	receiverConfig = NRF24L01_BenchConfig(dataRate, false);
+	NRF24L01_SimReset(&air);
+	NRF24L01_SimNode *node = NRF24L01_SimAddNode(Transmitter, &run);
+	NRF24L01_SimAttach(&transmitter, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	node = NRF24L01_SimAddNode(Receiver, &run);
+	NRF24L01_SimAttach(&receiver, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	NRF24L01_SimRun(60 * NRF24L01_SIM_SECOND);
+	return run;
+}
+
+static double PacketRate(const BenchRun *run) {
+	return run->duration > 0 ? (double) BENCH_PACKETS * NRF24L01_SIM_SECOND / run->duration : 0;
+}
+
+int main(void) {
+	const DATA_RATE rates[] = { DATA_RATE_250KBPS, DATA_RATE_1MBPS, DATA_RATE_2MBPS };
+	const float losses[] = { 0.0f, 0.1f };
+	printf("%d packets of 32 bytes, packets/s and packets received\n", BENCH_PACKETS);
+	printf("| Data rate | Loss | ACK packets/s | ACK received | No-ACK packets/s | No-ACK received | Speedup |\n");
+	printf("|-----------|------|---------------|--------------|------------------|-----------------|---------|\n");
+	for (uint8_t i = 0; i < 3; i++) {
+		for (uint8_t j = 0; j < 2; j++) {
+			BenchRun ack = Run(rates[i], losses[j], false);
+			BenchRun noAck = Run(rates[i], losses[j], true);
+			const char *name = NRF24L01_BenchDataRateName(rates[i]);
+			printf("| %-9s | %3.0f%% | %13.0f | %12u | %16.0f | %15u | %6.2fx |\n", name, losses[j] * 100,
+					PacketRate(&ack), ack.received, PacketRate(&noAck), noAck.received,
+					PacketRate(&noAck) / PacketRate(&ack));
+
+			NRF24L01_BENCH_CHECK(ack.delivered == BENCH_PACKETS && ack.received == BENCH_PACKETS,
+					"%s, loss %.0f%%: ACK mode delivered %u, received %u", name, losses[j] * 100, ack.delivered,
+					ack.received);
+			NRF24L01_BENCH_CHECK(noAck.delivered == BENCH_PACKETS, "%s, loss %.0f%%: %u no-ACK packets queued", name,
+					losses[j] * 100, noAck.delivered);
+			//Receiver keeps up, so only the air link loses packets
+			double expected = BENCH_PACKETS * (1 - losses[j]);
+			NRF24L01_BENCH_CHECK(noAck.received >= expected * 0.95 && noAck.received <= expected * 1.05,
+					"%s, loss %.0f%%: %u no-ACK packets received", name, losses[j] * 100, noAck.received);
+			NRF24L01_BENCH_CHECK(PacketRate(&noAck) > PacketRate(&ack), "%s, loss %.0f%%: no-ACK is not faster",
+					name, losses[j] * 100);
+		}
+	}
+	printf("\n");
+	return NRF24L01_BenchExit("NRF24L01_BenchNoAck");
+}
@@ -0,0 +1,394 @@
+/**
+ * @brief Chip and air link model checks and single packet benchmark
+ *
+ * Checks the model against datasheet behaviour through the unmodified library: ACK timing, retransmissions and
+ * duplicate detection on lossy link, air link latency and bit rate, MAX_RT with nobody listening, dynamic payload
+ * sizes, ACK payloads, no ACK while RX FIFO is full and interrupt driven transmission over SPI DMA.
+ * Measures TransmitPacket rate and latency for every data rate.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Bench.h"
+#include <math.h>
+
+#define BENCH_PACKETS 500
+#define BENCH_LOSS_PACKETS 2000
+
+typedef struct {
+	NRF24L01_Device device;
+	NRF24L01_Config config;
+	uint32_t packets;
+	uint32_t delivered;
+	uint32_t received;
+	uint32_t corrupted;
+	uint32_t duration;
+	NRF24L01_Stats stats;
+	bool done;
+} BenchNode;
+
+static BenchNode transmitter;
+static BenchNode receiver;
+
+static void Transmitter(void *arg) {
+	BenchNode *node = arg;
+	uint8_t packet[32];
+	NRF24L01_Init(&node->device, &node->config);
+	HAL_Delay(5); //Receiver is listening
+	uint32_t start = HAL_GetTick();
+	for (uint32_t i = 0; i < node->packets; i++) {
+		memset(packet, (uint8_t) i, sizeof(packet));
+		memcpy(packet, &i, sizeof(i));
+		if (NRF24L01_TransmitPacket(&node->device, packet, sizeof(packet))) {
+			node->delivered++;
+		}
+	}
+	node->duration = HAL_GetTick() - start;
+	NRF24L01_GetStats(&node->device, &node->stats, false);
+	node->done = true;
+	NRF24L01_SimStop();
+}
+
+static void Receiver(void *arg) {
+	BenchNode *node = arg;
+	uint8_t packet[32];
+	uint8_t size;
+	uint32_t expected = 0;
+	NRF24L01_Init(&node->device, &node->config);
+	while (true) {
+		if (!NRF24L01_ReceivePacketWithSize(&node->device, 1, packet, &size, 100)) {
+			continue;
+		}
+		uint32_t sequence;
+		memcpy(&sequence, packet, sizeof(sequence));
+		if (size != 32 || sequence != expected || packet[31] != (uint8_t) sequence) {
+			node->corrupted++;
+		}
+		expected = sequence + 1;
+		node->received++;
+	}
+}
+
+static void Setup(DATA_RATE dataRate, const NRF24L01_SimAir *air, uint32_t packets,
+		void (*transmitterMain)(void *arg), void (*receiverMain)(void *arg), NRF24L01_SimIrqMode irqMode) {
+	NRF24L01_SimReset(air);
+	memset(&transmitter, 0, sizeof(transmitter));
+	memset(&receiver, 0, sizeof(receiver));
+	transmitter.config = NRF24L01_BenchConfig(dataRate, true);
+	transmitter.device.enableStatistics = true;
+	transmitter.packets = packets;
+	NRF24L01_SimNode *node = NRF24L01_SimAddNode(transmitterMain, &transmitter);
+	NRF24L01_SimAttach(&transmitter.device, NRF24L01_SimAddChip(node), irqMode);
+	if (receiverMain != NULL) {
+		receiver.config = NRF24L01_BenchConfig(dataRate, false);
+		node = NRF24L01_SimAddNode(receiverMain, &receiver);
+		NRF24L01_SimAttach(&receiver.device, NRF24L01_SimAddChip(node), irqMode);
+	}
+}
+
+static double BitRate(DATA_RATE dataRate) {
+	return dataRate == DATA_RATE_250KBPS ? 250e3 : dataRate == DATA_RATE_1MBPS ? 1e6 : 2e6;
+}
+
+//Settling, packet, settling of receiver before ACK and ACK itself, both packets delayed by air latency
+static double ExpectedLatency(double bitRate, double latency) {
+	double packetBits = 8 * (1 + 5 + 32 + 1) + 9;
+	double ackBits = 8 * (1 + 5 + 1) + 9;
+	return 130 + packetBits / bitRate * 1e6 + latency + 130 + ackBits / bitRate * 1e6 + latency;
+}
+
+//Polling of the IRQ pin and CE pulse add a few us on top of radio timing
+static bool LatencyMatches(uint32_t latency, double expected) {
+	return latency >= expected && latency <= expected + 40;
+}
+
+static void BenchRates(void) {
+	const DATA_RATE rates[] = { DATA_RATE_250KBPS, DATA_RATE_1MBPS, DATA_RATE_2MBPS };
+	printf("TransmitPacket, 32 byte payload, lossless link, %d packets\n", BENCH_PACKETS);
+	printf("| Data rate | Packets/s | Latency avg (us) | Expected (us) |\n");
+	printf("|-----------|-----------|------------------|---------------|\n");
+	for (uint8_t i = 0; i < 3; i++) {
+		NRF24L01_SimAir air = NRF24L01_SimDefaultAir();
+		Setup(rates[i], &air, BENCH_PACKETS, Transmitter, Receiver, NRF24L01_SIM_IRQ_POLL);
+		NRF24L01_SimRun(60 * NRF24L01_SIM_SECOND);
+		NRF24L01_Stats stats = transmitter.stats;
+		double expected = ExpectedLatency(BitRate(rates[i]), 0);
+		printf("| %-9s | %9.0f | %16u | %13.0f |\n", NRF24L01_BenchDataRateName(rates[i]),
+				transmitter.packets * 1000.0 / transmitter.duration, stats.latencyAverage, expected);
+
+		NRF24L01_BENCH_CHECK(transmitter.done && transmitter.delivered == BENCH_PACKETS,
+				"%s: %u of %d packets delivered", NRF24L01_BenchDataRateName(rates[i]), transmitter.delivered,
+				BENCH_PACKETS);
+		NRF24L01_BENCH_CHECK(receiver.received == BENCH_PACKETS && receiver.corrupted == 0,
+				"%s: %u received, %u corrupted", NRF24L01_BenchDataRateName(rates[i]), receiver.received,
+				receiver.corrupted);
+		NRF24L01_BENCH_CHECK(transmitter.device.packetsRetransmitted == 0, "%s: retransmissions on lossless link",
+				NRF24L01_BenchDataRateName(rates[i]));
+		NRF24L01_BENCH_CHECK(LatencyMatches(stats.latencyAverage, expected),
+				"%s: latency %u us, expected %.0f us", NRF24L01_BenchDataRateName(rates[i]), stats.latencyAverage,
+				expected);
+	}
+	printf("\n");
+}
+
+//Every attempt needs both packet and ACK through: expected retransmissions are 1 / (1 - loss)^2 - 1
+static void BenchLoss(void) {
+	const float losses[] = { 0.1f, 0.2f, 0.3f };
+	printf("TransmitPacket at 1 Mbps on lossy link, %d packets\n", BENCH_LOSS_PACKETS);
+	printf("| Loss | Delivered | Duplicates dropped | Retransmissions/packet | Expected |\n");
+	printf("|------|-----------|--------------------|------------------------|----------|\n");
+	for (uint8_t i = 0; i < 3; i++) {
+		NRF24L01_SimAir air = NRF24L01_SimDefaultAir();
+		air.loss = losses[i];
+		Setup(DATA_RATE_1MBPS, &air, BENCH_LOSS_PACKETS, Transmitter, Receiver, NRF24L01_SIM_IRQ_POLL);
+		NRF24L01_SimRun(60 * NRF24L01_SIM_SECOND);
+		double success = (1 - losses[i]) * (1 - losses[i]);
+		double expected = 1 / success - 1;
+		double measured = (double) transmitter.device.packetsRetransmitted / BENCH_LOSS_PACKETS;
+		uint32_t duplicates = NRF24L01_SimGetChipStats(receiver.device.hspi->chip).duplicates;
+		printf("| %3.0f%% | %9u | %18u | %22.3f | %8.3f |\n", losses[i] * 100, transmitter.delivered, duplicates,
+				measured, expected);
+
+		NRF24L01_BENCH_CHECK(transmitter.delivered == BENCH_LOSS_PACKETS && receiver.received == BENCH_LOSS_PACKETS
+				&& receiver.corrupted == 0, "loss %.0f%%: %u delivered, %u received, %u corrupted", losses[i] * 100,
+				transmitter.delivered, receiver.received, receiver.corrupted);
+		NRF24L01_BENCH_CHECK(fabs(measured - expected) <= expected * 0.2, "loss %.0f%%: %.3f retransmissions",
+				losses[i] * 100, measured);
+	}
+	printf("\n");
+}
+
+//Latency and fixed bit rate of the air link: ACK that ends after ARD is missed
+static void BenchAirLink(void) {
+	const uint32_t latencies[] = { 100, 300 };
+	printf("TransmitPacket at 1 Mbps over 250 kbps air link with latency, %d packets\n", BENCH_PACKETS);
+	printf("| Latency (us) | Delivered | Latency avg (us) | Expected (us) |\n");
+	printf("|--------------|-----------|------------------|---------------|\n");
+	for (uint8_t i = 0; i < 2; i++) {
+		NRF24L01_SimAir air = NRF24L01_SimDefaultAir();
+		air.latency = latencies[i] * NRF24L01_SIM_US;
+		air.bitRate = 250000;
+		Setup(DATA_RATE_1MBPS, &air, i == 0 ? BENCH_PACKETS : 3, Transmitter, Receiver, NRF24L01_SIM_IRQ_POLL);
+		NRF24L01_SimRun(60 * NRF24L01_SIM_SECOND);
+		double expected = ExpectedLatency(air.bitRate, latencies[i]);
+		printf("| %12u | %9u | %16u | %13.0f |\n", latencies[i], transmitter.delivered,
+				transmitter.stats.latencyAverage, expected);
+		//From the end of the packet until the end of its ACK
+		double ackWait = latencies[i] + 130 + (8 * (1 + 5 + 1) + 9) / 250e3 * 1e6 + latencies[i];
+		if (ackWait < 750) {
+			NRF24L01_BENCH_CHECK(transmitter.delivered == transmitter.packets && receiver.received == BENCH_PACKETS
+					&& LatencyMatches(transmitter.stats.latencyAverage, expected),
+					"latency %u us: %u delivered, latency %u us, expected %.0f us", latencies[i], transmitter.delivered,
+					transmitter.stats.latencyAverage, expected);
+		} else {
+			//Receiver gets the packet once and drops every retransmission as duplicate
+			NRF24L01_BENCH_CHECK(transmitter.delivered == 0 && receiver.received == 3,
+					"latency %u us: %u delivered, %u received", latencies[i], transmitter.delivered,
+					receiver.received);
+		}
+	}
+	printf("\n");
+}
+
+//Nobody listens: every packet ends with MAX_RT after 15 retransmissions every ARD
+static void BenchNoReceiver(void) {
+	Setup(DATA_RATE_1MBPS, NULL, 3, Transmitter, NULL, NRF24L01_SIM_IRQ_POLL);
+	NRF24L01_SimRun(60 * NRF24L01_SIM_SECOND);
+	NRF24L01_SimChipStats chip = NRF24L01_SimGetChipStats(transmitter.device.hspi->chip);
+	printf("No receiver: %u delivered, %llu lost, %u packets on air, %u ms for 3 packets\n\n", transmitter.delivered,
+			(unsigned long long) transmitter.device.packetsLost, chip.txPackets, transmitter.duration);
+	NRF24L01_BENCH_CHECK(transmitter.delivered == 0 && transmitter.device.packetsLost == 3,
+			"no receiver: %u delivered, %llu lost", transmitter.delivered,
+			(unsigned long long) transmitter.device.packetsLost);
+	NRF24L01_BENCH_CHECK(chip.txPackets == 3 * 16 && chip.maxRetransmits == 3, "no receiver: %u packets on air",
+			chip.txPackets);
+	//Settling, then 16 attempts, each packet followed by 750 us ARD
+	double packetTime = (8 * (1 + 5 + 32 + 1) + 9) / 1e3;
+	double expected = 3 * (0.13 + 16 * (packetTime + 0.75));
+	NRF24L01_BENCH_CHECK(fabs(transmitter.duration - expected) <= 2, "no receiver: %u ms, expected %.1f ms",
+			transmitter.duration, expected);
+}
+
+/* Dynamic payload sizes and ACK payloads */
+
+static uint32_t sizeErrors;
+static uint32_t ackPayloads;
+
+static void SizeTransmitter(void *arg) {
+	BenchNode *node = arg;
+	uint8_t packet[32];
+	NRF24L01_Packet ack;
+	NRF24L01_Init(&node->device, &node->config);
+	HAL_Delay(5);
+	for (uint8_t size = 1; size <= 32; size++) {
+		memset(packet, size, size);
+		if (NRF24L01_TransmitPacket(&node->device, packet, size)) {
+			node->delivered++;
+		}
+		//Receiver answers every packet with ACK payload of the size of the previous one
+		if (NRF24L01_ReadAckPayload(&node->device, &ack)) {
+			if (ack.size != size - 1 || ack.data[0] != 0xA0 + size - 1) {
+				sizeErrors++;
+			}
+			ackPayloads++;
+		}
+	}
+	node->done = true;
+	NRF24L01_SimStop();
+}
+
+static void SizeReceiver(void *arg) {
+	BenchNode *node = arg;
+	uint8_t packet[32];
+	uint8_t reply[32];
+	uint8_t size;
+	NRF24L01_Init(&node->device, &node->config);
+	while (true) {
+		if (!NRF24L01_ReceivePacketWithSize(&node->device, 1, packet, &size, 100)) {
+			continue;
+		}
+		if (packet[0] != size || packet[size - 1] != size) {
+			sizeErrors++;
+		}
+		node->received++;
+		memset(reply, 0xA0 + size, size);
+		NRF24L01_WriteAckPayload(&node->device, 1, reply, size);
+	}
+}
+
+static void BenchPayloads(void) {
+	Setup(DATA_RATE_1MBPS, NULL, 32, SizeTransmitter, SizeReceiver, NRF24L01_SIM_IRQ_POLL);
+	sizeErrors = 0;
+	ackPayloads = 0;
+	NRF24L01_SimRun(60 * NRF24L01_SIM_SECOND);
+	printf("Dynamic payloads 1-32 bytes: %u delivered, %u received, %u ACK payloads, %u errors\n\n",
+			transmitter.delivered, receiver.received, ackPayloads, sizeErrors);
+	NRF24L01_BENCH_CHECK(transmitter.delivered == 32 && receiver.received == 32 && sizeErrors == 0,
+			"dynamic payloads: %u delivered, %u received, %u errors", transmitter.delivered, receiver.received,
+			sizeErrors);
+	//The first packet finds no ACK payload queued yet
+	NRF24L01_BENCH_CHECK(ackPayloads == 31, "ACK payloads: %u", ackPayloads);
+}
+
+/* RX FIFO overflow */
+
+static void DeafReceiver(void *arg) {
+	BenchNode *node = arg;
+	NRF24L01_Init(&node->device, &node->config);
+	NRF24L01_StartListening(&node->device); //IRQ pin is not serviced, nobody reads RX FIFO
+	while (true) {
+		HAL_Delay(100);
+	}
+}
+
+static void BenchOverflow(void) {
+	Setup(DATA_RATE_1MBPS, NULL, 5, Transmitter, DeafReceiver, NRF24L01_SIM_IRQ_POLL);
+	NRF24L01_SimRun(60 * NRF24L01_SIM_SECOND);
+	NRF24L01_SimChipStats chip = NRF24L01_SimGetChipStats(receiver.device.hspi->chip);
+	printf("RX FIFO overflow: %u of 5 delivered, %u received by chip, %u dropped\n\n", transmitter.delivered,
+			chip.received, chip.overflows);
+	NRF24L01_BENCH_CHECK(transmitter.delivered == 3 && chip.received == 3 && chip.overflows == 2 * 16,
+			"overflow: %u delivered, %u received, %u dropped", transmitter.delivered, chip.received, chip.overflows);
+}
+
+/* Interrupt driven transmission over SPI DMA */
+
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
+	BenchNode *node = NRF24L01_SimGetArg();
+	if (GPIO_Pin == node->device.IRQ_Pin) {
+		NRF24L01_IRQHandler(&node->device);
+	}
+}
+
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi) {
+	BenchNode *node = NRF24L01_SimGetArg();
+	if (hspi == node->device.hspi) {
+		NRF24L01_SPICompleteHandler(&node->device);
+	}
+}
+
+static volatile bool asyncPending;
+
+static void OnPacketSent(NRF24L01_Device *device) {
+	(void) device;
+	transmitter.delivered++;
+	asyncPending = false;
+}
+
+static void OnMaxRetransmits(NRF24L01_Device *device) {
+	(void) device;
+	asyncPending = false;
+}
+
+static void OnPacketReceived(NRF24L01_Device *device, uint8_t pipe, const uint8_t *data, uint8_t size) {
+	(void) device;
+	(void) pipe;
+	uint32_t sequence;
+	memcpy(&sequence, data, sizeof(sequence));
+	if (size != 32 || sequence != receiver.received) {
+		receiver.corrupted++;
+	}
+	receiver.received++;
+}
+
+static void AsyncTransmitter(void *arg) {
+	BenchNode *node = arg;
+	const NRF24L01_Callbacks callbacks = { NULL, OnPacketSent, OnMaxRetransmits };
+	uint8_t packet[32] = { 0 };
+	NRF24L01_Init(&node->device, &node->config);
+	NRF24L01_RegisterCallbacks(&node->device, &callbacks);
+	HAL_Delay(5);
+	uint32_t start = HAL_GetTick();
+	for (uint32_t i = 0; i < node->packets; i++) {
+		memcpy(packet, &i, sizeof(i));
+		asyncPending = true;
+		if (!NRF24L01_TransmitPacketAsync(&node->device, packet, sizeof(packet))) {
+			break;
+		}
+		while (asyncPending) {
+			__WFI();
+		}
+	}
+	node->duration = HAL_GetTick() - start;
+	NRF24L01_GetStats(&node->device, &node->stats, false);
+	node->done = true;
+	NRF24L01_SimStop();
+}
+
+static void ListeningReceiver(void *arg) {
+	BenchNode *node = arg;
+	const NRF24L01_Callbacks callbacks = { OnPacketReceived, NULL, NULL };
+	NRF24L01_Init(&node->device, &node->config);
+	NRF24L01_RegisterCallbacks(&node->device, &callbacks);
+	NRF24L01_StartListening(&node->device);
+	while (true) {
+		__WFI();
+	}
+}
+
+static void BenchInterrupts(void) {
+	Setup(DATA_RATE_2MBPS, NULL, BENCH_PACKETS, AsyncTransmitter, ListeningReceiver, NRF24L01_SIM_IRQ_EXTI);
+	NRF24L01_SimRun(60 * NRF24L01_SIM_SECOND);
+	double expected = ExpectedLatency(BitRate(DATA_RATE_2MBPS), 0);
+	printf("TransmitPacketAsync at 2 Mbps with EXTI and DMA: %u delivered, %u received, %.0f packets/s, "
+			"latency avg %u us, expected %.0f us\n\n", transmitter.delivered, receiver.received,
+			transmitter.packets * 1000.0 / transmitter.duration, transmitter.stats.latencyAverage, expected);
+	NRF24L01_BENCH_CHECK(transmitter.done && transmitter.delivered == BENCH_PACKETS
+			&& receiver.received == BENCH_PACKETS && receiver.corrupted == 0,
+			"async: %u delivered, %u received, %u corrupted", transmitter.delivered, receiver.received,
+			receiver.corrupted);
+	NRF24L01_BENCH_CHECK(LatencyMatches(transmitter.stats.latencyAverage, expected),
+			"async: latency %u us, expected %.0f us", transmitter.stats.latencyAverage, expected);
+}
+
+int main(void) {
+	BenchRates();
+	BenchLoss();
+	BenchAirLink();
+	BenchNoReceiver();
+	BenchPayloads();
+	BenchOverflow();
+	BenchInterrupts();
+	return NRF24L01_BenchExit("NRF24L01_BenchRadio");
+}
@@ -0,0 +1,278 @@
+/**
+ * @brief SPI transactions per acknowledged packet
+ *
+ * Counts CSN low windows seen by the chip model for one NRF24L01_TransmitPacket in steady state, right after
+ * the radio was receiving and with power down between transactions, and for NRF24L01_VerifyRegisters.
+ * The count of the library's own statistics is reported next to it and must agree.
+ * With IRQ pin on EXTI measures latency from the falling edge of the pin to the callback and SPI transactions per
+ * event, also while main context keeps running blocking SPI transactions on the same radio.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Bench.h"
+
+#define BENCH_PACKETS 100
+
+typedef struct {
+	const char *name;
+	uint32_t limit;
+	uint32_t calls;
+	uint32_t chip;
+	uint32_t library;
+} BenchCase;
+
+//Limits are the counts with shadow registers: CONFIG and RF_CH are no longer read back before they are written.
+//VerifyRegisters reads each of 22 shadowed registers once and writes none, as the model agrees with the shadow.
+static BenchCase cases[] = {
+	{ "TransmitPacket, steady state", 6, 0, 0, 0 },
+	{ "TransmitPacket after ReceivePacket", 7, 0, 0, 0 },
+	{ "TransmitPacket, power down between", 8, 0, 0, 0 },
+	{ "VerifyRegisters", 22, 0, 0, 0 }
+};
+
+typedef struct {
+	const char *name;
+	bool mainBusy;     //Main context of receiver runs NRF24L01_VerifyRegisters in a loop
+	uint32_t events;
+	uint64_t latencyTotal;
+	uint64_t latencyMax;
+	uint32_t transactions; //Made by the handler, calls of main context are not counted
+} BenchIrqCase;
+
+static BenchIrqCase irqCases[] = {
+	{ "TransmitPacketIT and onPacketSent", false, 0, 0, 0, 0 },
+	{ "StartListening, main context idle", false, 0, 0, 0, 0 },
+	{ "StartListening, main context on SPI", true, 0, 0, 0, 0 }
+};
+
+static NRF24L01_Device transmitter;
+static NRF24L01_Device receiver;
+static NRF24L01_Config transmitterConfig;
+static NRF24L01_Config receiverConfig;
+static uint32_t failures;
+
+static uint32_t ChipTransactions(void) {
+	return NRF24L01_SimGetChipStats(transmitter.hspi->chip).spiTransactions;
+}
+
+//Runs one call and adds SPI transactions it made to the case
+static void Measure(BenchCase *benchCase, bool (*call)(void)) {
+	NRF24L01_Stats stats;
+	NRF24L01_GetStats(&transmitter, &stats, true);
+	uint32_t start = ChipTransactions();
+	failures += !call();
+	NRF24L01_GetStats(&transmitter, &stats, true);
+	benchCase->chip += ChipTransactions() - start;
+	benchCase->library += stats.spiTransactions;
+	benchCase->calls++;
+}
+
+static bool TransmitPacket(void) {
+	uint8_t packet[32] = { 0 };
+	return NRF24L01_TransmitPacket(&transmitter, packet, sizeof(packet));
+}
+
+static bool VerifyRegisters(void) {
+	return NRF24L01_VerifyRegisters(&transmitter);
+}
+
+static void Transmitter(void *arg) {
+	(void) arg;
+	uint8_t packet[32];
+	NRF24L01_Init(&transmitter, &transmitterConfig);
+	HAL_Delay(5);
+	TransmitPacket();
+	for (uint32_t i = 0; i < BENCH_PACKETS; i++) {
+		Measure(&cases[0], TransmitPacket);
+	}
+	for (uint32_t i = 0; i < BENCH_PACKETS; i++) {
+		NRF24L01_ReceivePacket(&transmitter, 0, packet, 1); //Nothing comes, leaves radio in RX mode
+		Measure(&cases[1], TransmitPacket);
+	}
+	NRF24L01_UsePowerDownMode(&transmitter, true);
+	for (uint32_t i = 0; i < BENCH_PACKETS; i++) {
+		Measure(&cases[2], TransmitPacket);
+	}
+	NRF24L01_UsePowerDownMode(&transmitter, false);
+	Measure(&cases[3], VerifyRegisters);
+	NRF24L01_SimStop();
+}
+
+static void Receiver(void *arg) {
+	(void) arg;
+	uint8_t packet[32];
+	NRF24L01_Init(&receiver, &receiverConfig);
+	while (true) {
+		NRF24L01_ReceivePacket(&receiver, 1, packet, 100);
+	}
+}
+
+/* IRQ pin on EXTI */
+
+static BenchIrqCase *irqCase;
+static volatile bool sendPending;
+
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
+	NRF24L01_Device *device = NRF24L01_SimGetArg();
+	if (GPIO_Pin == device->IRQ_Pin) {
+		NRF24L01_IRQHandler(device);
+	}
+}
+
+static void RecordLatency(NRF24L01_Device *device) {
+	uint64_t latency = NRF24L01_SimGetTime() - NRF24L01_SimGetIrqTime(device->hspi->chip);
+	irqCase->events++;
+	irqCase->latencyTotal += latency;
+	irqCase->latencyMax = latency > irqCase->latencyMax ? latency : irqCase->latencyMax;
+}
+
+static void OnPacketSent(NRF24L01_Device *device) {
+	RecordLatency(device);
+	sendPending = false;
+}
+
+static void OnMaxRetransmits(NRF24L01_Device *device) {
+	(void) device;
+	failures++;
+	sendPending = false;
+}
+
+//Every packet raises its own interrupt, as they arrive 1 ms apart
+static void OnPacketReceived(NRF24L01_Device *device, uint8_t pipe, const uint8_t *data, uint8_t size) {
+	(void) pipe;
+	(void) data;
+	(void) size;
+	RecordLatency(device);
+}
+
+static void ItTransmitter(void *arg) {
+	NRF24L01_Device *device = arg;
+	const NRF24L01_Callbacks callbacks = { NULL, OnPacketSent, OnMaxRetransmits };
+	uint8_t packet[32] = { 0 };
+	NRF24L01_Init(device, &transmitterConfig);
+	NRF24L01_RegisterCallbacks(device, &callbacks);
+	HAL_Delay(5);
+	uint32_t start = ChipTransactions();
+	for (uint32_t i = 0; i < BENCH_PACKETS; i++) {
+		sendPending = true;
+		failures += !NRF24L01_TransmitPacketIT(device, packet, sizeof(packet));
+		while (sendPending) {
+			__WFI();
+		}
+	}
+	irqCase->transactions = ChipTransactions() - start;
+	NRF24L01_SimStop();
+}
+
+static void PacedTransmitter(void *arg) {
+	NRF24L01_Device *device = arg;
+	uint8_t packet[32] = { 0 };
+	NRF24L01_Init(device, &transmitterConfig);
+	HAL_Delay(5);
+	for (uint32_t i = 0; i < BENCH_PACKETS; i++) {
+		failures += !NRF24L01_TransmitPacket(device, packet, sizeof(packet));
+		HAL_Delay(1);
+	}
+	HAL_Delay(1);
+	NRF24L01_SimStop();
+}
+
+static void ListeningReceiver(void *arg) {
+	NRF24L01_Device *device = arg;
+	const NRF24L01_Callbacks callbacks = { OnPacketReceived, NULL, NULL };
+	uint32_t mainTransactions = 0;
+	NRF24L01_Init(device, &receiverConfig);
+	NRF24L01_RegisterCallbacks(device, &callbacks);
+	NRF24L01_StartListening(device);
+	uint32_t start = NRF24L01_SimGetChipStats(device->hspi->chip).spiTransactions;
+	while (irqCase->events < BENCH_PACKETS) {
+		if (irqCase->mainBusy) {
+			NRF24L01_VerifyRegisters(device);
+			mainTransactions += cases[3].limit; //Registers agree, nothing is written
+		} else {
+			__WFI();
+		}
+	}
+	irqCase->transactions = NRF24L01_SimGetChipStats(device->hspi->chip).spiTransactions - start - mainTransactions;
+	while (true) {
+		__WFI();
+	}
+}
+
+static void PolledReceiver(void *arg) {
+	NRF24L01_Device *device = arg;
+	uint8_t packet[32];
+	NRF24L01_Init(device, &receiverConfig);
+	while (true) {
+		NRF24L01_ReceivePacket(device, 1, packet, 100);
+	}
+}
+
+static void BenchInterrupts(void) {
+	printf("IRQ pin on EXTI, latency from falling edge of IRQ pin to callback\n");
+	printf("| Event                               | Events | Latency avg/max (us) | SPI transactions per event |\n");
+	printf("|-------------------------------------|--------|----------------------|----------------------------|\n");
+	for (uint8_t i = 0; i < sizeof(irqCases) / sizeof(irqCases[0]); i++) {
+		irqCase = &irqCases[i];
+		NRF24L01_SimReset(NULL);
+		memset(&transmitter, 0, sizeof(transmitter));
+		memset(&receiver, 0, sizeof(receiver));
+		NRF24L01_SimNode *node = NRF24L01_SimAddNode(i == 0 ? ItTransmitter : PacedTransmitter, &transmitter);
+		NRF24L01_SimAttach(&transmitter, NRF24L01_SimAddChip(node), i == 0 ? NRF24L01_SIM_IRQ_EXTI
+				: NRF24L01_SIM_IRQ_POLL);
+		node = NRF24L01_SimAddNode(i == 0 ? PolledReceiver : ListeningReceiver, &receiver);
+		NRF24L01_SimAttach(&receiver, NRF24L01_SimAddChip(node), i == 0 ? NRF24L01_SIM_IRQ_POLL
+				: NRF24L01_SIM_IRQ_EXTI);
+		NRF24L01_SimRun(60 * NRF24L01_SIM_SECOND);
+
+		double average = irqCase->events > 0 ? (double) irqCase->latencyTotal / irqCase->events / NRF24L01_SIM_US : 0;
+		double maximum = (double) irqCase->latencyMax / NRF24L01_SIM_US;
+		double perEvent = irqCase->events > 0 ? (double) irqCase->transactions / irqCase->events : 0;
+		printf("| %-35s | %6u | %9.1f / %8.1f | %26.2f |\n", irqCase->name, irqCase->events, average, maximum,
+				perEvent);
+
+		//Handler reads STATUS once and clears it, receive also reads payload width, payload and STATUS again. The
+		//32 byte payload read takes most of the receive latency. With main context on SPI the event waits for the
+		//end of its transaction(6 bytes at most for VerifyRegisters) instead of breaking into it.
+		NRF24L01_BENCH_CHECK(irqCase->events == BENCH_PACKETS, "%s: %u events", irqCase->name, irqCase->events);
+		NRF24L01_BENCH_CHECK(perEvent <= (i == 0 ? cases[0].limit : 5), "%s: %.2f transactions per event",
+				irqCase->name, perEvent);
+		NRF24L01_BENCH_CHECK(maximum < (i == 0 ? 30 : irqCase->mainBusy ? 70 : 60), "%s: max latency %.1f us",
+				irqCase->name, maximum);
+	}
+	printf("\n");
+	NRF24L01_BENCH_CHECK(failures == 0, "%u calls failed", failures);
+}
+
+int main(void) {
+	transmitterConfig = NRF24L01_BenchConfig(DATA_RATE_2MBPS, true);
+	receiverConfig = NRF24L01_BenchConfig(DATA_RATE_2MBPS, false);
+	transmitter.enableStatistics = true;
+	NRF24L01_SimReset(NULL);
+	NRF24L01_SimNode *node = NRF24L01_SimAddNode(Transmitter, NULL);
+	NRF24L01_SimAttach(&transmitter, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	node = NRF24L01_SimAddNode(Receiver, NULL);
+	NRF24L01_SimAttach(&receiver, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	NRF24L01_SimRun(60 * NRF24L01_SIM_SECOND);
+
+	printf("SPI transactions per call, IRQ pin polled\n");
+	printf("| Call                               | Calls | Chip model | Library stats | Limit |\n");
+	printf("|------------------------------------|-------|------------|---------------|-------|\n");
+	for (uint8_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		BenchCase *benchCase = &cases[i];
+		double perCall = benchCase->calls > 0 ? (double) benchCase->chip / benchCase->calls : 0;
+		printf("| %-34s | %5u | %10.2f | %13.2f | %5u |\n", benchCase->name, benchCase->calls, perCall,
+				benchCase->calls > 0 ? (double) benchCase->library / benchCase->calls : 0, benchCase->limit);
+		NRF24L01_BENCH_CHECK(benchCase->calls > 0 && perCall <= benchCase->limit, "%s: %.2f transactions",
+				benchCase->name, perCall);
+		NRF24L01_BENCH_CHECK(benchCase->chip == benchCase->library, "%s: chip saw %u transactions, library counted %u",
+				benchCase->name, benchCase->chip, benchCase->library);
+	}
+	printf("\n");
+	NRF24L01_BENCH_CHECK(failures == 0, "%u calls failed", failures);
+
+	BenchInterrupts();
+	return NRF24L01_BenchExit("NRF24L01_BenchSpi");
+}
@@ -0,0 +1,198 @@
+/**
+ * @brief Collision rate and latency of TDMA against uncoordinated transmissions to one gateway
+ *
+ * 10, 50 and 100 nodes in range of each other send an 8 byte reading to one gateway every 500 ms(every node at its
+ * own random phase). With ALOHA every node transmits as soon as its reading is due and relies on automatic
+ * retransmissions, with TDMA it transmits in the slot the gateway assigned to it(one 2 ms slot per node).
+ * Nodes join and synchronize during the first seconds, only readings due in the measurement window are counted.
+ * Reports per transmission the share that collided, transmissions per reading, latency from the reading being
+ * due to its ACK and with TDMA the time until every node had its slot. Both modes use 3 retransmissions with
+ * 500 us delay, which fit the slot.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Bench.h"
+#include "NRF24L01_Tdma.h"
+
+#define BENCH_MAX_NODES 100
+#define BENCH_PERIOD 500      //ms between readings of a node, fits two superframes of 100 slots
+#define BENCH_SLOT_TIME 2000  //us
+#define BENCH_WARMUP 8000     //ms for nodes to join and synchronize
+#define BENCH_MEASURE 5000    //ms of counted readings
+#define BENCH_BEACON_ADDRESS 0xB5B5B5B5B5
+
+typedef struct {
+	NRF24L01_Device device;
+	NRF24L01_Config config;
+	NRF24L01_Tdma tdma;
+	uint32_t readings;
+	uint32_t delivered;
+	NRF24L01_SimChipStats before; //Chip statistics when the window started
+	NRF24L01_SimChipStats after;  //Chip statistics when the window ended
+	uint64_t latencyTotal;
+	uint64_t latencyMax;
+	uint64_t joined; //Time the node first knew its slot
+} BenchNode;
+
+typedef struct {
+	uint32_t readings;
+	uint32_t delivered;
+	uint32_t transmissions;
+	uint32_t collisions;
+	double latencyAverage; //ms
+	double latencyMax;     //ms
+	double joined;         //s until every node had its slot
+} BenchResult;
+
+static BenchNode nodes[BENCH_MAX_NODES];
+static NRF24L01_Device gatewayDevice;
+static NRF24L01_Config gatewayConfig;
+static NRF24L01_Tdma gatewayTdma;
+static uint8_t numberOfNodes;
+static bool tdma;
+
+static void Gateway(void *arg) {
+	(void) arg;
+	uint8_t buffer[32];
+	uint8_t nodeId;
+	uint8_t size;
+	NRF24L01_Init(&gatewayDevice, &gatewayConfig);
+	if (tdma) {
+		NRF24L01_TdmaInitGateway(&gatewayTdma, &gatewayDevice, BENCH_BEACON_ADDRESS, NRF24L01_BENCH_ADDRESS,
+				numberOfNodes, BENCH_SLOT_TIME);
+	}
+	while (HAL_GetTick() < BENCH_WARMUP + BENCH_MEASURE + BENCH_PERIOD) {
+		if (tdma) {
+			NRF24L01_TdmaReceive(&gatewayTdma, &nodeId, buffer, &size, 10);
+		} else {
+			NRF24L01_ReceivePacket(&gatewayDevice, 1, buffer, 10);
+		}
+	}
+	NRF24L01_SimStop();
+}
+
+static void Node(void *arg) {
+	BenchNode *node = arg;
+	uint8_t reading[8] = { (uint8_t) (node - nodes) };
+	NRF24L01_Init(&node->device, &node->config);
+	if (tdma) {
+		NRF24L01_TdmaInitNode(&node->tdma, &node->device, BENCH_BEACON_ADDRESS, NRF24L01_BENCH_ADDRESS,
+				(uint8_t) (node - nodes + 1));
+	}
+
+	uint64_t due = (uint64_t) (NRF24L01_SimRandom() * BENCH_PERIOD * NRF24L01_SIM_MS);
+	bool counted = false;
+	while (due < (uint64_t) (BENCH_WARMUP + BENCH_MEASURE) * NRF24L01_SIM_MS) {
+		//Ticks of all nodes start together in the simulation, so the reading waits for its exact time
+		if (NRF24L01_SimGetTime() < due) {
+			HAL_Delay((uint32_t) ((due - NRF24L01_SimGetTime()) / NRF24L01_SIM_MS));
+		}
+		while (NRF24L01_SimGetTime() < due) {
+			(void) DWT->CYCCNT;
+		}
+		if (!counted && due >= (uint64_t) BENCH_WARMUP * NRF24L01_SIM_MS) {
+			node->before = NRF24L01_SimGetChipStats(node->device.hspi->chip);
+			counted = true;
+		}
+
+		bool delivered = tdma ? NRF24L01_TdmaTransmitPacket(&node->tdma, reading, sizeof(reading), BENCH_PERIOD)
+				: NRF24L01_TransmitPacket(&node->device, reading, sizeof(reading));
+		if (node->joined == 0 && (!tdma || node->tdma.slot != NRF24L01_TDMA_NO_SLOT)) {
+			node->joined = NRF24L01_SimGetTime();
+		}
+		if (counted) {
+			uint64_t latency = NRF24L01_SimGetTime() - due;
+			node->readings++;
+			node->delivered += delivered;
+			node->latencyTotal += delivered ? latency : 0;
+			node->latencyMax = delivered && latency > node->latencyMax ? latency : node->latencyMax;
+		}
+		due += BENCH_PERIOD * NRF24L01_SIM_MS;
+	}
+	node->after = NRF24L01_SimGetChipStats(node->device.hspi->chip);
+}
+
+static BenchResult Run(uint8_t count, bool useTdma) {
+	numberOfNodes = count;
+	tdma = useTdma;
+	NRF24L01_SimReset(NULL);
+	gatewayConfig = NRF24L01_BenchConfig(DATA_RATE_2MBPS, false);
+	NRF24L01_SimNode *simNode = NRF24L01_SimAddNode(Gateway, NULL);
+	NRF24L01_SimAttach(&gatewayDevice, NRF24L01_SimAddChip(simNode), NRF24L01_SIM_IRQ_POLL);
+	for (uint8_t i = 0; i < count; i++) {
+		BenchNode *node = &nodes[i];
+		memset(node, 0, sizeof(BenchNode));
+		node->config = NRF24L01_BenchConfig(DATA_RATE_2MBPS, true);
+		node->config.retransmitCount = RETR_TIMES_3;
+		node->config.retransmitDelay = RETR_DELAY_500US;
+		simNode = NRF24L01_SimAddNode(Node, node);
+		NRF24L01_SimAttach(&node->device, NRF24L01_SimAddChip(simNode), NRF24L01_SIM_IRQ_POLL);
+	}
+	NRF24L01_SimRun(60 * NRF24L01_SIM_SECOND);
+
+	BenchResult result = { 0 };
+	uint64_t latencyTotal = 0;
+	uint64_t latencyMax = 0;
+	uint64_t joined = 0;
+	for (uint8_t i = 0; i < count; i++) {
+		BenchNode *node = &nodes[i];
+		result.readings += node->readings;
+		result.delivered += node->delivered;
+		result.transmissions += node->after.txPackets - node->before.txPackets;
+		result.collisions += node->after.collisions - node->before.collisions;
+		latencyTotal += node->latencyTotal;
+		latencyMax = node->latencyMax > latencyMax ? node->latencyMax : latencyMax;
+		joined = node->joined > joined ? node->joined : joined;
+	}
+	result.latencyAverage = result.delivered > 0 ? (double) latencyTotal / result.delivered / NRF24L01_SIM_MS : 0;
+	result.latencyMax = (double) latencyMax / NRF24L01_SIM_MS;
+	result.joined = (double) joined / NRF24L01_SIM_SECOND;
+	return result;
+}
+
+int main(void) {
+	const uint8_t counts[] = { 10, 50, 100 };
+	printf("Reading every %d ms per node at 2 Mbps, TDMA slot %d us\n", BENCH_PERIOD, BENCH_SLOT_TIME);
+	printf("| Nodes | Mode  | Readings | Delivered | Transmissions per reading | Collided | "
+			"Latency avg/max (ms) | All joined (s) |\n");
+	printf("|-------|-------|----------|-----------|---------------------------|----------|"
+			"----------------------|----------------|\n");
+	for (uint8_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+		BenchResult aloha = Run(counts[i], false);
+		BenchResult slotted = Run(counts[i], true);
+		const BenchResult *results[] = { &aloha, &slotted };
+		for (uint8_t mode = 0; mode < 2; mode++) {
+			const BenchResult *result = results[mode];
+			printf("| %5u | %-5s | %8u | %8.1f%% | %25.2f | %7.1f%% | %8.1f / %9.1f | ", counts[i],
+					mode == 0 ? "ALOHA" : "TDMA", result->readings,
+					result->readings > 0 ? 100.0 * result->delivered / result->readings : 0,
+					result->readings > 0 ? (double) result->transmissions / result->readings : 0,
+					result->transmissions > 0 ? 100.0 * result->collisions / result->transmissions : 0,
+					result->latencyAverage, result->latencyMax);
+			if (mode == 0) {
+				printf("%14s |\n", "-"); //Nodes transmit without joining
+			} else {
+				printf("%14.1f |\n", result->joined);
+			}
+		}
+
+		//Slots do not overlap, so once nodes have joined nothing collides and every reading gets through. Nodes are
+		//idle between readings for longer than resync interval, so they wait for a beacon and then for their slot
+		double superframe = (counts[i] + 2) * BENCH_SLOT_TIME / 1000.0;
+		NRF24L01_BENCH_CHECK(slotted.readings >= counts[i] * (BENCH_MEASURE / BENCH_PERIOD - 1),
+				"%u nodes: %u TDMA readings", counts[i], slotted.readings);
+		NRF24L01_BENCH_CHECK(slotted.joined * 1000 < BENCH_WARMUP, "%u nodes: joined after %.1f s", counts[i],
+				slotted.joined);
+		NRF24L01_BENCH_CHECK(slotted.collisions == 0 && slotted.delivered == slotted.readings,
+				"%u nodes: TDMA %u collisions, %u of %u readings delivered", counts[i], slotted.collisions,
+				slotted.delivered, slotted.readings);
+		NRF24L01_BENCH_CHECK(slotted.latencyMax <= 2 * superframe,
+				"%u nodes: TDMA max latency %.1f ms, superframe %.1f ms", counts[i], slotted.latencyMax, superframe);
+		NRF24L01_BENCH_CHECK(counts[i] < 50 || aloha.collisions > 0,
+				"%u nodes: no ALOHA collisions", counts[i]);
+	}
+	printf("\n");
+	return NRF24L01_BenchExit("NRF24L01_BenchTdma");
+}
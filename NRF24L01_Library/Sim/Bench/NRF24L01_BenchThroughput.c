@@ -0,0 +1,118 @@
+/**
+ * @brief Throughput of NRF24L01_Transmit streaming through TX FIFO
+ *
+ * Sends one large message with NRF24L01_Transmit, which keeps TX FIFO full with CE held high, and the same
+ * amount of data packet by packet with NRF24L01_TransmitPacket, which waits for every ACK before writing the next
+ * payload. Reports goodput(message data only) for every data rate against the limit of auto acknowledged packets:
+ * TX settling, packet, settling of the receiver and ACK for every 32 bytes.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Bench.h"
+
+#define BENCH_MESSAGE_SIZE 16384
+
+typedef struct {
+	bool streaming;
+	bool delivered;
+	uint32_t received;
+	uint64_t duration;
+} BenchRun;
+
+static NRF24L01_Device transmitter;
+static NRF24L01_Device receiver;
+static NRF24L01_Config transmitterConfig;
+static NRF24L01_Config receiverConfig;
+static uint8_t message[BENCH_MESSAGE_SIZE];
+static uint8_t buffer[BENCH_MESSAGE_SIZE + 32];
+
+static void Transmitter(void *arg) {
+	BenchRun *run = arg;
+	NRF24L01_Init(&transmitter, &transmitterConfig);
+	HAL_Delay(5);
+	uint64_t start = NRF24L01_SimGetTime();
+	if (run->streaming) {
+		run->delivered = NRF24L01_Transmit(&transmitter, message, sizeof(message), 32);
+	} else {
+		run->delivered = true;
+		for (uint32_t offset = 0; offset < sizeof(message) && run->delivered; offset += 32) {
+			run->delivered = NRF24L01_TransmitPacket(&transmitter, &message[offset], 32);
+		}
+	}
+	run->duration = NRF24L01_SimGetTime() - start;
+	HAL_Delay(5); //Receiver takes the last packets
+	NRF24L01_SimStop();
+}
+
+static void Receiver(void *arg) {
+	BenchRun *run = arg;
+	NRF24L01_Init(&receiver, &receiverConfig);
+	if (run->streaming) {
+		if (NRF24L01_Receive(&receiver, 1, buffer, 1000) && memcmp(buffer, message, sizeof(message)) == 0) {
+			run->received = sizeof(message);
+		}
+		return;
+	}
+	while (true) {
+		if (NRF24L01_ReceivePacket(&receiver, 1, &buffer[run->received], 1000)
+				&& memcmp(&buffer[run->received], &message[run->received], 32) == 0) {
+			run->received += 32;
+		}
+	}
+}
+
+static BenchRun Run(DATA_RATE dataRate, bool streaming) {
+	BenchRun run = { streaming, false, 0, 0 };
+	transmitterConfig = NRF24L01_BenchConfig(dataRate, true);
+	receiverConfig = NRF24L01_BenchConfig(dataRate, false);
+	NRF24L01_SimReset(NULL);
+	NRF24L01_SimNode *node = NRF24L01_SimAddNode(Transmitter, &run);
+	NRF24L01_SimAttach(&transmitter, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	node = NRF24L01_SimAddNode(Receiver, &run);
+	NRF24L01_SimAttach(&receiver, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	NRF24L01_SimRun(60 * NRF24L01_SIM_SECOND);
+	return run;
+}
+
+static double AckLimit(double bitRate) {
+	double packetBits = 8 * (1 + 5 + 32 + 1) + 9;
+	double ackBits = 8 * (1 + 5 + 1) + 9;
+	return 32 * 8 / (130e-6 + packetBits / bitRate + 130e-6 + ackBits / bitRate) / 1000;
+}
+
+static double Goodput(const BenchRun *run) {
+	return run->duration > 0 ? BENCH_MESSAGE_SIZE * 8.0 * NRF24L01_SIM_SECOND / run->duration / 1000 : 0;
+}
+
+int main(void) {
+	const DATA_RATE rates[] = { DATA_RATE_250KBPS, DATA_RATE_1MBPS, DATA_RATE_2MBPS };
+	const double bitRates[] = { 250e3, 1e6, 2e6 };
+	for (uint32_t i = 0; i < sizeof(message); i++) {
+		message[i] = (uint8_t) (i * 7 + i / 256);
+	}
+
+	printf("%d byte message, 32 byte packets, goodput in kbps\n", BENCH_MESSAGE_SIZE);
+	printf("| Data rate | TransmitPacket loop | Transmit(streaming) | Speedup | ACK limit | Streaming / limit |\n");
+	printf("|-----------|---------------------|---------------------|---------|-----------|-------------------|\n");
+	for (uint8_t i = 0; i < 3; i++) {
+		BenchRun single = Run(rates[i], false);
+		BenchRun streaming = Run(rates[i], true);
+		const char *name = NRF24L01_BenchDataRateName(rates[i]);
+		double limit = AckLimit(bitRates[i]);
+		printf("| %-9s | %19.0f | %19.0f | %6.2fx | %9.0f | %16.1f%% |\n", name, Goodput(&single),
+				Goodput(&streaming), Goodput(&streaming) / Goodput(&single), limit, Goodput(&streaming) / limit * 100);
+
+		NRF24L01_BENCH_CHECK(single.delivered && single.received == BENCH_MESSAGE_SIZE,
+				"%s: TransmitPacket loop delivered %u bytes", name, single.received);
+		NRF24L01_BENCH_CHECK(streaming.delivered && streaming.received == BENCH_MESSAGE_SIZE,
+				"%s: Transmit delivered %u bytes", name, streaming.received);
+		NRF24L01_BENCH_CHECK(Goodput(&streaming) > Goodput(&single), "%s: streaming is not faster", name);
+		//SPI work of the next payloads is hidden behind the air time of the current one
+		NRF24L01_BENCH_CHECK(Goodput(&streaming) >= limit * 0.95, "%s: streaming reaches %.1f%% of ACK limit", name,
+				Goodput(&streaming) / limit * 100);
+	}
+	printf("\n");
+	return NRF24L01_BenchExit("NRF24L01_BenchThroughput");
+}
@@ -0,0 +1,202 @@
+/**
+ * @brief Multi-packet messages with stray packets on the pipe and reliable transport on a lossy link
+ *
+ * Transmitter sends packets that look like the start of a multi-packet message right before a real message: a
+ * 32 byte packet that is not a header(its bytes stay in the receiver's packet buffer) followed by a lone 0x00,
+ * and a 4 byte packet declaring 4 packets of 16 bytes. NRF24L01_Receive must skip them and return the real message.
+ *
+ * NRF24L01_TransportSend sends BENCH_TRANSPORT_MESSAGES messages of 1000 bytes at several loss rates(every
+ * delivery, ACKs included, is lost with the same probability) with window 1(stop-and-wait, every fragment waits
+ * for its ACK and a lost one for retransmit delay) and larger windows(one acknowledged fragment per window).
+ * Goodput is message data per simulated time.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Bench.h"
+#include "NRF24L01_Transport.h"
+
+#define BENCH_MESSAGE_SIZE 200
+#define BENCH_TRANSPORT_MESSAGE_SIZE 1000
+#define BENCH_TRANSPORT_MESSAGES 20
+
+typedef struct {
+	const char *name;
+	uint8_t stray[32];
+	uint8_t straySize;
+	bool received;
+	bool intact;
+} BenchStray;
+
+static BenchStray strays[] = {
+	{ "Lone 0x00 after a 32 byte packet", { 0x00 }, 1, false, false },
+	{ "4 byte header of 4 x 16 byte packets", { 0x00, 0x04, 0x10, 0x55 }, 4, false, false }
+};
+
+typedef struct {
+	uint8_t window;
+	float loss;
+	uint32_t sent;      //Messages NRF24L01_TransportSend reported delivered
+	uint32_t delivered; //Messages that arrived intact
+	uint64_t duration;
+} BenchWindow;
+
+static NRF24L01_Device transmitter;
+static NRF24L01_Device receiver;
+static NRF24L01_Config transmitterConfig;
+static NRF24L01_Config receiverConfig;
+static uint8_t message[BENCH_MESSAGE_SIZE];
+static uint8_t buffer[BENCH_MESSAGE_SIZE + 32]; //Padding of the last packet is stored too
+static NRF24L01_Transport transmitterTransport;
+static NRF24L01_Transport receiverTransport;
+static uint8_t transportMessage[BENCH_TRANSPORT_MESSAGE_SIZE];
+static uint8_t transportBuffer[BENCH_TRANSPORT_MESSAGE_SIZE];
+
+/* Stray packets */
+
+static void StrayTransmitter(void *arg) {
+	BenchStray *stray = arg;
+	uint8_t packet[32];
+	NRF24L01_Init(&transmitter, &transmitterConfig);
+	HAL_Delay(5);
+	memset(packet, 0xAA, sizeof(packet));
+	packet[1] = 0x04; //Stale bytes the lone 0x00 would be read with: 4 packets of 32 bytes
+	packet[2] = 0x20;
+	NRF24L01_TransmitPacket(&transmitter, packet, sizeof(packet));
+	NRF24L01_TransmitPacket(&transmitter, stray->stray, stray->straySize);
+	NRF24L01_Transmit(&transmitter, message, BENCH_MESSAGE_SIZE, 32);
+}
+
+static void StrayReceiver(void *arg) {
+	BenchStray *stray = arg;
+	NRF24L01_Init(&receiver, &receiverConfig);
+	memset(buffer, 0, sizeof(buffer));
+	stray->received = NRF24L01_Receive(&receiver, 1, buffer, 1000);
+	stray->intact = memcmp(buffer, message, BENCH_MESSAGE_SIZE) == 0;
+	NRF24L01_SimStop();
+}
+
+static void BenchStrays(void) {
+	printf("NRF24L01_Receive of %d byte message after a stray packet\n", BENCH_MESSAGE_SIZE);
+	printf("| Stray packet                         | Received | Intact |\n");
+	printf("|--------------------------------------|----------|--------|\n");
+	for (uint8_t i = 0; i < sizeof(strays) / sizeof(strays[0]); i++) {
+		BenchStray *stray = &strays[i];
+		NRF24L01_SimReset(NULL);
+		NRF24L01_SimNode *node = NRF24L01_SimAddNode(StrayTransmitter, stray);
+		NRF24L01_SimAttach(&transmitter, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+		node = NRF24L01_SimAddNode(StrayReceiver, stray);
+		NRF24L01_SimAttach(&receiver, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+		NRF24L01_SimRun(10 * NRF24L01_SIM_SECOND);
+		printf("| %-36s | %8s | %6s |\n", stray->name, stray->received ? "yes" : "no", stray->intact ? "yes" : "no");
+		NRF24L01_BENCH_CHECK(stray->received && stray->intact, "%s: message %s", stray->name,
+				stray->received ? "corrupted" : "not received");
+	}
+	printf("\n");
+}
+
+/* Transport windows */
+
+//Every message differs, so a stale buffer is never taken for the new one
+static void FillTransportMessage(uint8_t *data, uint32_t number) {
+	for (uint32_t i = 0; i < BENCH_TRANSPORT_MESSAGE_SIZE; i++) {
+		data[i] = (uint8_t) (number * 31 + i * 7);
+	}
+}
+
+static void WindowTransmitter(void *arg) {
+	BenchWindow *run = arg;
+	NRF24L01_Init(&transmitter, &transmitterConfig);
+	NRF24L01_TransportInit(&transmitterTransport, &transmitter, 0, 32, run->window);
+	HAL_Delay(5);
+
+	uint64_t start = NRF24L01_SimGetTime();
+	for (uint32_t i = 0; i < BENCH_TRANSPORT_MESSAGES; i++) {
+		FillTransportMessage(transportMessage, i);
+		run->sent += NRF24L01_TransportSend(&transmitterTransport, transportMessage, BENCH_TRANSPORT_MESSAGE_SIZE);
+	}
+	run->duration = NRF24L01_SimGetTime() - start;
+	HAL_Delay(10); //Receiver checks the last message
+	NRF24L01_SimStop();
+}
+
+static void WindowReceiver(void *arg) {
+	BenchWindow *run = arg;
+	uint8_t expected[BENCH_TRANSPORT_MESSAGE_SIZE];
+	uint16_t size;
+	NRF24L01_Init(&receiver, &receiverConfig);
+	NRF24L01_TransportInit(&receiverTransport, &receiver, 1, 32, 1);
+	while (true) {
+		if (!NRF24L01_TransportReceive(&receiverTransport, transportBuffer, sizeof(transportBuffer), &size, 100)) {
+			continue;
+		}
+		FillTransportMessage(expected, run->delivered);
+		run->delivered += size == BENCH_TRANSPORT_MESSAGE_SIZE
+				&& memcmp(transportBuffer, expected, BENCH_TRANSPORT_MESSAGE_SIZE) == 0;
+	}
+}
+
+static BenchWindow RunWindow(uint8_t window, float loss) {
+	BenchWindow run = { window, loss, 0, 0, 0 };
+	NRF24L01_SimAir air = NRF24L01_SimDefaultAir();
+	air.loss = loss;
+	//12 byte ACK payload fits into the shortest delay at 2 Mbps
+	transmitterConfig.retransmitDelay = RETR_DELAY_250US;
+	receiverConfig.retransmitDelay = RETR_DELAY_250US;
+	NRF24L01_SimReset(&air);
+	NRF24L01_SimNode *node = NRF24L01_SimAddNode(WindowTransmitter, &run);
+	NRF24L01_SimAttach(&transmitter, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	node = NRF24L01_SimAddNode(WindowReceiver, &run);
+	NRF24L01_SimAttach(&receiver, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+	NRF24L01_SimRun(120 * NRF24L01_SIM_SECOND);
+	return run;
+}
+
+static double WindowGoodput(const BenchWindow *run) {
+	return run->duration > 0 ?
+			(double) run->delivered * BENCH_TRANSPORT_MESSAGE_SIZE * 8.0 * NRF24L01_SIM_SECOND / run->duration / 1000 :
+			0;
+}
+
+static void BenchWindows(void) {
+	const float losses[] = { 0.0f, 0.05f, 0.1f, 0.2f };
+	const uint8_t windows[] = { 1, 8, 32 };
+	printf("NRF24L01_TransportSend of %d byte messages in 32 byte packets at 2 Mbps, goodput in kbps"
+			"(messages delivered of %d)\n", BENCH_TRANSPORT_MESSAGE_SIZE, BENCH_TRANSPORT_MESSAGES);
+	printf("| Loss | Window 1(stop-and-wait) | Window 8     | Window 32    |\n");
+	printf("|------|-------------------------|--------------|--------------|\n");
+	for (uint8_t i = 0; i < sizeof(losses) / sizeof(losses[0]); i++) {
+		BenchWindow runs[3];
+		for (uint8_t j = 0; j < 3; j++) {
+			runs[j] = RunWindow(windows[j], losses[i]);
+		}
+		printf("| %3.0f%% | %17.0f (%3u) | %6.0f (%3u) | %6.0f (%3u) |\n", losses[i] * 100, WindowGoodput(&runs[0]),
+				runs[0].delivered, WindowGoodput(&runs[1]), runs[1].delivered, WindowGoodput(&runs[2]),
+				runs[2].delivered);
+
+		for (uint8_t j = 0; j < 3; j++) {
+			NRF24L01_BENCH_CHECK(runs[j].sent == BENCH_TRANSPORT_MESSAGES && runs[j].delivered == BENCH_TRANSPORT_MESSAGES,
+					"loss %.0f%%, window %u: %u sent, %u of %u delivered intact", losses[i] * 100, windows[j],
+					runs[j].sent, runs[j].delivered, BENCH_TRANSPORT_MESSAGES);
+		}
+		//Fragments without ACK go back-to-back and a lost one costs one more fragment instead of retransmit delays
+		for (uint8_t j = 1; j < 3; j++) {
+			NRF24L01_BENCH_CHECK(WindowGoodput(&runs[j]) > WindowGoodput(&runs[0]),
+					"loss %.0f%%: goodput %.0f kbps with window %u, %.0f kbps stop-and-wait", losses[i] * 100,
+					WindowGoodput(&runs[j]), windows[j], WindowGoodput(&runs[0]));
+		}
+	}
+	printf("\n");
+}
+
+int main(void) {
+	transmitterConfig = NRF24L01_BenchConfig(DATA_RATE_2MBPS, true);
+	receiverConfig = NRF24L01_BenchConfig(DATA_RATE_2MBPS, false);
+	for (uint32_t i = 0; i < BENCH_MESSAGE_SIZE; i++) {
+		message[i] = (uint8_t) (i * 7 + 1);
+	}
+	BenchStrays();
+	BenchWindows();
+	return NRF24L01_BenchExit("NRF24L01_BenchTransport");
+}
@@ -0,0 +1,462 @@
+/**
+ * @brief Implementation of nRF24L01+ host simulator: node scheduler and HAL surface
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_SimRadio.h"
+#include <ucontext.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define NRF24L01_SIM_MAX_CHIPS_PER_NODE 4
+
+//Cost of HAL calls on the MCU
+#define NRF24L01_SIM_GPIO_TIME 100
+#define NRF24L01_SIM_CLOCK_TIME 100
+#define NRF24L01_SIM_SPI_CALL_TIME 1000
+//Growth of the step of polling loop that sees no change, and its limit
+#define NRF24L01_SIM_POLL_STEP 100
+#define NRF24L01_SIM_MAX_POLL_STEP (5 * NRF24L01_SIM_US)
+
+uint32_t SystemCoreClock = 72000000;
+
+/**
+ * @brief Simulated MCU
+ *
+ * Fields:
+ * - context:     Coroutine context
+ * - stack:       Coroutine stack
+ * - main:        Firmware function
+ * - arg:         Argument of firmware function
+ * - time:        Simulated time of the node in ns
+ * - finished:    Firmware function returned
+ * - primask:     Interrupts are disabled
+ * - inInterrupt: Interrupt callback is running
+ * - interrupts:  Number of interrupt callbacks taken
+ * - pollStep:    Extra time spent by the next poll that sees no change
+ * - spiClock:    SPI clock in Hz
+ * - dwt:         Cycle counter
+ * - coreDebug:   Debug control
+ * - chips:       Chips wired to the node
+ * - chipCount:   Number of chips
+ */
+struct NRF24L01_SimNode {
+	ucontext_t context;
+	uint8_t *stack;
+	void (*main)(void *arg);
+	void *arg;
+	uint64_t time;
+	bool finished;
+	uint32_t primask;
+	bool inInterrupt;
+	uint32_t interrupts;
+	uint64_t pollStep;
+	uint32_t spiClock;
+	DWT_Type dwt;
+	CoreDebug_Type coreDebug;
+	NRF24L01_SimChip *chips[NRF24L01_SIM_MAX_CHIPS_PER_NODE];
+	uint8_t chipCount;
+};
+
+static struct {
+	NRF24L01_SimAir air;
+	NRF24L01_SimNode **nodes;
+	size_t nodeCount;
+	size_t nodeCapacity;
+	NRF24L01_SimNode *current;
+	ucontext_t scheduler;
+	uint64_t horizon;
+	bool stop;
+} sim;
+
+__attribute__((weak)) void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
+	(void) GPIO_Pin;
+}
+
+__attribute__((weak)) void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi) {
+	(void) hspi;
+}
+
+static NRF24L01_SimNode* NRF24L01_SimCurrent(void) {
+	if (sim.current == NULL) {
+		fprintf(stderr, "NRF24L01_Sim: HAL called outside of a node\n");
+		abort();
+	}
+	return sim.current;
+}
+
+/* Time and interrupts */
+
+static uint64_t NRF24L01_SimNextInterrupt(const NRF24L01_SimNode *node) {
+	uint64_t next = UINT64_MAX;
+	for (uint8_t i = 0; i < node->chipCount; i++) {
+		if (node->chips[i]->dmaActive && node->chips[i]->dmaDone < next) {
+			next = node->chips[i]->dmaDone;
+		}
+	}
+	return next;
+}
+
+static bool NRF24L01_SimHasInterrupts(const NRF24L01_SimNode *node) {
+	for (uint8_t i = 0; i < node->chipCount; i++) {
+		if (node->chips[i]->irqMode == NRF24L01_SIM_IRQ_EXTI || node->chips[i]->dmaActive) {
+			return true;
+		}
+	}
+	return false;
+}
+
+//Interrupts are taken between HAL calls while they are enabled and no interrupt is running
+static void NRF24L01_SimDispatch(NRF24L01_SimNode *node) {
+	if (node->inInterrupt || node->primask) {
+		return;
+	}
+	for (uint8_t i = 0; i < node->chipCount; i++) {
+		NRF24L01_SimChip *chip = node->chips[i];
+		if (chip->dmaActive && node->time >= chip->dmaDone) {
+			chip->dmaActive = false;
+			node->interrupts++;
+			node->inInterrupt = true;
+			node->pollStep = 0;
+			HAL_SPI_TxRxCpltCallback(&chip->spi);
+			node->inInterrupt = false;
+		}
+		if (chip->extiPending) {
+			chip->extiPending = false;
+			node->interrupts++;
+			node->inInterrupt = true;
+			node->pollStep = 0;
+			HAL_GPIO_EXTI_Callback(NRF24L01_SIM_PIN_IRQ);
+			node->inInterrupt = false;
+		}
+	}
+}
+
+//Advances time of the calling node, brings radio up to it and yields once the node is ahead of the others
+static void NRF24L01_SimSpend(uint64_t time) {
+	NRF24L01_SimNode *node = NRF24L01_SimCurrent();
+	node->time += time;
+	NRF24L01_SimRadioProcess(node->time);
+	NRF24L01_SimDispatch(node);
+	if (node->time > sim.horizon || sim.stop) {
+		swapcontext(&node->context, &sim.scheduler);
+	}
+}
+
+//Polling access: the longer nothing changes the bigger the step, but the next event is never skipped
+static void NRF24L01_SimPoll(uint64_t time) {
+	NRF24L01_SimNode *node = NRF24L01_SimCurrent();
+	uint64_t step = node->pollStep;
+	uint64_t next = NRF24L01_SimRadioNextEvent();
+	uint64_t interrupt = NRF24L01_SimNextInterrupt(node);
+	if (interrupt < next) {
+		next = interrupt;
+	}
+	if (node->time + time + step > next) {
+		step = next > node->time + time ? next - node->time - time : 0;
+	}
+	node->pollStep = node->pollStep == 0 ? NRF24L01_SIM_POLL_STEP : node->pollStep * 2;
+	if (node->pollStep > NRF24L01_SIM_MAX_POLL_STEP) {
+		node->pollStep = NRF24L01_SIM_MAX_POLL_STEP;
+	}
+	NRF24L01_SimSpend(time + step);
+}
+
+//Any change made by the node restarts polling with the smallest step
+static void NRF24L01_SimCheckChanged(NRF24L01_SimNode *node, NRF24L01_SimChip *chip) {
+	if (chip->changed) {
+		chip->changed = false;
+		node->pollStep = 0;
+	}
+}
+
+/* HAL */
+
+DWT_Type* NRF24L01_SimDWT(void) {
+	NRF24L01_SimNode *node = NRF24L01_SimCurrent();
+	NRF24L01_SimPoll(NRF24L01_SIM_CLOCK_TIME);
+	node->dwt.CYCCNT = (uint32_t) (node->time * (SystemCoreClock / 1000000) / 1000);
+	return &node->dwt;
+}
+
+CoreDebug_Type* NRF24L01_SimCoreDebug(void) {
+	return &NRF24L01_SimCurrent()->coreDebug;
+}
+
+uint32_t __get_PRIMASK(void) {
+	return NRF24L01_SimCurrent()->primask;
+}
+
+void __set_PRIMASK(uint32_t primask) {
+	NRF24L01_SimNode *node = NRF24L01_SimCurrent();
+	node->primask = primask & 0x01;
+	NRF24L01_SimDispatch(node);
+}
+
+void __disable_irq(void) {
+	NRF24L01_SimCurrent()->primask = 1;
+}
+
+void __enable_irq(void) {
+	__set_PRIMASK(0);
+}
+
+void __WFI(void) {
+	NRF24L01_SimNode *node = NRF24L01_SimCurrent();
+	uint32_t interrupts = node->interrupts;
+	while (node->interrupts == interrupts) {
+		NRF24L01_SimSpend(sim.air.quantum);
+	}
+}
+
+uint32_t HAL_GetTick(void) {
+	NRF24L01_SimPoll(NRF24L01_SIM_CLOCK_TIME);
+	return NRF24L01_SimCurrent()->time / NRF24L01_SIM_MS;
+}
+
+void HAL_Delay(uint32_t delay) {
+	NRF24L01_SimNode *node = NRF24L01_SimCurrent();
+	uint64_t end = node->time + delay * NRF24L01_SIM_MS;
+	while (node->time < end) {
+		//Node that may be interrupted sleeps in quanta, so interrupts are taken in time
+		uint64_t step = end - node->time;
+		if (NRF24L01_SimHasInterrupts(node) && step > sim.air.quantum) {
+			step = sim.air.quantum;
+		}
+		NRF24L01_SimSpend(step);
+	}
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state) {
+	NRF24L01_SimNode *node = NRF24L01_SimCurrent();
+	NRF24L01_SimChip *chip = port->chip;
+	if (pin & NRF24L01_SIM_PIN_CE) {
+		NRF24L01_SimChipSetCE(chip, state == GPIO_PIN_SET, node->time);
+	}
+	if (pin & NRF24L01_SIM_PIN_CSN) {
+		NRF24L01_SimChipSetCSN(chip, state == GPIO_PIN_SET, node->time);
+	}
+
+	//Transaction that only read the chip is part of a polling loop
+	if (chip->changed || !(pin & NRF24L01_SIM_PIN_CSN) || state == GPIO_PIN_RESET) {
+		NRF24L01_SimCheckChanged(node, chip);
+		NRF24L01_SimSpend(NRF24L01_SIM_GPIO_TIME);
+	} else {
+		NRF24L01_SimPoll(NRF24L01_SIM_GPIO_TIME);
+	}
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *port, uint16_t pin) {
+	NRF24L01_SimChip *chip = port->chip;
+	NRF24L01_SimPoll(NRF24L01_SIM_GPIO_TIME);
+	bool level = false;
+	if (pin & NRF24L01_SIM_PIN_CE) {
+		level = chip->ce;
+	} else if (pin & NRF24L01_SIM_PIN_CSN) {
+		level = chip->csn;
+	} else if (pin & NRF24L01_SIM_PIN_IRQ) {
+		level = !chip->irqAsserted;
+	}
+	return level ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+static uint64_t NRF24L01_SimSpiTime(const NRF24L01_SimNode *node, uint16_t size) {
+	return (uint64_t) size * 8 * NRF24L01_SIM_SECOND / node->spiClock;
+}
+
+//Bytes reach the chip when the transfer is over
+static HAL_StatusTypeDef NRF24L01_SimSpi(SPI_HandleTypeDef *hspi, const uint8_t *txData, uint8_t *rxData,
+		uint16_t size) {
+	NRF24L01_SimNode *node = NRF24L01_SimCurrent();
+	NRF24L01_SimChip *chip = hspi->chip;
+	if (chip->dmaActive) {
+		return HAL_BUSY;
+	}
+	NRF24L01_SimSpend(NRF24L01_SIM_SPI_CALL_TIME + NRF24L01_SimSpiTime(node, size));
+	for (uint16_t i = 0; i < size; i++) {
+		uint8_t data = NRF24L01_SimChipExchange(chip, txData != NULL ? txData[i] : 0xFF, node->time);
+		if (rxData != NULL) {
+			rxData[i] = data;
+		}
+	}
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *data, uint16_t size, uint32_t timeout) {
+	(void) timeout;
+	return NRF24L01_SimSpi(hspi, data, NULL, size);
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *data, uint16_t size, uint32_t timeout) {
+	(void) timeout;
+	return NRF24L01_SimSpi(hspi, NULL, data, size);
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef *hspi, uint8_t *txData, uint8_t *rxData, uint16_t size,
+		uint32_t timeout) {
+	(void) timeout;
+	return NRF24L01_SimSpi(hspi, txData, rxData, size);
+}
+
+//Bytes are exchanged right away, the buffer must not be used before completion callback anyway
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA(SPI_HandleTypeDef *hspi, uint8_t *txData, uint8_t *rxData,
+		uint16_t size) {
+	NRF24L01_SimNode *node = NRF24L01_SimCurrent();
+	NRF24L01_SimChip *chip = hspi->chip;
+	if (chip->dmaActive) {
+		return HAL_BUSY;
+	}
+	for (uint16_t i = 0; i < size; i++) {
+		rxData[i] = NRF24L01_SimChipExchange(chip, txData[i], node->time);
+	}
+	chip->dmaActive = true;
+	chip->dmaDone = node->time + NRF24L01_SIM_SPI_CALL_TIME + NRF24L01_SimSpiTime(node, size);
+	NRF24L01_SimSpend(NRF24L01_SIM_SPI_CALL_TIME);
+	return HAL_OK;
+}
+
+/* Simulation control */
+
+NRF24L01_SimAir NRF24L01_SimDefaultAir(void) {
+	NRF24L01_SimAir air = { 0 };
+	air.seed = 1;
+	air.quantum = 10 * NRF24L01_SIM_US;
+	air.stackSize = 256 * 1024;
+	return air;
+}
+
+void NRF24L01_SimReset(const NRF24L01_SimAir *air) {
+	for (size_t i = 0; i < sim.nodeCount; i++) {
+		free(sim.nodes[i]->stack);
+		free(sim.nodes[i]);
+	}
+	free(sim.nodes);
+	memset(&sim, 0, sizeof(sim));
+	sim.air = air != NULL ? *air : NRF24L01_SimDefaultAir();
+	if (sim.air.quantum == 0) {
+		sim.air.quantum = NRF24L01_SimDefaultAir().quantum;
+	}
+	if (sim.air.stackSize == 0) {
+		sim.air.stackSize = NRF24L01_SimDefaultAir().stackSize;
+	}
+	NRF24L01_SimRadioReset(&sim.air);
+}
+
+static void NRF24L01_SimNodeEntry(void) {
+	NRF24L01_SimNode *node = sim.current;
+	node->main(node->arg);
+	node->finished = true; //Returns to scheduler through uc_link
+}
+
+NRF24L01_SimNode* NRF24L01_SimAddNode(void (*main)(void *arg), void *arg) {
+	if (sim.nodeCount == sim.nodeCapacity) {
+		sim.nodeCapacity = sim.nodeCapacity == 0 ? 16 : sim.nodeCapacity * 2;
+		sim.nodes = realloc(sim.nodes, sim.nodeCapacity * sizeof(NRF24L01_SimNode*));
+	}
+	NRF24L01_SimNode *node = calloc(1, sizeof(NRF24L01_SimNode));
+	uint8_t *stack = malloc(sim.air.stackSize);
+	if (sim.nodes == NULL || node == NULL || stack == NULL) {
+		fprintf(stderr, "NRF24L01_Sim: out of memory\n");
+		abort();
+	}
+
+	node->main = main;
+	node->arg = arg;
+	node->stack = stack;
+	node->spiClock = 8000000;
+	getcontext(&node->context);
+	node->context.uc_stack.ss_sp = stack;
+	node->context.uc_stack.ss_size = sim.air.stackSize;
+	node->context.uc_link = &sim.scheduler;
+	makecontext(&node->context, NRF24L01_SimNodeEntry, 0);
+	sim.nodes[sim.nodeCount++] = node;
+	return node;
+}
+
+void NRF24L01_SimSetSpiClock(NRF24L01_SimNode *node, uint32_t clock) {
+	node->spiClock = clock;
+}
+
+NRF24L01_SimChip* NRF24L01_SimAddChip(NRF24L01_SimNode *node) {
+	if (node->chipCount == NRF24L01_SIM_MAX_CHIPS_PER_NODE) {
+		fprintf(stderr, "NRF24L01_Sim: too many chips on one node\n");
+		abort();
+	}
+	NRF24L01_SimChip *chip = NRF24L01_SimRadioAddChip(node);
+	node->chips[node->chipCount++] = chip;
+	return chip;
+}
+
+void NRF24L01_SimAttach(NRF24L01_Device *device, NRF24L01_SimChip *chip, NRF24L01_SimIrqMode irqMode) {
+	chip->irqMode = irqMode;
+	device->CE_Port = &chip->port;
+	device->CE_Pin = NRF24L01_SIM_PIN_CE;
+	device->CSN_Port = &chip->port;
+	device->CSN_Pin = NRF24L01_SIM_PIN_CSN;
+	device->IRQ_Port = irqMode == NRF24L01_SIM_IRQ_NONE ? NULL : &chip->port;
+	device->IRQ_Pin = NRF24L01_SIM_PIN_IRQ;
+	device->hspi = &chip->spi;
+}
+
+uint64_t NRF24L01_SimRun(uint64_t until) {
+	sim.stop = false;
+	while (!sim.stop) {
+		//Node furthest behind runs until it is a quantum ahead of the next one
+		NRF24L01_SimNode *next = NULL;
+		uint64_t second = UINT64_MAX;
+		for (size_t i = 0; i < sim.nodeCount; i++) {
+			NRF24L01_SimNode *node = sim.nodes[i];
+			if (node->finished) {
+				continue;
+			}
+			if (next == NULL || node->time < next->time) {
+				if (next != NULL) {
+					second = next->time;
+				}
+				next = node;
+			} else if (node->time < second) {
+				second = node->time;
+			}
+		}
+		if (next == NULL || next->time >= until) {
+			break;
+		}
+
+		sim.horizon = second < until ? second + sim.air.quantum : until;
+		NRF24L01_SimRadioProcess(next->time);
+		sim.current = next;
+		swapcontext(&sim.scheduler, &next->context);
+		sim.current = NULL;
+	}
+	return NRF24L01_SimGetTime();
+}
+
+void NRF24L01_SimStop(void) {
+	sim.stop = true;
+	if (sim.current != NULL) {
+		swapcontext(&sim.current->context, &sim.scheduler);
+	}
+}
+
+uint64_t NRF24L01_SimGetTime(void) {
+	if (sim.current != NULL) {
+		return sim.current->time;
+	}
+	uint64_t behind = UINT64_MAX;
+	uint64_t latest = 0;
+	for (size_t i = 0; i < sim.nodeCount; i++) {
+		if (!sim.nodes[i]->finished && sim.nodes[i]->time < behind) {
+			behind = sim.nodes[i]->time;
+		}
+		if (sim.nodes[i]->time > latest) {
+			latest = sim.nodes[i]->time;
+		}
+	}
+	return behind != UINT64_MAX ? behind : latest;
+}
+
+void* NRF24L01_SimGetArg(void) {
+	return sim.current != NULL ? sim.current->arg : NULL;
+}
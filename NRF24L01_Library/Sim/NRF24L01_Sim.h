@@ -0,0 +1,269 @@
+/**
+ * @brief Host simulator of nRF24L01+ chip and air link
+ *
+ * Every simulated MCU(node) runs its own firmware function with the unmodified library on top of sim_hal.h.
+ * Nodes are cooperative coroutines, each with its own simulated time: HAL calls cost time(SPI at the node's clock,
+ * a fixed cost per GPIO and timer access) and the node that is furthest behind always runs next, so nodes never
+ * drift apart by more than the scheduling quantum. Polling loops that only read clocks, pins or registers are
+ * accelerated: their step grows while nothing changes, but never skips a radio event.
+ *
+ * Chip model:
+ * - Register file with reset values, byte stream SPI protocol per CSN window, 3-deep TX and RX FIFOs
+ * - STATUS(RX_DR, TX_DS, MAX_RT, RX_P_NO, TX_FULL), FIFO_STATUS, OBSERVE_TX(PLOS_CNT, ARC_CNT), RPD
+ * - Power down, 1.5 ms start up, Standby-I/II, 130 us TX/RX settling, CE pulse or CE held high transmission
+ * - Auto acknowledgement with PID based duplicate detection, retransmission every ARD up to ARC times,
+ *   MAX_RT blocks transmission until cleared, ACK payloads released by the next packet with a new PID
+ * - Static and dynamic payload length per pipe, W_TX_PAYLOAD_NOACK, no ACK while RX FIFO is full
+ * - IRQ pin(active low, masked by CONFIG) with optional EXTI interrupt, DMA completion interrupt
+ *
+ * Air link: packets occupy the channel for (preamble + address + 9 bit control field + payload + CRC) at the data
+ * rate or a fixed bit rate, overlapping packets on one channel are both corrupted(optionally only at receivers in
+ * range of both transmitters, e.g. for a mesh where nodes hear only their neighbours), every delivery is lost with a
+ * configurable probability(global, per channel or from a callback that may depend on path, data rate and time)
+ * and arrives after a fixed latency. Random numbers are deterministic for a given seed.
+ *
+ * @example
+ * static void Transmitter(void *arg) {
+ *     NRF24L01_Device *device = arg;
+ *     NRF24L01_Init(device, &txConfig);
+ *     NRF24L01_TransmitPacket(device, data, 32);
+ *     NRF24L01_SimStop();
+ * }
+ *
+ * NRF24L01_SimAir air = NRF24L01_SimDefaultAir();
+ * air.loss = 0.1f;
+ * NRF24L01_SimReset(&air);
+ * NRF24L01_SimNode *node = NRF24L01_SimAddNode(Transmitter, &txDevice);
+ * NRF24L01_SimAttach(&txDevice, NRF24L01_SimAddChip(node), NRF24L01_SIM_IRQ_POLL);
+ * ...
+ * NRF24L01_SimRun(NRF24L01_SIM_SECOND);
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#ifndef NRF24L01_SIM_H
+#define NRF24L01_SIM_H
+
+#include "NRF24L01.h"
+
+#define NRF24L01_SIM_US 1000ULL
+#define NRF24L01_SIM_MS 1000000ULL
+#define NRF24L01_SIM_SECOND 1000000000ULL
+
+#define NRF24L01_SIM_PIN_CE 0x0001
+#define NRF24L01_SIM_PIN_CSN 0x0002
+#define NRF24L01_SIM_PIN_IRQ 0x0004
+
+typedef struct NRF24L01_SimNode NRF24L01_SimNode;
+
+/**
+ * @brief How IRQ pin of the chip is wired to the node
+ */
+typedef enum {
+	NRF24L01_SIM_IRQ_NONE = 0x00, //Not connected, IRQ_Port is NULL
+	NRF24L01_SIM_IRQ_POLL = 0x01, //Connected to input pin
+	NRF24L01_SIM_IRQ_EXTI = 0x02  //Connected to input pin, falling edge calls HAL_GPIO_EXTI_Callback
+} NRF24L01_SimIrqMode;
+
+/**
+ * @brief One delivery of a packet over the air, passed to loss callback
+ *
+ * Fields:
+ * - transmitter: Index of transmitting chip(in order of NRF24L01_SimAddChip)
+ * - receiver:    Index of receiving chip
+ * - channel:     RF channel
+ * - dataRate:    Data rate of the packet
+ * - rfPower:     RF power of transmitting chip
+ * - ack:         Packet is an ACK
+ * - time:        Simulated time in ns when the packet ends
+ */
+typedef struct {
+	uint16_t transmitter;
+	uint16_t receiver;
+	uint8_t channel;
+	DATA_RATE dataRate;
+	RF_POWER rfPower;
+	bool ack;
+	uint64_t time;
+} NRF24L01_SimPath;
+
+/**
+ * @brief Returns probability(0-1) that a delivery is lost
+ */
+typedef float (*NRF24L01_SimLossCallback)(void *context, const NRF24L01_SimPath *path);
+
+/**
+ * @brief Returns true if receiving chip is in range of transmitting chip(indexes in order of NRF24L01_SimAddChip)
+ */
+typedef bool (*NRF24L01_SimRangeCallback)(void *context, uint16_t transmitter, uint16_t receiver);
+
+/**
+ * @brief Air link and scheduler configuration
+ *
+ * Fields:
+ * - loss:         Probability that a delivery is lost (default 0), used if lossCallback is NULL
+ * - channelLoss:  Additional loss probability per RF channel, also seen by RPD as channel busy (default 0)
+ * - lossCallback: Loss probability per delivery (optional)
+ * - lossContext:  Context passed to lossCallback
+ * - rangeCallback: Chips that hear each other (optional, all chips do if NULL). Packets out of range of a chip
+ *                  are not received and do not corrupt other packets at it, nor are seen by its RPD
+ * - rangeContext: Context passed to rangeCallback
+ * - latency:      Propagation latency in ns (default 0)
+ * - bitRate:      Air bit rate in bit/s, 0 to use data rate of the chips (default 0)
+ * - seed:         Seed of random numbers (default 1)
+ * - quantum:      Max time in ns a node runs ahead of the others (default 10 us)
+ * - stackSize:    Stack size of every node in bytes (default 256 KB)
+ */
+typedef struct {
+	float loss;
+	float channelLoss[128];
+	NRF24L01_SimLossCallback lossCallback;
+	void *lossContext;
+	NRF24L01_SimRangeCallback rangeCallback;
+	void *rangeContext;
+	uint32_t latency;
+	uint32_t bitRate;
+	uint32_t seed;
+	uint32_t quantum;
+	uint32_t stackSize;
+} NRF24L01_SimAir;
+
+/**
+ * @brief Air link statistics of one chip
+ *
+ * Fields:
+ * - txPackets:  Packets transmitted(every retransmission counts)
+ * - txAcks:     ACK packets transmitted
+ * - collisions: Transmitted packets corrupted by overlapping packets(with rangeCallback, at a chip that would
+ *               have taken them)
+ * - lost:       Deliveries to this chip lost by the loss model
+ * - received:   Packets put into RX FIFO
+ * - duplicates: Retransmitted packets recognized by PID and dropped
+ * - overflows:  Packets dropped because RX FIFO was full
+ * - maxRetransmits: Packets that reached MAX_RT
+ * - airTime:    Time in ns this chip occupied the air
+ * - spiTransactions: SPI transactions(CSN low windows) made by the node
+ */
+typedef struct {
+	uint32_t txPackets;
+	uint32_t txAcks;
+	uint32_t collisions;
+	uint32_t lost;
+	uint32_t received;
+	uint32_t duplicates;
+	uint32_t overflows;
+	uint32_t maxRetransmits;
+	uint64_t airTime;
+	uint32_t spiTransactions;
+} NRF24L01_SimChipStats;
+
+/**
+ * @brief Get default air link configuration
+ *
+ * @return Lossless air link without latency
+ */
+NRF24L01_SimAir NRF24L01_SimDefaultAir(void);
+
+/**
+ * @brief Start a new simulation, all nodes and chips of the previous one are released
+ *
+ * @param air Air link configuration, NULL for default
+ */
+void NRF24L01_SimReset(const NRF24L01_SimAir *air);
+
+/**
+ * @brief Add a node running firmware function
+ *
+ * @param main Firmware, node is finished when it returns
+ * @param arg Argument of firmware function
+ * @return Node handle
+ */
+NRF24L01_SimNode* NRF24L01_SimAddNode(void (*main)(void *arg), void *arg);
+
+/**
+ * @brief Set SPI clock of a node
+ *
+ * @param node Node handle
+ * @param clock SPI clock in Hz (default 8 MHz)
+ */
+void NRF24L01_SimSetSpiClock(NRF24L01_SimNode *node, uint32_t clock);
+
+/**
+ * @brief Add a chip wired to a node, chip is in power on reset state
+ *
+ * @param node Node handle
+ * @return Chip handle
+ */
+NRF24L01_SimChip* NRF24L01_SimAddChip(NRF24L01_SimNode *node);
+
+/**
+ * @brief Fill pins and SPI handle of device with the ones of a chip
+ *
+ * @param device Device handle
+ * @param chip Chip handle
+ * @param irqMode How IRQ pin is wired
+ */
+void NRF24L01_SimAttach(NRF24L01_Device *device, NRF24L01_SimChip *chip, NRF24L01_SimIrqMode irqMode);
+
+/**
+ * @brief Run simulation until every node is finished, NRF24L01_SimStop is called or time limit is reached
+ *
+ * Can be called again to continue.
+ *
+ * @param until Simulated time limit in ns
+ * @return Simulated time in ns of the node that is furthest behind
+ */
+uint64_t NRF24L01_SimRun(uint64_t until);
+
+/**
+ * @brief Stop simulation, called by a node when the scenario is done
+ */
+void NRF24L01_SimStop(void);
+
+/**
+ * @brief Get simulated time
+ *
+ * @return Time in ns of the calling node, of the node that is furthest behind outside of nodes
+ */
+uint64_t NRF24L01_SimGetTime(void);
+
+/**
+ * @brief Get argument of the calling node's firmware, e.g. to find the device in interrupt callbacks
+ *
+ * @return Argument passed to NRF24L01_SimAddNode, NULL outside of nodes
+ */
+void* NRF24L01_SimGetArg(void);
+
+/**
+ * @brief Get index of a chip as used in NRF24L01_SimPath
+ *
+ * @param chip Chip handle
+ * @return Index in order of NRF24L01_SimAddChip
+ */
+uint16_t NRF24L01_SimGetChipIndex(const NRF24L01_SimChip *chip);
+
+/**
+ * @brief Get time the IRQ pin of a chip last fell, e.g. to measure interrupt latency
+ *
+ * @param chip Chip handle
+ * @return Time in ns, 0 if it never fell
+ */
+uint64_t NRF24L01_SimGetIrqTime(const NRF24L01_SimChip *chip);
+
+/**
+ * @brief Get air link statistics of a chip
+ *
+ * @param chip Chip handle
+ * @return Statistics since NRF24L01_SimAddChip
+ */
+NRF24L01_SimChipStats NRF24L01_SimGetChipStats(const NRF24L01_SimChip *chip);
+
+/**
+ * @brief Draw deterministic random number of the simulation
+ *
+ * @return Uniformly distributed number in range 0-1
+ */
+float NRF24L01_SimRandom(void);
+
+#endif // NRF24L01_SIM_H
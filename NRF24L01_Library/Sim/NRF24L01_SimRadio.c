@@ -0,0 +1,977 @@
+/**
+ * @brief Implementation of chip and air link model of nRF24L01+ host simulator
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_SimRadio.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+#define NRF24L01_SIM_START_UP_TIME (1500 * NRF24L01_SIM_US)
+#define NRF24L01_SIM_SETTLE_TIME (130 * NRF24L01_SIM_US)
+#define NRF24L01_SIM_RPD_TIME (40 * NRF24L01_SIM_US)
+#define NRF24L01_SIM_RETRANSMIT_DELAY_STEP (250 * NRF24L01_SIM_US)
+//Delivered packets are kept this long after their end, so late starting packets still see the overlap
+#define NRF24L01_SIM_AIR_HISTORY (1 * NRF24L01_SIM_MS)
+
+#define NRF24L01_SIM_CONFIG_MASK_IRQ 0x70
+#define NRF24L01_SIM_CONFIG_EN_CRC 0x08
+#define NRF24L01_SIM_CONFIG_CRCO 0x04
+#define NRF24L01_SIM_FIFO_STATUS_TX_REUSE 0x40
+#define NRF24L01_SIM_TX_ADDR_INDEX 6
+
+/**
+ * @brief Pending event, either a chip timer or the end of a packet at receivers
+ *
+ * Fields:
+ * - time:         Time of the event in ns
+ * - sequence:     Order of scheduling, keeps events of the same time in order
+ * - chip:         Chip of timer event
+ * - timer:        Generation of timer event
+ * - transmission: Packet of delivery event
+ */
+typedef struct {
+	uint64_t time;
+	uint64_t sequence;
+	NRF24L01_SimChip *chip;
+	uint32_t timer;
+	NRF24L01_SimTransmission *transmission;
+} NRF24L01_SimEvent;
+
+static struct {
+	NRF24L01_SimAir air;
+	NRF24L01_SimChip **chips;
+	size_t chipCount;
+	size_t chipCapacity;
+	NRF24L01_SimEvent *events;
+	size_t eventCount;
+	size_t eventCapacity;
+	uint64_t sequence;
+	NRF24L01_SimTransmission **packets;
+	size_t packetCount;
+	size_t packetCapacity;
+	NRF24L01_SimTransmission **spare;
+	size_t spareCount;
+	size_t spareCapacity;
+	uint32_t random;
+	uint64_t now;
+} radio;
+
+static void* NRF24L01_SimGrow(void *array, size_t *capacity, size_t count, size_t itemSize) {
+	if (count < *capacity) {
+		return array;
+	}
+	*capacity = *capacity == 0 ? 16 : *capacity * 2;
+	array = realloc(array, *capacity * itemSize);
+	if (array == NULL) {
+		fprintf(stderr, "NRF24L01_Sim: out of memory\n");
+		abort();
+	}
+	return array;
+}
+
+float NRF24L01_SimRandom(void) {
+	//xorshift32
+	radio.random ^= radio.random << 13;
+	radio.random ^= radio.random >> 17;
+	radio.random ^= radio.random << 5;
+	return (radio.random >> 8) / 16777216.0f;
+}
+
+/* Event queue(binary min heap by time and sequence) */
+
+static bool NRF24L01_SimEventBefore(const NRF24L01_SimEvent *a, const NRF24L01_SimEvent *b) {
+	return a->time < b->time || (a->time == b->time && a->sequence < b->sequence);
+}
+
+static void NRF24L01_SimPushEvent(uint64_t time, NRF24L01_SimChip *chip, uint32_t timer,
+		NRF24L01_SimTransmission *transmission) {
+	radio.events = NRF24L01_SimGrow(radio.events, &radio.eventCapacity, radio.eventCount, sizeof(NRF24L01_SimEvent));
+
+	size_t i = radio.eventCount++;
+	NRF24L01_SimEvent event = { time, radio.sequence++, chip, timer, transmission };
+	while (i > 0 && NRF24L01_SimEventBefore(&event, &radio.events[(i - 1) / 2])) {
+		radio.events[i] = radio.events[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	radio.events[i] = event;
+}
+
+static NRF24L01_SimEvent NRF24L01_SimPopEvent(void) {
+	NRF24L01_SimEvent top = radio.events[0];
+	NRF24L01_SimEvent last = radio.events[--radio.eventCount];
+	size_t i = 0;
+	while (true) {
+		size_t child = 2 * i + 1;
+		if (child >= radio.eventCount) {
+			break;
+		}
+		if (child + 1 < radio.eventCount && NRF24L01_SimEventBefore(&radio.events[child + 1], &radio.events[child])) {
+			child++;
+		}
+		if (!NRF24L01_SimEventBefore(&radio.events[child], &last)) {
+			break;
+		}
+		radio.events[i] = radio.events[child];
+		i = child;
+	}
+	radio.events[i] = last;
+	return top;
+}
+
+uint64_t NRF24L01_SimRadioNextEvent(void) {
+	return radio.eventCount > 0 ? radio.events[0].time : UINT64_MAX;
+}
+
+//Schedules the only timer of the chip, pending one becomes stale
+static void NRF24L01_SimSetTimer(NRF24L01_SimChip *chip, uint64_t time) {
+	chip->timer++;
+	NRF24L01_SimPushEvent(time, chip, chip->timer, NULL);
+}
+
+static void NRF24L01_SimCancelTimer(NRF24L01_SimChip *chip) {
+	chip->timer++;
+}
+
+/* Registers */
+
+static uint8_t NRF24L01_SimAddressWidth(const NRF24L01_SimChip *chip) {
+	uint8_t setup = chip->registers[NRF24L01_REG_SETUP_AW] & 0x03;
+	return setup == 0 ? 2 : setup + 2; //0 is illegal, 2 bytes is the closest the radio can do
+}
+
+static uint8_t NRF24L01_SimCrcSize(const NRF24L01_SimChip *chip) {
+	uint8_t config = chip->registers[NRF24L01_REG_CONFIG];
+	//CRC is forced on if auto acknowledgement is enabled on any pipe
+	if (!(config & NRF24L01_SIM_CONFIG_EN_CRC) && (chip->registers[NRF24L01_REG_EN_AA] & 0x3F) == 0) {
+		return 0;
+	}
+	return config & NRF24L01_SIM_CONFIG_CRCO ? 2 : 1;
+}
+
+static uint32_t NRF24L01_SimBitRate(uint8_t dataRate) {
+	if (radio.air.bitRate != 0) {
+		return radio.air.bitRate;
+	}
+	switch (dataRate) {
+	case DATA_RATE_1MBPS:
+		return 1000000;
+	case DATA_RATE_2MBPS:
+		return 2000000;
+	default:
+		return 250000;
+	}
+}
+
+//Preamble, address, 9 bit packet control field, payload and CRC
+static uint64_t NRF24L01_SimAirTime(uint8_t dataRate, uint8_t addressWidth, uint8_t size, uint8_t crcSize) {
+	uint64_t bits = 8 * (1 + addressWidth + size + crcSize) + 9;
+	uint64_t bitRate = NRF24L01_SimBitRate(dataRate);
+	return (bits * NRF24L01_SIM_SECOND + bitRate - 1) / bitRate;
+}
+
+static bool NRF24L01_SimDynamicPayload(const NRF24L01_SimChip *chip, uint8_t pipe) {
+	return (chip->registers[NRF24L01_REG_FEATURE] & NRF24L01_REG_FEATURE_ENABLE_DYNAMIC_PAYLOAD)
+			&& (chip->registers[NRF24L01_REG_DYNPD] & (1 << pipe));
+}
+
+static uint8_t NRF24L01_SimStatus(const NRF24L01_SimChip *chip) {
+	uint8_t status = chip->registers[NRF24L01_REG_STATUS] & NRF24L01_REG_STATUS_RESET_FLAGS;
+	status |= (chip->rxCount > 0 ? chip->rxFifo[0].pipe : 0x07) << 1;
+	if (chip->txCount == NRF24L01_SIM_FIFO_DEPTH) {
+		status |= 0x01;
+	}
+	return status;
+}
+
+static uint8_t NRF24L01_SimFifoStatus(const NRF24L01_SimChip *chip) {
+	uint8_t fifoStatus = chip->reuse ? NRF24L01_SIM_FIFO_STATUS_TX_REUSE : 0x00;
+	if (chip->txCount == NRF24L01_SIM_FIFO_DEPTH) {
+		fifoStatus |= NRF24L01_REG_FIFO_STATUS_TX_FULL_BIT_MASK;
+	}
+	if (chip->txCount == 0) {
+		fifoStatus |= NRF24L01_REG_FIFO_STATUS_TX_EMPTY_BIT_MASK;
+	}
+	if (chip->rxCount == NRF24L01_SIM_FIFO_DEPTH) {
+		fifoStatus |= NRF24L01_REG_FIFO_STATUS_RX_FULL_BIT_MASK;
+	}
+	if (chip->rxCount == 0) {
+		fifoStatus |= NRF24L01_REG_FIFO_STATUS_RX_EMPTY_BIT_MASK;
+	}
+	return fifoStatus;
+}
+
+//IRQ pin is low while any status flag not masked in CONFIG is set, falling edge is latched for EXTI
+static void NRF24L01_SimUpdateIrq(NRF24L01_SimChip *chip) {
+	uint8_t flags = chip->registers[NRF24L01_REG_STATUS] & NRF24L01_REG_STATUS_RESET_FLAGS;
+	bool asserted = (flags & ~(chip->registers[NRF24L01_REG_CONFIG] & NRF24L01_SIM_CONFIG_MASK_IRQ)) != 0;
+	if (asserted && !chip->irqAsserted) {
+		chip->irqFallTime = radio.now;
+		chip->extiPending = chip->irqMode == NRF24L01_SIM_IRQ_EXTI;
+	}
+	chip->irqAsserted = asserted;
+}
+
+static void NRF24L01_SimSetFlags(NRF24L01_SimChip *chip, uint8_t flags) {
+	chip->registers[NRF24L01_REG_STATUS] |= flags;
+	NRF24L01_SimUpdateIrq(chip);
+}
+
+static bool NRF24L01_SimInRange(const NRF24L01_SimChip *transmitter, const NRF24L01_SimChip *receiver) {
+	return radio.air.rangeCallback == NULL
+			|| radio.air.rangeCallback(radio.air.rangeContext, transmitter->index, receiver->index);
+}
+
+//Received power detector: carrier on the channel during the last 40 us of listening
+static uint8_t NRF24L01_SimReadRpd(const NRF24L01_SimChip *chip, uint64_t now) {
+	if (chip->state != CHIP_RX || now - chip->listenStart < NRF24L01_SIM_RPD_TIME) {
+		return 0;
+	}
+	uint8_t channel = chip->registers[NRF24L01_REG_RF_CH];
+	for (size_t i = 0; i < radio.packetCount; i++) {
+		NRF24L01_SimTransmission *packet = radio.packets[i];
+		uint64_t start = packet->start + radio.air.latency;
+		uint64_t end = packet->end + radio.air.latency;
+		if (packet->channel == channel && start <= now && end + NRF24L01_SIM_RPD_TIME >= now
+				&& NRF24L01_SimInRange(packet->chip, chip)) {
+			return 1;
+		}
+	}
+	return NRF24L01_SimRandom() < radio.air.channelLoss[channel & 0x7F] ? 1 : 0;
+}
+
+static uint8_t NRF24L01_SimReadRegister(const NRF24L01_SimChip *chip, uint8_t address, uint8_t index,
+		uint64_t now) {
+	switch (address) {
+	case NRF24L01_REG_RX_ADDR_P0:
+	case NRF24L01_REG_RX_ADDR_P1:
+		return index < 5 ? chip->addresses[address - NRF24L01_REG_RX_ADDR_P0][index] : 0;
+	case NRF24L01_REG_TX_ADDR:
+		return index < 5 ? chip->addresses[NRF24L01_SIM_TX_ADDR_INDEX][index] : 0;
+	case NRF24L01_REG_RX_ADDR_P2:
+	case NRF24L01_REG_RX_ADDR_P3:
+	case NRF24L01_REG_RX_ADDR_P4:
+	case NRF24L01_REG_RX_ADDR_P5:
+		return index == 0 ? chip->addresses[address - NRF24L01_REG_RX_ADDR_P0][0] : 0;
+	case NRF24L01_REG_STATUS:
+		return NRF24L01_SimStatus(chip);
+	case NRF24L01_REG_FIFO_STATUS:
+		return index == 0 ? NRF24L01_SimFifoStatus(chip) : 0;
+	case NRF24L01_REG_RPD:
+		return index == 0 ? NRF24L01_SimReadRpd(chip, now) : 0;
+	default:
+		return index == 0 && address <= NRF24L01_REG_FEATURE ? chip->registers[address] : 0;
+	}
+}
+
+static void NRF24L01_SimEvaluate(NRF24L01_SimChip *chip, uint64_t now);
+
+static void NRF24L01_SimWriteRegister(NRF24L01_SimChip *chip, uint8_t address, const uint8_t *data, uint8_t size,
+		uint64_t now) {
+	switch (address) {
+	case NRF24L01_REG_RX_ADDR_P0:
+	case NRF24L01_REG_RX_ADDR_P1:
+		memcpy(chip->addresses[address - NRF24L01_REG_RX_ADDR_P0], data, size < 5 ? size : 5);
+		return;
+	case NRF24L01_REG_TX_ADDR:
+		memcpy(chip->addresses[NRF24L01_SIM_TX_ADDR_INDEX], data, size < 5 ? size : 5);
+		return;
+	case NRF24L01_REG_RX_ADDR_P2:
+	case NRF24L01_REG_RX_ADDR_P3:
+	case NRF24L01_REG_RX_ADDR_P4:
+	case NRF24L01_REG_RX_ADDR_P5:
+		chip->addresses[address - NRF24L01_REG_RX_ADDR_P0][0] = data[0];
+		return;
+	case NRF24L01_REG_STATUS:
+		chip->registers[NRF24L01_REG_STATUS] &= ~(data[0] & NRF24L01_REG_STATUS_RESET_FLAGS);
+		NRF24L01_SimUpdateIrq(chip);
+		NRF24L01_SimEvaluate(chip, now); //Cleared MAX_RT unblocks transmission
+		return;
+	case NRF24L01_REG_OBSERVE_TX:
+	case NRF24L01_REG_RPD:
+	case NRF24L01_REG_FIFO_STATUS:
+		return; //Read only
+	case NRF24L01_REG_RF_CH:
+		chip->registers[NRF24L01_REG_RF_CH] = data[0] & 0x7F;
+		chip->registers[NRF24L01_REG_OBSERVE_TX] &= 0x0F; //PLOS_CNT is reset by writing RF_CH
+		return;
+	case NRF24L01_REG_CONFIG:
+		chip->registers[NRF24L01_REG_CONFIG] = data[0] & 0x7F;
+		NRF24L01_SimUpdateIrq(chip);
+		NRF24L01_SimEvaluate(chip, now);
+		return;
+	default:
+		if (address <= NRF24L01_REG_FEATURE) {
+			chip->registers[address] = data[0];
+		}
+		return;
+	}
+}
+
+/* FIFOs */
+
+static void NRF24L01_SimRemovePayload(NRF24L01_SimPayload *fifo, uint8_t *count, uint8_t index) {
+	memmove(&fifo[index], &fifo[index + 1], (*count - index - 1) * sizeof(NRF24L01_SimPayload));
+	(*count)--;
+}
+
+//Returns index of the first payload to transmit, -1 if there is none
+static int NRF24L01_SimTxHead(const NRF24L01_SimChip *chip) {
+	for (uint8_t i = 0; i < chip->txCount; i++) {
+		if (!chip->txFifo[i].ack) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static int NRF24L01_SimFindSerial(const NRF24L01_SimChip *chip, uint32_t serial) {
+	for (uint8_t i = 0; i < chip->txCount; i++) {
+		if (chip->txFifo[i].serial == serial) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static void NRF24L01_SimPushTx(NRF24L01_SimChip *chip, const uint8_t *data, uint8_t size, bool noAck, bool ack,
+		uint8_t pipe) {
+	if (size == 0 || chip->txCount == NRF24L01_SIM_FIFO_DEPTH) {
+		return;
+	}
+	NRF24L01_SimPayload *payload = &chip->txFifo[chip->txCount++];
+	memset(payload, 0, sizeof(NRF24L01_SimPayload));
+	payload->size = size;
+	memcpy(payload->data, data, size);
+	payload->noAck = noAck;
+	payload->ack = ack;
+	payload->pipe = pipe;
+	payload->serial = ++chip->serial;
+}
+
+static bool NRF24L01_SimPushRx(NRF24L01_SimChip *chip, uint8_t pipe, const NRF24L01_SimPayload *payload) {
+	if (chip->rxCount == NRF24L01_SIM_FIFO_DEPTH) {
+		chip->stats.overflows++;
+		return false;
+	}
+	NRF24L01_SimPayload *entry = &chip->rxFifo[chip->rxCount++];
+	*entry = *payload;
+	entry->pipe = pipe;
+	chip->stats.received++;
+	NRF24L01_SimSetFlags(chip, NRF24L01_REG_STATUS_RX_DR_BIT_MASK);
+	return true;
+}
+
+/* Air */
+
+static void NRF24L01_SimForgetPackets(uint64_t now) {
+	size_t kept = 0;
+	for (size_t i = 0; i < radio.packetCount; i++) {
+		NRF24L01_SimTransmission *packet = radio.packets[i];
+		if (packet->delivered && packet->end + radio.air.latency + NRF24L01_SIM_AIR_HISTORY < now) {
+			//Kept for reuse, so the model does not touch the heap once the air is busy
+			radio.spare = NRF24L01_SimGrow(radio.spare, &radio.spareCapacity, radio.spareCount,
+					sizeof(NRF24L01_SimTransmission*));
+			radio.spare[radio.spareCount++] = packet;
+		} else {
+			radio.packets[kept++] = packet;
+		}
+	}
+	radio.packetCount = kept;
+}
+
+static void NRF24L01_SimCountCollision(NRF24L01_SimTransmission *packet) {
+	if (!packet->collided) {
+		packet->collided = true;
+		packet->chip->stats.collisions++;
+	}
+}
+
+static void NRF24L01_SimCorrupt(NRF24L01_SimTransmission *packet) {
+	packet->corrupted = true;
+	NRF24L01_SimCountCollision(packet);
+}
+
+//Packet is corrupted at receiver by overlapping packet in range of it, overlaps are checked at delivery time
+//when every packet that started before the end of this one is on the air
+static bool NRF24L01_SimCollides(NRF24L01_SimTransmission *packet, const NRF24L01_SimChip *receiver) {
+	if (packet->corrupted) {
+		return true;
+	}
+	for (size_t i = 0; i < radio.packetCount && radio.air.rangeCallback != NULL; i++) {
+		NRF24L01_SimTransmission *other = radio.packets[i];
+		if (other != packet && other->channel == packet->channel && other->start < packet->end
+				&& packet->start < other->end && NRF24L01_SimInRange(other->chip, receiver)) {
+			NRF24L01_SimCountCollision(packet);
+			return true;
+		}
+	}
+	return false;
+}
+
+//Puts packet on the air with current radio settings of the chip
+static NRF24L01_SimTransmission* NRF24L01_SimStartPacket(NRF24L01_SimChip *chip, const NRF24L01_SimPayload *payload,
+		const uint8_t *address, uint8_t pid, bool ack, uint64_t now) {
+	NRF24L01_SimForgetPackets(now);
+
+	NRF24L01_SimTransmission *packet;
+	if (radio.spareCount > 0) {
+		packet = radio.spare[--radio.spareCount];
+		memset(packet, 0, sizeof(NRF24L01_SimTransmission));
+	} else {
+		packet = calloc(1, sizeof(NRF24L01_SimTransmission));
+		if (packet == NULL) {
+			fprintf(stderr, "NRF24L01_Sim: out of memory\n");
+			abort();
+		}
+	}
+	packet->chip = chip;
+	packet->channel = chip->registers[NRF24L01_REG_RF_CH];
+	packet->dataRate = chip->registers[NRF24L01_REG_RF_SETUP] & NRF24L01_REG_RF_SETUP_DATA_RATE_BIT_MASK;
+	packet->rfPower = chip->registers[NRF24L01_REG_RF_SETUP] & NRF24L01_REG_RF_SETUP_RF_POWER_BIT_MASK;
+	packet->addressWidth = NRF24L01_SimAddressWidth(chip);
+	packet->crcSize = NRF24L01_SimCrcSize(chip);
+	memcpy(packet->address, address, 5);
+	packet->payload = *payload;
+	packet->pid = pid;
+	packet->ack = ack;
+	packet->start = now;
+	packet->end = now
+			+ NRF24L01_SimAirTime(packet->dataRate, packet->addressWidth, payload->size, packet->crcSize);
+
+	//With range callback overlaps are found per receiver, see NRF24L01_SimCollides
+	for (size_t i = 0; i < radio.packetCount && radio.air.rangeCallback == NULL; i++) {
+		NRF24L01_SimTransmission *other = radio.packets[i];
+		if (other->channel == packet->channel && other->start < packet->end && packet->start < other->end) {
+			NRF24L01_SimCorrupt(other);
+			NRF24L01_SimCorrupt(packet);
+		}
+	}
+
+	radio.packets = NRF24L01_SimGrow(radio.packets, &radio.packetCapacity, radio.packetCount,
+			sizeof(NRF24L01_SimTransmission*));
+	radio.packets[radio.packetCount++] = packet;
+
+	chip->transmission = packet;
+	chip->stats.airTime += packet->end - packet->start;
+	NRF24L01_SimPushEvent(packet->end + radio.air.latency, NULL, 0, packet);
+	return packet;
+}
+
+static bool NRF24L01_SimLost(const NRF24L01_SimTransmission *packet, const NRF24L01_SimChip *receiver,
+		uint64_t now) {
+	float loss = radio.air.loss;
+	if (radio.air.lossCallback != NULL) {
+		NRF24L01_SimPath path = { packet->chip->index, receiver->index, packet->channel, packet->dataRate,
+				packet->rfPower, packet->ack, now };
+		loss = radio.air.lossCallback(radio.air.lossContext, &path);
+	}
+	bool lost = NRF24L01_SimRandom() < loss;
+	return NRF24L01_SimRandom() < radio.air.channelLoss[packet->channel & 0x7F] || lost;
+}
+
+//Receiver is tuned to the packet and listened since its first bit arrived
+static bool NRF24L01_SimHears(const NRF24L01_SimChip *chip, const NRF24L01_SimTransmission *packet) {
+	return chip->listenStart <= packet->start + radio.air.latency
+			&& chip->registers[NRF24L01_REG_RF_CH] == packet->channel
+			&& (chip->registers[NRF24L01_REG_RF_SETUP] & NRF24L01_REG_RF_SETUP_DATA_RATE_BIT_MASK) == packet->dataRate
+			&& NRF24L01_SimAddressWidth(chip) == packet->addressWidth && NRF24L01_SimCrcSize(chip) == packet->crcSize;
+}
+
+//Returns enabled pipe with address of the packet, -1 if there is none. Pipes 2-5 replace byte 0 of pipe 1 address.
+static int NRF24L01_SimMatchPipe(const NRF24L01_SimChip *chip, const NRF24L01_SimTransmission *packet) {
+	uint8_t width = packet->addressWidth;
+	for (uint8_t pipe = 0; pipe < 6; pipe++) {
+		if (!(chip->registers[NRF24L01_REG_EN_RXADDR] & (1 << pipe))) {
+			continue;
+		}
+		if (pipe < 2) {
+			if (memcmp(chip->addresses[pipe], packet->address, width) == 0) {
+				return pipe;
+			}
+		} else if (chip->addresses[pipe][0] == packet->address[0]
+				&& memcmp(&chip->addresses[1][1], &packet->address[1], width - 1) == 0) {
+			return pipe;
+		}
+	}
+	return -1;
+}
+
+static uint32_t NRF24L01_SimChecksum(const NRF24L01_SimPayload *payload) {
+	uint32_t checksum = 2166136261u; //FNV-1a
+	for (uint8_t i = 0; i < payload->size; i++) {
+		checksum = (checksum ^ payload->data[i]) * 16777619u;
+	}
+	return checksum ^ payload->size;
+}
+
+/* Chip state machine */
+
+static void NRF24L01_SimAbort(NRF24L01_SimChip *chip) {
+	if (chip->transmission != NULL) {
+		NRF24L01_SimCorrupt(chip->transmission);
+		chip->transmission = NULL;
+	}
+	NRF24L01_SimCancelTimer(chip);
+}
+
+//Starts what the pins and registers ask for once the radio is idle
+static void NRF24L01_SimEvaluate(NRF24L01_SimChip *chip, uint64_t now) {
+	uint8_t config = chip->registers[NRF24L01_REG_CONFIG];
+	bool primaryRx = config & NRF24L01_REG_CONFIG_PRIM_RX_BIT_MASK;
+	if (!(config & NRF24L01_REG_CONFIG_PWR_UP_BIT_MASK)) {
+		if (chip->state != CHIP_POWER_DOWN) {
+			NRF24L01_SimAbort(chip);
+			chip->state = CHIP_POWER_DOWN;
+		}
+		return;
+	}
+
+	switch (chip->state) {
+	case CHIP_POWER_DOWN:
+		chip->state = CHIP_START_UP;
+		NRF24L01_SimSetTimer(chip, now + NRF24L01_SIM_START_UP_TIME);
+		return;
+	case CHIP_RX_SETTLE:
+	case CHIP_RX:
+		if (chip->ce && primaryRx) {
+			return;
+		}
+		NRF24L01_SimCancelTimer(chip);
+		chip->state = CHIP_STANDBY;
+		break;
+	case CHIP_STANDBY:
+		break;
+	default:
+		return; //Start up, packet or ACK in progress completes first
+	}
+
+	if (!chip->ce) {
+		return; //Standby-I
+	}
+	if (primaryRx) {
+		chip->state = CHIP_RX_SETTLE;
+		NRF24L01_SimSetTimer(chip, now + NRF24L01_SIM_SETTLE_TIME);
+		return;
+	}
+	//Nothing is transmitted while MAX_RT is set, CE high with empty TX FIFO is Standby-II
+	if (NRF24L01_SimTxHead(chip) >= 0
+			&& !(chip->registers[NRF24L01_REG_STATUS] & NRF24L01_REG_STATUS_MAX_RT_BIT_MASK)) {
+		chip->state = CHIP_TX_SETTLE;
+		NRF24L01_SimSetTimer(chip, now + NRF24L01_SIM_SETTLE_TIME);
+	}
+}
+
+static void NRF24L01_SimTransmit(NRF24L01_SimChip *chip, int index, uint64_t now) {
+	NRF24L01_SimTransmission *packet = NRF24L01_SimStartPacket(chip, &chip->txFifo[index],
+			chip->addresses[NRF24L01_SIM_TX_ADDR_INDEX], chip->pid, false, now);
+	chip->stats.txPackets++;
+	chip->state = CHIP_TX;
+	NRF24L01_SimSetTimer(chip, packet->end);
+}
+
+//Settled after CE rising edge or previous packet, payload is taken from TX FIFO only now
+static void NRF24L01_SimSettledForTx(NRF24L01_SimChip *chip, uint64_t now) {
+	int index = NRF24L01_SimTxHead(chip);
+	if (index < 0) {
+		chip->state = CHIP_STANDBY;
+		NRF24L01_SimEvaluate(chip, now);
+		return;
+	}
+	//Payload left after MAX_RT keeps its PID, so receiver that got it drops the copy
+	if (chip->txFifo[index].serial != chip->txSerial) {
+		chip->txSerial = chip->txFifo[index].serial;
+		chip->pid = (chip->pid + 1) & 0x03;
+	}
+	chip->registers[NRF24L01_REG_OBSERVE_TX] &= 0xF0; //ARC_CNT counts retransmissions of this packet
+	NRF24L01_SimTransmit(chip, index, now);
+}
+
+static void NRF24L01_SimTransmitted(NRF24L01_SimChip *chip, uint64_t now) {
+	int index = NRF24L01_SimFindSerial(chip, chip->txSerial);
+	if (index >= 0 && !chip->reuse) {
+		NRF24L01_SimRemovePayload(chip->txFifo, &chip->txCount, index);
+	}
+	NRF24L01_SimSetFlags(chip, NRF24L01_REG_STATUS_TX_DS_BIT_MASK);
+	chip->state = CHIP_STANDBY;
+	NRF24L01_SimEvaluate(chip, now);
+}
+
+static void NRF24L01_SimPacketSent(NRF24L01_SimChip *chip, uint64_t now) {
+	NRF24L01_SimTransmission *packet = chip->transmission;
+	chip->transmission = NULL;
+	bool autoAck = chip->registers[NRF24L01_REG_EN_AA] & 0x01;
+	if (packet->payload.noAck || !autoAck) {
+		NRF24L01_SimTransmitted(chip, now);
+		return;
+	}
+	//ACK must arrive within ARD, retransmission starts when it elapses
+	uint8_t delay = chip->registers[NRF24L01_REG_SETUP_RETR] >> 4;
+	chip->state = CHIP_WAIT_ACK;
+	chip->listenStart = now;
+	NRF24L01_SimSetTimer(chip, now + (delay + 1) * NRF24L01_SIM_RETRANSMIT_DELAY_STEP);
+}
+
+static void NRF24L01_SimAckTimeout(NRF24L01_SimChip *chip, uint64_t now) {
+	uint8_t observe = chip->registers[NRF24L01_REG_OBSERVE_TX];
+	uint8_t count = chip->registers[NRF24L01_REG_SETUP_RETR] & 0x0F;
+	int index = NRF24L01_SimFindSerial(chip, chip->txSerial);
+	if ((observe & 0x0F) < count && index >= 0) {
+		chip->registers[NRF24L01_REG_OBSERVE_TX] = observe + 1;
+		NRF24L01_SimTransmit(chip, index, now);
+		return;
+	}
+
+	if ((observe >> 4) < 0x0F) {
+		chip->registers[NRF24L01_REG_OBSERVE_TX] = observe + 0x10;
+	}
+	chip->stats.maxRetransmits++;
+	NRF24L01_SimSetFlags(chip, NRF24L01_REG_STATUS_MAX_RT_BIT_MASK);
+	chip->state = CHIP_STANDBY;
+}
+
+static void NRF24L01_SimAckReceived(NRF24L01_SimChip *chip, const NRF24L01_SimTransmission *ack, uint64_t now) {
+	NRF24L01_SimCancelTimer(chip);
+	if (ack->payload.size > 0) {
+		NRF24L01_SimPushRx(chip, 0, &ack->payload);
+	}
+	NRF24L01_SimTransmitted(chip, now);
+}
+
+//ACK payload that was sent is known to be received once the transmitter moves on to a new PID
+static void NRF24L01_SimReleaseAckPayload(NRF24L01_SimChip *chip, uint8_t pipe) {
+	for (uint8_t i = 0; i < chip->txCount; i++) {
+		if (chip->txFifo[i].ack && chip->txFifo[i].pipe == pipe && chip->txFifo[i].sent) {
+			NRF24L01_SimRemovePayload(chip->txFifo, &chip->txCount, i);
+			NRF24L01_SimSetFlags(chip, NRF24L01_REG_STATUS_TX_DS_BIT_MASK);
+			return;
+		}
+	}
+}
+
+static void NRF24L01_SimReceive(NRF24L01_SimChip *chip, uint8_t pipe, const NRF24L01_SimTransmission *packet,
+		uint64_t now) {
+	uint8_t size = packet->payload.size;
+	bool valid = NRF24L01_SimDynamicPayload(chip, pipe) ?
+			size <= 32 : size == (chip->registers[NRF24L01_REG_RX_PW_P0 + pipe] & 0x3F);
+	if (!valid) {
+		return; //Length mismatch fails CRC
+	}
+
+	bool autoAck = (chip->registers[NRF24L01_REG_EN_AA] & (1 << pipe)) && !packet->payload.noAck;
+	uint32_t checksum = NRF24L01_SimChecksum(&packet->payload);
+	if (autoAck && chip->lastValid[pipe] && chip->lastPid[pipe] == packet->pid && chip->lastCrc[pipe] == checksum) {
+		chip->stats.duplicates++; //ACK was lost, acknowledged again
+	} else {
+		if (!NRF24L01_SimPushRx(chip, pipe, &packet->payload)) {
+			return; //Not acknowledged while RX FIFO is full
+		}
+		if (autoAck) {
+			chip->lastValid[pipe] = true;
+			chip->lastPid[pipe] = packet->pid;
+			chip->lastCrc[pipe] = checksum;
+			NRF24L01_SimReleaseAckPayload(chip, pipe);
+		}
+	}
+
+	if (autoAck) {
+		chip->state = CHIP_ACK_SETTLE;
+		chip->ackPid = packet->pid;
+		memcpy(chip->ackAddress, packet->address, 5);
+		chip->ackSerial = 0;
+		//ACK payload has to be pending when the packet arrives, a later one waits for the next packet
+		if (chip->registers[NRF24L01_REG_FEATURE] & NRF24L01_REG_FEATURE_ENABLE_ACK_PAYLOAD) {
+			for (uint8_t i = 0; i < chip->txCount; i++) {
+				if (chip->txFifo[i].ack && chip->txFifo[i].pipe == pipe) {
+					chip->ackSerial = chip->txFifo[i].serial;
+					break;
+				}
+			}
+		}
+		NRF24L01_SimSetTimer(chip, now + NRF24L01_SIM_SETTLE_TIME);
+	}
+}
+
+static void NRF24L01_SimSendAck(NRF24L01_SimChip *chip, uint64_t now) {
+	NRF24L01_SimPayload payload = { 0 };
+	int index = chip->ackSerial != 0 ? NRF24L01_SimFindSerial(chip, chip->ackSerial) : -1;
+	if (index >= 0) {
+		chip->txFifo[index].sent = true;
+		payload = chip->txFifo[index];
+	}
+	NRF24L01_SimTransmission *packet = NRF24L01_SimStartPacket(chip, &payload, chip->ackAddress, chip->ackPid, true,
+			now);
+	chip->stats.txAcks++;
+	chip->state = CHIP_ACK_TX;
+	NRF24L01_SimSetTimer(chip, packet->end);
+}
+
+static void NRF24L01_SimTimer(NRF24L01_SimChip *chip, uint64_t now) {
+	switch (chip->state) {
+	case CHIP_START_UP:
+		chip->state = CHIP_STANDBY;
+		NRF24L01_SimEvaluate(chip, now);
+		break;
+	case CHIP_TX_SETTLE:
+		NRF24L01_SimSettledForTx(chip, now);
+		break;
+	case CHIP_TX:
+		NRF24L01_SimPacketSent(chip, now);
+		break;
+	case CHIP_WAIT_ACK:
+		NRF24L01_SimAckTimeout(chip, now);
+		break;
+	case CHIP_RX_SETTLE:
+		chip->state = CHIP_RX;
+		chip->listenStart = now;
+		break;
+	case CHIP_ACK_SETTLE:
+		NRF24L01_SimSendAck(chip, now);
+		break;
+	case CHIP_ACK_TX:
+		chip->transmission = NULL;
+		chip->state = CHIP_STANDBY; //Back to RX through settling
+		NRF24L01_SimEvaluate(chip, now);
+		break;
+	default:
+		break;
+	}
+}
+
+static void NRF24L01_SimDeliver(NRF24L01_SimTransmission *packet, uint64_t now) {
+	packet->delivered = true;
+	for (size_t i = 0; i < radio.chipCount; i++) {
+		NRF24L01_SimChip *chip = radio.chips[i];
+		if (chip == packet->chip || !NRF24L01_SimInRange(packet->chip, chip)) {
+			continue;
+		}
+
+		if (packet->ack) {
+			//Waiting transmitter accepts ACK of its PID on pipe 0 address
+			if (chip->state != CHIP_WAIT_ACK || chip->pid != packet->pid || !NRF24L01_SimHears(chip, packet)
+					|| memcmp(chip->addresses[0], packet->address, packet->addressWidth) != 0
+					|| NRF24L01_SimCollides(packet, chip)) {
+				continue;
+			}
+			if (NRF24L01_SimLost(packet, chip, now)) {
+				chip->stats.lost++;
+				continue;
+			}
+			NRF24L01_SimAckReceived(chip, packet, now);
+			continue;
+		}
+
+		if (chip->state != CHIP_RX || !NRF24L01_SimHears(chip, packet)) {
+			continue;
+		}
+		int pipe = NRF24L01_SimMatchPipe(chip, packet);
+		if (pipe < 0 || NRF24L01_SimCollides(packet, chip)) {
+			continue;
+		}
+		if (NRF24L01_SimLost(packet, chip, now)) {
+			chip->stats.lost++;
+			continue;
+		}
+		NRF24L01_SimReceive(chip, pipe, packet, now);
+	}
+}
+
+void NRF24L01_SimRadioProcess(uint64_t until) {
+	while (radio.eventCount > 0 && radio.events[0].time <= until) {
+		NRF24L01_SimEvent event = NRF24L01_SimPopEvent();
+		radio.now = event.time;
+		if (event.transmission != NULL) {
+			NRF24L01_SimDeliver(event.transmission, event.time);
+		} else if (event.timer == event.chip->timer) {
+			NRF24L01_SimTimer(event.chip, event.time);
+		}
+	}
+}
+
+/* SPI and pins */
+
+void NRF24L01_SimChipSetCE(NRF24L01_SimChip *chip, bool level, uint64_t now) {
+	radio.now = now;
+	if (chip->ce == level) {
+		return;
+	}
+	chip->ce = level;
+	chip->changed = true;
+	NRF24L01_SimEvaluate(chip, now);
+}
+
+uint8_t NRF24L01_SimChipExchange(NRF24L01_SimChip *chip, uint8_t data, uint64_t now) {
+	radio.now = now;
+	if (chip->csn) {
+		return 0xFF; //Not selected, MISO floats
+	}
+	uint8_t index = chip->spiCount;
+	if (chip->spiCount < 0xFF) {
+		chip->spiCount++;
+	}
+	if (index == 0) {
+		chip->command = data;
+		return NRF24L01_SimStatus(chip); //STATUS is clocked out with every command
+	}
+
+	index--;
+	uint8_t command = chip->command;
+	if (command <= (NRF24L01_CMD_R_REGISTER | 0x1F)) {
+		return NRF24L01_SimReadRegister(chip, command & 0x1F, index, now);
+	}
+	if (command == NRF24L01_CMD_R_RX_PAYLOAD) {
+		return chip->rxCount > 0 && index < chip->rxFifo[0].size ? chip->rxFifo[0].data[index] : 0x00;
+	}
+	if (command == NRF24L01_CMD_R_RX_PL_WID) {
+		return chip->rxCount > 0 ? chip->rxFifo[0].size : 0x00;
+	}
+	if (index < sizeof(chip->spiData)) {
+		chip->spiData[index] = data;
+	}
+	return 0x00;
+}
+
+//Command is executed on CSN rising edge
+static void NRF24L01_SimExecute(NRF24L01_SimChip *chip, uint64_t now) {
+	uint8_t command = chip->command;
+	uint8_t size = chip->spiCount - 1;
+	if (size > sizeof(chip->spiData)) {
+		size = sizeof(chip->spiData);
+	}
+	uint8_t feature = chip->registers[NRF24L01_REG_FEATURE];
+
+	if (command >= NRF24L01_CMD_W_REGISTER && command <= (NRF24L01_CMD_W_REGISTER | 0x1F)) {
+		if (size > 0) {
+			NRF24L01_SimWriteRegister(chip, command & 0x1F, chip->spiData, size, now);
+			chip->changed = true;
+		}
+		return;
+	}
+
+	switch (command) {
+	case NRF24L01_CMD_R_RX_PAYLOAD:
+		if (size > 0 && chip->rxCount > 0) {
+			NRF24L01_SimRemovePayload(chip->rxFifo, &chip->rxCount, 0);
+			chip->changed = true;
+		}
+		return;
+	case NRF24L01_CMD_W_TX_PAYLOAD:
+		NRF24L01_SimPushTx(chip, chip->spiData, size, false, false, 0);
+		chip->reuse = false;
+		break;
+	case NRF24L01_CMD_W_TX_PAYLOAD_NOACK:
+		if (!(feature & NRF24L01_REG_FEATURE_ENABLE_DYNAMIC_ACK)) {
+			return; //Command is not recognized unless EN_DYN_ACK is set
+		}
+		NRF24L01_SimPushTx(chip, chip->spiData, size, true, false, 0);
+		chip->reuse = false;
+		break;
+	case NRF24L01_CMD_FLUSH_TX:
+		chip->txCount = 0;
+		chip->reuse = false;
+		break;
+	case NRF24L01_CMD_FLUSH_RX:
+		chip->rxCount = 0;
+		break;
+	case NRF24L01_CMD_REUSE_TX_PL:
+		chip->reuse = true;
+		break;
+	default:
+		if ((command & 0xF8) == NRF24L01_CMD_W_ACK_PAYLOAD && (command & 0x07) < 6) {
+			if (feature & NRF24L01_REG_FEATURE_ENABLE_ACK_PAYLOAD) {
+				NRF24L01_SimPushTx(chip, chip->spiData, size, false, true, command & 0x07);
+			}
+			break;
+		}
+		return; //NOP, R_RX_PL_WID and ACTIVATE(not needed by nRF24L01+) change nothing
+	}
+
+	chip->changed = true;
+	NRF24L01_SimEvaluate(chip, now); //CE may already be high
+}
+
+void NRF24L01_SimChipSetCSN(NRF24L01_SimChip *chip, bool level, uint64_t now) {
+	radio.now = now;
+	if (chip->csn == level) {
+		return;
+	}
+	chip->csn = level;
+	if (!level) {
+		chip->spiCount = 0;
+		chip->stats.spiTransactions++;
+		return;
+	}
+	if (chip->spiCount > 0) {
+		NRF24L01_SimExecute(chip, now);
+	}
+}
+
+/* Chips */
+
+static void NRF24L01_SimPowerOnReset(NRF24L01_SimChip *chip) {
+	static const uint8_t resetValues[NRF24L01_REG_FEATURE + 1] = { [NRF24L01_REG_CONFIG] = 0x08,
+			[NRF24L01_REG_EN_AA] = 0x3F, [NRF24L01_REG_EN_RXADDR] = 0x03, [NRF24L01_REG_SETUP_AW] = 0x03,
+			[NRF24L01_REG_SETUP_RETR] = 0x03, [NRF24L01_REG_RF_CH] = 0x02, [NRF24L01_REG_RF_SETUP] = 0x0E,
+			[NRF24L01_REG_STATUS] = 0x0E, [NRF24L01_REG_FIFO_STATUS] = 0x11 };
+	memcpy(chip->registers, resetValues, sizeof(resetValues));
+	memset(chip->addresses[0], 0xE7, 5);
+	memset(chip->addresses[1], 0xC2, 5);
+	for (uint8_t pipe = 2; pipe < 6; pipe++) {
+		chip->addresses[pipe][0] = 0xC1 + pipe;
+	}
+	memset(chip->addresses[NRF24L01_SIM_TX_ADDR_INDEX], 0xE7, 5);
+	chip->registers[NRF24L01_REG_STATUS] = 0x00; //Only flags are kept, RX_P_NO and TX_FULL come from FIFOs
+	chip->csn = true;
+	chip->state = CHIP_POWER_DOWN;
+	chip->irqAsserted = false;
+}
+
+NRF24L01_SimChip* NRF24L01_SimRadioAddChip(NRF24L01_SimNode *node) {
+	NRF24L01_SimChip *chip = calloc(1, sizeof(NRF24L01_SimChip));
+	radio.chips = NRF24L01_SimGrow(radio.chips, &radio.chipCapacity, radio.chipCount, sizeof(NRF24L01_SimChip*));
+	if (chip == NULL) {
+		fprintf(stderr, "NRF24L01_Sim: out of memory\n");
+		abort();
+	}
+
+	chip->index = radio.chipCount;
+	chip->node = node;
+	chip->port.chip = chip;
+	chip->spi.chip = chip;
+	NRF24L01_SimPowerOnReset(chip);
+	radio.chips[radio.chipCount++] = chip;
+	return chip;
+}
+
+void NRF24L01_SimRadioReset(const NRF24L01_SimAir *air) {
+	for (size_t i = 0; i < radio.chipCount; i++) {
+		free(radio.chips[i]);
+	}
+	for (size_t i = 0; i < radio.packetCount; i++) {
+		free(radio.packets[i]);
+	}
+	for (size_t i = 0; i < radio.spareCount; i++) {
+		free(radio.spare[i]);
+	}
+	free(radio.chips);
+	free(radio.events);
+	free(radio.packets);
+	free(radio.spare);
+	memset(&radio, 0, sizeof(radio));
+	radio.air = *air;
+	radio.random = air->seed != 0 ? air->seed : 1;
+}
+
+uint16_t NRF24L01_SimGetChipIndex(const NRF24L01_SimChip *chip) {
+	return chip->index;
+}
+
+uint64_t NRF24L01_SimGetIrqTime(const NRF24L01_SimChip *chip) {
+	return chip->irqFallTime;
+}
+
+NRF24L01_SimChipStats NRF24L01_SimGetChipStats(const NRF24L01_SimChip *chip) {
+	return chip->stats;
+}
@@ -0,0 +1,232 @@
+/**
+ * @brief Chip and air link model of nRF24L01+ host simulator (internal)
+ *
+ * Chips change state on pin and SPI activity of their node and on timed events(end of settling, end of a packet
+ * on the air, ACK timeout). Events are kept in one queue ordered by time and processed by the scheduler
+ * up to the time of the running node.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#ifndef NRF24L01_SIM_RADIO_H
+#define NRF24L01_SIM_RADIO_H
+
+#include "NRF24L01_Sim.h"
+
+#define NRF24L01_SIM_FIFO_DEPTH 3
+
+/**
+ * @brief Payload in TX or RX FIFO
+ *
+ * Fields:
+ * - size:   Payload size
+ * - data:   Payload
+ * - noAck:  Written with W_TX_PAYLOAD_NOACK
+ * - ack:    ACK payload written with W_ACK_PAYLOAD
+ * - pipe:   Pipe of ACK payload or received payload
+ * - sent:   ACK payload was sent, released by the next packet with a new PID
+ * - serial: Number of the write, identifies payload after FIFO changed
+ */
+typedef struct {
+	uint8_t size;
+	uint8_t data[32];
+	bool noAck;
+	bool ack;
+	uint8_t pipe;
+	bool sent;
+	uint32_t serial;
+} NRF24L01_SimPayload;
+
+typedef enum {
+	CHIP_POWER_DOWN = 0x00,
+	CHIP_START_UP,
+	CHIP_STANDBY,
+	CHIP_TX_SETTLE,
+	CHIP_TX,
+	CHIP_WAIT_ACK,
+	CHIP_RX_SETTLE,
+	CHIP_RX,
+	CHIP_ACK_SETTLE,
+	CHIP_ACK_TX
+} NRF24L01_SimChipState;
+
+/**
+ * @brief Packet on the air
+ *
+ * Fields:
+ * - chip:      Transmitting chip
+ * - start:     Time when the first bit is sent
+ * - end:       Time when the last bit is sent
+ * - channel:   RF channel
+ * - dataRate:  Data rate bits of RF_SETUP
+ * - rfPower:   RF power bits of RF_SETUP
+ * - addressWidth: Address width in bytes
+ * - crcSize:   CRC size in bytes
+ * - address:   Address(byte 0 is written first over SPI)
+ * - payload:   Payload
+ * - pid:       Packet identification of the control field
+ * - ack:       ACK packet
+ * - corrupted: Overlapped by another packet on the same channel(at every chip, without range callback) or cut
+ *              by power down
+ * - collided:  Counted in collisions of the transmitting chip
+ * - delivered: Packet reached receivers, kept for a while to detect overlaps
+ */
+typedef struct {
+	NRF24L01_SimChip *chip;
+	uint64_t start;
+	uint64_t end;
+	uint8_t channel;
+	uint8_t dataRate;
+	uint8_t rfPower;
+	uint8_t addressWidth;
+	uint8_t crcSize;
+	uint8_t address[5];
+	NRF24L01_SimPayload payload;
+	uint8_t pid;
+	bool ack;
+	bool corrupted;
+	bool collided;
+	bool delivered;
+} NRF24L01_SimTransmission;
+
+/**
+ * @brief Simulated chip
+ *
+ * Fields:
+ * - index:        Index in order of creation
+ * - node:         Node the chip is wired to
+ * - port:         GPIO port with CE, CSN and IRQ pins
+ * - spi:          SPI bus
+ * - irqMode:      How IRQ pin is wired
+ * - ce:           CE pin level
+ * - csn:          CSN pin level
+ * - command:      Command of current SPI transaction
+ * - spiCount:     Bytes clocked in current SPI transaction, including command
+ * - spiData:      Data bytes written in current SPI transaction
+ * - changed:      Chip was changed by SPI or pins since the node last checked
+ * - registers:    Register file, address registers are kept in addresses
+ * - addresses:    RX_ADDR_P0-P5 and TX_ADDR, byte 0 is written first
+ * - txFifo:       TX FIFO, payloads and ACK payloads
+ * - txCount:      Payloads in TX FIFO
+ * - reuse:        REUSE_TX_PL is active
+ * - rxFifo:       RX FIFO
+ * - rxCount:      Payloads in RX FIFO
+ * - serial:       Number of payload writes
+ * - state:        Radio state
+ * - timer:        Generation of pending timed event, older events are stale
+ * - listenStart:  Time from which receiver listens
+ * - pid:          PID of the last new packet
+ * - txSerial:     Serial of payload being transmitted
+ * - transmission: Packet being transmitted
+ * - lastPid:      PID of the last received packet per pipe
+ * - lastCrc:      Checksum of the last received packet per pipe
+ * - lastValid:    lastPid and lastCrc are set
+ * - ackPid:       PID of packet to acknowledge
+ * - ackAddress:   Address of packet to acknowledge
+ * - ackSerial:    Serial of ACK payload pending when the packet arrived, 0 for empty ACK
+ * - irqAsserted:  IRQ pin is low
+ * - irqFallTime:  Time of the last falling edge of IRQ pin
+ * - extiPending:  Falling edge of IRQ pin waits for interrupt dispatch
+ * - dmaActive:    DMA transfer in progress
+ * - dmaDone:      Time when DMA transfer completes
+ * - stats:        Air link statistics
+ */
+struct NRF24L01_SimChip {
+	uint16_t index;
+	NRF24L01_SimNode *node;
+	GPIO_TypeDef port;
+	SPI_HandleTypeDef spi;
+	NRF24L01_SimIrqMode irqMode;
+	bool ce;
+	bool csn;
+	uint8_t command;
+	uint8_t spiCount;
+	uint8_t spiData[32];
+	bool changed;
+	uint8_t registers[NRF24L01_REG_FEATURE + 1];
+	uint8_t addresses[7][5];
+	NRF24L01_SimPayload txFifo[NRF24L01_SIM_FIFO_DEPTH];
+	uint8_t txCount;
+	bool reuse;
+	NRF24L01_SimPayload rxFifo[NRF24L01_SIM_FIFO_DEPTH];
+	uint8_t rxCount;
+	uint32_t serial;
+	NRF24L01_SimChipState state;
+	uint32_t timer;
+	uint64_t listenStart;
+	uint8_t pid;
+	uint32_t txSerial;
+	NRF24L01_SimTransmission *transmission;
+	uint8_t lastPid[6];
+	uint32_t lastCrc[6];
+	bool lastValid[6];
+	uint8_t ackPid;
+	uint8_t ackAddress[5];
+	uint32_t ackSerial;
+	bool irqAsserted;
+	uint64_t irqFallTime;
+	bool extiPending;
+	bool dmaActive;
+	uint64_t dmaDone;
+	NRF24L01_SimChipStats stats;
+};
+
+/**
+ * @brief Release chips, pending events and packets on the air and apply air link configuration
+ *
+ * @param air Air link configuration
+ */
+void NRF24L01_SimRadioReset(const NRF24L01_SimAir *air);
+
+/**
+ * @brief Create chip in power on reset state
+ *
+ * @param node Node the chip is wired to
+ * @return Chip handle
+ */
+NRF24L01_SimChip* NRF24L01_SimRadioAddChip(NRF24L01_SimNode *node);
+
+/**
+ * @brief Process events up to given time
+ *
+ * @param until Time in ns
+ */
+void NRF24L01_SimRadioProcess(uint64_t until);
+
+/**
+ * @brief Get time of the next pending event
+ *
+ * @return Time in ns, UINT64_MAX if there is none
+ */
+uint64_t NRF24L01_SimRadioNextEvent(void);
+
+/**
+ * @brief Drive CSN pin
+ *
+ * @param chip Chip handle
+ * @param level New level, rising edge executes the command
+ * @param now Current time in ns
+ */
+void NRF24L01_SimChipSetCSN(NRF24L01_SimChip *chip, bool level, uint64_t now);
+
+/**
+ * @brief Drive CE pin
+ *
+ * @param chip Chip handle
+ * @param level New level
+ * @param now Current time in ns
+ */
+void NRF24L01_SimChipSetCE(NRF24L01_SimChip *chip, bool level, uint64_t now);
+
+/**
+ * @brief Clock one byte through SPI while CSN is low
+ *
+ * @param chip Chip handle
+ * @param data Byte sent to the chip
+ * @param now Current time in ns
+ * @return Byte received from the chip
+ */
+uint8_t NRF24L01_SimChipExchange(NRF24L01_SimChip *chip, uint8_t data, uint64_t now);
+
+#endif // NRF24L01_SIM_RADIO_H
@@ -0,0 +1,91 @@
+/**
+ * @brief STM32 HAL surface of nRF24L01+ library for host simulation
+ *
+ * Selected with -DNRF24L01_HAL_HEADER=\"sim_hal.h\". Every call is served by the simulator(NRF24L01_Sim.h):
+ * GPIO ports and SPI handles belong to simulated chips, time is the simulated time of the calling node
+ * and interrupts are simulated per node.
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct NRF24L01_SimChip NRF24L01_SimChip;
+
+typedef enum {
+	HAL_OK = 0x00,
+	HAL_ERROR = 0x01,
+	HAL_BUSY = 0x02,
+	HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+typedef enum {
+	GPIO_PIN_RESET = 0,
+	GPIO_PIN_SET
+} GPIO_PinState;
+
+/**
+ * @brief GPIO port wired to CE, CSN and IRQ pins of one simulated chip
+ */
+typedef struct {
+	NRF24L01_SimChip *chip;
+} GPIO_TypeDef;
+
+/**
+ * @brief SPI bus wired to one simulated chip
+ */
+typedef struct {
+	NRF24L01_SimChip *chip;
+} SPI_HandleTypeDef;
+
+typedef struct {
+	volatile uint32_t CTRL;
+	volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+	volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+//Every access reads the cycle counter of the calling node
+#define DWT (NRF24L01_SimDWT())
+#define CoreDebug (NRF24L01_SimCoreDebug())
+
+extern uint32_t SystemCoreClock;
+
+DWT_Type* NRF24L01_SimDWT(void);
+CoreDebug_Type* NRF24L01_SimCoreDebug(void);
+
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+//Sleeps until the calling node takes an interrupt
+void __WFI(void);
+
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t delay);
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *port, uint16_t pin);
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *data, uint16_t size, uint32_t timeout);
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *data, uint16_t size, uint32_t timeout);
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef *hspi, uint8_t *txData, uint8_t *rxData, uint16_t size,
+		uint32_t timeout);
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA(SPI_HandleTypeDef *hspi, uint8_t *txData, uint8_t *rxData,
+		uint16_t size);
+
+//Interrupt callbacks, called in context of the node the interrupt belongs to. Empty by default.
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin);
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi);
+
+#endif // SIM_HAL_H
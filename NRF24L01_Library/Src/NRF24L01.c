@@ -6,55 +6,112 @@
  */
 
 #include "NRF24L01.h"
+#include "NRF24L01_Compression.h"
 
-static NRF24L01_Instance cache[NRF24L01_DEVICES];
-static uint8_t cacheSize = 0;
 static uint8_t ticksPerUs = 0;
 
+//Blocking SPI transaction marks the instance busy, NRF24L01_IRQHandler defers its event until the transaction ends
+//instead of using SPI and the scratch buffer in the middle of it. Other interrupts and radios stay unaffected.
 static void NRF24L01_CSNLow(NRF24L01_Device *device) {
+	device->instance.spiBusy = true;
 	HAL_GPIO_WritePin(device->CSN_Port, device->CSN_Pin, GPIO_PIN_RESET);
+	device->instance.stats.spiTransactions++; //Every SPI transaction starts here
 }
 
 static void NRF24L01_CSNHigh(NRF24L01_Device *device) {
+	NRF24L01_Instance *instance = &device->instance;
 	HAL_GPIO_WritePin(device->CSN_Port, device->CSN_Pin, GPIO_PIN_SET);
+	instance->spiBusy = false;
+
+	//Handle interrupt that arrived during the transaction
+	if (instance->irqPending) {
+		instance->irqPending = false;
+		NRF24L01_IRQHandler(device);
+	}
 }
 
-static void NRF24L01_CELow(NRF24L01_Device *device) {
-	HAL_GPIO_WritePin(device->CE_Port, device->CE_Pin, GPIO_PIN_RESET);
+//DMA transfer keeps interrupts enabled as its completion is an interrupt, NRF24L01_IRQHandler defers events
+//until it completes
+static void NRF24L01_CSNLowDMA(NRF24L01_Device *device) {
+	HAL_GPIO_WritePin(device->CSN_Port, device->CSN_Pin, GPIO_PIN_RESET);
+	device->instance.stats.spiTransactions++;
 }
 
-static void NRF24L01_CEHigh(NRF24L01_Device *device) {
-	HAL_GPIO_WritePin(device->CE_Port, device->CE_Pin, GPIO_PIN_SET);
+static void NRF24L01_CSNHighDMA(NRF24L01_Device *device) {
+	HAL_GPIO_WritePin(device->CSN_Port, device->CSN_Pin, GPIO_PIN_SET);
 }
 
-static void NRF24L01_ReadRegister(NRF24L01_Device *device, uint8_t address, uint8_t *buffer, uint8_t size) {
-	uint8_t command = NRF24L01_CMD_R_REGISTER | address;
-	uint8_t *request = malloc(size + 1);
-	uint8_t *response = malloc(size + 1);
-	request[0] = command;
-	memset(&request[1], NRF24L01_CMD_DUMMY_LOAD, size);
-	memset(response, 0, size + 1);
+static NRF24L01_Instance* NRF24L01_GetInstance(NRF24L01_Device *device) {
+	return &device->instance;
+}
+
+//Writable registers kept in shadow copy
+static const uint8_t shadowedRegisters[] = { NRF24L01_REG_CONFIG, NRF24L01_REG_EN_AA, NRF24L01_REG_EN_RXADDR,
+		NRF24L01_REG_SETUP_AW, NRF24L01_REG_SETUP_RETR, NRF24L01_REG_RF_CH, NRF24L01_REG_RF_SETUP,
+		NRF24L01_REG_RX_ADDR_P0, NRF24L01_REG_RX_ADDR_P1, NRF24L01_REG_RX_ADDR_P2, NRF24L01_REG_RX_ADDR_P3,
+		NRF24L01_REG_RX_ADDR_P4, NRF24L01_REG_RX_ADDR_P5, NRF24L01_REG_TX_ADDR, NRF24L01_REG_RX_PW_P0,
+		NRF24L01_REG_RX_PW_P1, NRF24L01_REG_RX_PW_P2, NRF24L01_REG_RX_PW_P3, NRF24L01_REG_RX_PW_P4,
+		NRF24L01_REG_RX_PW_P5, NRF24L01_REG_DYNPD, NRF24L01_REG_FEATURE };
+
+//Returns shadow copy of register and its size, NULL if register is not shadowed
+static uint8_t* NRF24L01_GetShadowRegister(NRF24L01_Instance *instance, uint8_t address, uint8_t *size) {
+	*size = 1;
+	switch (address) {
+	case NRF24L01_REG_RX_ADDR_P0:
+		*size = 5;
+		return instance->addressRegisters[0];
+	case NRF24L01_REG_RX_ADDR_P1:
+		*size = 5;
+		return instance->addressRegisters[1];
+	case NRF24L01_REG_TX_ADDR:
+		*size = 5;
+		return instance->addressRegisters[2];
+	case NRF24L01_REG_STATUS:
+	case NRF24L01_REG_OBSERVE_TX:
+	case NRF24L01_REG_RPD:
+	case NRF24L01_REG_FIFO_STATUS:
+		return NULL;
+	default:
+		return address <= NRF24L01_REG_FEATURE ? &instance->registers[address] : NULL;
+	}
+}
 
+static void NRF24L01_ReadRegister(NRF24L01_Device *device, uint8_t address, uint8_t *buffer, uint8_t size) {
+	uint8_t *spiBuffer = NRF24L01_GetInstance(device)->spiBuffer;
 	NRF24L01_CSNLow(device);
-	HAL_SPI_TransmitReceive(device->hspi, request, response, size + 1, 50);
+	spiBuffer[0] = NRF24L01_CMD_R_REGISTER | address;
+	memset(&spiBuffer[1], NRF24L01_CMD_DUMMY_LOAD, size);
+	HAL_SPI_TransmitReceive(device->hspi, spiBuffer, spiBuffer, size + 1, 50);
+	memcpy(buffer, &spiBuffer[1], size);
 	NRF24L01_CSNHigh(device);
-
-	memcpy(buffer, &response[1], size);
-	free(request);
-	free(response);
 }
 
 static void NRF24L01_WriteRegister(NRF24L01_Device *device, uint8_t address, const uint8_t *data, uint8_t size) {
-	uint8_t command = NRF24L01_CMD_W_REGISTER | address;
-	uint8_t *request = malloc(size + 1);
-	request[0] = command;
-	memcpy(&request[1], data, size);
-
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	uint8_t *spiBuffer = instance->spiBuffer;
 	NRF24L01_CSNLow(device);
-	HAL_SPI_Transmit(device->hspi, request, size + 1, 50);
+	spiBuffer[0] = NRF24L01_CMD_W_REGISTER | address;
+	memcpy(&spiBuffer[1], data, size);
+	HAL_SPI_Transmit(device->hspi, spiBuffer, size + 1, 50);
 	NRF24L01_CSNHigh(device);
 
-	free(request);
+	//Update shadow copy, address registers narrower than 5 bytes keep their remaining bytes
+	uint8_t shadowSize;
+	uint8_t *shadow = NRF24L01_GetShadowRegister(instance, address, &shadowSize);
+	if (shadow != NULL) {
+		memcpy(shadow, data, size < shadowSize ? size : shadowSize);
+	}
+}
+
+//Loads shadow copy from radio registers
+static void NRF24L01_SyncRegisters(NRF24L01_Device *device) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	uint8_t size;
+	uint8_t *shadow;
+	for (uint8_t i = 0; i < sizeof(shadowedRegisters); i++) {
+		shadow = NRF24L01_GetShadowRegister(instance, shadowedRegisters[i], &size);
+		NRF24L01_ReadRegister(device, shadowedRegisters[i], shadow, size);
+	}
 }
 
 static void NRF24L01_SendCommand(NRF24L01_Device *device, uint8_t command) {
@@ -63,29 +120,12 @@ static void NRF24L01_SendCommand(NRF24L01_Device *device, uint8_t command) {
 	NRF24L01_CSNHigh(device);
 }
 
-static NRF24L01_Instance* NRF24L01_GetInstanceCache(NRF24L01_Device *device) {
-	for (int i = 0; i < cacheSize; i++) {
-		NRF24L01_Instance *cachedInstance = &cache[i];
-		if (cachedInstance->device == device) {
-			return cachedInstance;
-		}
-	}
-	return NULL;
-}
-
-static void NRF24L01_PutConfigCache(NRF24L01_Device *device, NRF24L01_Config *config) {
-	for (int i = 0; i < cacheSize; i++) {
-		NRF24L01_Device *cachedDevice = cache[i].device;
-		if (cachedDevice == device) {
-			cache[i].config = config;
-			cache[i].mode = 0xFF;
-			return;
-		}
-	}
-	cache[cacheSize].device = device;
-	cache[cacheSize].config = config;
-	cache[cacheSize].mode = 0xFF;
-	cacheSize++;
+static void NRF24L01_InitInstance(NRF24L01_Device *device, NRF24L01_Config *config) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	instance->device = device;
+	instance->config = config;
+	instance->mode = 0xFF;
+	instance->processState = PROCESS_READY;
 }
 
 static void NRF24L01_InitDWT(void) {
@@ -103,49 +143,121 @@ static void NRF24L01_DelayUs(uint32_t us) {
 		;
 }
 
-static void NRF24L01_PowerUp(NRF24L01_Device *device) {
-	uint8_t config;
-	NRF24L01_ReadRegister(device, NRF24L01_REG_CONFIG, &config, 1);
+//Accounts time spent in previous power state. Interval longer than DWT counter period is measured in ms.
+static void NRF24L01_SetPowerState(NRF24L01_Instance *instance, NRF24L01_PowerState state) {
+	uint32_t tick = HAL_GetTick();
+	uint32_t cycles = DWT->CYCCNT;
+	uint32_t elapsedMs = tick - instance->powerStateTick;
+	if (ticksPerUs != 0 && elapsedMs < UINT32_MAX / SystemCoreClock * 1000 / 2) {
+		instance->powerStats.timeInState[instance->powerState] += (cycles - instance->powerStateCycles) / ticksPerUs;
+	} else {
+		instance->powerStats.timeInState[instance->powerState] += (uint64_t) elapsedMs * 1000;
+	}
+	instance->powerState = state;
+	instance->powerStateTick = tick;
+	instance->powerStateCycles = cycles;
+}
+
+static bool NRF24L01_IsPoweredUp(NRF24L01_Instance *instance) {
+	return instance->registers[NRF24L01_REG_CONFIG] & NRF24L01_REG_CONFIG_PWR_UP_BIT_MASK;
+}
+
+static void NRF24L01_CELow(NRF24L01_Device *device) {
+	HAL_GPIO_WritePin(device->CE_Port, device->CE_Pin, GPIO_PIN_RESET);
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (instance->powerState == POWER_STATE_ACTIVE) {
+		NRF24L01_SetPowerState(instance, POWER_STATE_STANDBY);
+	}
+}
+
+static void NRF24L01_CEHigh(NRF24L01_Device *device) {
+	HAL_GPIO_WritePin(device->CE_Port, device->CE_Pin, GPIO_PIN_SET);
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (instance->powerState == POWER_STATE_STANDBY) {
+		NRF24L01_SetPowerState(instance, POWER_STATE_ACTIVE);
+	}
+}
+
+//Sets PWR_UP bit, returns false if radio is already powered up(e.g. kept in Standby-I by idle timeout)
+static bool NRF24L01_StartPowerUp(NRF24L01_Device *device) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (NRF24L01_IsPoweredUp(instance)) {
+		return false;
+	}
+
+	uint8_t config = instance->registers[NRF24L01_REG_CONFIG];
 	config |= NRF24L01_REG_CONFIG_PWR_UP_BIT_MASK;
 	NRF24L01_WriteRegister(device, NRF24L01_REG_CONFIG, &config, 1);
-	NRF24L01_DelayUs(4500); //Worst case scenario(External crystal, Ls = 90mH)
+	instance->powerUpCycles = DWT->CYCCNT;
+	return true;
+}
+
+//Worst case is used if not set: external crystal, Ls = 90mH
+static uint32_t NRF24L01_GetPowerUpDelay(NRF24L01_Device *device) {
+	return device->powerUpDelay != 0 ? device->powerUpDelay : 4500;
+}
+
+static bool NRF24L01_PowerUpElapsed(NRF24L01_Device *device) {
+	return (DWT->CYCCNT - NRF24L01_GetInstance(device)->powerUpCycles)
+			>= NRF24L01_GetPowerUpDelay(device) * ticksPerUs;
+}
+
+static void NRF24L01_FinishPowerUp(NRF24L01_Instance *instance) {
+	instance->powerStats.powerUps++;
+	NRF24L01_SetPowerState(instance, POWER_STATE_STANDBY);
+}
+
+static void NRF24L01_PowerUp(NRF24L01_Device *device) {
+	if (NRF24L01_StartPowerUp(device)) {
+		NRF24L01_DelayUs(NRF24L01_GetPowerUpDelay(device));
+		NRF24L01_FinishPowerUp(NRF24L01_GetInstance(device));
+	}
 }
 
 static void NRF24L01_PowerDown(NRF24L01_Device *device) {
-	uint8_t config;
-	NRF24L01_ReadRegister(device, NRF24L01_REG_CONFIG, &config, 1);
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	uint8_t config = instance->registers[NRF24L01_REG_CONFIG];
 	config &= ~NRF24L01_REG_CONFIG_PWR_UP_BIT_MASK;
 	NRF24L01_WriteRegister(device, NRF24L01_REG_CONFIG, &config, 1);
+	NRF24L01_SetPowerState(instance, POWER_STATE_POWER_DOWN);
 }
 
-static void NRF24L01_ReceiveMode(NRF24L01_Device *device) {
-	//Bypass already configured receive mode
-	NRF24L01_Instance *instance = NRF24L01_GetInstanceCache(device);
-	if (instance->mode == 0x01) {
-		return;
+//Called when transaction is finished in power down mode, radio stays in Standby-I if idle timeout is used
+static void NRF24L01_EnterIdle(NRF24L01_Device *device) {
+	NRF24L01_GetInstance(device)->lastActivityTick = HAL_GetTick();
+	if (device->powerDownIdleTimeout == 0) {
+		NRF24L01_PowerDown(device);
+	}
+}
+
+//Writes PRIM_RX bit, returns false if mode is already configured
+static bool NRF24L01_SetMode(NRF24L01_Device *device, uint8_t mode) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (instance->mode == mode) {
+		return false;
 	}
 
-	uint8_t config;
-	NRF24L01_ReadRegister(device, NRF24L01_REG_CONFIG, &config, 1);
-	config |= NRF24L01_REG_CONFIG_PRIM_RX_BIT_MASK;
+	uint8_t config = instance->registers[NRF24L01_REG_CONFIG];
+	if (mode == 0x01) {
+		config |= NRF24L01_REG_CONFIG_PRIM_RX_BIT_MASK;
+	} else {
+		config &= ~NRF24L01_REG_CONFIG_PRIM_RX_BIT_MASK;
+	}
 	NRF24L01_WriteRegister(device, NRF24L01_REG_CONFIG, &config, 1);
-	instance->mode = 0x01;
-	NRF24L01_DelayUs(130); //Standby modes -> TX/RX mode
+	instance->mode = mode;
+	return true;
 }
 
-static void NRF24L01_TransmitMode(NRF24L01_Device *device) {
-	//Bypass already configured receive mode
-	NRF24L01_Instance *instance = NRF24L01_GetInstanceCache(device);
-	if (instance->mode == 0x00) {
-		return;
+static void NRF24L01_ReceiveMode(NRF24L01_Device *device) {
+	if (NRF24L01_SetMode(device, 0x01)) {
+		NRF24L01_DelayUs(130); //Standby modes -> TX/RX mode
 	}
+}
 
-	uint8_t config;
-	NRF24L01_ReadRegister(device, NRF24L01_REG_CONFIG, &config, 1);
-	config &= ~NRF24L01_REG_CONFIG_PRIM_RX_BIT_MASK;
-	NRF24L01_WriteRegister(device, NRF24L01_REG_CONFIG, &config, 1);
-	instance->mode = 0x00;
-	NRF24L01_DelayUs(130); //Standby modes -> TX/RX mode
+static void NRF24L01_TransmitMode(NRF24L01_Device *device) {
+	if (NRF24L01_SetMode(device, 0x00)) {
+		NRF24L01_DelayUs(130); //Standby modes -> TX/RX mode
+	}
 }
 
 static uint8_t NRF24L01_ResolveAddressWidth(ADDRESS_WIDTH addressWidth) {
@@ -168,7 +280,7 @@ static void NRF24L01_ConvertAddress(uint64_t address, uint8_t *buffer, uint8_t s
 }
 
 static uint8_t NRF24L01_GetReceivedPayloadSizeForPipe(NRF24L01_Device *device, uint8_t index) {
-	NRF24L01_RxPipe *cachedPipesConfig = NRF24L01_GetInstanceCache(device)->config->rxPipes;
+	NRF24L01_RxPipe *cachedPipesConfig = NRF24L01_GetInstance(device)->config->rxPipes;
 	NRF24L01_RxPipe pipeConfig = { 0 };
 	uint8_t payloadSize = 0x00;
 	for (int i = 0; i < 6; ++i) {
@@ -205,6 +317,40 @@ static void NRF24L01_ResetStatus(NRF24L01_Device *device) {
 	NRF24L01_WriteRegister(device, NRF24L01_REG_STATUS, &resetFlags, 1);
 }
 
+//Returns true if IRQ pin is asserted(active low). Without IRQ pin connected STATUS must be polled, so returns true.
+static bool NRF24L01_IRQAsserted(NRF24L01_Device *device) {
+	if (device->IRQ_Port == NULL) {
+		return true;
+	}
+	return HAL_GPIO_ReadPin(device->IRQ_Port, device->IRQ_Pin) == GPIO_PIN_RESET;
+}
+
+//Writes command followed by payload straight from caller's buffer under one CSN assertion, nothing is copied
+static void NRF24L01_WritePayload(NRF24L01_Device *device, uint8_t command, const uint8_t *data, uint8_t size) {
+	NRF24L01_CSNLow(device);
+	HAL_SPI_Transmit(device->hspi, &command, 1, 50);
+	if (size > 0) {
+		HAL_SPI_Transmit(device->hspi, (uint8_t*) data, size, 50);
+	}
+	NRF24L01_CSNHigh(device);
+}
+
+//Reads top RX FIFO payload straight into buffer(at least 32 bytes) and returns its size.
+//Returns 0 if payload size is invalid, RX FIFO is flushed in this case.
+static uint8_t NRF24L01_ReadPayload(NRF24L01_Device *device, uint8_t pipe, uint8_t *buffer) {
+	uint8_t command = NRF24L01_CMD_R_RX_PAYLOAD;
+	uint8_t payloadSize = NRF24L01_GetReceivedPayloadSizeForPipe(device, pipe);
+	if (payloadSize == 0 || payloadSize > 32) {
+		NRF24L01_SendCommand(device, NRF24L01_CMD_FLUSH_RX); //Corrupted payload, must be discarded
+		return 0;
+	}
+	NRF24L01_CSNLow(device);
+	HAL_SPI_Transmit(device->hspi, &command, 1, 50);
+	HAL_SPI_Receive(device->hspi, buffer, payloadSize, 50); //Clocked out bytes are ignored by the radio
+	NRF24L01_CSNHigh(device);
+	return payloadSize;
+}
+
 static void NRF24L01_UpdateStatistic(NRF24L01_Device *device) {
 	if (!device->enableStatistics) {
 		return;
@@ -215,11 +361,157 @@ static void NRF24L01_UpdateStatistic(NRF24L01_Device *device) {
 	NRF24L01_ReadRegister(device, NRF24L01_REG_OBSERVE_TX, &data, 1);
 	device->packetsLost += data >> 4;
 	device->packetsRetransmitted += data & 0x0F;
+	NRF24L01_GetInstance(device)->stats.retransmitHistogram[data & 0x0F]++;
+
+	//Reset PLOS_CNT(only by writing RF_CH), ARC_CNT is reset by every new transmission
+	if (data >> 4) {
+		uint8_t rfChannel = NRF24L01_GetInstance(device)->registers[NRF24L01_REG_RF_CH];
+		NRF24L01_WriteRegister(device, NRF24L01_REG_RF_CH, &rfChannel, 1);
+	}
+}
+
+static void NRF24L01_RecordReception(NRF24L01_Instance *instance, uint8_t pipe, uint8_t size) {
+	instance->stats.rxPackets[pipe]++;
+	instance->stats.rxBytes[pipe] += size;
+}
+
+//Pulses CE to send payload written into TX FIFO and remembers when transmission started
+static void NRF24L01_StartTransmission(NRF24L01_Device *device, uint8_t size) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	instance->txSize = size;
+	instance->txStartCycles = DWT->CYCCNT;
+	NRF24L01_CEHigh(device);
+	NRF24L01_DelayUs(10);
+	NRF24L01_CELow(device);
+}
+
+//Records result of single packet transmission started with NRF24L01_StartTransmission
+static void NRF24L01_FinishTransmission(NRF24L01_Instance *instance, bool sent) {
+	if (!sent) {
+		instance->stats.txFailed++;
+		return;
+	}
+
+	uint32_t latency = ticksPerUs != 0 ? (DWT->CYCCNT - instance->txStartCycles) / ticksPerUs : 0;
+	NRF24L01_Stats *stats = &instance->stats;
+	stats->txPackets++;
+	stats->txBytes += instance->txSize;
+	if (stats->latencyCount == 0 || latency < stats->latencyMin) {
+		stats->latencyMin = latency;
+	}
+	if (latency > stats->latencyMax) {
+		stats->latencyMax = latency;
+	}
+	stats->latencyTotal += latency;
+	stats->latencyCount++;
+}
+
+//Returns free slot of queue to read payload into, NULL if queue is full
+static NRF24L01_Packet* NRF24L01_ReservePacket(NRF24L01_RxQueue *queue) {
+	if ((uint8_t) (queue->tail - queue->head) == NRF24L01_RX_QUEUE_DEPTH) {
+		return NULL;
+	}
+	return &queue->packets[queue->tail % NRF24L01_RX_QUEUE_DEPTH];
+}
+
+//Publishes slot returned by NRF24L01_ReservePacket
+static void NRF24L01_CommitPacket(NRF24L01_Instance *instance, NRF24L01_RxQueue *queue, uint8_t pipe, uint8_t size) {
+	NRF24L01_Packet *packet = &queue->packets[queue->tail % NRF24L01_RX_QUEUE_DEPTH];
+	packet->pipe = pipe;
+	packet->size = size;
+	queue->tail++; //Published last, queue is shared with NRF24L01_IRQHandler
+
+	uint8_t count = queue->tail - queue->head;
+	if (queue != &instance->ackQueue && count > instance->stats.rxQueueHighWater[pipe]) {
+		instance->stats.rxQueueHighWater[pipe] = count;
+	}
+}
+
+//Takes the oldest packet out of queue
+static bool NRF24L01_TakePacket(NRF24L01_RxQueue *queue, NRF24L01_Packet *packet) {
+	if (queue->head == queue->tail) {
+		return false;
+	}
+
+	*packet = queue->packets[queue->head % NRF24L01_RX_QUEUE_DEPTH];
+	queue->head++;
+	return true;
+}
+
+//Copies data of the oldest packet of given pipe straight into caller's buffer, returns its size or 0 if none
+static uint8_t NRF24L01_TakePayload(NRF24L01_Instance *instance, uint8_t pipe, uint8_t *buffer) {
+	uint8_t size = 0;
+	if (pipe == NRF24L01_ANY_PIPE) {
+		for (uint8_t i = 0; i < 6 && size == 0; i++) {
+			size = NRF24L01_TakePayload(instance, i, buffer);
+		}
+		return size;
+	}
+
+	NRF24L01_RxQueue *queue = &instance->rxQueues[pipe];
+	if (queue->head == queue->tail) {
+		return 0;
+	}
+
+	NRF24L01_Packet *packet = &queue->packets[queue->head % NRF24L01_RX_QUEUE_DEPTH];
+	size = packet->size;
+	memcpy(buffer, packet->data, size);
+	queue->head++;
+	return size;
+}
+
+//Returns number of packets in all RX queues
+static uint8_t NRF24L01_CountPackets(NRF24L01_Instance *instance) {
+	uint8_t count = 0;
+	for (int i = 0; i < 6; i++) {
+		count += (uint8_t) (instance->rxQueues[i].tail - instance->rxQueues[i].head);
+	}
+	return count;
+}
+
+//Reads every payload in RX FIFO. STATUS must be read right before the call.
+//Payloads are delivered to onPacketReceived callback if useCallback is true and it is registered, queued otherwise.
+//In TX mode only ACK payloads can be received, they are always put into ACK payload queue.
+static void NRF24L01_DrainRxFifo(NRF24L01_Device *device, STATUS_Register status, bool useCallback) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	bool ackPayloads = instance->mode == 0x00;
+	bool deliver = useCallback && !ackPayloads && instance->callbacks.onPacketReceived != NULL;
+	NRF24L01_RxQueue *queue;
+	NRF24L01_Packet *packet;
+	uint8_t *buffer;
+	uint8_t payloadSize;
+	uint8_t count = 0;
+	while (status.rxPipeNumber <= 5) {
+		//Queued payloads are read straight into their queue slot, scratch buffer is used for callback and overflow
+		queue = ackPayloads ? &instance->ackQueue : &instance->rxQueues[status.rxPipeNumber];
+		packet = deliver ? NULL : NRF24L01_ReservePacket(queue);
+		buffer = packet != NULL ? packet->data : &instance->spiBuffer[1];
+		payloadSize = NRF24L01_ReadPayload(device, status.rxPipeNumber, buffer);
+		if (payloadSize > 0) {
+			NRF24L01_RecordReception(instance, status.rxPipeNumber, payloadSize);
+			count++;
+			if (deliver) {
+				instance->callbacks.onPacketReceived(device, status.rxPipeNumber, buffer, payloadSize);
+			} else if (packet != NULL) {
+				NRF24L01_CommitPacket(instance, queue, status.rxPipeNumber, payloadSize);
+			} else {
+				instance->stats.rxDropped[status.rxPipeNumber]++;
+			}
+		}
+		status = NRF24L01_GetStatus(device); //STATUS is returned for free as the first byte of NOP
+	}
+	if (count > instance->stats.rxFifoHighWater) {
+		instance->stats.rxFifoHighWater = count;
+	}
+}
 
-	//Reset PLOS_CNT
-	NRF24L01_Instance *instance = NRF24L01_GetInstanceCache(device);
-	uint8_t rfChannel = instance->config->channel;
-	NRF24L01_WriteRegister(device, NRF24L01_REG_RF_CH, &rfChannel, 1);
+//Clears RX_DR flag if set and reads all payloads into RX queues
+static void NRF24L01_ClearRxAndDrain(NRF24L01_Device *device, STATUS_Register status) {
+	if (status.dataReady) {
+		uint8_t flags = NRF24L01_REG_STATUS_RX_DR_BIT_MASK;
+		NRF24L01_WriteRegister(device, NRF24L01_REG_STATUS, &flags, 1);
+	}
+	NRF24L01_DrainRxFifo(device, status, false);
 }
 
 static bool NRF24L01_WaitForTransmission(NRF24L01_Device *device, uint32_t timeout) {
@@ -227,8 +519,15 @@ static bool NRF24L01_WaitForTransmission(NRF24L01_Device *device, uint32_t timeo
 	STATUS_Register status;
 	uint32_t start = HAL_GetTick();
 	while ((HAL_GetTick() - start) < timeout) {
+		if (!NRF24L01_IRQAsserted(device)) {
+			continue;
+		}
 		status = NRF24L01_GetStatus(device);
 		if (status.dataSent) {
+			//ACK payload arrives together with TX_DS
+			if (status.dataReady) {
+				NRF24L01_DrainRxFifo(device, status, false);
+			}
 			result = true;
 			break;
 		}
@@ -237,20 +536,61 @@ static bool NRF24L01_WaitForTransmission(NRF24L01_Device *device, uint32_t timeo
 		}
 	}
 
+	NRF24L01_FinishTransmission(NRF24L01_GetInstance(device), result);
 	NRF24L01_UpdateStatistic(device);
 	NRF24L01_ResetStatus(device);
 	return result;
 }
 
-void NRF24L01_Init(NRF24L01_Device *device, NRF24L01_Config *config) {
-	if (config->channel > 127) {
-		return;
+//Waits for a free TX FIFO slot and writes payload. Returns false if max retransmits reached or timeout occurred.
+static bool NRF24L01_QueuePayload(NRF24L01_Device *device, uint8_t command, const uint8_t *data, uint8_t size,
+		uint32_t timeout) {
+	STATUS_Register status;
+	uint32_t start = HAL_GetTick();
+	while ((HAL_GetTick() - start) < timeout) {
+		status = NRF24L01_GetStatus(device);
+		if (status.maxRetransmitsReached) {
+			return false;
+		}
+		if (status.dataReady) {
+			NRF24L01_ClearRxAndDrain(device, status);
+		}
+		if (!status.txFifoFull) {
+			NRF24L01_WritePayload(device, command, data, size);
+			return true;
+		}
 	}
-	NRF24L01_InitDWT(); //Prepare us delay functionality
-	NRF24L01_PutConfigCache(device, config);
+	return false;
+}
 
-	HAL_Delay(100); //Power on reset transition state
+//Waits until all queued payloads are sent. Returns false if max retransmits reached or timeout occurred.
+static bool NRF24L01_WaitForTxFifoEmpty(NRF24L01_Device *device, uint32_t timeout) {
+	STATUS_Register status;
+	uint8_t fifoStatus;
+	uint32_t start = HAL_GetTick();
+	while ((HAL_GetTick() - start) < timeout) {
+		status = NRF24L01_GetStatus(device);
+		if (status.maxRetransmitsReached) {
+			return false;
+		}
+		NRF24L01_ReadRegister(device, NRF24L01_REG_FIFO_STATUS, &fifoStatus, 1);
+		if (fifoStatus & NRF24L01_REG_FIFO_STATUS_TX_EMPTY_BIT_MASK) {
+			return true;
+		}
+	}
+	return false;
+}
+
+//Writes configuration into radio, called once power on reset time has passed
+static void NRF24L01_Configure(NRF24L01_Device *device, NRF24L01_Config *config) {
 	NRF24L01_SendCommand(device, NRF24L01_CMD_NOP); //Init SPI clock
+	NRF24L01_SyncRegisters(device); //Registers keep their values if only MCU was reset
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	instance->powerState = NRF24L01_IsPoweredUp(instance) ? POWER_STATE_STANDBY : POWER_STATE_POWER_DOWN;
+	instance->powerStateTick = HAL_GetTick();
+	instance->powerStateCycles = DWT->CYCCNT;
+	memset(&instance->powerStats, 0, sizeof(NRF24L01_PowerStats));
+	memset(&instance->stats, 0, sizeof(NRF24L01_Stats));
 
 	//Build registers values for pipes configuration
 	uint8_t pipeBit = 0x00;
@@ -272,18 +612,19 @@ void NRF24L01_Init(NRF24L01_Device *device, NRF24L01_Config *config) {
 	}
 	uint8_t automaticRetransmission = config->retransmitDelay | config->retransmitCount;
 	uint8_t rfSetup = config->rfPower | config->dataRate;
+	uint8_t setupAddressWidth = config->addressWidth;
 
 	//General configuration(registers 0x01 - 0x06)
 	NRF24L01_WriteRegister(device, NRF24L01_REG_EN_AA, &enableAutoAckPipesValue, 1);
 	NRF24L01_WriteRegister(device, NRF24L01_REG_EN_RXADDR, &enableRxPipesValue, 1);
-	NRF24L01_WriteRegister(device, NRF24L01_REG_SETUP_AW, &config->addressWidth, 1);
+	NRF24L01_WriteRegister(device, NRF24L01_REG_SETUP_AW, &setupAddressWidth, 1);
 	NRF24L01_WriteRegister(device, NRF24L01_REG_SETUP_RETR, &automaticRetransmission, 1);
 	NRF24L01_WriteRegister(device, NRF24L01_REG_RF_CH, &config->channel, 1);
 	NRF24L01_WriteRegister(device, NRF24L01_REG_RF_SETUP, &rfSetup, 1);
 
 	//Configure RX pipes
 	uint8_t addressWidth = NRF24L01_ResolveAddressWidth(config->addressWidth);
-	uint8_t *addressBuffer = (uint8_t*) malloc(addressWidth * sizeof(uint8_t));
+	uint8_t addressBuffer[5];
 	NRF24L01_RxPipe pipe;
 	for (int i = 0; i < 6; i++) {
 		pipe = config->rxPipes[i];
@@ -326,26 +667,205 @@ void NRF24L01_Init(NRF24L01_Device *device, NRF24L01_Config *config) {
 	//Set TX address
 	NRF24L01_ConvertAddress(config->txPipeAddress, addressBuffer, addressWidth);
 	NRF24L01_WriteRegister(device, NRF24L01_REG_TX_ADDR, addressBuffer, addressWidth);
-	free(addressBuffer);
 
-	//Dynamic payload size configuration
+	//Dynamic payload size and ACK payload configuration
+	uint8_t featureRegisterValue = 0x00;
 	if (config->enableDynamicPayloadSizeFeature) {
-		uint8_t featureRegisterValue = NRF24L01_REG_FEATURE_ENABLE_DYNAMIC_PAYLOAD;
+		featureRegisterValue |= NRF24L01_REG_FEATURE_ENABLE_DYNAMIC_PAYLOAD;
+	}
+	if (config->enableAckPayloadFeature) {
+		featureRegisterValue |= NRF24L01_REG_FEATURE_ENABLE_ACK_PAYLOAD;
+	}
+	if (config->enableNoAckFeature) {
+		featureRegisterValue |= NRF24L01_REG_FEATURE_ENABLE_DYNAMIC_ACK;
+	}
+	if (featureRegisterValue != 0x00) {
 		NRF24L01_SendCommand(device, NRF24L01_CMD_ACTIVATE_FEATURES); //Activate advanced features
 		NRF24L01_SendCommand(device, NRF24L01_CMD_ACTIVATE_FEATURES_KEY);
 		NRF24L01_WriteRegister(device, NRF24L01_REG_FEATURE, &featureRegisterValue, 1);
 		NRF24L01_WriteRegister(device, NRF24L01_REG_DYNPD, &enableDynamicPayloadSizeValue, 1);
 	}
+}
+
+void NRF24L01_Init(NRF24L01_Device *device, NRF24L01_Config *config) {
+	if (config->channel > 127) {
+		return;
+	}
+	NRF24L01_InitDWT(); //Prepare us delay functionality
+	NRF24L01_InitInstance(device, config);
+
+	HAL_Delay(100); //Power on reset transition state
+	NRF24L01_Configure(device, config);
 
-	bool powerDownBetweenTransactions = NRF24L01_GetInstanceCache(device)->device->powerDownBetweenTransactions;
+	bool powerDownBetweenTransactions = NRF24L01_GetInstance(device)->device->powerDownBetweenTransactions;
 	if (!powerDownBetweenTransactions) {
 		NRF24L01_PowerUp(device);
 	}
 }
 
+bool NRF24L01_VerifyRegisters(NRF24L01_Device *device) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	bool result = true;
+	bool featuresActivated = false;
+	uint8_t value[5];
+	uint8_t size;
+	uint8_t *shadow;
+	for (uint8_t i = 0; i < sizeof(shadowedRegisters); i++) {
+		shadow = NRF24L01_GetShadowRegister(instance, shadowedRegisters[i], &size);
+		NRF24L01_ReadRegister(device, shadowedRegisters[i], value, size);
+		if (memcmp(value, shadow, size) == 0) {
+			continue;
+		}
+
+		//Advanced features are deactivated by reset, CONFIG is restored last as it may power up the radio
+		result = false;
+		if (!featuresActivated
+				&& (shadowedRegisters[i] == NRF24L01_REG_FEATURE || shadowedRegisters[i] == NRF24L01_REG_DYNPD)) {
+			featuresActivated = true;
+			NRF24L01_SendCommand(device, NRF24L01_CMD_ACTIVATE_FEATURES);
+			NRF24L01_SendCommand(device, NRF24L01_CMD_ACTIVATE_FEATURES_KEY);
+		}
+		if (shadowedRegisters[i] != NRF24L01_REG_CONFIG) {
+			NRF24L01_WriteRegister(device, shadowedRegisters[i], shadow, size);
+		}
+	}
+
+	if (!result) {
+		uint8_t config = instance->registers[NRF24L01_REG_CONFIG];
+		NRF24L01_WriteRegister(device, NRF24L01_REG_CONFIG, &config, 1);
+		if (config & NRF24L01_REG_CONFIG_PWR_UP_BIT_MASK) {
+			NRF24L01_DelayUs(NRF24L01_GetPowerUpDelay(device));
+		}
+	}
+
+	return result;
+}
+
+bool NRF24L01_SetChannel(NRF24L01_Device *device, uint8_t channel) {
+	if (channel > 127) {
+		return false;
+	}
+
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	bool listening = instance->powerState == POWER_STATE_ACTIVE;
+	if (listening) {
+		NRF24L01_CELow(device);
+	}
+	NRF24L01_WriteRegister(device, NRF24L01_REG_RF_CH, &channel, 1);
+	if (listening) {
+		NRF24L01_CEHigh(device);
+		NRF24L01_DelayUs(130); //Standby modes -> TX/RX mode
+	}
+	return true;
+}
+
+uint8_t NRF24L01_GetChannel(NRF24L01_Device *device) {
+	return NRF24L01_GetInstance(device)->registers[NRF24L01_REG_RF_CH];
+}
+
+void NRF24L01_SetDataRate(NRF24L01_Device *device, DATA_RATE dataRate) {
+	uint8_t rfSetup = NRF24L01_GetInstance(device)->registers[NRF24L01_REG_RF_SETUP];
+	rfSetup = (rfSetup & ~NRF24L01_REG_RF_SETUP_DATA_RATE_BIT_MASK) | dataRate;
+	NRF24L01_WriteRegister(device, NRF24L01_REG_RF_SETUP, &rfSetup, 1);
+}
+
+void NRF24L01_SetRFPower(NRF24L01_Device *device, RF_POWER rfPower) {
+	uint8_t rfSetup = NRF24L01_GetInstance(device)->registers[NRF24L01_REG_RF_SETUP];
+	rfSetup = (rfSetup & ~NRF24L01_REG_RF_SETUP_RF_POWER_BIT_MASK) | rfPower;
+	NRF24L01_WriteRegister(device, NRF24L01_REG_RF_SETUP, &rfSetup, 1);
+}
+
+void NRF24L01_SetRetransmission(NRF24L01_Device *device, RETRANSMIT_DELAY retransmitDelay,
+		RETRANSMIT_COUNT retransmitCount) {
+	uint8_t automaticRetransmission = retransmitDelay | retransmitCount;
+	NRF24L01_WriteRegister(device, NRF24L01_REG_SETUP_RETR, &automaticRetransmission, 1);
+}
+
+bool NRF24L01_SetTxAddress(NRF24L01_Device *device, uint64_t address) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (instance->powerState == POWER_STATE_ACTIVE) {
+		return false;
+	}
+
+	//Pipe 0 receives ACKs, so it gets the same address
+	uint8_t addressWidth = NRF24L01_ResolveAddressWidth(instance->registers[NRF24L01_REG_SETUP_AW]);
+	uint8_t addressBuffer[5];
+	NRF24L01_ConvertAddress(address, addressBuffer, addressWidth);
+	NRF24L01_WriteRegister(device, NRF24L01_REG_TX_ADDR, addressBuffer, addressWidth);
+	NRF24L01_WriteRegister(device, NRF24L01_REG_RX_ADDR_P0, addressBuffer, addressWidth);
+	return true;
+}
+
+bool NRF24L01_SetRxAddress(NRF24L01_Device *device, uint8_t pipe, uint64_t address) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (pipe > 5 || instance->powerState == POWER_STATE_ACTIVE) {
+		return false;
+	}
+
+	//Pipes 2-5 have only the least significant byte
+	uint8_t addressWidth = NRF24L01_ResolveAddressWidth(instance->registers[NRF24L01_REG_SETUP_AW]);
+	uint8_t addressBuffer[5];
+	NRF24L01_ConvertAddress(address, addressBuffer, addressWidth);
+	if (pipe < 2) {
+		NRF24L01_WriteRegister(device, NRF24L01_REG_RX_ADDR_P0 + pipe, addressBuffer, addressWidth);
+	} else {
+		NRF24L01_WriteRegister(device, NRF24L01_REG_RX_ADDR_P0 + pipe, &addressBuffer[addressWidth - 1], 1);
+	}
+	return true;
+}
+
+bool NRF24L01_ScanChannels(NRF24L01_Device *device, uint8_t *histogram, uint8_t samples) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (instance->interruptDriven || instance->asyncState != ASYNC_IDLE) {
+		return false;
+	}
+
+	uint8_t channel = instance->registers[NRF24L01_REG_RF_CH];
+	uint8_t rpd;
+	memset(histogram, 0, NRF24L01_CHANNELS);
+	if (device->powerDownBetweenTransactions) {
+		NRF24L01_PowerUp(device);
+	}
+	NRF24L01_ReceiveMode(device);
+
+	//Sweep all channels on every sample, so short bursts are caught at different moments
+	for (uint8_t i = 0; i < samples; i++) {
+		for (uint8_t j = 0; j < NRF24L01_CHANNELS; j++) {
+			NRF24L01_WriteRegister(device, NRF24L01_REG_RF_CH, &j, 1);
+			NRF24L01_CEHigh(device);
+			NRF24L01_DelayUs(170); //RX settling(130 us) + RPD detection time(40 us)
+			NRF24L01_ReadRegister(device, NRF24L01_REG_RPD, &rpd, 1);
+			NRF24L01_CELow(device);
+			histogram[j] += rpd & 0x01;
+		}
+	}
+
+	NRF24L01_WriteRegister(device, NRF24L01_REG_RF_CH, &channel, 1);
+	if (device->powerDownBetweenTransactions) {
+		NRF24L01_EnterIdle(device);
+	}
+	return true;
+}
+
+uint8_t NRF24L01_FindQuietChannel(const uint8_t *histogram, uint8_t firstChannel, uint8_t lastChannel) {
+	uint8_t result = firstChannel;
+	uint16_t minimalOccupancy = UINT16_MAX;
+	uint16_t occupancy;
+	for (uint8_t i = firstChannel; i <= lastChannel && i < NRF24L01_CHANNELS; i++) {
+		occupancy = 2 * histogram[i];
+		occupancy += i > 0 ? histogram[i - 1] : 0;
+		occupancy += i < NRF24L01_CHANNELS - 1 ? histogram[i + 1] : 0;
+		if (occupancy < minimalOccupancy) {
+			minimalOccupancy = occupancy;
+			result = i;
+		}
+	}
+	return result;
+}
+
 void NRF24L01_UsePowerDownMode(NRF24L01_Device *device, bool enable) {
 	if (!device->powerDownBetweenTransactions && enable) {
-		NRF24L01_PowerDown(device);
+		NRF24L01_EnterIdle(device);
 	}
 	if (device->powerDownBetweenTransactions && !enable) {
 		NRF24L01_PowerUp(device);
@@ -353,18 +873,32 @@ void NRF24L01_UsePowerDownMode(NRF24L01_Device *device, bool enable) {
 	device->powerDownBetweenTransactions = enable;
 }
 
+void NRF24L01_UpdatePowerState(NRF24L01_Device *device) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (!device->powerDownBetweenTransactions || instance->powerState != POWER_STATE_STANDBY
+			|| instance->interruptDriven || instance->asyncState != ASYNC_IDLE
+			|| instance->processState != PROCESS_READY) {
+		return;
+	}
+	if ((HAL_GetTick() - instance->lastActivityTick) >= device->powerDownIdleTimeout) {
+		NRF24L01_PowerDown(device);
+	}
+}
+
+void NRF24L01_GetPowerStats(NRF24L01_Device *device, NRF24L01_PowerStats *stats) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	NRF24L01_SetPowerState(instance, instance->powerState);
+	*stats = instance->powerStats;
+}
+
 bool NRF24L01_TransmitPacket(NRF24L01_Device *device, const uint8_t *data, uint8_t size) {
-	bool powerDownBetweenTransactions = NRF24L01_GetInstanceCache(device)->device->powerDownBetweenTransactions;
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	bool powerDownBetweenTransactions = instance->device->powerDownBetweenTransactions;
 	bool result = false;
 	if (size > 32) {
 		return result;
 	}
 
-	//Prepare request
-	uint8_t *request = malloc(size + 1);
-	request[0] = NRF24L01_CMD_W_TX_PAYLOAD;
-	memcpy(&request[1], data, size);
-
 	if (powerDownBetweenTransactions) {
 		NRF24L01_PowerUp(device);
 	}
@@ -372,31 +906,43 @@ bool NRF24L01_TransmitPacket(NRF24L01_Device *device, const uint8_t *data, uint8
 	//Write TX payload
 	NRF24L01_TransmitMode(device);
 	NRF24L01_SendCommand(device, NRF24L01_CMD_FLUSH_TX);
-	NRF24L01_CSNLow(device);
-	HAL_SPI_Transmit(device->hspi, request, size + 1, 50);
-	NRF24L01_CSNHigh(device);
-	free(request);
+	NRF24L01_ResetStatus(device); //TX_DS could be left by NRF24L01_TransmitPacketNoAck
+	NRF24L01_WritePayload(device, NRF24L01_CMD_W_TX_PAYLOAD, data, size);
 
 	//Transmit
-	NRF24L01_CEHigh(device);
-	NRF24L01_DelayUs(10);
-	NRF24L01_CELow(device);
+	NRF24L01_StartTransmission(device, size);
 
 	//Wait for transmission to finish and collect statistic(if enabled)
 	result = NRF24L01_WaitForTransmission(device, 100);
 
 	if (powerDownBetweenTransactions) {
-		NRF24L01_PowerDown(device);
+		NRF24L01_EnterIdle(device);
 	}
 	return result;
 }
 
 bool NRF24L01_ReceivePacket(NRF24L01_Device *device, uint8_t pipe, uint8_t *buffer, uint32_t timeout) {
-	bool powerDownBetweenTransactions = NRF24L01_GetInstanceCache(device)->device->powerDownBetweenTransactions;
+	uint8_t size;
+	return NRF24L01_ReceivePacketWithSize(device, pipe, buffer, &size, timeout);
+}
+
+bool NRF24L01_ReceivePacketWithSize(NRF24L01_Device *device, uint8_t pipe, uint8_t *buffer, uint8_t *size,
+		uint32_t timeout) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	bool powerDownBetweenTransactions = instance->device->powerDownBetweenTransactions;
 	bool result = false;
+	bool rxFifoEmpty = false;
 	STATUS_Register status;
 	uint8_t payloadSize;
-	uint8_t *tempBuffer = NULL;
+	if (pipe > 5 && pipe != NRF24L01_ANY_PIPE) {
+		return result;
+	}
+
+	//Packet could be already received with previous calls
+	*size = NRF24L01_TakePayload(instance, pipe, buffer);
+	if (*size > 0) {
+		return true;
+	}
 
 	if (powerDownBetweenTransactions) {
 		NRF24L01_PowerUp(device);
@@ -408,90 +954,220 @@ bool NRF24L01_ReceivePacket(NRF24L01_Device *device, uint8_t pipe, uint8_t *buff
 	uint32_t start = HAL_GetTick();
 
 	while ((HAL_GetTick() - start) < timeout) {
+		//IRQ pin stays high for payloads left in RX FIFO after RX_DR was cleared
+		if (rxFifoEmpty && !NRF24L01_IRQAsserted(device)) {
+			continue;
+		}
 		status = NRF24L01_GetStatus(device);
 		if (status.dataReady) {
 			NRF24L01_ResetStatus(device);
-			if (status.rxPipeNumber > 5) {
-				continue;
-			}
-
-			//Read RX payload
-			payloadSize = NRF24L01_GetReceivedPayloadSizeForPipe(device, status.rxPipeNumber);
-			tempBuffer = malloc(payloadSize + 1);
-			memset(tempBuffer, 0xFF, payloadSize + 1);
-			tempBuffer[0] = NRF24L01_CMD_R_RX_PAYLOAD;
-			NRF24L01_CSNLow(device);
-			HAL_SPI_TransmitReceive(device->hspi, tempBuffer, tempBuffer, payloadSize + 1, 50);
-			NRF24L01_CSNHigh(device);
-
-			//Copy data and finish if the pipe is correct
-			if (status.rxPipeNumber == pipe) {
-				memcpy(buffer, &tempBuffer[1], payloadSize);
+		}
+		rxFifoEmpty = status.rxPipeNumber > 5;
+		if (rxFifoEmpty) {
+			continue;
+		}
+
+		//Payload of this pipe at the top of RX FIFO is read straight into caller's buffer
+		if (status.rxPipeNumber == pipe || pipe == NRF24L01_ANY_PIPE) {
+			payloadSize = NRF24L01_ReadPayload(device, status.rxPipeNumber, buffer);
+			if (payloadSize > 0) {
+				NRF24L01_RecordReception(instance, status.rxPipeNumber, payloadSize);
+				*size = payloadSize;
 				result = true;
 				break;
 			}
+			continue;
+		}
+
+		//Read all payloads, the ones for other pipes stay queued for later calls
+		NRF24L01_DrainRxFifo(device, status, false);
+		rxFifoEmpty = true;
+		*size = NRF24L01_TakePayload(instance, pipe, buffer);
+		if (*size > 0) {
+			result = true;
+			break;
 		}
 	}
 
-	//Finish receiving and clear RX FIFO
-	free(tempBuffer);
+	//Finish receiving
 	NRF24L01_CELow(device);
-	NRF24L01_SendCommand(device, NRF24L01_CMD_FLUSH_RX);
 
 	if (powerDownBetweenTransactions) {
-		NRF24L01_PowerDown(device);
+		NRF24L01_EnterIdle(device);
 	}
 
 	return result;
 }
 
-bool NRF24L01_Transmit(NRF24L01_Device *device, const uint8_t *data, uint8_t size, uint8_t packetSize) {
+static bool NRF24L01_BufferSource(void *context, uint32_t offset, uint8_t *data, uint8_t size) {
+	memcpy(data, (const uint8_t*) context + offset, size);
+	return true;
+}
+
+static bool NRF24L01_BufferSink(void *context, uint32_t offset, const uint8_t *data, uint8_t size) {
+	memcpy((uint8_t*) context + offset, data, size);
+	return true;
+}
+
+//Compresses the whole message without sending it to find out how many packets it takes compressed
+static bool NRF24L01_CountCompressedPackets(NRF24L01_Compressor *compressor, NRF24L01_DataSource source,
+		void *context, uint32_t size, uint8_t packetSize, uint32_t *numberOfPackets) {
+	uint8_t packet[32];
+	uint8_t chunkSize = packetSize - NRF24L01_COMPRESSED_MESSAGE_HEADER_SIZE;
+	*numberOfPackets = 0;
+	NRF24L01_CompressorInit(compressor, source, context, size);
+	do {
+		if (!NRF24L01_CompressorRead(compressor, packet, chunkSize, &chunkSize)) {
+			return false;
+		}
+		(*numberOfPackets)++;
+		chunkSize = packetSize;
+	} while (!NRF24L01_CompressorFinished(compressor));
+	return true;
+}
+
+bool NRF24L01_Transmit(NRF24L01_Device *device, const uint8_t *data, uint32_t size, uint8_t packetSize) {
+	return NRF24L01_TransmitStream(device, NRF24L01_BufferSource, (void*) data, size, packetSize);
+}
+
+bool NRF24L01_TransmitStream(NRF24L01_Device *device, NRF24L01_DataSource source, void *context, uint32_t size,
+		uint8_t packetSize) {
+	if (packetSize < NRF24L01_MESSAGE_HEADER_SIZE || packetSize > 32 || size > UINT32_MAX - 32) {
+		return false;
+	}
+
 	bool result = true;
-	bool powerDownBetweenTransactions = NRF24L01_GetInstanceCache(device)->device->powerDownBetweenTransactions;
-
-	//Build message
-	//3 additional bytes for first packet:
-	//identifier(0x00), number of packets and packet size for receiver to expect
-	uint8_t messageSize = size + 3;
-	uint8_t numberOfPackets = (uint8_t) ceil((float) messageSize / packetSize);
-	uint8_t fillBytesSize = packetSize - messageSize % packetSize;
-	uint8_t *message = malloc(messageSize + fillBytesSize);
-	message[0] = 0x00;
-	message[1] = numberOfPackets;
-	message[2] = packetSize;
-	memcpy(&message[3], data, size);
-	memset(&message[messageSize], 0x00, fillBytesSize);
+	bool powerDownBetweenTransactions = NRF24L01_GetInstance(device)->device->powerDownBetweenTransactions;
+	NRF24L01_Compressor *compressor = NULL;
+	uint32_t compressedPackets;
+
+	//Additional bytes for first packet for receiver to expect: identifier(0x00), number of packets and packet size
+	//or, if message does not fit into 255 packets or is compressed, identifier(0x01 or 0x02), packet size
+	//and 32-bit message size
+	uint8_t headerSize = NRF24L01_MESSAGE_HEADER_SIZE;
+	uint32_t numberOfPackets = (size + headerSize + packetSize - 1) / packetSize;
+	if (numberOfPackets > UINT8_MAX) {
+		if (packetSize < NRF24L01_LARGE_MESSAGE_HEADER_SIZE) {
+			return false;
+		}
+		headerSize = NRF24L01_LARGE_MESSAGE_HEADER_SIZE;
+		numberOfPackets = (size + headerSize + packetSize - 1) / packetSize;
+	}
+
+	//Single packet and incompressible messages are sent as they are, compressed ones would only take more packets
+	if (device->compressMessages && device->compression != NULL && numberOfPackets > 1
+			&& packetSize > NRF24L01_COMPRESSED_MESSAGE_HEADER_SIZE) {
+		if (!NRF24L01_CountCompressedPackets(&device->compression->compressor, source, context, size, packetSize,
+				&compressedPackets)) {
+			return false;
+		}
+		if (compressedPackets < numberOfPackets) {
+			compressor = &device->compression->compressor;
+			headerSize = NRF24L01_COMPRESSED_MESSAGE_HEADER_SIZE;
+			numberOfPackets = compressedPackets;
+			NRF24L01_CompressorInit(compressor, source, context, size);
+		}
+	}
+	uint8_t packet[32];
+	uint32_t dataOffset = 0;
+	uint8_t chunkSize;
 
 	//Disable power down mode if is used
 	if (powerDownBetweenTransactions) {
 		NRF24L01_UsePowerDownMode(device, false);
 	}
 
-	//Send packets
-	for (int i = 0; i < numberOfPackets; i++) {
-		if (!NRF24L01_TransmitPacket(device, &message[i * packetSize], packetSize)) {
+	//Keep CE high and TX FIFO filled, so packets are sent back-to-back
+	NRF24L01_TransmitMode(device);
+	NRF24L01_SendCommand(device, NRF24L01_CMD_FLUSH_TX);
+	NRF24L01_ResetStatus(device);
+	NRF24L01_CEHigh(device);
+
+	//Build and queue packets one by one, the last one is padded with 0x00
+	for (uint32_t i = 0; i < numberOfPackets; i++) {
+		uint8_t offset = 0;
+		if (i == 0 && headerSize == NRF24L01_MESSAGE_HEADER_SIZE) {
+			packet[0] = NRF24L01_MESSAGE_HEADER;
+			packet[1] = numberOfPackets;
+			packet[2] = packetSize;
+			offset = headerSize;
+		} else if (i == 0) {
+			packet[0] = compressor != NULL ? NRF24L01_COMPRESSED_MESSAGE_HEADER : NRF24L01_LARGE_MESSAGE_HEADER;
+			packet[1] = packetSize;
+			packet[2] = size >> 24;
+			packet[3] = size >> 16;
+			packet[4] = size >> 8;
+			packet[5] = size;
+			offset = headerSize;
+		}
+		chunkSize = packetSize - offset;
+		if (compressor != NULL) {
+			if (!NRF24L01_CompressorRead(compressor, &packet[offset], chunkSize, &chunkSize)) {
+				result = false;
+				break;
+			}
+			if (NRF24L01_CompressorFinished(compressor)) {
+				numberOfPackets = i + 1;
+			}
+		} else {
+			if (chunkSize > size - dataOffset) {
+				chunkSize = size - dataOffset;
+			}
+			if (chunkSize > 0 && !source(context, dataOffset, &packet[offset], chunkSize)) {
+				result = false;
+				break;
+			}
+		}
+		memset(&packet[offset + chunkSize], 0x00, packetSize - offset - chunkSize);
+		dataOffset += chunkSize;
+
+		if (!NRF24L01_QueuePayload(device, NRF24L01_CMD_W_TX_PAYLOAD, packet, packetSize, 100)) {
 			result = false;
 			break;
 		}
 	}
 
+	//Wait for the rest of the FIFO to be sent, drop it on failure
+	if (result) {
+		result = NRF24L01_WaitForTxFifoEmpty(device, 100);
+	}
+	NRF24L01_CELow(device);
+	NRF24L01_Stats *stats = &NRF24L01_GetInstance(device)->stats;
+	if (result) {
+		stats->txPackets += numberOfPackets;
+		stats->txBytes += numberOfPackets * packetSize;
+	} else {
+		NRF24L01_SendCommand(device, NRF24L01_CMD_FLUSH_TX);
+		stats->txFailed++;
+	}
+	NRF24L01_UpdateStatistic(device);
+	NRF24L01_ResetStatus(device);
+
 	//Re-enable power down mode if was used
 	if (powerDownBetweenTransactions) {
 		NRF24L01_UsePowerDownMode(device, true);
 	}
 
-	free(message);
 	return result;
 }
 
 bool NRF24L01_Receive(NRF24L01_Device *device, uint8_t pipe, uint8_t *buffer, uint32_t timeout) {
+	return NRF24L01_ReceiveStream(device, pipe, NRF24L01_BufferSink, buffer, NULL, timeout);
+}
+
+bool NRF24L01_ReceiveStream(NRF24L01_Device *device, uint8_t pipe, NRF24L01_DataSink sink, void *context,
+		uint32_t *size, uint32_t timeout) {
 	bool result = false;
-	bool powerDownBetweenTransactions = NRF24L01_GetInstanceCache(device)->device->powerDownBetweenTransactions;
-	uint8_t firstPacket[32] = { 0 };
-	uint8_t numberOfPackets;
+	bool powerDownBetweenTransactions = NRF24L01_GetInstance(device)->device->powerDownBetweenTransactions;
+	NRF24L01_Decompressor *decompressor;
+	uint8_t packet[32] = { 0 };
+	uint32_t numberOfPackets;
+	uint32_t messageSize;
+	uint32_t dataOffset;
 	uint8_t packetSize;
-	uint8_t bytesLeft;
-	uint8_t *restOfPackets;
+	uint8_t headerSize;
+	uint8_t chunkSize;
+	uint8_t received;
 
 	//Disable power down mode if is being used
 	if (powerDownBetweenTransactions) {
@@ -501,34 +1177,79 @@ bool NRF24L01_Receive(NRF24L01_Device *device, uint8_t pipe, uint8_t *buffer, ui
 	//Receive packets
 	uint32_t start = HAL_GetTick();
 	while ((HAL_GetTick() - start) < timeout && !result) {
-		if (NRF24L01_ReceivePacket(device, pipe, firstPacket, 50)) {
-			//Skip if no first packet identifier found
-			if(firstPacket[0] != 0x00){
-				continue;
-			}
-			result = true;
+		if (!NRF24L01_ReceivePacketWithSize(device, pipe, packet, &received, 50)) {
+			continue;
+		}
 
-			//Extract transaction data
-			numberOfPackets = firstPacket[1];
-			packetSize = firstPacket[2];
-
-			//Receive other packets
-			bytesLeft = (numberOfPackets - 1) * packetSize;
-			restOfPackets = malloc(bytesLeft);
-			for (int i = 0; i < numberOfPackets - 1; i++) {
-				if (!NRF24L01_ReceivePacket(device, pipe, &restOfPackets[i * packetSize], 50)) {
-					result = false;
-					break;
-				}
+		//Extract transaction data, skip if no first packet identifier found
+		decompressor = NULL;
+		if (packet[0] == NRF24L01_MESSAGE_HEADER) {
+			headerSize = NRF24L01_MESSAGE_HEADER_SIZE;
+			numberOfPackets = packet[1];
+			packetSize = packet[2];
+			messageSize = numberOfPackets * packetSize - headerSize;
+		} else if (packet[0] == NRF24L01_LARGE_MESSAGE_HEADER) {
+			headerSize = NRF24L01_LARGE_MESSAGE_HEADER_SIZE;
+			packetSize = packet[1];
+			messageSize = ((uint32_t) packet[2] << 24) | ((uint32_t) packet[3] << 16) | (packet[4] << 8) | packet[5];
+			numberOfPackets = packetSize > 0 ? (messageSize + headerSize + packetSize - 1) / packetSize : 0;
+		} else if (packet[0] == NRF24L01_COMPRESSED_MESSAGE_HEADER && device->compression != NULL) {
+			headerSize = NRF24L01_COMPRESSED_MESSAGE_HEADER_SIZE;
+			packetSize = packet[1];
+			messageSize = ((uint32_t) packet[2] << 24) | ((uint32_t) packet[3] << 16) | (packet[4] << 8) | packet[5];
+			numberOfPackets = UINT32_MAX; //Message ends when decompressor has produced messageSize bytes
+			decompressor = &device->compression->decompressor;
+		} else {
+			continue;
+		}
+		//Every packet of a message is packetSize long, so a stray packet starting with the identifier(e.g. a lone
+		//0x00) is not taken for a header. Large header is used only for messages longer than 255 packets.
+		if (packetSize < headerSize || packetSize > 32 || numberOfPackets == 0 || received != packetSize
+				|| (headerSize == NRF24L01_LARGE_MESSAGE_HEADER_SIZE && decompressor == NULL
+						&& numberOfPackets <= UINT8_MAX)) {
+			continue;
+		}
+		result = true;
+
+		//Decompress packets until the whole message is produced, padding of the last packet is ignored
+		if (decompressor != NULL) {
+			NRF24L01_DecompressorInit(decompressor, sink, context, messageSize);
+			result = NRF24L01_DecompressorWrite(decompressor, &packet[headerSize], packetSize - headerSize);
+			while (result && !NRF24L01_DecompressorFinished(decompressor)) {
+				result = NRF24L01_ReceivePacketWithSize(device, pipe, packet, &received, 50) && received == packetSize
+						&& NRF24L01_DecompressorWrite(decompressor, packet, packetSize);
 			}
-
-			//Copy data to result buffer
-			if (result) {
-				memcpy(buffer, &firstPacket[3], packetSize - 3);
-				memcpy(&buffer[packetSize - 3], restOfPackets, bytesLeft);
+			if (result && size != NULL) {
+				*size = messageSize;
 			}
+			continue;
+		}
 
-			free(restOfPackets);
+		//Pass first packet's data and receive other packets
+		chunkSize = packetSize - headerSize;
+		if (chunkSize > messageSize) {
+			chunkSize = messageSize;
+		}
+		if (chunkSize > 0 && !sink(context, 0, &packet[headerSize], chunkSize)) {
+			result = false;
+		}
+		dataOffset = chunkSize;
+		for (uint32_t i = 1; i < numberOfPackets && result; i++) {
+			if (!NRF24L01_ReceivePacketWithSize(device, pipe, packet, &received, 50) || received != packetSize) {
+				result = false;
+				break;
+			}
+			chunkSize = packetSize;
+			if (chunkSize > messageSize - dataOffset) {
+				chunkSize = messageSize - dataOffset;
+			}
+			if (!sink(context, dataOffset, packet, chunkSize)) {
+				result = false;
+			}
+			dataOffset += chunkSize;
+		}
+		if (result && size != NULL) {
+			*size = messageSize;
 		}
 	}
 
@@ -539,3 +1260,549 @@ bool NRF24L01_Receive(NRF24L01_Device *device, uint8_t pipe, uint8_t *buffer, ui
 
 	return result;
 }
+
+//Starts DMA read of top RX FIFO payload, stays in ASYNC_RX_WAIT if payload is invalid or DMA failed to start
+static void NRF24L01_StartPayloadReadDMA(NRF24L01_Device *device, uint8_t pipe) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	uint8_t payloadSize = NRF24L01_GetReceivedPayloadSizeForPipe(device, pipe);
+	if (payloadSize == 0 || payloadSize > 32) {
+		NRF24L01_SendCommand(device, NRF24L01_CMD_FLUSH_RX);
+		return;
+	}
+
+	instance->asyncPipe = pipe;
+	instance->asyncSize = payloadSize;
+	instance->asyncState = ASYNC_RX_PAYLOAD;
+	memset(instance->spiBuffer, NRF24L01_CMD_DUMMY_LOAD, payloadSize + 1);
+	instance->spiBuffer[0] = NRF24L01_CMD_R_RX_PAYLOAD;
+	NRF24L01_CSNLowDMA(device);
+	if (HAL_SPI_TransmitReceive_DMA(device->hspi, instance->spiBuffer, instance->spiBuffer, payloadSize + 1) != HAL_OK) {
+		NRF24L01_CSNHighDMA(device);
+		instance->asyncState = ASYNC_RX_WAIT;
+	}
+}
+
+void NRF24L01_RegisterCallbacks(NRF24L01_Device *device, const NRF24L01_Callbacks *callbacks) {
+	NRF24L01_GetInstance(device)->callbacks = *callbacks;
+}
+
+void NRF24L01_StartListening(NRF24L01_Device *device) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (device->powerDownBetweenTransactions) {
+		NRF24L01_PowerUp(device);
+	}
+
+	NRF24L01_ReceiveMode(device);
+	instance->interruptDriven = true;
+	NRF24L01_CEHigh(device);
+}
+
+void NRF24L01_StopListening(NRF24L01_Device *device) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	NRF24L01_CELow(device);
+	instance->interruptDriven = false;
+	if (instance->asyncState == ASYNC_RX_WAIT) {
+		instance->asyncState = ASYNC_IDLE;
+	}
+
+	if (device->powerDownBetweenTransactions) {
+		NRF24L01_EnterIdle(device);
+	}
+}
+
+bool NRF24L01_TransmitPacketIT(NRF24L01_Device *device, const uint8_t *data, uint8_t size) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (size > 32 || instance->asyncState != ASYNC_IDLE) {
+		return false;
+	}
+
+	//Leave RX mode if listening
+	NRF24L01_CELow(device);
+	instance->interruptDriven = false;
+
+	if (device->powerDownBetweenTransactions) {
+		NRF24L01_PowerUp(device);
+	}
+
+	//Write TX payload
+	NRF24L01_TransmitMode(device);
+	NRF24L01_SendCommand(device, NRF24L01_CMD_FLUSH_TX);
+	NRF24L01_ResetStatus(device); //TX_DS could be left by NRF24L01_TransmitPacketNoAck
+	NRF24L01_WritePayload(device, NRF24L01_CMD_W_TX_PAYLOAD, data, size);
+
+	//Transmit, result is delivered from NRF24L01_IRQHandler
+	instance->interruptDriven = true;
+	NRF24L01_StartTransmission(device, size);
+	return true;
+}
+
+void NRF24L01_IRQHandler(NRF24L01_Device *device) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (!instance->interruptDriven) {
+		return;
+	}
+
+	//SPI is owned by DMA or by blocking transaction, the event is handled once it completes
+	if (instance->spiBusy || instance->asyncState == ASYNC_TX_PAYLOAD || instance->asyncState == ASYNC_RX_PAYLOAD) {
+		instance->irqPending = true;
+		return;
+	}
+
+	//Read STATUS once and clear only flags that were seen to not lose events arrived meanwhile
+	STATUS_Register status = NRF24L01_GetStatus(device);
+	uint8_t flags = status.value & NRF24L01_REG_STATUS_RESET_FLAGS;
+	NRF24L01_WriteRegister(device, NRF24L01_REG_STATUS, &flags, 1);
+
+	//Asynchronous receive reads only one payload using DMA
+	if (instance->asyncState == ASYNC_RX_WAIT) {
+		if (status.rxPipeNumber <= 5) {
+			NRF24L01_StartPayloadReadDMA(device, status.rxPipeNumber);
+		}
+		return;
+	}
+
+	//Drain whole RX FIFO
+	if (status.dataReady) {
+		NRF24L01_DrainRxFifo(device, status, true);
+	}
+
+	//Finish transmission
+	if (flags & (NRF24L01_REG_STATUS_TX_DS_BIT_MASK | NRF24L01_REG_STATUS_MAX_RT_BIT_MASK)) {
+		if (flags & NRF24L01_REG_STATUS_MAX_RT_BIT_MASK) {
+			NRF24L01_SendCommand(device, NRF24L01_CMD_FLUSH_TX);
+		}
+		NRF24L01_FinishTransmission(instance, flags & NRF24L01_REG_STATUS_TX_DS_BIT_MASK);
+		NRF24L01_UpdateStatistic(device);
+		instance->interruptDriven = false;
+		instance->asyncState = ASYNC_IDLE;
+
+		if (device->powerDownBetweenTransactions) {
+			NRF24L01_EnterIdle(device);
+		}
+
+		if ((flags & NRF24L01_REG_STATUS_TX_DS_BIT_MASK) && instance->callbacks.onPacketSent != NULL) {
+			instance->callbacks.onPacketSent(device);
+		} else if ((flags & NRF24L01_REG_STATUS_MAX_RT_BIT_MASK) && instance->callbacks.onMaxRetransmits != NULL) {
+			instance->callbacks.onMaxRetransmits(device);
+		}
+	}
+}
+
+bool NRF24L01_TransmitPacketAsync(NRF24L01_Device *device, const uint8_t *data, uint8_t size) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (size > 32 || instance->asyncState != ASYNC_IDLE) {
+		return false;
+	}
+
+	//Leave RX mode if listening
+	NRF24L01_CELow(device);
+	instance->interruptDriven = false;
+
+	if (device->powerDownBetweenTransactions) {
+		NRF24L01_PowerUp(device);
+	}
+	NRF24L01_TransmitMode(device);
+	NRF24L01_SendCommand(device, NRF24L01_CMD_FLUSH_TX);
+	NRF24L01_ResetStatus(device); //TX_DS could be left by NRF24L01_TransmitPacketNoAck
+
+	//Write TX payload by DMA, transmission is started from NRF24L01_SPICompleteHandler
+	instance->spiBuffer[0] = NRF24L01_CMD_W_TX_PAYLOAD;
+	memcpy(&instance->spiBuffer[1], data, size);
+	instance->asyncSize = size;
+	instance->asyncState = ASYNC_TX_PAYLOAD;
+	instance->interruptDriven = true;
+	NRF24L01_CSNLowDMA(device);
+	if (HAL_SPI_TransmitReceive_DMA(device->hspi, instance->spiBuffer, instance->spiBuffer, size + 1) != HAL_OK) {
+		NRF24L01_CSNHighDMA(device);
+		instance->asyncState = ASYNC_IDLE;
+		instance->interruptDriven = false;
+		return false;
+	}
+	return true;
+}
+
+bool NRF24L01_ReceivePacketAsync(NRF24L01_Device *device, uint8_t *buffer) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (instance->asyncState != ASYNC_IDLE) {
+		return false;
+	}
+
+	if (device->powerDownBetweenTransactions) {
+		NRF24L01_PowerUp(device);
+	}
+	NRF24L01_ReceiveMode(device);
+	instance->asyncBuffer = buffer;
+	instance->asyncState = ASYNC_RX_WAIT;
+	instance->interruptDriven = true;
+
+	//Payload could already be waiting in RX FIFO with RX_DR flag cleared, it won't raise IRQ again.
+	//CE is still low, so nothing can arrive meanwhile.
+	STATUS_Register status = NRF24L01_GetStatus(device);
+	if (status.rxPipeNumber <= 5) {
+		NRF24L01_StartPayloadReadDMA(device, status.rxPipeNumber);
+	}
+	if (instance->asyncState == ASYNC_RX_WAIT) {
+		NRF24L01_CEHigh(device);
+	}
+	return true;
+}
+
+bool NRF24L01_IsBusy(NRF24L01_Device *device) {
+	return NRF24L01_GetInstance(device)->asyncState != ASYNC_IDLE;
+}
+
+void NRF24L01_SPICompleteHandler(NRF24L01_Device *device) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	switch (instance->asyncState) {
+	case ASYNC_TX_PAYLOAD:
+		//Payload is in TX FIFO, pulse CE and wait for TX_DS/MAX_RT interrupt
+		NRF24L01_CSNHighDMA(device);
+		instance->asyncState = ASYNC_TX_WAIT;
+		NRF24L01_StartTransmission(device, instance->asyncSize);
+		break;
+	case ASYNC_RX_PAYLOAD:
+		NRF24L01_CSNHighDMA(device);
+		NRF24L01_CELow(device);
+		instance->interruptDriven = false;
+		instance->asyncState = ASYNC_IDLE;
+		instance->irqPending = false; //Remaining payloads stay in RX FIFO for the next call
+
+		if (device->powerDownBetweenTransactions) {
+			NRF24L01_EnterIdle(device);
+		}
+
+		NRF24L01_RecordReception(instance, instance->asyncPipe, instance->asyncSize);
+		memcpy(instance->asyncBuffer, &instance->spiBuffer[1], instance->asyncSize);
+		if (instance->callbacks.onPacketReceived != NULL) {
+			instance->callbacks.onPacketReceived(device, instance->asyncPipe, instance->asyncBuffer,
+					instance->asyncSize);
+		}
+		break;
+	default:
+		break;
+	}
+
+	//Handle interrupt that arrived while DMA owned SPI
+	if (instance->irqPending) {
+		instance->irqPending = false;
+		NRF24L01_IRQHandler(device);
+	}
+}
+
+uint8_t NRF24L01_Poll(NRF24L01_Device *device) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (instance->asyncState == ASYNC_IDLE) {
+		NRF24L01_ClearRxAndDrain(device, NRF24L01_GetStatus(device));
+	}
+	return NRF24L01_CountPackets(instance);
+}
+
+bool NRF24L01_Read(NRF24L01_Device *device, NRF24L01_Packet *packet) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+
+	//Serve pipes round-robin, so a busy pipe can't starve others
+	for (int i = 1; i <= 6; i++) {
+		uint8_t pipe = (instance->lastReadPipe + i) % 6;
+		if (NRF24L01_TakePacket(&instance->rxQueues[pipe], packet)) {
+			instance->lastReadPipe = pipe;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool NRF24L01_ReadPipe(NRF24L01_Device *device, uint8_t pipe, NRF24L01_Packet *packet) {
+	if (pipe > 5) {
+		return false;
+	}
+	return NRF24L01_TakePacket(&NRF24L01_GetInstance(device)->rxQueues[pipe], packet);
+}
+
+uint8_t NRF24L01_Available(NRF24L01_Device *device, uint8_t pipe) {
+	if (pipe > 5) {
+		return 0;
+	}
+	NRF24L01_RxQueue *queue = &NRF24L01_GetInstance(device)->rxQueues[pipe];
+	return (uint8_t) (queue->tail - queue->head);
+}
+
+void NRF24L01_GetPipeCounters(NRF24L01_Device *device, uint8_t pipe, uint32_t *received, uint32_t *dropped) {
+	if (pipe > 5) {
+		return;
+	}
+	NRF24L01_Stats *stats = &NRF24L01_GetInstance(device)->stats;
+	*received = stats->rxPackets[pipe];
+	*dropped = stats->rxDropped[pipe];
+}
+
+void NRF24L01_GetStats(NRF24L01_Device *device, NRF24L01_Stats *stats, bool reset) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	*stats = instance->stats;
+	if (reset) {
+		memset(&instance->stats, 0, sizeof(NRF24L01_Stats));
+	}
+	__set_PRIMASK(primask);
+
+	stats->latencyAverage = stats->latencyCount != 0 ? stats->latencyTotal / stats->latencyCount : 0;
+}
+
+bool NRF24L01_WriteAckPayload(NRF24L01_Device *device, uint8_t pipe, const uint8_t *data, uint8_t size) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (pipe > 5 || size == 0 || size > 32 || !instance->config->enableAckPayloadFeature) {
+		return false;
+	}
+
+	//Payload is rejected if TX FIFO is full
+	STATUS_Register status = NRF24L01_GetStatus(device);
+	if (status.txFifoFull) {
+		return false;
+	}
+
+	NRF24L01_WritePayload(device, NRF24L01_CMD_W_ACK_PAYLOAD | pipe, data, size);
+	return true;
+}
+
+void NRF24L01_FlushAckPayloads(NRF24L01_Device *device) {
+	NRF24L01_SendCommand(device, NRF24L01_CMD_FLUSH_TX);
+}
+
+bool NRF24L01_ReadAckPayload(NRF24L01_Device *device, NRF24L01_Packet *packet) {
+	return NRF24L01_TakePacket(&NRF24L01_GetInstance(device)->ackQueue, packet);
+}
+
+bool NRF24L01_TransmitPacketNoAck(NRF24L01_Device *device, const uint8_t *data, uint8_t size) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (size > 32 || !instance->config->enableNoAckFeature || instance->asyncState != ASYNC_IDLE) {
+		return false;
+	}
+
+	if (device->powerDownBetweenTransactions) {
+		NRF24L01_PowerUp(device);
+	}
+
+	//Queue payload and keep CE high, so the next payloads go on air as soon as they are written
+	NRF24L01_TransmitMode(device);
+	bool result = NRF24L01_QueuePayload(device, NRF24L01_CMD_W_TX_PAYLOAD_NOACK, data, size, 100);
+	NRF24L01_CEHigh(device);
+	if (result) {
+		instance->stats.txPackets++;
+		instance->stats.txBytes += size;
+	}
+
+	//Nothing is acknowledged, wait only for the air time before powering down
+	if (device->powerDownBetweenTransactions) {
+		result = NRF24L01_FlushNoAck(device, 100) && result;
+	}
+	return result;
+}
+
+bool NRF24L01_FlushNoAck(NRF24L01_Device *device, uint32_t timeout) {
+	bool result = NRF24L01_WaitForTxFifoEmpty(device, timeout);
+	NRF24L01_CELow(device);
+	NRF24L01_ResetStatus(device);
+
+	if (device->powerDownBetweenTransactions) {
+		NRF24L01_EnterIdle(device);
+	}
+	return result;
+}
+
+bool NRF24L01_InitNonBlocking(NRF24L01_Device *device, NRF24L01_Config *config) {
+	if (config->channel > 127) {
+		return false;
+	}
+	NRF24L01_InitDWT();
+	NRF24L01_InitInstance(device, config);
+
+	//Power on reset transition state is waited for by NRF24L01_Process
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	instance->processState = PROCESS_POWER_ON_RESET;
+	instance->processTickPending = true;
+	return true;
+}
+
+//Raises CE for the operation waited for by PROCESS_POWER_UP state
+static NRF24L01_ProcessEvent NRF24L01_ProcessEnterState(NRF24L01_Device *device, NRF24L01_ProcessState state) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	instance->processState = state;
+	switch (state) {
+	case PROCESS_TX:
+		instance->txStartCycles = DWT->CYCCNT;
+		NRF24L01_CEHigh(device); //Kept high until TX_DS/MAX_RT, so no CE pulse has to be timed
+		break;
+	case PROCESS_RX:
+		NRF24L01_CEHigh(device);
+		break;
+	default:
+		return PROCESS_EVENT_READY;
+	}
+	return PROCESS_EVENT_NONE;
+}
+
+//Enters state right away if radio is powered up, otherwise waits for crystal to start up first
+static NRF24L01_ProcessEvent NRF24L01_ProcessPowerUp(NRF24L01_Device *device, NRF24L01_ProcessState state) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (NRF24L01_StartPowerUp(device)) {
+		instance->processState = PROCESS_POWER_UP;
+		instance->processNextState = state;
+		return PROCESS_EVENT_NONE;
+	}
+	return NRF24L01_ProcessEnterState(device, state);
+}
+
+static NRF24L01_ProcessEvent NRF24L01_ProcessFinishTransmission(NRF24L01_Device *device, bool sent) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	NRF24L01_CELow(device);
+	if (!sent) {
+		NRF24L01_SendCommand(device, NRF24L01_CMD_FLUSH_TX);
+	}
+	NRF24L01_FinishTransmission(instance, sent);
+	NRF24L01_UpdateStatistic(device);
+	NRF24L01_ResetStatus(device);
+
+	if (instance->processListening) {
+		NRF24L01_SetMode(device, 0x01);
+		NRF24L01_ProcessEnterState(device, PROCESS_RX);
+	} else {
+		instance->processState = PROCESS_READY;
+		if (device->powerDownBetweenTransactions) {
+			NRF24L01_EnterIdle(device);
+		}
+	}
+
+	if (sent && instance->callbacks.onPacketSent != NULL) {
+		instance->callbacks.onPacketSent(device);
+	} else if (!sent && instance->callbacks.onMaxRetransmits != NULL) {
+		instance->callbacks.onMaxRetransmits(device);
+	}
+	return sent ? PROCESS_EVENT_PACKET_SENT : PROCESS_EVENT_TRANSMIT_FAILED;
+}
+
+NRF24L01_ProcessEvent NRF24L01_Process(NRF24L01_Device *device, uint32_t tick) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	STATUS_Register status;
+	uint8_t count;
+
+	//Operation is timed by caller's clock from the first call after it was started
+	if (instance->processTickPending) {
+		instance->processTick = tick;
+		instance->processTickPending = false;
+	}
+
+	switch (instance->processState) {
+	case PROCESS_READY:
+		NRF24L01_UpdatePowerState(device);
+		break;
+	case PROCESS_POWER_ON_RESET:
+		if ((tick - instance->processTick) < 100) {
+			break;
+		}
+		NRF24L01_Configure(device, instance->config);
+		if (!device->powerDownBetweenTransactions) {
+			return NRF24L01_ProcessPowerUp(device, PROCESS_READY);
+		}
+		instance->processState = PROCESS_READY;
+		return PROCESS_EVENT_READY;
+	case PROCESS_POWER_UP:
+		if (!NRF24L01_PowerUpElapsed(device)) {
+			break;
+		}
+		NRF24L01_FinishPowerUp(instance);
+		return NRF24L01_ProcessEnterState(device, instance->processNextState);
+	case PROCESS_TX:
+		if ((tick - instance->processTick) >= 100) {
+			return NRF24L01_ProcessFinishTransmission(device, false);
+		}
+		if (!NRF24L01_IRQAsserted(device)) {
+			break;
+		}
+		status = NRF24L01_GetStatus(device);
+		if (status.dataSent) {
+			//ACK payload arrives together with TX_DS
+			if (status.dataReady) {
+				NRF24L01_DrainRxFifo(device, status, false);
+			}
+			return NRF24L01_ProcessFinishTransmission(device, true);
+		}
+		if (status.maxRetransmitsReached) {
+			return NRF24L01_ProcessFinishTransmission(device, false);
+		}
+		break;
+	case PROCESS_RX:
+		if (!NRF24L01_IRQAsserted(device)) {
+			break;
+		}
+		status = NRF24L01_GetStatus(device);
+		if (status.rxPipeNumber > 5) {
+			break;
+		}
+		count = NRF24L01_CountPackets(instance);
+		NRF24L01_ClearRxAndDrain(device, status);
+		if (NRF24L01_CountPackets(instance) != count) {
+			return PROCESS_EVENT_PACKET_RECEIVED;
+		}
+		break;
+	}
+	return PROCESS_EVENT_NONE;
+}
+
+NRF24L01_ProcessState NRF24L01_GetProcessState(NRF24L01_Device *device) {
+	return NRF24L01_GetInstance(device)->processState;
+}
+
+bool NRF24L01_TransmitPacketNonBlocking(NRF24L01_Device *device, const uint8_t *data, uint8_t size) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (size > 32 || instance->asyncState != ASYNC_IDLE || instance->interruptDriven
+			|| (instance->processState != PROCESS_READY && instance->processState != PROCESS_RX)) {
+		return false;
+	}
+
+	//Leave RX mode if listening, PLL settling(130 us) is done by radio after CE goes high.
+	//Payloads left in RX FIFO are queued as clearing RX_DR would keep IRQ pin from signaling them.
+	instance->processListening = instance->processState == PROCESS_RX;
+	NRF24L01_CELow(device);
+	if (instance->processListening) {
+		NRF24L01_ClearRxAndDrain(device, NRF24L01_GetStatus(device));
+	}
+	NRF24L01_SetMode(device, 0x00);
+
+	//Payload can be written while crystal is starting up
+	NRF24L01_SendCommand(device, NRF24L01_CMD_FLUSH_TX);
+	NRF24L01_ResetStatus(device);
+	NRF24L01_WritePayload(device, NRF24L01_CMD_W_TX_PAYLOAD, data, size);
+	instance->txSize = size;
+	instance->processTickPending = true;
+	NRF24L01_ProcessPowerUp(device, PROCESS_TX);
+	return true;
+}
+
+bool NRF24L01_StartListeningNonBlocking(NRF24L01_Device *device) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	if (instance->asyncState != ASYNC_IDLE || instance->interruptDriven || instance->processState != PROCESS_READY) {
+		return false;
+	}
+
+	NRF24L01_SetMode(device, 0x01);
+	NRF24L01_ProcessPowerUp(device, PROCESS_RX);
+	return true;
+}
+
+void NRF24L01_StopListeningNonBlocking(NRF24L01_Device *device) {
+	NRF24L01_Instance *instance = NRF24L01_GetInstance(device);
+	instance->processListening = false;
+	if (instance->processState != PROCESS_RX
+			&& !(instance->processState == PROCESS_POWER_UP && instance->processNextState == PROCESS_RX)) {
+		return;
+	}
+
+	NRF24L01_CELow(device);
+	if (instance->processState == PROCESS_POWER_UP) {
+		NRF24L01_FinishPowerUp(instance); //PWR_UP is already set
+	}
+	instance->processState = PROCESS_READY;
+	if (device->powerDownBetweenTransactions) {
+		NRF24L01_EnterIdle(device);
+	}
+}
@@ -0,0 +1,99 @@
+/**
+ * @brief Implementation of small-message aggregation for nRF24L01+ library
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Aggregator.h"
+
+void NRF24L01_AggregatorInit(NRF24L01_Aggregator *aggregator, NRF24L01_Device *device, uint8_t pipe,
+		uint32_t flushDelay) {
+	memset(aggregator, 0, sizeof(NRF24L01_Aggregator));
+	aggregator->device = device;
+	aggregator->pipe = pipe;
+	aggregator->flushDelay = flushDelay;
+	aggregator->txPacket[0] = NRF24L01_AGGREGATOR_MARKER;
+}
+
+bool NRF24L01_AggregatorWrite(NRF24L01_Aggregator *aggregator, const uint8_t *data, uint8_t size) {
+	if (size == 0 || size > NRF24L01_AGGREGATOR_MAX_RECORD) {
+		return false;
+	}
+
+	if (aggregator->txSize + 1 + size > 32 && !NRF24L01_AggregatorFlush(aggregator)) {
+		return false;
+	}
+
+	if (aggregator->txSize == 0) {
+		aggregator->txPacket[1] = 0;
+		aggregator->txSize = NRF24L01_AGGREGATOR_HEADER_SIZE;
+		aggregator->txTick = HAL_GetTick();
+	}
+	aggregator->txPacket[aggregator->txSize++] = size;
+	memcpy(&aggregator->txPacket[aggregator->txSize], data, size);
+	aggregator->txSize += size;
+	aggregator->txPacket[1]++;
+	aggregator->records++;
+
+	//Packet that can not take even a 1 byte record is sent now, the next record would flush it anyway
+	if (aggregator->flushDelay == 0 || aggregator->txSize + 2 > 32) {
+		NRF24L01_AggregatorFlush(aggregator); //Record is accepted, failed packet is sent again later
+	}
+	return true;
+}
+
+bool NRF24L01_AggregatorUpdate(NRF24L01_Aggregator *aggregator) {
+	if (aggregator->txSize == 0 || (HAL_GetTick() - aggregator->txTick) < aggregator->flushDelay) {
+		return true;
+	}
+	return NRF24L01_AggregatorFlush(aggregator);
+}
+
+bool NRF24L01_AggregatorFlush(NRF24L01_Aggregator *aggregator) {
+	if (aggregator->txSize == 0) {
+		return true;
+	}
+	if (!NRF24L01_TransmitPacket(aggregator->device, aggregator->txPacket, aggregator->txSize)) {
+		return false;
+	}
+	aggregator->txSize = 0;
+	aggregator->packets++;
+	return true;
+}
+
+bool NRF24L01_AggregatorReceive(NRF24L01_Aggregator *aggregator, uint8_t *buffer, uint8_t *size, uint32_t timeout) {
+	uint8_t recordSize;
+	uint32_t elapsed;
+	uint32_t start = HAL_GetTick();
+	while (true) {
+		//Corrupted size or count would read past received bytes, rest of the packet is dropped
+		if (aggregator->rxRemaining > 0) {
+			recordSize = aggregator->rxOffset < aggregator->rxLength ? aggregator->rxPacket[aggregator->rxOffset] : 0;
+			if (recordSize != 0 && aggregator->rxOffset + 1 + recordSize <= aggregator->rxLength) {
+				break;
+			}
+			aggregator->rxRemaining = 0;
+		}
+
+		elapsed = HAL_GetTick() - start;
+		if (elapsed >= timeout) {
+			return false;
+		}
+		if (!NRF24L01_ReceivePacketWithSize(aggregator->device, aggregator->pipe, aggregator->rxPacket,
+				&aggregator->rxLength, timeout - elapsed) || aggregator->rxLength < NRF24L01_AGGREGATOR_HEADER_SIZE
+				|| aggregator->rxPacket[0] != NRF24L01_AGGREGATOR_MARKER) {
+			continue;
+		}
+		aggregator->rxOffset = NRF24L01_AGGREGATOR_HEADER_SIZE;
+		aggregator->rxRemaining = aggregator->rxPacket[1];
+		aggregator->packets++;
+	}
+
+	*size = recordSize;
+	memcpy(buffer, &aggregator->rxPacket[aggregator->rxOffset + 1], recordSize);
+	aggregator->rxOffset += 1 + recordSize;
+	aggregator->rxRemaining--;
+	aggregator->records++;
+	return true;
+}
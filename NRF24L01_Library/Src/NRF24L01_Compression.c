@@ -0,0 +1,212 @@
+/**
+ * @brief Implementation of compression of multi-packet messages for nRF24L01+ library
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Compression.h"
+
+//Keeps at least max match of lookahead, window bytes are shifted out only when input buffer is full
+static bool NRF24L01_CompressorFill(NRF24L01_Compressor *compressor) {
+	if ((compressor->inputLength - compressor->position) >= NRF24L01_COMPRESSION_MAX_MATCH
+			|| compressor->readOffset == compressor->size) {
+		return true;
+	}
+
+	if (compressor->position > NRF24L01_COMPRESSION_WINDOW) {
+		uint16_t shift = compressor->position - NRF24L01_COMPRESSION_WINDOW;
+		memmove(compressor->input, &compressor->input[shift], compressor->inputLength - shift);
+		compressor->inputLength -= shift;
+		compressor->position -= shift;
+	}
+
+	uint32_t chunkSize;
+	while (compressor->inputLength < sizeof(compressor->input) && compressor->readOffset < compressor->size) {
+		chunkSize = sizeof(compressor->input) - compressor->inputLength;
+		if (chunkSize > compressor->size - compressor->readOffset) {
+			chunkSize = compressor->size - compressor->readOffset;
+		}
+		if (chunkSize > UINT8_MAX) {
+			chunkSize = UINT8_MAX;
+		}
+		if (!compressor->source(compressor->context, compressor->readOffset,
+				&compressor->input[compressor->inputLength], chunkSize)) {
+			compressor->failed = true;
+			return false;
+		}
+		compressor->inputLength += chunkSize;
+		compressor->readOffset += chunkSize;
+	}
+	return true;
+}
+
+//Closes open literal run, its bytes are already in place after the token
+static void NRF24L01_CompressorFlushLiterals(NRF24L01_Compressor *compressor) {
+	if (compressor->literals > 0) {
+		compressor->output[compressor->outputLength] = compressor->literals - 1;
+		compressor->outputLength += 1 + compressor->literals;
+		compressor->literals = 0;
+	}
+}
+
+//Compresses one token: the longest match within the window or a single literal byte
+static bool NRF24L01_CompressorStep(NRF24L01_Compressor *compressor) {
+	if (!NRF24L01_CompressorFill(compressor)) {
+		return false;
+	}
+
+	uint16_t available = compressor->inputLength - compressor->position;
+	if (available == 0) {
+		NRF24L01_CompressorFlushLiterals(compressor);
+		return true;
+	}
+
+	uint16_t maxLength = available < NRF24L01_COMPRESSION_MAX_MATCH ? available : NRF24L01_COMPRESSION_MAX_MATCH;
+	uint16_t maxDistance =
+			compressor->position < NRF24L01_COMPRESSION_WINDOW ? compressor->position : NRF24L01_COMPRESSION_WINDOW;
+	const uint8_t *current = &compressor->input[compressor->position];
+	const uint8_t *candidate;
+	uint16_t bestLength = 0;
+	uint16_t bestDistance = 0;
+	uint16_t length;
+	for (uint16_t distance = 1; distance <= maxDistance && bestLength < maxLength; distance++) {
+		candidate = current - distance;
+		if (candidate[0] != current[0] || candidate[bestLength] != current[bestLength]) {
+			continue;
+		}
+		length = 1;
+		while (length < maxLength && candidate[length] == current[length]) {
+			length++;
+		}
+		if (length > bestLength) {
+			bestLength = length;
+			bestDistance = distance;
+		}
+	}
+
+	if (bestLength >= NRF24L01_COMPRESSION_MIN_MATCH) {
+		NRF24L01_CompressorFlushLiterals(compressor);
+		compressor->output[compressor->outputLength++] = 0x80 | (bestLength - NRF24L01_COMPRESSION_MIN_MATCH);
+		compressor->output[compressor->outputLength++] = bestDistance - 1;
+		compressor->position += bestLength;
+	} else {
+		compressor->output[compressor->outputLength + 1 + compressor->literals] = *current;
+		compressor->literals++;
+		compressor->position++;
+		if (compressor->literals == NRF24L01_COMPRESSION_MAX_LITERALS) {
+			NRF24L01_CompressorFlushLiterals(compressor);
+		}
+	}
+	return true;
+}
+
+static bool NRF24L01_CompressorInputDone(NRF24L01_Compressor *compressor) {
+	return compressor->position == compressor->inputLength && compressor->readOffset == compressor->size;
+}
+
+void NRF24L01_CompressorInit(NRF24L01_Compressor *compressor, NRF24L01_DataSource source, void *context,
+		uint32_t size) {
+	memset(compressor, 0, sizeof(NRF24L01_Compressor));
+	compressor->source = source;
+	compressor->context = context;
+	compressor->size = size;
+}
+
+bool NRF24L01_CompressorRead(NRF24L01_Compressor *compressor, uint8_t *data, uint8_t size, uint8_t *taken) {
+	*taken = 0;
+	if (compressor->failed) {
+		return false;
+	}
+
+	while (compressor->outputLength < size
+			&& !(NRF24L01_CompressorInputDone(compressor) && compressor->literals == 0)) {
+		if (!NRF24L01_CompressorStep(compressor)) {
+			return false;
+		}
+	}
+
+	//Move the rest(with open literal run) to the front
+	*taken = compressor->outputLength < size ? compressor->outputLength : size;
+	memcpy(data, compressor->output, *taken);
+	memmove(compressor->output, &compressor->output[*taken],
+			compressor->outputLength + 1 + compressor->literals - *taken);
+	compressor->outputLength -= *taken;
+	return true;
+}
+
+bool NRF24L01_CompressorFinished(NRF24L01_Compressor *compressor) {
+	return NRF24L01_CompressorInputDone(compressor) && compressor->literals == 0 && compressor->outputLength == 0;
+}
+
+//Passes produced bytes to sink, they are contiguous as it is called at least once per window wrap
+static bool NRF24L01_DecompressorFlush(NRF24L01_Decompressor *decompressor) {
+	uint16_t index;
+	uint32_t chunkSize;
+	while (decompressor->flushed < decompressor->written) {
+		index = decompressor->flushed % NRF24L01_COMPRESSION_WINDOW;
+		chunkSize = decompressor->written - decompressor->flushed;
+		if (chunkSize > (uint32_t) (NRF24L01_COMPRESSION_WINDOW - index)) {
+			chunkSize = NRF24L01_COMPRESSION_WINDOW - index;
+		}
+		if (chunkSize > UINT8_MAX) {
+			chunkSize = UINT8_MAX;
+		}
+		if (!decompressor->sink(decompressor->context, decompressor->flushed, &decompressor->window[index],
+				chunkSize)) {
+			return false;
+		}
+		decompressor->flushed += chunkSize;
+	}
+	return true;
+}
+
+static bool NRF24L01_DecompressorPut(NRF24L01_Decompressor *decompressor, uint8_t value) {
+	decompressor->window[decompressor->written % NRF24L01_COMPRESSION_WINDOW] = value;
+	decompressor->written++;
+	if ((decompressor->written % NRF24L01_COMPRESSION_WINDOW) == 0 || decompressor->written == decompressor->size) {
+		return NRF24L01_DecompressorFlush(decompressor);
+	}
+	return true;
+}
+
+void NRF24L01_DecompressorInit(NRF24L01_Decompressor *decompressor, NRF24L01_DataSink sink, void *context,
+		uint32_t size) {
+	memset(decompressor, 0, sizeof(NRF24L01_Decompressor));
+	decompressor->sink = sink;
+	decompressor->context = context;
+	decompressor->size = size;
+}
+
+bool NRF24L01_DecompressorWrite(NRF24L01_Decompressor *decompressor, const uint8_t *data, uint8_t size) {
+	uint16_t distance;
+	for (uint8_t i = 0; i < size && decompressor->written < decompressor->size; i++) {
+		if (decompressor->literals > 0) {
+			decompressor->literals--;
+			if (!NRF24L01_DecompressorPut(decompressor, data[i])) {
+				return false;
+			}
+		} else if (decompressor->matchLength > 0) {
+			distance = data[i] + 1;
+			if (distance > decompressor->written) {
+				return false; //Reference before the start of data, stream is corrupted
+			}
+			for (uint8_t j = 0; j < decompressor->matchLength && decompressor->written < decompressor->size; j++) {
+				if (!NRF24L01_DecompressorPut(decompressor,
+						decompressor->window[(decompressor->written - distance) % NRF24L01_COMPRESSION_WINDOW])) {
+					return false;
+				}
+			}
+			decompressor->matchLength = 0;
+		} else if (data[i] & 0x80) {
+			decompressor->matchLength = (data[i] & 0x7F) + NRF24L01_COMPRESSION_MIN_MATCH;
+		} else {
+			decompressor->literals = data[i] + 1;
+		}
+	}
+	return true;
+}
+
+bool NRF24L01_DecompressorFinished(NRF24L01_Decompressor *decompressor) {
+	return decompressor->written == decompressor->size && decompressor->flushed == decompressor->size;
+}
@@ -0,0 +1,255 @@
+/**
+ * @brief Implementation of forward error correction for nRF24L01+ library
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Fec.h"
+
+static bool NRF24L01_FecSendFragment(NRF24L01_Fec *fec, uint8_t *packet, uint16_t index) {
+	packet[4] = (index >> 8) | (fec->maxRetransmissions > 0 ? NRF24L01_FEC_REPAIR_FLAG : 0);
+	packet[5] = index;
+	bool result = fec->noAck ? NRF24L01_TransmitPacketNoAck(fec->device, packet, fec->packetSize)
+			: NRF24L01_TransmitPacket(fec->device, packet, fec->packetSize);
+	fec->stats.fragments++;
+	if (!result) {
+		fec->stats.failed++;
+	}
+	return result;
+}
+
+//Header-only fragment carries no data, its ACK carries receiver's pending status. Receiver writes the status again
+//after request(repair flag), so a status request that came back without one is answered by the next one.
+static bool NRF24L01_FecRequestStatus(NRF24L01_Fec *fec, uint8_t *packet, bool request) {
+	packet[2] = NRF24L01_FEC_HEADER_SIZE;
+	packet[4] = request ? NRF24L01_FEC_REPAIR_FLAG : 0;
+	packet[5] = 0;
+	bool result = NRF24L01_TransmitPacket(fec->device, packet, NRF24L01_FEC_HEADER_SIZE);
+	packet[2] = fec->packetSize;
+	return result;
+}
+
+static void NRF24L01_FecFillFragment(uint8_t *packet, const uint8_t *data, uint16_t size, uint8_t chunkSize,
+		uint16_t fragment) {
+	uint8_t length = NRF24L01_FragmentLength(size, chunkSize, fragment);
+	memcpy(&packet[NRF24L01_FEC_HEADER_SIZE], &data[fragment * chunkSize], length);
+	memset(&packet[NRF24L01_FEC_HEADER_SIZE + length], 0x00, chunkSize - length);
+}
+
+//Sends data fragments missing from receiver's status until it has the whole message
+static bool NRF24L01_FecRepair(NRF24L01_Fec *fec, uint8_t *packet, const uint8_t *data, uint16_t size,
+		uint8_t chunkSize, uint16_t numberOfFragments, uint16_t failures) {
+	NRF24L01_ReassemblyStatus status;
+	bool queued;
+	while (true) {
+		//Request or its status was lost, ask again
+		if (!NRF24L01_FecRequestStatus(fec, packet, true)
+				|| !NRF24L01_ReassemblyReadStatus(fec->device, NRF24L01_FEC_STATUS_MARKER, fec->messageId, &status)) {
+			if (++failures > fec->maxRetransmissions) {
+				return false;
+			}
+			continue;
+		}
+		if (status.missing >= numberOfFragments) {
+			return true;
+		}
+
+		queued = false;
+		for (uint16_t fragment = status.missing;
+				fragment < numberOfFragments && fragment < status.missing + NRF24L01_REASSEMBLY_STATUS_WINDOW;
+				fragment++) {
+			if (NRF24L01_ReassemblyStatusHas(&status, fragment)) {
+				continue;
+			}
+			if (++failures > fec->maxRetransmissions) {
+				return false;
+			}
+			NRF24L01_FecFillFragment(packet, data, size, chunkSize, fragment);
+			queued = NRF24L01_FecSendFragment(fec, packet,
+					fragment / fec->groupSize * (fec->groupSize + 1) + fragment % fec->groupSize) || queued;
+			fec->stats.resent++;
+		}
+		if (fec->noAck && queued) {
+			NRF24L01_FlushNoAck(fec->device, fec->flushTimeout);
+		}
+	}
+}
+
+//XORs received fragments of the group into parity, the only missing one is what is left
+static bool NRF24L01_FecRebuild(NRF24L01_Fec *fec, uint8_t *buffer, uint16_t group, uint8_t groupSize,
+		const uint8_t *data) {
+	NRF24L01_Reassembly *rx = &fec->rx;
+	uint16_t first = group * groupSize;
+	uint16_t last = first + groupSize < rx->fragments ? first + groupSize : rx->fragments;
+	uint16_t missing = 0;
+	uint8_t missingCount = 0;
+	uint8_t parity[32 - NRF24L01_FEC_HEADER_SIZE];
+	uint8_t length;
+
+	for (uint16_t fragment = first; fragment < last; fragment++) {
+		if (!NRF24L01_ReassemblyHasFragment(rx, fragment)) {
+			missing = fragment;
+			missingCount++;
+		}
+	}
+	if (missingCount == 0) {
+		return true;
+	}
+	if (missingCount > 1) {
+		return false;
+	}
+
+	memcpy(parity, data, rx->chunkSize);
+	for (uint16_t fragment = first; fragment < last; fragment++) {
+		if (fragment == missing) {
+			continue;
+		}
+		length = NRF24L01_FragmentLength(rx->size, rx->chunkSize, fragment);
+		for (uint8_t i = 0; i < length; i++) {
+			parity[i] ^= buffer[fragment * rx->chunkSize + i];
+		}
+	}
+	NRF24L01_ReassemblyPlace(rx, buffer, missing, parity);
+	fec->stats.recovered++;
+	return true;
+}
+
+//Locates fragment in its group, the one after the group's data fragments is parity
+static NRF24L01_FragmentResult NRF24L01_FecHandleFragment(void *context, const uint8_t *packet, uint8_t *buffer) {
+	NRF24L01_Fec *fec = context;
+	if (packet[2] == NRF24L01_FEC_HEADER_SIZE) {
+		if (packet[4] & NRF24L01_FEC_REPAIR_FLAG) {
+			NRF24L01_ReassemblyWriteStatus(&fec->rx, fec->device, fec->pipe, NRF24L01_FEC_STATUS_MARKER, false);
+		}
+		return FRAGMENT_IGNORED;
+	}
+	uint8_t groupSize = packet[3];
+	if (groupSize == 0) {
+		return FRAGMENT_IGNORED;
+	}
+
+	uint16_t index = ((packet[4] & ~NRF24L01_FEC_REPAIR_FLAG) << 8) | packet[5];
+	bool repair = packet[4] & NRF24L01_FEC_REPAIR_FLAG;
+	uint16_t group = index / (groupSize + 1);
+	uint8_t position = index % (groupSize + 1);
+	if (group * groupSize >= fec->rx.fragments) {
+		return FRAGMENT_IGNORED;
+	}
+	uint8_t groupFragments = fec->rx.fragments - group * groupSize < groupSize ?
+			fec->rx.fragments - group * groupSize : groupSize;
+	fec->stats.fragments++;
+
+	//Transmitter that repairs groups sends their missing fragments again, so the message is not lost
+	if (position < groupFragments) {
+		NRF24L01_ReassemblyPlace(&fec->rx, buffer, group * groupSize + position, &packet[NRF24L01_FEC_HEADER_SIZE]);
+	} else if (position == groupFragments
+			&& !NRF24L01_FecRebuild(fec, buffer, group, groupSize, &packet[NRF24L01_FEC_HEADER_SIZE]) && !repair) {
+		fec->stats.lost++;
+		return FRAGMENT_LOST;
+	}
+	if (repair) {
+		NRF24L01_ReassemblyWriteStatus(&fec->rx, fec->device, fec->pipe, NRF24L01_FEC_STATUS_MARKER, true);
+	}
+	return FRAGMENT_ACCEPTED;
+}
+
+void NRF24L01_FecInit(NRF24L01_Fec *fec, NRF24L01_Device *device, uint8_t pipe, uint8_t packetSize,
+		uint8_t groupSize) {
+	memset(fec, 0, sizeof(NRF24L01_Fec));
+	fec->device = device;
+	fec->pipe = pipe;
+	fec->packetSize = packetSize;
+	fec->groupSize = groupSize > 0 ? groupSize : 1;
+	fec->flushTimeout = 100;
+	NRF24L01_ReassemblyInit(&fec->rx);
+}
+
+bool NRF24L01_FecSend(NRF24L01_Fec *fec, const uint8_t *data, uint16_t size) {
+	if (fec->packetSize <= NRF24L01_FEC_HEADER_SIZE || fec->packetSize > 32) {
+		return false;
+	}
+
+	uint8_t chunkSize = fec->packetSize - NRF24L01_FEC_HEADER_SIZE;
+	uint16_t numberOfFragments = NRF24L01_FragmentCount(size, chunkSize);
+	if (numberOfFragments > NRF24L01_FEC_MAX_FRAGMENTS) {
+		return false;
+	}
+
+	uint8_t packet[32];
+	uint8_t parity[32 - NRF24L01_FEC_HEADER_SIZE];
+	uint16_t index = 0;
+	uint8_t failed = 0;
+	uint16_t failures = 0;
+	bool repair = fec->maxRetransmissions > 0;
+	bool result = true;
+	NRF24L01_ReassemblyStatus status;
+
+	fec->messageId++;
+	packet[0] = NRF24L01_FEC_FRAME_MARKER;
+	packet[1] = fec->messageId;
+	packet[2] = fec->packetSize;
+	packet[3] = fec->groupSize;
+	packet[6] = size >> 8;
+	packet[7] = size;
+
+	//Status of an earlier message with the same id(e.g. sent before reboot) may be pending at receiver,
+	//it goes with the ACK of header-only fragment and is dropped together with older ones
+	if (repair) {
+		while (!NRF24L01_FecRequestStatus(fec, packet, false)) {
+			if (++failures > fec->maxRetransmissions) {
+				return false;
+			}
+		}
+		NRF24L01_ReassemblyReadStatus(fec->device, NRF24L01_FEC_STATUS_MARKER, fec->messageId, &status);
+	}
+
+	for (uint16_t fragment = 0; fragment < numberOfFragments && result; fragment++) {
+		if (fragment % fec->groupSize == 0) {
+			memset(parity, 0x00, chunkSize);
+			failed = 0;
+		}
+
+		NRF24L01_FecFillFragment(packet, data, size, chunkSize, fragment);
+		for (uint8_t i = 0; i < chunkSize; i++) {
+			parity[i] ^= packet[NRF24L01_FEC_HEADER_SIZE + i];
+		}
+		if (!NRF24L01_FecSendFragment(fec, packet, index++)) {
+			failed++;
+		}
+
+		//Group is complete, send its parity
+		if (fragment % fec->groupSize == fec->groupSize - 1 || fragment == numberOfFragments - 1) {
+			memcpy(&packet[NRF24L01_FEC_HEADER_SIZE], parity, chunkSize);
+			if (!NRF24L01_FecSendFragment(fec, packet, index++)) {
+				failed++;
+			}
+		}
+		//Group that can not be rebuilt is repaired at the end, otherwise the message is lost
+		if (failed > 1 && !repair) {
+			result = false;
+		}
+	}
+
+	//Queued fragments are not on air yet, any of them may still fail
+	if (fec->noAck && !NRF24L01_FlushNoAck(fec->device, fec->flushTimeout)) {
+		result = false;
+	}
+	if (!repair) {
+		return result;
+	}
+	return NRF24L01_FecRepair(fec, packet, data, size, chunkSize, numberOfFragments, failures);
+}
+
+bool NRF24L01_FecReceive(NRF24L01_Fec *fec, uint8_t *buffer, uint16_t bufferSize, uint16_t *size,
+		uint32_t timeout) {
+	return NRF24L01_ReassemblyReceive(&fec->rx, fec->device, fec->pipe, NRF24L01_FEC_FRAME_MARKER,
+			NRF24L01_FEC_HEADER_SIZE, NRF24L01_FecHandleFragment, fec, buffer, bufferSize, size, timeout);
+}
+
+void NRF24L01_FecGetStats(NRF24L01_Fec *fec, NRF24L01_FecStats *stats, bool reset) {
+	*stats = fec->stats;
+	if (reset) {
+		memset(&fec->stats, 0, sizeof(NRF24L01_FecStats));
+	}
+}
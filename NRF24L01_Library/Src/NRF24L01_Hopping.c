@@ -0,0 +1,170 @@
+/**
+ * @brief Implementation of frequency hopping for nRF24L01+ library
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Hopping.h"
+
+//16-bit Galois LFSR(x^16 + x^14 + x^13 + x^11 + 1), gives the same sequence on every platform
+static uint16_t NRF24L01_HoppingNextRandom(uint16_t *state) {
+	uint16_t lsb = *state & 0x0001;
+	*state >>= 1;
+	if (lsb) {
+		*state ^= 0xB400;
+	}
+	return *state;
+}
+
+static uint8_t NRF24L01_HoppingGetSlot(NRF24L01_Hopping *hopping, uint32_t tick) {
+	return ((tick - hopping->epoch) / hopping->slotTime) % hopping->numberOfChannels;
+}
+
+bool NRF24L01_HoppingInit(NRF24L01_Hopping *hopping, NRF24L01_Device *device, uint16_t seed, uint8_t firstChannel,
+		uint8_t lastChannel, uint32_t slotTime) {
+	if (firstChannel > lastChannel || lastChannel > 125 || slotTime == 0) {
+		return false;
+	}
+
+	memset(hopping, 0, sizeof(NRF24L01_Hopping));
+	hopping->device = device;
+	hopping->numberOfChannels = lastChannel - firstChannel + 1;
+	hopping->slotTime = slotTime;
+	hopping->lossTimeout = 2 * hopping->numberOfChannels * slotTime;
+
+	//Shuffle channel range(Fisher-Yates), so every channel is used once per cycle
+	uint16_t state = seed != 0 ? seed : 0xACE1; //LFSR never leaves zero state
+	uint8_t swap;
+	uint8_t j;
+	for (uint8_t i = 0; i < hopping->numberOfChannels; i++) {
+		hopping->sequence[i] = firstChannel + i;
+	}
+	for (uint8_t i = hopping->numberOfChannels - 1; i > 0; i--) {
+		j = NRF24L01_HoppingNextRandom(&state) % (i + 1);
+		swap = hopping->sequence[i];
+		hopping->sequence[i] = hopping->sequence[j];
+		hopping->sequence[j] = swap;
+	}
+
+	return true;
+}
+
+void NRF24L01_HoppingStart(NRF24L01_Hopping *hopping, bool leader) {
+	uint32_t tick = HAL_GetTick();
+	hopping->leader = leader;
+	hopping->synchronized = leader;
+	hopping->epoch = tick;
+	hopping->slot = 0;
+	hopping->lastReceivedTick = tick;
+	hopping->parkedTick = tick;
+	NRF24L01_SetChannel(hopping->device, hopping->sequence[0]);
+}
+
+void NRF24L01_HoppingUpdate(NRF24L01_Hopping *hopping) {
+	uint32_t tick = HAL_GetTick();
+
+	//Follower lost the leader, park on current channel until leader is heard again
+	if (!hopping->leader && hopping->synchronized && (tick - hopping->lastReceivedTick) >= hopping->lossTimeout) {
+		hopping->synchronized = false;
+		hopping->parkedTick = tick;
+	}
+
+	if (hopping->synchronized) {
+		hopping->slot = NRF24L01_HoppingGetSlot(hopping, tick);
+	} else if ((tick - hopping->parkedTick) >= (hopping->numberOfChannels + 1) * hopping->slotTime) {
+		//Leader visits every channel during a cycle, nothing heard for longer means this channel is jammed
+		hopping->slot = (hopping->slot + 1) % hopping->numberOfChannels;
+		hopping->parkedTick = tick;
+	}
+
+	if (NRF24L01_GetChannel(hopping->device) != hopping->sequence[hopping->slot]) {
+		NRF24L01_SetChannel(hopping->device, hopping->sequence[hopping->slot]);
+	}
+}
+
+void NRF24L01_HoppingPacketReceived(NRF24L01_Hopping *hopping) {
+	uint32_t tick = HAL_GetTick();
+	uint32_t elapsed = tick - hopping->lastReceivedTick;
+	hopping->lastReceivedTick = tick;
+	if (hopping->leader) {
+		return;
+	}
+
+	//Number of the slot since epoch in which the packet was sent, it is the one of current channel
+	//closest to follower's own slot timing
+	uint32_t slot = hopping->slot;
+	if (hopping->synchronized) {
+		uint32_t ownSlot = (tick - hopping->epoch) / hopping->slotTime;
+		int16_t difference = (hopping->slot + hopping->numberOfChannels - ownSlot % hopping->numberOfChannels)
+				% hopping->numberOfChannels;
+		if (difference > hopping->numberOfChannels / 2
+				&& ownSlot >= (uint32_t) (hopping->numberOfChannels - difference)) {
+			difference -= hopping->numberOfChannels;
+		}
+		slot = ownSlot + difference;
+	}
+
+	//Packet was sent during that slot of leader, so leader's epoch is within these bounds
+	uint32_t latest = tick - slot * hopping->slotTime;
+	uint32_t earliest = latest - hopping->slotTime + 1;
+
+	if (!hopping->synchronized) {
+		//Follower listened on this channel for more than a slot, so it heard the first packet of leader's slot
+		//and leader's slot started right before it
+		hopping->epochMin = (tick - hopping->parkedTick) >= hopping->slotTime ? latest : earliest;
+		hopping->epochMax = latest;
+		hopping->synchronized = true;
+	} else {
+		//Clocks drift apart in either direction since the previous packet(up to ~1.5%)
+		uint32_t drift = elapsed / 64 + 1;
+		hopping->epochMin -= drift;
+		hopping->epochMax += drift;
+		if ((int32_t) (earliest - hopping->epochMin) > 0) {
+			hopping->epochMin = earliest;
+		}
+		if ((int32_t) (latest - hopping->epochMax) < 0) {
+			hopping->epochMax = latest;
+		}
+
+		//Bounds do not overlap if the guess of the first packet was wrong, the packet alone is trusted then
+		if ((int32_t) (hopping->epochMax - hopping->epochMin) < 0) {
+			hopping->epochMin = earliest;
+			hopping->epochMax = latest;
+		}
+	}
+	hopping->epoch = hopping->epochMin + (hopping->epochMax - hopping->epochMin) / 2;
+}
+
+bool NRF24L01_HoppingTransmitPacket(NRF24L01_Hopping *hopping, const uint8_t *data, uint8_t size) {
+	NRF24L01_HoppingUpdate(hopping);
+	return NRF24L01_TransmitPacket(hopping->device, data, size);
+}
+
+bool NRF24L01_HoppingReceivePacket(NRF24L01_Hopping *hopping, uint8_t pipe, uint8_t *buffer, uint32_t timeout) {
+	NRF24L01_Device *device = hopping->device;
+	NRF24L01_Packet packet;
+	bool received = false;
+	if (pipe > 5 && pipe != NRF24L01_ANY_PIPE) {
+		return false;
+	}
+
+	//Radio stays in RX mode while channels are switched, restarting RX for every poll would drop CE
+	//and cost 130 us of settling each time
+	if (!NRF24L01_StartListeningNonBlocking(device)) {
+		return false;
+	}
+	uint32_t start = HAL_GetTick();
+	while (!received && (HAL_GetTick() - start) < timeout) {
+		NRF24L01_HoppingUpdate(hopping);
+		NRF24L01_Process(device, HAL_GetTick());
+		received = pipe == NRF24L01_ANY_PIPE ? NRF24L01_Read(device, &packet) : NRF24L01_ReadPipe(device, pipe, &packet);
+	}
+	NRF24L01_StopListeningNonBlocking(device);
+
+	if (received) {
+		memcpy(buffer, packet.data, packet.size);
+		NRF24L01_HoppingPacketReceived(hopping);
+	}
+	return received;
+}
@@ -0,0 +1,218 @@
+/**
+ * @brief Implementation of adaptive link controller for nRF24L01+ library
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Link.h"
+
+static const DATA_RATE levelDataRates[NRF24L01_LINK_LEVELS] = { DATA_RATE_250KBPS, DATA_RATE_1MBPS,
+		DATA_RATE_2MBPS };
+static const RETRANSMIT_DELAY levelRetransmitDelays[NRF24L01_LINK_LEVELS] = { RETR_DELAY_1500US, RETR_DELAY_750US,
+		RETR_DELAY_500US };
+//Higher data rate gives a packet up sooner, so a fading level shows up as lost packets before it stalls the link
+static const RETRANSMIT_COUNT levelRetransmitCounts[NRF24L01_LINK_LEVELS] = { RETR_TIMES_15, RETR_TIMES_10,
+		RETR_TIMES_5 };
+
+static void NRF24L01_LinkSetLevel(NRF24L01_Link *link, uint8_t level) {
+	link->level = level;
+	link->settling = true;
+	NRF24L01_SetDataRate(link->device, levelDataRates[level]);
+	NRF24L01_SetRetransmission(link->device, levelRetransmitDelays[level], levelRetransmitCounts[level]);
+}
+
+//Sends packet with link header, every packet counts into the window as a sample of link quality
+static bool NRF24L01_LinkSend(NRF24L01_Link *link, uint8_t header, const uint8_t *data, uint8_t size) {
+	uint8_t packet[32];
+	packet[0] = header;
+	if (size > 0) {
+		memcpy(&packet[NRF24L01_LINK_HEADER_SIZE], data, size);
+	}
+	bool result = NRF24L01_TransmitPacket(link->device, packet, NRF24L01_LINK_HEADER_SIZE + size);
+	link->lastTransmitTick = HAL_GetTick();
+	link->windowPackets++;
+	if (result) {
+		link->lastAckedTick = link->lastTransmitTick;
+	} else {
+		link->windowLost++;
+	}
+	return result;
+}
+
+//Leader announces new level at the old data rate and switches once follower confirmed it with ACK.
+//Step down is repeated until follower has not heard leader for followerTimeout, then follower searches lower
+//levels by itself. Unconfirmed step up is dropped, follower that took it comes back by searching.
+static void NRF24L01_LinkChangeLevel(NRF24L01_Link *link, uint8_t level) {
+	bool confirmed = NRF24L01_LinkSend(link, NRF24L01_LINK_KEEPALIVE | level, NULL, 0);
+	while (!confirmed && level < link->level && (HAL_GetTick() - link->lastAckedTick) < link->followerTimeout) {
+		confirmed = NRF24L01_LinkSend(link, NRF24L01_LINK_KEEPALIVE | level, NULL, 0);
+	}
+	if (confirmed || level < link->level) {
+		NRF24L01_LinkSetLevel(link, level);
+	}
+}
+
+static void NRF24L01_LinkStartWindow(NRF24L01_Link *link) {
+	link->windowPackets = 0;
+	link->windowLost = 0;
+	link->windowRetransmitted = link->device->packetsRetransmitted;
+}
+
+//Window has already lost more than the whole window may, failed packets cost all retries so it ends right away
+static bool NRF24L01_LinkWindowLossy(NRF24L01_Link *link) {
+	return (uint32_t) link->windowLost * 1000 > (uint32_t) link->maxLossRate * link->window;
+}
+
+static void NRF24L01_LinkEvaluate(NRF24L01_Link *link) {
+	link->lossRate = (uint32_t) link->windowLost * 1000 / link->windowPackets;
+	link->retransmitRate = (link->device->packetsRetransmitted - link->windowRetransmitted) * 1000
+			/ link->windowPackets;
+	NRF24L01_LinkStartWindow(link);
+
+	//Receiver may still be searching for the new data rate
+	if (link->settling) {
+		link->settling = false;
+		return;
+	}
+
+	bool steppedUp = link->steppedUp;
+	link->steppedUp = false;
+
+	//Degraded link: higher level failed right away, otherwise more power first, then lower data rate
+	if (link->lossRate > link->maxLossRate) {
+		link->cleanWindows = 0;
+		if (steppedUp) {
+			link->stepUpBackoff = link->stepUpBackoff < 8 ? link->stepUpBackoff * 2 : 8;
+			NRF24L01_LinkChangeLevel(link, link->level - 1);
+		} else if (link->rfPower < RF_PWR_0DBM) {
+			link->rfPower += 2;
+			NRF24L01_SetRFPower(link->device, link->rfPower);
+		} else if (link->level > 0) {
+			NRF24L01_LinkChangeLevel(link, link->level - 1);
+		}
+		return;
+	}
+	if (steppedUp) {
+		link->stepUpBackoff = 1;
+	}
+
+	//Clean link: higher data rate first, then less power
+	if (link->lossRate == 0 && link->retransmitRate <= link->maxRetransmitRate) {
+		link->cleanWindows++;
+		if (link->cleanWindows >= link->stepUpWindows * link->stepUpBackoff) {
+			link->cleanWindows = 0;
+			if (link->level < NRF24L01_LINK_LEVELS - 1) {
+				uint8_t level = link->level;
+				NRF24L01_LinkChangeLevel(link, level + 1);
+				link->steppedUp = link->level > level;
+			} else if (link->rfPower > RF_PWR_NEG18DBM) {
+				link->rfPower -= 2;
+				NRF24L01_SetRFPower(link->device, link->rfPower);
+			}
+		}
+	} else {
+		link->cleanWindows = 0;
+	}
+}
+
+bool NRF24L01_LinkInit(NRF24L01_Link *link, NRF24L01_Device *device, bool leader) {
+	NRF24L01_Config *config = device->instance.config;
+	if (leader && !device->enableStatistics) {
+		return false;
+	}
+
+	memset(link, 0, sizeof(NRF24L01_Link));
+	link->device = device;
+	link->leader = leader;
+	link->window = 50;
+	link->maxLossRate = 100;
+	link->maxRetransmitRate = 100;
+	link->stepUpWindows = 4;
+	link->keepaliveInterval = 100;
+	link->followerTimeout = 200;
+	link->stepUpBackoff = 1;
+	link->rfPower = config->rfPower;
+	link->lastTransmitTick = HAL_GetTick();
+	link->lastReceivedTick = HAL_GetTick();
+	link->lastAckedTick = HAL_GetTick();
+
+	uint8_t level = 0;
+	for (uint8_t i = 0; i < NRF24L01_LINK_LEVELS; i++) {
+		if (levelDataRates[i] == config->dataRate) {
+			level = i;
+		}
+	}
+	NRF24L01_LinkSetLevel(link, level);
+	link->settling = false;
+	NRF24L01_LinkStartWindow(link);
+	return true;
+}
+
+bool NRF24L01_LinkTransmitPacket(NRF24L01_Link *link, const uint8_t *data, uint8_t size) {
+	if (size > 32 - NRF24L01_LINK_HEADER_SIZE) {
+		return false;
+	}
+
+	bool result = NRF24L01_LinkSend(link, link->level, data, size);
+	if (link->windowPackets >= link->window || NRF24L01_LinkWindowLossy(link)) {
+		NRF24L01_LinkEvaluate(link);
+	}
+	return result;
+}
+
+bool NRF24L01_LinkUpdate(NRF24L01_Link *link) {
+	if ((HAL_GetTick() - link->lastTransmitTick) < link->keepaliveInterval) {
+		return true;
+	}
+
+	bool result = NRF24L01_LinkSend(link, NRF24L01_LINK_KEEPALIVE | link->level, NULL, 0);
+	if (link->windowPackets >= link->window || NRF24L01_LinkWindowLossy(link)) {
+		NRF24L01_LinkEvaluate(link);
+	}
+	return result;
+}
+
+bool NRF24L01_LinkReceivePacket(NRF24L01_Link *link, uint8_t pipe, uint8_t *buffer, uint32_t timeout) {
+	uint8_t packet[32];
+	uint8_t size;
+	uint8_t level;
+	uint32_t wait;
+	uint32_t silence;
+	uint32_t start = HAL_GetTick();
+	while ((HAL_GetTick() - start) < timeout) {
+		//Radio leaves RX mode after every call, so one call waits until timeout or until the next level is due
+		wait = timeout - (HAL_GetTick() - start);
+		silence = HAL_GetTick() - link->lastReceivedTick;
+		if (silence < link->followerTimeout) {
+			if (link->followerTimeout - silence < wait) {
+				wait = link->followerTimeout - silence;
+			}
+			if (NRF24L01_ReceivePacketWithSize(link->device, pipe, packet, &size, wait)) {
+				link->lastReceivedTick = HAL_GetTick();
+
+				//Leader's level is in every packet, announcement switches follower right away
+				level = packet[0] & ~NRF24L01_LINK_KEEPALIVE;
+				if (level < NRF24L01_LINK_LEVELS && level != link->level) {
+					//ACK confirms the announcement to leader, it must go out at the old data rate first
+					HAL_Delay(2);
+					NRF24L01_LinkSetLevel(link, level);
+				}
+				if (!(packet[0] & NRF24L01_LINK_KEEPALIVE)) {
+					memcpy(buffer, &packet[NRF24L01_LINK_HEADER_SIZE], size - NRF24L01_LINK_HEADER_SIZE);
+					return true;
+				}
+				continue;
+			}
+		}
+
+		//Announcement and keepalives were missed, leader is at another data rate. Announcement of a step down is
+		//sent over the failing link and is the one most likely lost, so lower levels are tried first
+		if ((HAL_GetTick() - link->lastReceivedTick) >= link->followerTimeout) {
+			NRF24L01_LinkSetLevel(link, (link->level + NRF24L01_LINK_LEVELS - 1) % NRF24L01_LINK_LEVELS);
+			link->lastReceivedTick = HAL_GetTick();
+		}
+	}
+
+	return false;
+}
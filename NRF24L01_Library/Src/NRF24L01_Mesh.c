@@ -0,0 +1,320 @@
+/**
+ * @brief Implementation of multi-hop mesh routing layer for nRF24L01+ library
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Mesh.h"
+
+//Number of digits in address, 0 for the gateway
+static uint8_t NRF24L01_MeshGetLevel(uint16_t address) {
+	uint8_t level = 0;
+	while (address != 0) {
+		address >>= 3;
+		level++;
+	}
+	return level;
+}
+
+//Address of ancestor at given level, e.g. level 1 of 0543 is 03
+static uint16_t NRF24L01_MeshGetAncestor(uint16_t address, uint8_t level) {
+	return address & ((1 << (3 * level)) - 1);
+}
+
+//16-bit xorshift, only spreads retries of nodes, so quality does not matter
+static uint16_t NRF24L01_MeshNextRandom(NRF24L01_Mesh *mesh) {
+	mesh->random ^= mesh->random << 7;
+	mesh->random ^= mesh->random >> 9;
+	mesh->random ^= mesh->random << 8;
+	return mesh->random;
+}
+
+//Nodes with the same retransmit delay that collided would collide again on every automatic retransmission,
+//so every node waits 0-750 us longer than configured, drawn again after every failed attempt
+static void NRF24L01_MeshSpreadRetransmitDelay(NRF24L01_Mesh *mesh) {
+	NRF24L01_Config *config = mesh->device->instance.config;
+	uint8_t delay = (config->retransmitDelay >> 4) + NRF24L01_MeshNextRandom(mesh) % 4;
+	NRF24L01_SetRetransmission(mesh->device, (RETRANSMIT_DELAY) ((delay < 0x0F ? delay : 0x0F) << 4),
+			config->retransmitCount);
+}
+
+static uint16_t NRF24L01_MeshGetUInt16(const uint8_t *data) {
+	return (data[0] << 8) | data[1];
+}
+
+static void NRF24L01_MeshPutUInt16(uint8_t *data, uint16_t value) {
+	data[0] = value >> 8;
+	data[1] = value;
+}
+
+//Returns true if frame was already seen, otherwise remembers it
+static bool NRF24L01_MeshCheckSeen(NRF24L01_Mesh *mesh, uint16_t source, uint8_t messageId) {
+	uint32_t key = (1UL << 24) | ((uint32_t) source << 8) | messageId;
+	for (uint8_t i = 0; i < NRF24L01_MESH_SEEN_DEPTH; i++) {
+		if (mesh->seen[i] == key) {
+			return true;
+		}
+	}
+	mesh->seen[mesh->seenNext] = key;
+	mesh->seenNext = (mesh->seenNext + 1) % NRF24L01_MESH_SEEN_DEPTH;
+	return false;
+}
+
+static bool NRF24L01_MeshEnqueue(NRF24L01_Mesh *mesh, const uint8_t *frame, uint8_t size) {
+	if (mesh->queueCount == NRF24L01_MESH_QUEUE_DEPTH) {
+		mesh->stats.dropped++;
+		return false;
+	}
+
+	NRF24L01_MeshFrame *entry = &mesh->queue[(mesh->queueHead + mesh->queueCount) % NRF24L01_MESH_QUEUE_DEPTH];
+	memcpy(entry->data, frame, size);
+	entry->size = size;
+	entry->attempts = 0;
+	entry->tick = HAL_GetTick();
+	mesh->queueCount++;
+	if (mesh->queueCount > mesh->stats.queueHighWater) {
+		mesh->stats.queueHighWater = mesh->queueCount;
+	}
+	return true;
+}
+
+static void NRF24L01_MeshDeliver(NRF24L01_Mesh *mesh, const uint8_t *frame, uint8_t size) {
+	if (mesh->inboxCount == NRF24L01_MESH_INBOX_DEPTH) {
+		mesh->stats.dropped++;
+		return;
+	}
+
+	NRF24L01_MeshFrame *entry = &mesh->inbox[(mesh->inboxHead + mesh->inboxCount) % NRF24L01_MESH_INBOX_DEPTH];
+	memcpy(entry->data, frame, size);
+	entry->size = size;
+	mesh->inboxCount++;
+
+	uint32_t latency = NRF24L01_MeshGetUInt16(&frame[7]);
+	uint8_t hops = frame[6];
+	NRF24L01_MeshStats *stats = &mesh->stats;
+	if (stats->received == 0 || latency < stats->latencyMin) {
+		stats->latencyMin = latency;
+	}
+	if (latency > stats->latencyMax) {
+		stats->latencyMax = latency;
+	}
+	if (stats->received == 0 || hops < stats->hopsMin) {
+		stats->hopsMin = hops;
+	}
+	if (hops > stats->hopsMax) {
+		stats->hopsMax = hops;
+	}
+	stats->latencyTotal += latency;
+	stats->hopsTotal += hops;
+	stats->received++;
+}
+
+static void NRF24L01_MeshHandleFrame(NRF24L01_Mesh *mesh, uint8_t *frame) {
+	//Skip stray packets
+	if (frame[0] != NRF24L01_MESH_FRAME_MARKER || frame[9] > NRF24L01_MESH_MAX_PAYLOAD) {
+		return;
+	}
+
+	uint16_t source = NRF24L01_MeshGetUInt16(&frame[1]);
+	uint16_t destination = NRF24L01_MeshGetUInt16(&frame[3]);
+	if (NRF24L01_MeshCheckSeen(mesh, source, frame[5])) {
+		mesh->stats.duplicates++;
+		return;
+	}
+
+	frame[6]++; //Hop that just delivered the frame
+	uint8_t size = NRF24L01_MESH_HEADER_SIZE + frame[9];
+	if (destination == mesh->address) {
+		NRF24L01_MeshDeliver(mesh, frame, size);
+	} else if (frame[6] >= NRF24L01_MESH_MAX_HOPS) {
+		mesh->stats.dropped++; //Misconfigured tree, e.g. two nodes with the same address
+	} else {
+		NRF24L01_MeshEnqueue(mesh, frame, size);
+	}
+}
+
+//Address node listens at for frames from parent(from 0) or from child with given digit(from 1-5), pipes 2-5
+//replace the first byte sent to the chip, which is the most significant one, so the neighbours differ in it
+static uint64_t NRF24L01_MeshGetRxAddress(uint16_t address, uint8_t from) {
+	return NRF24L01_MESH_BASE_ADDRESS ^ ((uint64_t) address << 8) ^ ((uint64_t) from << 32);
+}
+
+//Points pipe 0 back to frames of child 5, while transmitting it takes ACKs of the next hop
+static bool NRF24L01_MeshParkPipe0(NRF24L01_Mesh *mesh) {
+	mesh->txAddress = -1;
+	return NRF24L01_SetRxAddress(mesh->device, 0, NRF24L01_MeshGetRxAddress(mesh->address, 5));
+}
+
+//Slot of the head is free, so the frame taken from it is moved to the tail
+static void NRF24L01_MeshRequeue(NRF24L01_Mesh *mesh, NRF24L01_MeshFrame *entry) {
+	NRF24L01_MeshFrame *tail = &mesh->queue[(mesh->queueHead + mesh->queueCount) % NRF24L01_MESH_QUEUE_DEPTH];
+	if (tail != entry) {
+		memcpy(tail, entry, sizeof(NRF24L01_MeshFrame));
+	}
+	mesh->queueCount++;
+}
+
+//Tries to pass the oldest queued frame to the next hop, returns it to the end of the queue if it failed.
+//Next hop that did not answer is stored to failedHop, its other frames wait for the next update
+static void NRF24L01_MeshSendHead(NRF24L01_Mesh *mesh, int32_t *failedHop) {
+	NRF24L01_MeshFrame *entry = &mesh->queue[mesh->queueHead];
+	mesh->queueHead = (mesh->queueHead + 1) % NRF24L01_MESH_QUEUE_DEPTH;
+	mesh->queueCount--;
+
+	//Frame that failed waits for its backoff, while frames behind it go on
+	uint32_t now = HAL_GetTick();
+	uint16_t nextHop = NRF24L01_MeshGetNextHop(mesh->address, NRF24L01_MeshGetUInt16(&entry->data[3]));
+	if ((entry->attempts > 0 && (now - entry->tick) < entry->backoff) || *failedHop == nextHop) {
+		NRF24L01_MeshRequeue(mesh, entry);
+		return;
+	}
+
+	//Time spent in this node is added before every attempt, so retries count too
+	uint32_t age = NRF24L01_MeshGetUInt16(&entry->data[7]) + (now - entry->tick);
+	NRF24L01_MeshPutUInt16(&entry->data[7], age > UINT16_MAX ? UINT16_MAX : age);
+	entry->tick = now;
+
+	//Parent is reached at the address of this node's digit, children at the one for their parent
+	uint8_t level = NRF24L01_MeshGetLevel(mesh->address);
+	uint8_t from = NRF24L01_MeshGetLevel(nextHop) > level ? 0 : (mesh->address >> (3 * (level - 1))) & 0x07;
+	if (mesh->txAddress != nextHop
+			&& NRF24L01_SetTxAddress(mesh->device, NRF24L01_MeshGetRxAddress(nextHop, from))) {
+		mesh->txAddress = nextHop;
+	}
+
+	if (NRF24L01_TransmitPacket(mesh->device, entry->data, entry->size)) {
+		if (NRF24L01_MeshGetUInt16(&entry->data[1]) != mesh->address) {
+			mesh->stats.forwarded++;
+		}
+		return;
+	}
+
+	//Neighbour that is transmitting itself does not hear, so the node goes back to listening sooner
+	*failedHop = nextHop;
+	if (++entry->attempts >= mesh->maxAttempts) {
+		mesh->stats.failed++;
+		return;
+	}
+
+	//Frames that collided are not sent at the same time again: random backoff doubles after every attempt
+	entry->backoff = NRF24L01_MeshNextRandom(mesh) % (NRF24L01_MESH_BACKOFF << entry->attempts);
+	NRF24L01_MeshSpreadRetransmitDelay(mesh);
+	NRF24L01_MeshRequeue(mesh, entry);
+}
+
+bool NRF24L01_MeshIsValidAddress(uint16_t address) {
+	uint8_t digit;
+	for (uint8_t level = 0; level < NRF24L01_MESH_MAX_LEVELS && address != 0; level++) {
+		digit = address & 0x07;
+		if (digit == 0 || digit > 5) {
+			return false;
+		}
+		address >>= 3;
+	}
+	return address == 0;
+}
+
+uint16_t NRF24L01_MeshGetNextHop(uint16_t address, uint16_t destination) {
+	uint8_t level = NRF24L01_MeshGetLevel(address);
+	if (destination != address && NRF24L01_MeshGetAncestor(destination, level) == address) {
+		return NRF24L01_MeshGetAncestor(destination, level + 1);
+	}
+	return level > 0 ? NRF24L01_MeshGetAncestor(address, level - 1) : NRF24L01_MESH_GATEWAY;
+}
+
+bool NRF24L01_MeshInit(NRF24L01_Mesh *mesh, NRF24L01_Device *device, uint16_t address) {
+	if (!NRF24L01_MeshIsValidAddress(address)) {
+		return false;
+	}
+
+	memset(mesh, 0, sizeof(NRF24L01_Mesh));
+	mesh->device = device;
+	mesh->address = address;
+	mesh->maxAttempts = 5;
+	mesh->random = (address * 0x9E37) ^ DWT->CYCCNT;
+	if (mesh->random == 0) {
+		mesh->random = 0xACE1; //Xorshift never leaves zero state
+	}
+	NRF24L01_MeshSpreadRetransmitDelay(mesh);
+
+	//Pipe 1 for parent, pipes 2-5 for children 1-4, pipe 0 for child 5
+	bool result = NRF24L01_SetRxAddress(device, 1, NRF24L01_MeshGetRxAddress(address, 0));
+	for (uint8_t pipe = 2; pipe < 6; pipe++) {
+		result = result && NRF24L01_SetRxAddress(device, pipe, NRF24L01_MeshGetRxAddress(address, pipe - 1) >> 32);
+	}
+	return result && NRF24L01_MeshParkPipe0(mesh);
+}
+
+bool NRF24L01_MeshSend(NRF24L01_Mesh *mesh, uint16_t destination, const uint8_t *data, uint8_t size) {
+	if (size > NRF24L01_MESH_MAX_PAYLOAD || destination == mesh->address
+			|| !NRF24L01_MeshIsValidAddress(destination)) {
+		return false;
+	}
+
+	uint8_t frame[32];
+	frame[0] = NRF24L01_MESH_FRAME_MARKER;
+	NRF24L01_MeshPutUInt16(&frame[1], mesh->address);
+	NRF24L01_MeshPutUInt16(&frame[3], destination);
+	frame[5] = ++mesh->messageId;
+	frame[6] = 0;
+	NRF24L01_MeshPutUInt16(&frame[7], 0);
+	frame[9] = size;
+	memcpy(&frame[NRF24L01_MESH_HEADER_SIZE], data, size);
+
+	if (!NRF24L01_MeshEnqueue(mesh, frame, NRF24L01_MESH_HEADER_SIZE + size)) {
+		return false;
+	}
+	NRF24L01_MeshCheckSeen(mesh, mesh->address, frame[5]); //Echo of own frame is not forwarded again
+	mesh->stats.sent++;
+	return true;
+}
+
+bool NRF24L01_MeshUpdate(NRF24L01_Mesh *mesh, uint32_t timeout) {
+	if (mesh->queueCount > 0) {
+		int32_t failedHop = -1;
+		for (uint8_t pending = mesh->queueCount; pending > 0; pending--) {
+			NRF24L01_MeshSendHead(mesh, &failedHop);
+		}
+		NRF24L01_MeshParkPipe0(mesh);
+	}
+
+	//After the first frame only frames that follow shortly are taken, so forwarding is not delayed by timeout
+	uint8_t packet[32];
+	uint32_t start = HAL_GetTick();
+	uint32_t elapsed;
+	bool received = false;
+	while ((elapsed = HAL_GetTick() - start) < timeout) {
+		if (!NRF24L01_ReceivePacket(mesh->device, NRF24L01_ANY_PIPE, packet, received ? 1 : timeout - elapsed)) {
+			if (received) {
+				break;
+			}
+			continue;
+		}
+		NRF24L01_MeshHandleFrame(mesh, packet);
+		received = true;
+	}
+	return received;
+}
+
+bool NRF24L01_MeshReceive(NRF24L01_Mesh *mesh, uint16_t *source, uint8_t *buffer, uint8_t *size) {
+	if (mesh->inboxCount == 0) {
+		return false;
+	}
+
+	NRF24L01_MeshFrame *entry = &mesh->inbox[mesh->inboxHead];
+	*source = NRF24L01_MeshGetUInt16(&entry->data[1]);
+	*size = entry->data[9];
+	memcpy(buffer, &entry->data[NRF24L01_MESH_HEADER_SIZE], *size);
+	mesh->inboxHead = (mesh->inboxHead + 1) % NRF24L01_MESH_INBOX_DEPTH;
+	mesh->inboxCount--;
+	return true;
+}
+
+void NRF24L01_MeshGetStats(NRF24L01_Mesh *mesh, NRF24L01_MeshStats *stats, bool reset) {
+	*stats = mesh->stats;
+	stats->latencyAverage = stats->received > 0 ? stats->latencyTotal / stats->received : 0;
+	if (reset) {
+		memset(&mesh->stats, 0, sizeof(NRF24L01_MeshStats));
+	}
+}
@@ -0,0 +1,169 @@
+/**
+ * @brief Implementation of reassembly of fragmented messages for nRF24L01+ library
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Reassembly.h"
+
+uint16_t NRF24L01_FragmentCount(uint16_t size, uint8_t chunkSize) {
+	return size == 0 ? 1 : (size + chunkSize - 1) / chunkSize;
+}
+
+uint8_t NRF24L01_FragmentLength(uint16_t size, uint8_t chunkSize, uint16_t fragment) {
+	uint16_t offset = fragment * chunkSize;
+	return size - offset < chunkSize ? size - offset : chunkSize;
+}
+
+void NRF24L01_ReassemblyInit(NRF24L01_Reassembly *reassembly) {
+	memset(reassembly, 0, sizeof(NRF24L01_Reassembly));
+	reassembly->lastReceivedId = -1;
+}
+
+bool NRF24L01_ReassemblyHasFragment(NRF24L01_Reassembly *reassembly, uint16_t fragment) {
+	return reassembly->bitmap[fragment / 8] & (1 << (fragment % 8));
+}
+
+bool NRF24L01_ReassemblyPlace(NRF24L01_Reassembly *reassembly, uint8_t *buffer, uint16_t fragment,
+		const uint8_t *data) {
+	if (fragment >= reassembly->fragments || NRF24L01_ReassemblyHasFragment(reassembly, fragment)) {
+		return false;
+	}
+	memcpy(&buffer[fragment * reassembly->chunkSize], data,
+			NRF24L01_FragmentLength(reassembly->size, reassembly->chunkSize, fragment));
+	reassembly->bitmap[fragment / 8] |= 1 << (fragment % 8);
+	reassembly->received++;
+	return true;
+}
+
+void NRF24L01_ReassemblyWriteStatus(NRF24L01_Reassembly *reassembly, NRF24L01_Device *device, uint8_t pipe,
+		uint8_t marker, bool replace) {
+	uint8_t status[NRF24L01_REASSEMBLY_STATUS_SIZE] = { 0 };
+	uint16_t missing = 0;
+	while (missing < reassembly->fragments && NRF24L01_ReassemblyHasFragment(reassembly, missing)) {
+		missing++;
+	}
+
+	status[0] = marker;
+	status[1] = reassembly->messageId;
+	status[2] = missing >> 8;
+	status[3] = missing;
+	for (uint8_t i = 0; i < NRF24L01_REASSEMBLY_STATUS_WINDOW && missing + i < reassembly->fragments; i++) {
+		if (NRF24L01_ReassemblyHasFragment(reassembly, missing + i)) {
+			status[4 + i / 8] |= 1 << (i % 8);
+		}
+	}
+	if (replace) {
+		NRF24L01_FlushAckPayloads(device);
+	}
+	NRF24L01_WriteAckPayload(device, pipe, status, sizeof(status));
+}
+
+bool NRF24L01_ReassemblyReadStatus(NRF24L01_Device *device, uint8_t marker, uint8_t messageId,
+		NRF24L01_ReassemblyStatus *status) {
+	NRF24L01_Packet ack;
+	bool found = false;
+	//Receiver only adds fragments, so the latest status covers the earlier ones
+	while (NRF24L01_ReadAckPayload(device, &ack)) {
+		if (ack.size != NRF24L01_REASSEMBLY_STATUS_SIZE || ack.data[0] != marker || ack.data[1] != messageId) {
+			continue;
+		}
+		status->missing = (ack.data[2] << 8) | ack.data[3];
+		memcpy(status->bitmap, &ack.data[4], sizeof(status->bitmap));
+		found = true;
+	}
+	return found;
+}
+
+bool NRF24L01_ReassemblyStatusHas(const NRF24L01_ReassemblyStatus *status, uint16_t fragment) {
+	if (fragment < status->missing) {
+		return true;
+	}
+	uint16_t offset = fragment - status->missing;
+	return offset < NRF24L01_REASSEMBLY_STATUS_WINDOW && (status->bitmap[offset / 8] & (1 << (offset % 8)));
+}
+
+bool NRF24L01_ReassemblyReceive(NRF24L01_Reassembly *reassembly, NRF24L01_Device *device, uint8_t pipe,
+		uint8_t marker, uint8_t headerSize, NRF24L01_FragmentHandler handler, void *context, uint8_t *buffer,
+		uint16_t bufferSize, uint16_t *size, uint32_t timeout) {
+	NRF24L01_Packet received;
+	uint8_t *packet = received.data;
+	NRF24L01_FragmentResult result;
+	bool complete = false;
+	bool accepted = false;
+
+	//Radio stays in RX mode for the whole message, every CE toggle would cost 130 us of settling and
+	//fragments sent without ACK arrive back-to-back. Polled path keeps them out of onPacketReceived callback.
+	if (!NRF24L01_StartListeningNonBlocking(device)) {
+		return false;
+	}
+	uint32_t start = HAL_GetTick();
+	while ((HAL_GetTick() - start) < timeout) {
+		NRF24L01_Process(device, HAL_GetTick());
+		if (!NRF24L01_ReadPipe(device, pipe, &received)) {
+			continue;
+		}
+
+		//Skip stray packets and truncated fragments
+		if (packet[0] != marker || packet[2] < headerSize || packet[2] > received.size) {
+			continue;
+		}
+
+		//Header-only frame is protocol's request about the last message, it carries no data
+		if (packet[2] == headerSize) {
+			if (reassembly->fragments > 0 && packet[1] == reassembly->messageId) {
+				handler(context, packet, buffer);
+			}
+			continue;
+		}
+
+		//Skip late fragments of already received or lost message
+		if (packet[1] == reassembly->lastReceivedId) {
+			continue;
+		}
+
+		//First fragment of a new message(sender abandons previous one when it starts the next)
+		if (!reassembly->active || packet[1] != reassembly->messageId) {
+			uint16_t messageSize = (packet[headerSize - 2] << 8) | packet[headerSize - 1];
+			uint8_t chunkSize = packet[2] - headerSize;
+			uint16_t numberOfFragments = NRF24L01_FragmentCount(messageSize, chunkSize);
+			if (messageSize > bufferSize || numberOfFragments > NRF24L01_REASSEMBLY_MAX_FRAGMENTS) {
+				continue;
+			}
+			reassembly->active = true;
+			reassembly->messageId = packet[1];
+			reassembly->size = messageSize;
+			reassembly->chunkSize = chunkSize;
+			reassembly->fragments = numberOfFragments;
+			reassembly->received = 0;
+			memset(reassembly->bitmap, 0, sizeof(reassembly->bitmap));
+		}
+
+		result = handler(context, packet, buffer);
+		if (result == FRAGMENT_IGNORED) {
+			continue;
+		}
+		start = HAL_GetTick();
+		accepted = true;
+
+		if (result == FRAGMENT_LOST || reassembly->received == reassembly->fragments) {
+			reassembly->active = false;
+			reassembly->lastReceivedId = reassembly->messageId;
+			if (result == FRAGMENT_ACCEPTED) {
+				*size = reassembly->size;
+				complete = true;
+			}
+			break;
+		}
+	}
+
+	NRF24L01_StopListeningNonBlocking(device);
+
+	//Late fragments of the last message would have arrived by now, so the next message with the same id
+	//(e.g. first one of a rebooted sender) is not dropped
+	if (!accepted) {
+		reassembly->lastReceivedId = -1;
+	}
+	return complete;
+}
@@ -0,0 +1,367 @@
+/**
+ * @brief Implementation of TDMA slot scheduler for nRF24L01+ library
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Tdma.h"
+
+static uint32_t NRF24L01_TdmaUsToCycles(uint32_t us) {
+	return us * (SystemCoreClock / 1000000);
+}
+
+static uint32_t NRF24L01_TdmaGetSuperframeCycles(NRF24L01_Tdma *tdma) {
+	return NRF24L01_TdmaUsToCycles((tdma->numberOfSlots + 2) * (uint32_t) tdma->slotTime);
+}
+
+//Transmission in a slot starts after guard time, slot 0 is beacon slot, slot numberOfSlots + 1 is join slot
+static uint32_t NRF24L01_TdmaGetSlotStart(NRF24L01_Tdma *tdma, uint8_t slot) {
+	return tdma->beaconCycles + NRF24L01_TdmaUsToCycles(slot * (uint32_t) tdma->slotTime + NRF24L01_TDMA_GUARD_TIME);
+}
+
+static bool NRF24L01_TdmaReached(uint32_t cycles) {
+	return (int32_t) (DWT->CYCCNT - cycles) >= 0;
+}
+
+//Returns false if waiting would end after deadline(HAL tick)
+static bool NRF24L01_TdmaWaitUntil(uint32_t cycles, uint32_t deadline) {
+	uint32_t remaining = (int32_t) (cycles - DWT->CYCCNT) > 0 ? cycles - DWT->CYCCNT : 0;
+	if ((int32_t) (deadline - HAL_GetTick()) <= (int32_t) (remaining / NRF24L01_TdmaUsToCycles(1000))) {
+		return false;
+	}
+	while (!NRF24L01_TdmaReached(cycles))
+		;
+	return true;
+}
+
+//16-bit xorshift, only spreads join requests of nodes, so quality does not matter
+static uint16_t NRF24L01_TdmaNextRandom(NRF24L01_Tdma *tdma) {
+	tdma->random ^= tdma->random << 7;
+	tdma->random ^= tdma->random >> 9;
+	tdma->random ^= tdma->random << 8;
+	return tdma->random;
+}
+
+static void NRF24L01_TdmaInit(NRF24L01_Tdma *tdma, NRF24L01_Device *device, uint64_t beaconAddress,
+		uint64_t uplinkAddress) {
+	memset(tdma, 0, sizeof(NRF24L01_Tdma));
+	tdma->device = device;
+	tdma->beaconAddress = beaconAddress;
+	tdma->uplinkAddress = uplinkAddress;
+	tdma->resyncInterval = 8;
+}
+
+static void NRF24L01_TdmaSendBeacon(NRF24L01_Tdma *tdma) {
+	uint8_t packet[32];
+	packet[0] = NRF24L01_TDMA_BEACON_MARKER;
+	packet[1] = ++tdma->sequence;
+	packet[2] = tdma->numberOfSlots;
+	packet[3] = tdma->slotTime >> 8;
+	packet[4] = tdma->slotTime;
+	packet[5] = tdma->numberOfSlots + 1;
+	while (packet[5] > 1 && tdma->slotOwners[packet[5] - 1] == 0) {
+		packet[5]--;
+	}
+
+	//Announce assigned slots in rotation, so every node hears its slot within a few superframes
+	uint8_t count = 0;
+	uint8_t slot = tdma->announceSlot;
+	for (uint8_t i = 0; i < tdma->numberOfSlots && count < NRF24L01_TDMA_BEACON_ASSIGNMENTS; i++) {
+		if (tdma->slotOwners[slot] != 0) {
+			packet[NRF24L01_TDMA_BEACON_HEADER_SIZE + 2 * count] = tdma->slotOwners[slot];
+			packet[NRF24L01_TDMA_BEACON_HEADER_SIZE + 2 * count + 1] = slot;
+			count++;
+		}
+		slot = slot % tdma->numberOfSlots + 1;
+	}
+	tdma->announceSlot = slot;
+	tdma->assigned = false;
+	packet[6] = count;
+
+	NRF24L01_TransmitPacketNoAck(tdma->device, packet, NRF24L01_TDMA_BEACON_HEADER_SIZE + 2 * count);
+	NRF24L01_FlushNoAck(tdma->device, 10);
+	tdma->stats.beacons++;
+}
+
+//Assigns the first free data slot, node that joins again(e.g. after reset) keeps its slot
+static void NRF24L01_TdmaAssignSlot(NRF24L01_Tdma *tdma, uint8_t nodeId) {
+	if (nodeId == 0) {
+		return;
+	}
+
+	uint8_t freeSlot = NRF24L01_TDMA_NO_SLOT;
+	for (uint8_t slot = tdma->numberOfSlots; slot > 0; slot--) {
+		if (tdma->slotOwners[slot] == nodeId) {
+			freeSlot = slot;
+			break;
+		}
+		if (tdma->slotOwners[slot] == 0) {
+			freeSlot = slot;
+		}
+	}
+
+	//All slots are taken, node keeps requesting until one is released
+	if (freeSlot == NRF24L01_TDMA_NO_SLOT) {
+		return;
+	}
+	if (tdma->slotOwners[freeSlot] != nodeId) {
+		tdma->slotOwners[freeSlot] = nodeId;
+		tdma->stats.joins++;
+	}
+
+	//Slots are assigned in ascending order, so the next beacon announces all of this superframe
+	if (!tdma->assigned) {
+		tdma->announceSlot = freeSlot;
+		tdma->assigned = true;
+	}
+}
+
+static void NRF24L01_TdmaParseBeacon(NRF24L01_Tdma *tdma, const uint8_t *packet, uint32_t cycles) {
+	uint16_t slotTime = (packet[3] << 8) | packet[4];
+	if (packet[2] == 0 || packet[2] > NRF24L01_TDMA_MAX_SLOTS || slotTime <= NRF24L01_TDMA_GUARD_TIME
+			|| packet[5] == 0 || packet[5] > packet[2] + 1 || packet[6] > NRF24L01_TDMA_BEACON_ASSIGNMENTS) {
+		return;
+	}
+
+	tdma->sequence = packet[1];
+	tdma->numberOfSlots = packet[2];
+	tdma->slotTime = slotTime;
+	tdma->joinFrom = packet[5];
+	tdma->beaconCycles = cycles;
+	tdma->beaconTick = HAL_GetTick();
+	tdma->predictedBeacons = 0;
+	tdma->synchronized = true;
+	tdma->stats.beacons++;
+
+	//Slot announced for another node means gateway has restarted and reassigned it
+	const uint8_t *assignment;
+	for (uint8_t i = 0; i < packet[6]; i++) {
+		assignment = &packet[NRF24L01_TDMA_BEACON_HEADER_SIZE + 2 * i];
+		if (assignment[0] == tdma->nodeId) {
+			tdma->slot = assignment[1];
+			tdma->joinWindow = 1;
+			tdma->joinDelay = 0;
+		} else if (assignment[1] == tdma->slot) {
+			tdma->slot = NRF24L01_TDMA_NO_SLOT;
+		}
+	}
+}
+
+static bool NRF24L01_TdmaWaitForBeacon(NRF24L01_Tdma *tdma, uint32_t deadline) {
+	uint8_t packet[32];
+	uint32_t start = HAL_GetTick();
+	uint32_t listenTime = tdma->numberOfSlots != 0 ?
+			2 * (tdma->numberOfSlots + 2) * (uint32_t) tdma->slotTime / 1000 + 1 : UINT32_MAX;
+	uint32_t wait;
+
+	//Radio leaves RX mode after every call and needs 130 us to enter it again, so one call waits until a packet
+	//or the end of listening, otherwise beacons sent in step with the tick could fall into that gap every time
+	NRF24L01_SetRxAddress(tdma->device, 0, tdma->beaconAddress);
+	while ((HAL_GetTick() - start) < listenTime && (int32_t) (deadline - HAL_GetTick()) > 0) {
+		wait = deadline - HAL_GetTick();
+		if (listenTime - (HAL_GetTick() - start) < wait) {
+			wait = listenTime - (HAL_GetTick() - start);
+		}
+		if (NRF24L01_ReceivePacket(tdma->device, 0, packet, wait) && packet[0] == NRF24L01_TDMA_BEACON_MARKER) {
+			NRF24L01_TdmaParseBeacon(tdma, packet, DWT->CYCCNT);
+			if (tdma->synchronized) {
+				return true;
+			}
+		}
+	}
+
+	if ((HAL_GetTick() - start) >= listenTime) {
+		tdma->stats.missedBeacons++;
+	}
+	return false;
+}
+
+//Moves beacon time to the current superframe, real beacon is required after resyncInterval superframes
+static void NRF24L01_TdmaPredictBeacon(NRF24L01_Tdma *tdma) {
+	uint32_t superframe = NRF24L01_TdmaGetSuperframeCycles(tdma);
+	uint32_t resyncTime = (tdma->resyncInterval + 1) * (tdma->numberOfSlots + 2) * (uint32_t) tdma->slotTime / 1000;
+	if ((HAL_GetTick() - tdma->beaconTick) > resyncTime) {
+		tdma->synchronized = false; //Idle for long, cycle counter difference may overflow
+	}
+
+	while (tdma->synchronized && NRF24L01_TdmaReached(tdma->beaconCycles + superframe)) {
+		tdma->beaconCycles += superframe;
+		if (++tdma->predictedBeacons >= tdma->resyncInterval) {
+			tdma->synchronized = false;
+		}
+	}
+}
+
+//Sends join request in a random free slot of current superframe or counts down backoff
+static void NRF24L01_TdmaJoin(NRF24L01_Tdma *tdma, uint32_t deadline) {
+	if (tdma->joinDelay > 0) {
+		tdma->joinDelay--;
+		return;
+	}
+
+	uint8_t slot = tdma->joinFrom + NRF24L01_TdmaNextRandom(tdma) % (tdma->numberOfSlots + 2 - tdma->joinFrom);
+	uint32_t slotStart = NRF24L01_TdmaGetSlotStart(tdma, slot);
+	if (NRF24L01_TdmaReached(slotStart) || !NRF24L01_TdmaWaitUntil(slotStart, deadline)) {
+		return;
+	}
+	uint8_t packet[2] = { NRF24L01_TDMA_JOIN_MARKER, tdma->nodeId };
+	NRF24L01_SetTxAddress(tdma->device, tdma->uplinkAddress);
+	NRF24L01_TransmitPacket(tdma->device, packet, sizeof(packet));
+	tdma->stats.joins++;
+
+	//Even acknowledged request waits for assignment in a beacon, so the backoff applies anyway
+	tdma->joinDelay = NRF24L01_TdmaNextRandom(tdma) % tdma->joinWindow;
+	if (tdma->joinWindow < NRF24L01_TDMA_MAX_JOIN_BACKOFF) {
+		tdma->joinWindow *= 2;
+	}
+}
+
+bool NRF24L01_TdmaInitGateway(NRF24L01_Tdma *tdma, NRF24L01_Device *device, uint64_t beaconAddress,
+		uint64_t uplinkAddress, uint8_t numberOfSlots, uint16_t slotTime) {
+	if (numberOfSlots == 0 || numberOfSlots > NRF24L01_TDMA_MAX_SLOTS || slotTime <= NRF24L01_TDMA_GUARD_TIME
+			|| (numberOfSlots + 2) * (uint32_t) slotTime > NRF24L01_TDMA_MAX_SUPERFRAME) {
+		return false;
+	}
+
+	NRF24L01_TdmaInit(tdma, device, beaconAddress, uplinkAddress);
+	tdma->gateway = true;
+	tdma->numberOfSlots = numberOfSlots;
+	tdma->slotTime = slotTime;
+	tdma->announceSlot = 1;
+	tdma->beaconCycles = DWT->CYCCNT - NRF24L01_TdmaGetSuperframeCycles(tdma); //First beacon is due now
+	return NRF24L01_SetTxAddress(device, beaconAddress) && NRF24L01_SetRxAddress(device, 1, uplinkAddress);
+}
+
+bool NRF24L01_TdmaInitNode(NRF24L01_Tdma *tdma, NRF24L01_Device *device, uint64_t beaconAddress,
+		uint64_t uplinkAddress, uint8_t nodeId) {
+	if (nodeId == 0) {
+		return false;
+	}
+
+	NRF24L01_TdmaInit(tdma, device, beaconAddress, uplinkAddress);
+	tdma->nodeId = nodeId;
+	tdma->joinWindow = 1;
+	tdma->random = (nodeId * 0x9E37) ^ DWT->CYCCNT;
+	if (tdma->random == 0) {
+		tdma->random = 0xACE1; //Xorshift never leaves zero state
+	}
+	return true;
+}
+
+bool NRF24L01_TdmaTransmitPacket(NRF24L01_Tdma *tdma, const uint8_t *data, uint8_t size, uint32_t timeout) {
+	if (tdma->gateway || size > NRF24L01_TDMA_MAX_PAYLOAD) {
+		return false;
+	}
+
+	uint32_t startCycles = DWT->CYCCNT;
+	uint32_t deadline = HAL_GetTick() + timeout;
+	uint32_t slotStart;
+	uint32_t nextBeacon;
+	while ((int32_t) (deadline - HAL_GetTick()) > 0) {
+		NRF24L01_TdmaPredictBeacon(tdma);
+		if (!tdma->synchronized) {
+			NRF24L01_TdmaWaitForBeacon(tdma, deadline);
+			continue;
+		}
+
+		//Assignment comes with one of the next beacons
+		if (tdma->slot == NRF24L01_TDMA_NO_SLOT) {
+			NRF24L01_TdmaJoin(tdma, deadline);
+			tdma->synchronized = false;
+			continue;
+		}
+
+		//Slot of this superframe has passed, try the next one. If it needs a real beacon, listening starts
+		//a bit earlier, otherwise the beacon would be missed and so would the slot.
+		slotStart = NRF24L01_TdmaGetSlotStart(tdma, tdma->slot);
+		if (NRF24L01_TdmaReached(slotStart)) {
+			tdma->stats.lateSlots++;
+			nextBeacon = tdma->beaconCycles + NRF24L01_TdmaGetSuperframeCycles(tdma);
+			if (tdma->predictedBeacons + 1 >= tdma->resyncInterval) {
+				nextBeacon -= NRF24L01_TdmaUsToCycles(1000);
+				tdma->synchronized = false;
+			}
+			if (!NRF24L01_TdmaWaitUntil(nextBeacon, deadline)) {
+				return false;
+			}
+			continue;
+		}
+
+		uint8_t packet[32];
+		packet[0] = NRF24L01_TDMA_DATA_MARKER;
+		packet[1] = tdma->nodeId;
+		packet[2] = size;
+		memcpy(&packet[NRF24L01_TDMA_HEADER_SIZE], data, size);
+		NRF24L01_SetTxAddress(tdma->device, tdma->uplinkAddress);
+		if (!NRF24L01_TdmaWaitUntil(slotStart, deadline)) {
+			return false;
+		}
+
+		if (!NRF24L01_TransmitPacket(tdma->device, packet, NRF24L01_TDMA_HEADER_SIZE + size)) {
+			tdma->stats.failed++;
+			return false;
+		}
+		uint32_t latency = (DWT->CYCCNT - startCycles) / NRF24L01_TdmaUsToCycles(1);
+		if (latency > tdma->stats.latencyMax) {
+			tdma->stats.latencyMax = latency;
+		}
+		tdma->stats.packets++;
+		return true;
+	}
+
+	return false;
+}
+
+bool NRF24L01_TdmaReceive(NRF24L01_Tdma *tdma, uint8_t *nodeId, uint8_t *buffer, uint8_t *size, uint32_t timeout) {
+	if (!tdma->gateway) {
+		return false;
+	}
+
+	uint8_t packet[32];
+	uint32_t nextBeacon;
+	uint32_t start = HAL_GetTick();
+	while ((HAL_GetTick() - start) < timeout) {
+		//Listening takes up to 1 ms, so the last part before beacon is waited out to keep the schedule exact
+		nextBeacon = tdma->beaconCycles + NRF24L01_TdmaGetSuperframeCycles(tdma);
+		if (NRF24L01_TdmaReached(nextBeacon - NRF24L01_TdmaUsToCycles(1000))) {
+			if (NRF24L01_TdmaReached(nextBeacon + NRF24L01_TdmaUsToCycles(NRF24L01_TDMA_GUARD_TIME))) {
+				nextBeacon = DWT->CYCCNT; //Called too late, schedule restarts and nodes resynchronize
+			}
+			while (!NRF24L01_TdmaReached(nextBeacon))
+				;
+			tdma->beaconCycles = nextBeacon;
+			NRF24L01_TdmaSendBeacon(tdma);
+		}
+
+		if (!NRF24L01_ReceivePacket(tdma->device, 1, packet, 1)) {
+			continue;
+		}
+		if (packet[0] == NRF24L01_TDMA_JOIN_MARKER) {
+			NRF24L01_TdmaAssignSlot(tdma, packet[1]);
+		} else if (packet[0] == NRF24L01_TDMA_DATA_MARKER && packet[2] <= NRF24L01_TDMA_MAX_PAYLOAD) {
+			*nodeId = packet[1];
+			*size = packet[2];
+			memcpy(buffer, &packet[NRF24L01_TDMA_HEADER_SIZE], *size);
+			tdma->stats.packets++;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void NRF24L01_TdmaReleaseNode(NRF24L01_Tdma *tdma, uint8_t nodeId) {
+	for (uint8_t slot = 1; slot <= tdma->numberOfSlots; slot++) {
+		if (tdma->slotOwners[slot] == nodeId) {
+			tdma->slotOwners[slot] = 0;
+		}
+	}
+}
+
+void NRF24L01_TdmaGetStats(NRF24L01_Tdma *tdma, NRF24L01_TdmaStats *stats, bool reset) {
+	*stats = tdma->stats;
+	if (reset) {
+		memset(&tdma->stats, 0, sizeof(NRF24L01_TdmaStats));
+	}
+}
@@ -0,0 +1,158 @@
+/**
+ * @brief Implementation of reliable transport layer for nRF24L01+ library
+ *
+ * Author: Dmytro Novytskyi
+ * Version: 1.0
+ */
+
+#include "NRF24L01_Transport.h"
+
+//Fragments are placed by sequence number, duplicates are ignored.
+//ACK of acknowledged fragment may still be waiting to go on air with the pending status, so it is kept.
+static NRF24L01_FragmentResult NRF24L01_TransportHandleFragment(void *context, const uint8_t *packet,
+		uint8_t *buffer) {
+	NRF24L01_Transport *transport = context;
+	if (packet[2] == NRF24L01_TRANSPORT_HEADER_SIZE) {
+		return FRAGMENT_IGNORED; //Header-only fragment opens a message, its ACK takes the stale status
+	}
+	uint16_t sequence = ((packet[3] & ~NRF24L01_TRANSPORT_ACK_FLAG) << 8) | packet[4];
+	if (!NRF24L01_ReassemblyPlace(&transport->rx, buffer, sequence, &packet[NRF24L01_TRANSPORT_HEADER_SIZE])) {
+		return FRAGMENT_IGNORED;
+	}
+	if (!(packet[3] & NRF24L01_TRANSPORT_ACK_FLAG)) {
+		NRF24L01_ReassemblyWriteStatus(&transport->rx, transport->device, transport->pipe,
+				NRF24L01_TRANSPORT_STATUS_MARKER, true);
+	}
+	return FRAGMENT_ACCEPTED;
+}
+
+static bool NRF24L01_TransportIsDelivered(NRF24L01_Transport *transport, uint16_t sequence) {
+	return transport->txBitmap[sequence / 8] & (1 << (sequence % 8));
+}
+
+static void NRF24L01_TransportSetDelivered(NRF24L01_Transport *transport, uint16_t sequence) {
+	transport->txBitmap[sequence / 8] |= 1 << (sequence % 8);
+}
+
+//Takes every ACK payload received so far, status of the message being sent marks fragments delivered
+static void NRF24L01_TransportReadStatus(NRF24L01_Transport *transport, uint16_t numberOfFragments) {
+	NRF24L01_ReassemblyStatus status;
+	if (!NRF24L01_ReassemblyReadStatus(transport->device, NRF24L01_TRANSPORT_STATUS_MARKER, transport->messageId,
+			&status)) {
+		return;
+	}
+	for (uint16_t sequence = 0; sequence < numberOfFragments; sequence++) {
+		if (NRF24L01_ReassemblyStatusHas(&status, sequence)) {
+			NRF24L01_TransportSetDelivered(transport, sequence);
+		}
+	}
+}
+
+void NRF24L01_TransportInit(NRF24L01_Transport *transport, NRF24L01_Device *device, uint8_t pipe,
+		uint8_t packetSize, uint8_t window) {
+	memset(transport, 0, sizeof(NRF24L01_Transport));
+	transport->device = device;
+	transport->pipe = pipe;
+	transport->packetSize = packetSize;
+	transport->window = window > NRF24L01_TRANSPORT_MAX_WINDOW ? NRF24L01_TRANSPORT_MAX_WINDOW : window;
+	if (transport->window == 0) {
+		transport->window = 1;
+	}
+	transport->maxRetransmissions = 32;
+	NRF24L01_ReassemblyInit(&transport->rx);
+}
+
+bool NRF24L01_TransportSend(NRF24L01_Transport *transport, const uint8_t *data, uint16_t size) {
+	if (transport->packetSize <= NRF24L01_TRANSPORT_HEADER_SIZE || transport->packetSize > 32) {
+		return false;
+	}
+
+	uint8_t chunkSize = transport->packetSize - NRF24L01_TRANSPORT_HEADER_SIZE;
+	uint16_t numberOfFragments = NRF24L01_FragmentCount(size, chunkSize);
+	if (numberOfFragments > NRF24L01_TRANSPORT_MAX_FRAGMENTS) {
+		return false;
+	}
+
+	uint8_t packet[32];
+	uint16_t failures = 0;
+	uint16_t base = 0; //Oldest not delivered fragment
+	uint16_t last;
+	uint8_t length;
+	bool queued;
+
+	transport->messageId++;
+	memset(transport->txBitmap, 0, sizeof(transport->txBitmap));
+	packet[0] = NRF24L01_TRANSPORT_FRAME_MARKER;
+	packet[1] = transport->messageId;
+	packet[2] = transport->packetSize;
+	packet[3] = 0;
+	packet[4] = 0;
+	packet[5] = size >> 8;
+	packet[6] = size;
+
+	//ACK payload pending at the receiver may be a status of an earlier message with the same id(e.g. sent before
+	//reboot), it goes with the ACK of header-only fragment and is dropped together with older ones
+	if (transport->window > 1) {
+		packet[2] = NRF24L01_TRANSPORT_HEADER_SIZE;
+		while (!NRF24L01_TransmitPacket(transport->device, packet, NRF24L01_TRANSPORT_HEADER_SIZE)) {
+			if (++failures > transport->maxRetransmissions) {
+				return false;
+			}
+		}
+		packet[2] = transport->packetSize;
+	}
+	NRF24L01_TransportReadStatus(transport, 0);
+
+	while (base < numberOfFragments) {
+		//Window ends with its last not delivered fragment, which is the only one sent with ACK
+		last = (base + transport->window < numberOfFragments ? base + transport->window : numberOfFragments) - 1;
+		while (NRF24L01_TransportIsDelivered(transport, last)) {
+			last--;
+		}
+
+		queued = false;
+		for (uint16_t sequence = base; sequence <= last; sequence++) {
+			if (NRF24L01_TransportIsDelivered(transport, sequence)) {
+				continue;
+			}
+			length = NRF24L01_FragmentLength(size, chunkSize, sequence);
+			packet[3] = sequence >> 8;
+			packet[4] = sequence;
+			memcpy(&packet[NRF24L01_TRANSPORT_HEADER_SIZE], &data[sequence * chunkSize], length);
+			memset(&packet[NRF24L01_TRANSPORT_HEADER_SIZE + length], 0x00, chunkSize - length);
+
+			if (sequence < last) {
+				queued = NRF24L01_TransmitPacketNoAck(transport->device, packet, transport->packetSize) || queued;
+				continue;
+			}
+			packet[3] |= NRF24L01_TRANSPORT_ACK_FLAG;
+			if (queued) {
+				NRF24L01_FlushNoAck(transport->device, NRF24L01_TRANSPORT_FLUSH_TIMEOUT);
+			}
+			if (NRF24L01_TransmitPacket(transport->device, packet, transport->packetSize)) {
+				NRF24L01_TransportSetDelivered(transport, sequence);
+			}
+			//Without header-only fragment ACK payload may be stale, it is only taken out of the queue
+			NRF24L01_TransportReadStatus(transport, transport->window > 1 ? numberOfFragments : 0);
+		}
+
+		//Fragments of the window missing from receiver's bitmap are sent again in the next one
+		for (uint16_t sequence = base; sequence <= last; sequence++) {
+			if (!NRF24L01_TransportIsDelivered(transport, sequence) && ++failures > transport->maxRetransmissions) {
+				return false;
+			}
+		}
+		while (base < numberOfFragments && NRF24L01_TransportIsDelivered(transport, base)) {
+			base++;
+		}
+	}
+
+	return true;
+}
+
+bool NRF24L01_TransportReceive(NRF24L01_Transport *transport, uint8_t *buffer, uint16_t bufferSize, uint16_t *size,
+		uint32_t timeout) {
+	return NRF24L01_ReassemblyReceive(&transport->rx, transport->device, transport->pipe,
+			NRF24L01_TRANSPORT_FRAME_MARKER, NRF24L01_TRANSPORT_HEADER_SIZE, NRF24L01_TransportHandleFragment, transport,
+			buffer, bufferSize, size, timeout);
+}